@@ -1,4 +1,7 @@
 TEMPLATE = subdirs
 
 SUBDIRS += \
-    modbus-config-editor
+    modbus-config-editor \
+    modbus-probe \
+    modbus-simulator \
+    tests
@@ -0,0 +1,95 @@
+#include "aggregatekernel.h"
+
+#include "cpufeatures.h"
+
+#include <QtGlobal>
+
+#include <cmath>
+
+#if defined(MODBUS_CONFIG_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+#if defined(MODBUS_CONFIG_X86)
+// min / max возвращают второй операнд, если первый NaN, поэтому NaN
+// отбрасываются без отдельной маски; для суммы и количества маска нужна
+MODBUS_CONFIG_TARGET("avx")
+int accumulateAvx(const double *values, int count, ModbusConfig::AggregateState *state)
+{
+    const __m256d one = _mm256_set1_pd(1);
+    __m256d sum[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    __m256d valid[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    __m256d min[2] = {_mm256_set1_pd(state->min), _mm256_set1_pd(state->min)};
+    __m256d max[2] = {_mm256_set1_pd(state->max), _mm256_set1_pd(state->max)};
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int k = 0; k < 2; ++k) {
+            const __m256d v = _mm256_loadu_pd(values + i + 4 * k);
+            const __m256d ordered = _mm256_cmp_pd(v, v, _CMP_ORD_Q);
+            sum[k] = _mm256_add_pd(sum[k], _mm256_and_pd(ordered, v));
+            valid[k] = _mm256_add_pd(valid[k], _mm256_and_pd(ordered, one));
+            min[k] = _mm256_min_pd(v, min[k]);
+            max[k] = _mm256_max_pd(v, max[k]);
+        }
+    }
+    if (i == 0) {
+        return 0;
+    }
+    double lanes[4][4];
+    _mm256_storeu_pd(lanes[0], _mm256_add_pd(sum[0], sum[1]));
+    _mm256_storeu_pd(lanes[1], _mm256_add_pd(valid[0], valid[1]));
+    _mm256_storeu_pd(lanes[2], _mm256_min_pd(min[0], min[1]));
+    _mm256_storeu_pd(lanes[3], _mm256_max_pd(max[0], max[1]));
+    state->sum += (lanes[0][0] + lanes[0][1]) + (lanes[0][2] + lanes[0][3]);
+    state->count += int((lanes[1][0] + lanes[1][1]) + (lanes[1][2] + lanes[1][3]));
+    state->min = qMin(qMin(lanes[2][0], lanes[2][1]), qMin(lanes[2][2], lanes[2][3]));
+    state->max = qMax(qMax(lanes[3][0], lanes[3][1]), qMax(lanes[3][2], lanes[3][3]));
+    return i;
+}
+#endif
+
+}
+
+namespace ModbusConfig {
+
+void accumulate(const double *values, int count, AggregateState *state)
+{
+    int i = 0;
+#if defined(MODBUS_CONFIG_X86)
+    if (cpuFeatures().avx) {
+        i = accumulateAvx(values, count, state);
+    }
+#endif
+    for (; i < count; ++i) {
+        const double value = values[i];
+        if (std::isnan(value)) {
+            continue;
+        }
+        state->sum += value;
+        state->count += 1;
+        state->min = qMin(state->min, value);
+        state->max = qMax(state->max, value);
+    }
+}
+
+double aggregateValue(Sensor::Aggregation aggregation, const AggregateState &state)
+{
+    if (state.count == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    switch (aggregation) {
+    case Sensor::Aggregation::Sum:
+        return state.sum;
+    case Sensor::Aggregation::Min:
+        return state.min;
+    case Sensor::Aggregation::Max:
+        return state.max;
+    case Sensor::Aggregation::Average:
+        return state.sum / state.count;
+    }
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+}
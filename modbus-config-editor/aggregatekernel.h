@@ -0,0 +1,23 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <limits>
+
+namespace ModbusConfig {
+
+// Частичный результат свёртки: диапазон карты может приходить несколькими запросами.
+// NaN в исходных значениях пропускаются и не учитываются в count.
+struct AggregateState {
+    double sum{};
+    double min{std::numeric_limits<double>::infinity()};
+    double max{-std::numeric_limits<double>::infinity()};
+    int count{};
+};
+
+// добавляет блок декодированных значений, при наличии AVX - векторно
+void accumulate(const double *values, int count, AggregateState *state);
+// NaN, если в диапазоне не нашлось ни одного значения
+double aggregateValue(Sensor::Aggregation aggregation, const AggregateState &state);
+
+}
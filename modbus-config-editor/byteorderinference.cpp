@@ -0,0 +1,255 @@
+#include "byteorderinference.h"
+
+#include "registerdecoder.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace {
+// столько значений достаточно, чтобы отсеять явно неверные перестановки
+constexpr int prefixValues = 16;
+constexpr int minFullCandidates = 64;
+// без заданного диапазона значения по модулю больше этого считаются неправдоподобными
+constexpr double plausibleMagnitude = 1e12;
+// для float: значения меньше этой доли масштаба (и не равные нулю) считаются мусором
+constexpr double floatResolution = 1e-9;
+constexpr double minFloatMagnitude = 1e-20;
+constexpr double jitterWeight = 0.25;
+constexpr double magnitudeWeight = 0.01;
+// перестановки младших байт почти не меняют значения, поэтому при близких оценках
+// предпочитаются порядки, которые реально встречаются: регистры целиком с общим swap байт,
+// а среди них - прямой и обратный порядок регистров
+constexpr double orderPriorStep = 0.005;
+constexpr int decodeChunk = 256;
+
+using ModbusConfig::ByteOrderCandidate;
+using ModbusConfig::RegisterAddress;
+using ModbusConfig::RegisterDecoder;
+
+struct Range {
+    bool known{};
+    double min{};
+    double max{};
+    // масштаб для скачков: ширина диапазона или разрядность целого типа
+    double scale{};
+    // для float - минимальный правдоподобный модуль ненулевого значения
+    double resolution{};
+};
+
+bool isFloatType(RegisterAddress::ValType type)
+{
+    return type == RegisterAddress::ValType::Float || type == RegisterAddress::ValType::Double;
+}
+
+bool isPlausible(double value, const Range &range)
+{
+    if (!std::isfinite(value)) {
+        return false;
+    }
+    const double magnitude = std::fabs(value);
+    // неверный порядок байт у float часто даёт исчезающе малые числа
+    if (value != 0 && magnitude < range.resolution) {
+        return false;
+    }
+    if (range.known) {
+        return value >= range.min && value <= range.max;
+    }
+    return magnitude <= plausibleMagnitude;
+}
+
+double orderPrior(const QString &typeOrder)
+{
+    if (typeOrder.size() < 2) {
+        return 2 * orderPriorStep;
+    }
+    const int swap = (typeOrder.at(0).digitValue() - 1) % 2;
+    bool ascending = true;
+    bool descending = true;
+    for (int i = 0; i < typeOrder.size(); i += 2) {
+        const int high = typeOrder.at(i).digitValue() - 1;
+        const int low = typeOrder.at(i + 1).digitValue() - 1;
+        if (high % 2 != swap || low != high + 1 - 2 * swap) {
+            return 0;
+        }
+        ascending = ascending && high / 2 == i / 2;
+        descending = descending && high / 2 == (typeOrder.size() - i) / 2 - 1;
+    }
+    return ascending || descending ? 2 * orderPriorStep : orderPriorStep;
+}
+
+ByteOrderCandidate evaluate(const QString &typeOrder, RegisterAddress::ValType type,
+    const QByteArray &registers, int count, const Range &range)
+{
+    ByteOrderCandidate result;
+    result.typeOrder = typeOrder;
+    RegisterDecoder decoder(type, typeOrder);
+    if (!decoder.isValid() || count <= 0) {
+        result.score = -1;
+        return result;
+    }
+    const auto *raw = reinterpret_cast<const quint8 *>(registers.constData());
+    double decoded[decodeChunk];
+    int plausible = 0;
+    int steps = 0;
+    double jumps = 0;
+    double magnitude = 0;
+    double previous = std::numeric_limits<double>::quiet_NaN();
+    for (int first = 0; first < count; first += decodeChunk) {
+        const int size = qMin(decodeChunk, count - first);
+        decoder.decode(raw + first * decoder.valueSize(), size, decoded);
+        for (int i = 0; i < size; ++i) {
+            const double value = decoded[i];
+            if (!isPlausible(value, range)) {
+                previous = std::numeric_limits<double>::quiet_NaN();
+                continue;
+            }
+            ++plausible;
+            magnitude += std::fabs(value);
+            if (!std::isnan(previous)) {
+                jumps += std::fabs(value - previous);
+                ++steps;
+            }
+            previous = value;
+        }
+    }
+    result.inRange = double(plausible) / count;
+    result.score = result.inRange;
+    result.score += orderPrior(typeOrder);
+    if (plausible == 0) {
+        result.jitter = 1;
+        result.score -= jitterWeight;
+        return result;
+    }
+    magnitude /= plausible;
+    // у верного порядка меняются младшие байты, у неверного изменения попадают в старшие
+    const double scale = range.scale > 0 ? range.scale : magnitude + 1;
+    result.jitter = steps > 0 ? qMin(jumps / steps / scale, 1.0) : 0;
+    result.score -= jitterWeight * result.jitter;
+    if (!range.known) {
+        // при прочих равных верный порядок даёт меньшие по модулю числа
+        result.score -= magnitudeWeight * std::log10(1 + magnitude);
+    }
+    return result;
+}
+
+}
+
+namespace ModbusConfig {
+
+void ByteOrderInference::setResultCount(int count)
+{
+    mResultCount = qMax(count, 1);
+}
+
+QVector<ByteOrderCandidate> ByteOrderInference::rank(const ByteOrderCapture &capture) const
+{
+    return rankCapture(capture, true);
+}
+
+QVector<QVector<ByteOrderCandidate>> ByteOrderInference::rank(
+    const QVector<ByteOrderCapture> &captures) const
+{
+    QVector<QVector<ByteOrderCandidate>> result(captures.size());
+    QVector<int> indices(captures.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    auto *out = result.data();
+    QtConcurrent::blockingMap(indices, [this, &captures, out](int index) {
+        out[index] = rankCapture(captures.at(index), false);
+    });
+    return result;
+}
+
+QStringList ByteOrderInference::candidateOrders(RegisterAddress::ValType type)
+{
+    quint8 order[8];
+    const int size = typeOrderPermutation(type, QString(), order);
+    if (size == 0 || type == RegisterAddress::ValType::Bool
+        || type == RegisterAddress::ValType::Int8 || type == RegisterAddress::ValType::UInt8) {
+        return {QString()};
+    }
+    QString permutation;
+    for (int i = 1; i <= size; ++i) {
+        permutation.append(QString::number(i));
+    }
+    // лексикографический перебор начинается с "12..N"
+    QStringList result;
+    do {
+        result.append(permutation);
+    } while (std::next_permutation(permutation.begin(), permutation.end()));
+    return result;
+}
+
+QVector<ByteOrderCandidate> ByteOrderInference::rankCapture(
+    const ByteOrderCapture &capture, bool parallel) const
+{
+    Range range;
+    if (!capture.minValue.isNull() && !capture.maxValue.isNull()
+        && capture.minValue.toDouble() < capture.maxValue.toDouble()) {
+        range.known = true;
+        range.min = capture.minValue.toDouble();
+        range.max = capture.maxValue.toDouble();
+        range.scale = range.max - range.min;
+    }
+    quint8 order[8];
+    const int valueSize = typeOrderPermutation(capture.valType, QString(), order);
+    if (valueSize == 0) {
+        return {};
+    }
+    if (isFloatType(capture.valType)) {
+        range.resolution = qMax(range.scale * floatResolution, minFloatMagnitude);
+    } else if (!range.known) {
+        range.scale = std::ldexp(1.0, 8 * valueSize);
+    }
+    const int count = capture.registers.size() / valueSize;
+    const QStringList orders = candidateOrders(capture.valType);
+
+    QVector<ByteOrderCandidate> candidates(orders.size());
+    for (int i = 0; i < orders.size(); ++i) {
+        candidates[i].typeOrder = orders.at(i);
+    }
+    // индексы оцениваемых кандидатов в порядке генерации
+    QVector<int> active(candidates.size());
+    std::iota(active.begin(), active.end(), 0);
+    auto *out = candidates.data();
+    auto evaluateActive = [&](int valueCount) {
+        auto job = [&, out, valueCount](int index) {
+            out[index] = evaluate(out[index].typeOrder, capture.valType, capture.registers,
+                valueCount, range);
+        };
+        // распараллеливать есть смысл только полный перебор 8-байтных перестановок
+        if (parallel && active.size() > minFullCandidates) {
+            QtConcurrent::blockingMap(active, job);
+        } else {
+            std::for_each(active.begin(), active.end(), job);
+        }
+    };
+    // при равных оценках сохраняется порядок генерации, то есть выигрывает "12..N"
+    auto sortActive = [&]() {
+        std::stable_sort(active.begin(), active.end(), [out](int l, int r) {
+            return out[l].score > out[r].score;
+        });
+    };
+
+    const int keep = qMax(mResultCount * 4, minFullCandidates);
+    if (active.size() > keep && count > prefixValues) {
+        evaluateActive(prefixValues);
+        sortActive();
+        active.resize(keep);
+        std::sort(active.begin(), active.end());
+    }
+    evaluateActive(count);
+    sortActive();
+
+    QVector<ByteOrderCandidate> result;
+    result.reserve(qMin(active.size(), mResultCount));
+    for (int i = 0; i < active.size() && i < mResultCount; ++i) {
+        result.append(candidates.at(active.at(i)));
+    }
+    return result;
+}
+
+}
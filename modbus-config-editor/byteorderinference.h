@@ -0,0 +1,56 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QByteArray>
+#include <QVector>
+
+namespace ModbusConfig {
+
+// Снятые с линии значения датчика или карты регистров: registers - регистры подряд
+// в том виде, как пришли по сети (старший байт первым), значения идут в порядке съёма.
+struct ByteOrderCapture {
+    RegisterAddress::ValType valType{RegisterAddress::ValType::Unknown};
+    QByteArray registers;
+    // ожидаемый диапазон, пустые значения - диапазон неизвестен
+    QVariant minValue;
+    QVariant maxValue;
+};
+
+struct ByteOrderCandidate {
+    QString typeOrder;
+    // доля конечных значений, попавших в ожидаемый диапазон
+    double inRange{};
+    // средний скачок между соседними значениями относительно масштаба значений
+    double jitter{};
+    // итоговая правдоподобность, больше - лучше
+    double score{};
+};
+
+// Подбор typeOrder по снятым значениям: каждая перестановка байт, которую допускает
+// checkValOrder, декодирует выборку, а кандидаты ранжируются по правдоподобности значений.
+// Для 8-байтных типов все 40320 перестановок сначала оцениваются по короткому префиксу
+// выборки, полностью проверяются только лучшие.
+class ByteOrderInference
+{
+public:
+    ByteOrderInference() = default;
+
+    // сколько лучших кандидатов возвращать
+    void setResultCount(int count);
+
+    QVector<ByteOrderCandidate> rank(const ByteOrderCapture &capture) const;
+    // выборки обрабатываются параллельно
+    QVector<QVector<ByteOrderCandidate>> rank(const QVector<ByteOrderCapture> &captures) const;
+
+    // все допустимые порядки для типа, для 8-битных типов и Bool - только пустой
+    static QStringList candidateOrders(RegisterAddress::ValType type);
+
+private:
+    QVector<ByteOrderCandidate> rankCapture(const ByteOrderCapture &capture, bool parallel) const;
+
+private:
+    int mResultCount{8};
+};
+
+}
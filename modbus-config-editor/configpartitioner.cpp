@@ -0,0 +1,195 @@
+#include "configpartitioner.h"
+
+#include "pollplanner.h"
+#include "serializer.h"
+#include "utils.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMap>
+
+#include <algorithm>
+
+namespace {
+constexpr const char * nodesKey = "nodes";
+constexpr const char * deviceCountKey = "device_count";
+constexpr const char * channelsKey = "channels";
+constexpr const char * busTimeKey = "bus_time";
+constexpr const char * requestRateKey = "request_rate";
+
+struct Channel {
+    QStringList keys;
+    QList<QUuid> devices;
+    double busTime{};
+    int requestCount{};
+    // запросов в секунду при непрерывном опросе линий канала
+    double requestRate{};
+    double score{};
+};
+
+QString rootKey(QHash<QString, QString> *parents, QString key)
+{
+    while (parents->value(key, key) != key) {
+        const QString parent = parents->value(key);
+        (*parents)[key] = parents->value(parent, parent);
+        key = parent;
+    }
+    return key;
+}
+
+QString writeJson(const QString &path, const QJsonObject &obj)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return QObject::tr("Не удалось открыть файл '%0' на запись: %1")
+            .arg(path, file.errorString());
+    }
+    if (file.write(QJsonDocument(obj).toJson()) < 0) {
+        return QObject::tr("Ошибка записи в файл '%0': %1").arg(path, file.errorString());
+    }
+    return {};
+}
+
+}
+
+namespace ModbusConfig {
+
+QJsonObject PartitionReport::toJson() const
+{
+    QJsonArray nodesArray;
+    for (const auto &node : nodes) {
+        QJsonObject nodeObj;
+        nodeObj[deviceCountKey] = node.deviceCount;
+        nodeObj[channelsKey] = QJsonArray::fromStringList(node.channels);
+        nodeObj[busTimeKey] = node.busTime;
+        nodeObj[requestRateKey] = node.requestRate;
+        nodesArray.append(nodeObj);
+    }
+    QJsonObject result;
+    result[nodesKey] = nodesArray;
+    return result;
+}
+
+QVector<ModbusConfigModel> ConfigPartitioner::partition(
+    const ModbusConfigModel &model, int nodeCount, PartitionReport *report) const
+{
+    nodeCount = qMax(1, nodeCount);
+    const auto &plan = model.pollPlan();
+
+    // устройства на одной линии / одном tcp адресе не разделяются
+    QMap<QString, Channel> channelsByKey;
+    QHash<QUuid, QString> sensorChannels;
+    const auto devicesIds = model.devicesIds();
+    for (const auto &devId : devicesIds) {
+        const auto &device = model.device(devId);
+        auto key = channelKey(device.settings.connectionParams);
+        auto &channel = channelsByKey[key];
+        channel.keys = QStringList{key};
+        channel.devices.append(devId);
+        auto requests = plan.deviceRequests(devId);
+        channel.busTime += PollCostModel(device.settings.connectionParams).cycleTime(requests);
+        channel.requestCount += requests.size();
+        for (auto it = device.sensors.cbegin(); it != device.sensors.cend(); ++it) {
+            sensorChannels.insert(it.key(), key);
+        }
+    }
+    for (auto &channel : channelsByKey) {
+        channel.requestRate = channel.busTime > 0 ? channel.requestCount / channel.busTime : 0;
+    }
+
+    // каналы, датчики которых ссылаются друг на друга, попадают на один узел,
+    // иначе конфигурация узла не будет самостоятельной
+    QHash<QString, QString> parents;
+    for (auto it = sensorChannels.cbegin(); it != sensorChannels.cend(); ++it) {
+        const auto correction = model.sensorCorrection(it.key());
+        if (!correction) {
+            continue;
+        }
+        for (const auto &reference : correction->references()) {
+            auto refIt = sensorChannels.constFind(reference);
+            if (refIt == sensorChannels.cend()) {
+                continue;
+            }
+            const QString from = rootKey(&parents, it.value());
+            const QString to = rootKey(&parents, refIt.value());
+            if (from != to) {
+                parents[qMax(from, to)] = qMin(from, to);
+            }
+        }
+    }
+    QMap<QString, Channel> groups;
+    for (const auto &channel : qAsConst(channelsByKey)) {
+        auto &group = groups[rootKey(&parents, channel.keys.first())];
+        group.keys += channel.keys;
+        group.devices += channel.devices;
+        group.busTime += channel.busTime;
+        group.requestCount += channel.requestCount;
+        group.requestRate += channel.requestRate;
+    }
+
+    QVector<Channel> channels;
+    channels.reserve(groups.size());
+    double totalBusTime = 0;
+    double totalRate = 0;
+    for (const auto &channel : qAsConst(groups)) {
+        channels.append(channel);
+        totalBusTime += channel.busTime;
+        totalRate += channel.requestRate;
+    }
+    // нагрузка канала: доля занятости линий плюс доля потока запросов
+    for (auto &channel : channels) {
+        channel.score = (totalBusTime > 0 ? channel.busTime / totalBusTime : 0)
+            + (totalRate > 0 ? channel.requestRate / totalRate : 0);
+    }
+    std::stable_sort(channels.begin(), channels.end(), [](const Channel &l, const Channel &r) {
+        return l.score > r.score;
+    });
+
+    QVector<ModbusConfigModel> result(nodeCount);
+    QVector<double> scores(nodeCount, 0);
+    QVector<NodeLoad> loads(nodeCount);
+    for (auto &partition : result) {
+        partition.setCommonSettings(model.commonSettings());
+    }
+
+    for (const auto &channel : qAsConst(channels)) {
+        int node = static_cast<int>(
+            std::min_element(scores.cbegin(), scores.cend()) - scores.cbegin());
+        scores[node] += channel.score;
+        auto &load = loads[node];
+        load.channels += channel.keys;
+        load.busTime += channel.busTime;
+        load.requestRate += channel.requestRate;
+        for (const auto &devId : channel.devices) {
+            result[node].insertDevice(model.device(devId));
+            ++load.deviceCount;
+        }
+    }
+
+    if (report) {
+        report->nodes = loads;
+    }
+    return result;
+}
+
+QString ConfigPartitioner::write(const QVector<ModbusConfigModel> &partitions,
+    const PartitionReport &report, const QString &dirPath, const QString &baseName)
+{
+    QDir dir(dirPath);
+    if (!dir.exists()) {
+        return QObject::tr("Каталог '%0' не существует").arg(dirPath);
+    }
+    Serializer serializer;
+    for (int i = 0; i < partitions.size(); ++i) {
+        auto path = dir.filePath(QString("%0_%1.json").arg(baseName).arg(i + 1));
+        QString error = writeJson(path, serializer.serialize(partitions.at(i), true));
+        if (!error.isEmpty()) {
+            return error;
+        }
+    }
+    return writeJson(dir.filePath(QString("%0_report.json").arg(baseName)), report.toJson());
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "modbusconfigmodel.h"
+
+#include <QJsonObject>
+#include <QVector>
+
+namespace ModbusConfig {
+
+struct NodeLoad {
+    int deviceCount{};
+    QStringList channels;
+    // суммарное время цикла опроса каналов узла, с
+    double busTime{};
+    // запросов в секунду при непрерывном опросе каналов
+    double requestRate{};
+};
+
+struct PartitionReport {
+    QVector<NodeLoad> nodes;
+
+    QJsonObject toJson() const;
+};
+
+class ConfigPartitioner
+{
+public:
+    ConfigPartitioner() = default;
+
+    QVector<ModbusConfigModel> partition(
+        const ModbusConfigModel &model, int nodeCount, PartitionReport *report) const;
+
+    static QString write(const QVector<ModbusConfigModel> &partitions,
+        const PartitionReport &report, const QString &dirPath, const QString &baseName);
+};
+
+}
@@ -0,0 +1,458 @@
+#include "connectivitychecker.h"
+
+#include "pollplanner.h"
+#include "seriallink.h"
+#include "utils.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtMath>
+
+#include <algorithm>
+
+namespace {
+// проверяется доступность, а не данные: достаточно одного регистра
+constexpr int readCount = 1;
+// границы корзин: 1, 2, 4 ... 1024 мс
+constexpr int latencyBoundCount = 11;
+
+double seconds(qint64 ns)
+{
+    return ns / 1e9;
+}
+
+QString socketError(const QTcpSocket *socket)
+{
+    switch (socket->error()) {
+    case QAbstractSocket::ConnectionRefusedError:
+        return QObject::tr("соединение отклонено");
+    case QAbstractSocket::RemoteHostClosedError:
+        return QObject::tr("устройство закрыло соединение");
+    case QAbstractSocket::HostNotFoundError:
+        return QObject::tr("адрес не найден");
+    case QAbstractSocket::NetworkError:
+        return QObject::tr("сеть недоступна");
+    default:
+        break;
+    }
+    return socket->errorString();
+}
+
+QString responseError(const quint8 *pdu, int size, ModbusConfig::FunctionCode function)
+{
+    const quint8 *data = nullptr;
+    const int result = ModbusConfig::readResponseData(pdu, size, function, readCount, &data);
+    if (result == 0) {
+        return {};
+    }
+    if (result > 0) {
+        return QObject::tr("исключение %0").arg(result);
+    }
+    return QObject::tr("некорректный ответ");
+}
+
+QString milliseconds(double seconds)
+{
+    return QString::number(seconds * 1000, 'f', seconds < 0.01 ? 2 : 1);
+}
+}
+
+namespace ModbusConfig {
+
+QStringList connectivityReportText(const ConnectivityReport &report, bool verbose)
+{
+    QStringList lines;
+    lines << QObject::tr("Устройств: %0, ответили без ошибок: %1, время проверки: %2 с")
+                 .arg(report.devices.size())
+                 .arg(report.okCount)
+                 .arg(report.elapsed, 0, 'f', 2);
+
+    const auto &bounds = report.latencyBounds;
+    lines << QObject::tr("Задержка ответа:");
+    for (int i = 0; i < report.latencyBins.size(); ++i) {
+        QString range;
+        if (i == 0) {
+            range = QString("< %0 мс").arg(milliseconds(bounds.first()));
+        } else if (i < bounds.size()) {
+            range = QString("%0 - %1 мс").arg(milliseconds(bounds.at(i - 1)),
+                milliseconds(bounds.at(i)));
+        } else {
+            range = QString(">= %0 мс").arg(milliseconds(bounds.last()));
+        }
+        lines << QString("    %0: %1").arg(range).arg(report.latencyBins.at(i));
+    }
+
+    if (!report.errors.isEmpty()) {
+        lines << QObject::tr("Ошибки:");
+        for (auto it = report.errors.cbegin(); it != report.errors.cend(); ++it) {
+            lines << QString("    %0: %1").arg(it.key()).arg(it.value());
+        }
+    }
+
+    QStringList devices;
+    for (const auto &device : report.devices) {
+        if (!verbose && device.error.isEmpty()) {
+            continue;
+        }
+        QString line = QString("    %0 (%1) %2: ")
+                           .arg(device.description, toString(device.devId), device.endpoint);
+        if (device.latency >= 0) {
+            line += QObject::tr("%0 мс").arg(milliseconds(device.latency));
+            if (!device.error.isEmpty()) {
+                line += ", ";
+            }
+        }
+        devices << line + device.error;
+    }
+    if (!devices.isEmpty()) {
+        lines << (verbose ? QObject::tr("Устройства:") : QObject::tr("Устройства с ошибками:"));
+        lines << devices;
+    }
+    return lines;
+}
+
+ConnectivityChecker::ConnectivityChecker(QObject *parent)
+    : QObject(parent)
+{
+}
+
+ConnectivityChecker::~ConnectivityChecker()
+{
+    abort();
+}
+
+void ConnectivityChecker::setMaxInFlight(int count)
+{
+    mMaxInFlight = qMax(1, count);
+}
+
+void ConnectivityChecker::setTimeout(int msec)
+{
+    mTimeout = qMax(1, msec);
+}
+
+void ConnectivityChecker::start(const ModbusConfigModel &model)
+{
+    abort();
+    mTargets.clear();
+    mLines.clear();
+    mQueue.clear();
+    mQueueHead = 0;
+    mInFlight = 0;
+    mDone = 0;
+    mReport = ConnectivityReport();
+
+    QHash<QString, int> lineIndex;
+    const auto &plan = model.pollPlan();
+    for (const auto &devId : model.devicesIds()) {
+        const auto &settings = model.device(devId).settings;
+        Target target;
+        target.params = settings.connectionParams;
+        const auto requests = plan.deviceRequests(devId);
+        if (!requests.isEmpty()) {
+            const auto &request = requests.first();
+            target.slaveAddress = request.slaveAddress;
+            target.function = readFunction(request.regType);
+            target.offset = pduAddress(request.regType, request.startAddress);
+            target.hasRequest = true;
+        }
+
+        const int index = mTargets.size();
+        if (target.hasRequest && target.params.type == ConnectionParams::Type::Tcp) {
+            mQueue.append(index);
+        } else if (target.hasRequest) {
+            const QString key = channelKey(target.params);
+            auto it = lineIndex.find(key);
+            if (it == lineIndex.end()) {
+                it = lineIndex.insert(key, mLines.size());
+                Line line;
+                line.params = target.params;
+                line.silence = qCeil(PollCostModel(target.params).silenceTime() * 1000);
+                mLines.append(line);
+                mQueue.append(-it.value() - 1);
+            }
+            mLines[it.value()].targets.append(index);
+        }
+        mTargets.append(target);
+
+        DeviceConnectivity result;
+        result.devId = devId;
+        result.description = settings.description;
+        result.endpoint = toString(target.params);
+        mReport.devices.append(result);
+    }
+    mSockets.fill(nullptr, mTargets.size());
+    mSentAt.fill(-1, mTargets.size());
+
+    mRunning = true;
+    mClock.start();
+    for (int i = 0; i < mTargets.size(); ++i) {
+        if (!mTargets.at(i).hasRequest) {
+            complete(i, tr("нет опрашиваемых регистров"));
+        }
+    }
+    if (mTargets.isEmpty()) {
+        buildReport();
+        return;
+    }
+    startNext();
+}
+
+void ConnectivityChecker::abort()
+{
+    if (!mRunning) {
+        return;
+    }
+    mRunning = false;
+    for (auto &socket : mSockets) {
+        if (socket) {
+            socket->disconnect();
+            socket->abort();
+            socket->deleteLater();
+            socket = nullptr;
+        }
+    }
+    for (auto &line : mLines) {
+        if (line.link) {
+            line.link->disconnect();
+            line.link->close();
+            line.link->deleteLater();
+            line.link = nullptr;
+            line.timer = nullptr;
+        }
+    }
+}
+
+bool ConnectivityChecker::isRunning() const
+{
+    return mRunning;
+}
+
+QByteArray ConnectivityChecker::requestFrame(int index, bool tcp) const
+{
+    const auto &target = mTargets.at(index);
+    QByteArray frame(tcp ? maxTcpFrameSize : maxRtuFrameSize, Qt::Uninitialized);
+    auto data = reinterpret_cast<quint8 *>(frame.data());
+    const int pduSize = encodeReadRequest(data + (tcp ? tcpPduOffset : rtuPduOffset),
+        target.function, target.offset, readCount);
+    // номер устройства в отчёте - идентификатор транзакции, каждому своё соединение
+    frame.resize(tcp ? finishTcpFrame(data, quint16(index), target.slaveAddress, pduSize)
+                     : finishRtuFrame(data, target.slaveAddress, pduSize));
+    return frame;
+}
+
+void ConnectivityChecker::startNext()
+{
+    while (mRunning && mInFlight < mMaxInFlight && mQueueHead < mQueue.size()) {
+        const int item = mQueue.at(mQueueHead++);
+        ++mInFlight;
+        if (item >= 0) {
+            startTcp(item);
+        } else {
+            startLine(-item - 1);
+        }
+    }
+}
+
+void ConnectivityChecker::startTcp(int index)
+{
+    const auto &params = mTargets.at(index).params;
+    auto socket = new QTcpSocket(this);
+    auto timer = new QTimer(socket);
+    timer->setSingleShot(true);
+    mSockets[index] = socket;
+
+    const qint64 startedAt = mClock.nsecsElapsed();
+    connect(socket, &QTcpSocket::connected, socket, [this, socket, timer, index, startedAt]() {
+        mReport.devices[index].connectTime = seconds(mClock.nsecsElapsed() - startedAt);
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        mSentAt[index] = mClock.nsecsElapsed();
+        socket->write(requestFrame(index, true));
+        timer->start(mTimeout);
+    });
+    connect(socket, &QTcpSocket::readyRead, socket, [this, socket, index]() {
+        onTcpResponse(socket, index);
+    });
+    connect(socket, &QAbstractSocket::errorOccurred, socket, [this, socket, index]() {
+        finishTcp(index, socketError(socket));
+    });
+    connect(timer, &QTimer::timeout, socket, [this, socket, index]() {
+        finishTcp(index, socket->state() == QAbstractSocket::ConnectedState
+            ? tr("нет ответа") : tr("таймаут подключения"));
+    });
+    timer->start(mTimeout);
+    socket->connectToHost(params.address, params.port);
+}
+
+void ConnectivityChecker::onTcpResponse(QTcpSocket *socket, int index)
+{
+    const QByteArray data = socket->peek(maxTcpFrameSize);
+    ModbusFrame frame;
+    const int length = parseTcpFrame(
+        reinterpret_cast<const quint8 *>(data.constData()), data.size(), &frame);
+    if (length < 0) {
+        return;
+    }
+    if (length == 0 || frame.transactionId != quint16(index)
+        || frame.unit != mTargets.at(index).slaveAddress) {
+        finishTcp(index, tr("некорректный ответ"), true);
+        return;
+    }
+    finishTcp(index, responseError(frame.pdu, frame.pduSize, mTargets.at(index).function), true);
+}
+
+void ConnectivityChecker::finishTcp(int index, const QString &error, bool responded)
+{
+    auto socket = mSockets.at(index);
+    if (!socket) {
+        return;
+    }
+    mSockets[index] = nullptr;
+    // вызывается из обработчиков сигналов сокета: удаление отложено, таймер удалится с ним
+    socket->disconnect();
+    socket->abort();
+    socket->deleteLater();
+    complete(index, error, responded ? mSentAt.at(index) : -1);
+    releaseSlot();
+}
+
+void ConnectivityChecker::startLine(int line)
+{
+    auto &state = mLines[line];
+    state.link = new SerialLink(this);
+    const QString error = state.link->open(state.params);
+    if (!error.isEmpty()) {
+        for (; state.next < state.targets.size(); ++state.next) {
+            complete(state.targets.at(state.next), error);
+        }
+        closeLine(line);
+        return;
+    }
+    state.timer = new QTimer(state.link);
+    state.timer->setSingleShot(true);
+    connect(state.link, &SerialLink::readyRead, state.link, [this, line]() {
+        onLineResponse(line);
+    });
+    connect(state.timer, &QTimer::timeout, state.link, [this, line]() {
+        finishLineRequest(line, tr("нет ответа"));
+    });
+    sendLineRequest(line);
+}
+
+void ConnectivityChecker::sendLineRequest(int line)
+{
+    auto &state = mLines[line];
+    if (!state.link) {
+        return;
+    }
+    if (state.next >= state.targets.size()) {
+        closeLine(line);
+        return;
+    }
+    // опоздавший ответ прошлого устройства не должен попасть в ответ этого
+    state.link->clear();
+    state.buffer.clear();
+    state.sentAt = mClock.nsecsElapsed();
+    state.timer->start(mTimeout);
+    const QString error = state.link->write(requestFrame(state.targets.at(state.next), false));
+    if (!error.isEmpty()) {
+        finishLineRequest(line, error);
+    }
+}
+
+void ConnectivityChecker::onLineResponse(int line)
+{
+    auto &state = mLines[line];
+    state.buffer += state.link->readAll();
+    if (!state.timer->isActive()) {
+        return;
+    }
+    const auto data = reinterpret_cast<const quint8 *>(state.buffer.constData());
+    const int length = rtuResponseLength(data, state.buffer.size());
+    if (length < 0 || state.buffer.size() < length) {
+        return;
+    }
+    const int index = state.targets.at(state.next);
+    ModbusFrame frame;
+    if (length == 0 || state.buffer.size() > length) {
+        finishLineRequest(line, tr("некорректный ответ"), true);
+    } else if (!parseRtuFrame(data, length, &frame)) {
+        finishLineRequest(line, tr("ошибка CRC"), true);
+    } else if (frame.unit != mTargets.at(index).slaveAddress) {
+        finishLineRequest(line, tr("ответ другого слейва"), true);
+    } else {
+        finishLineRequest(line,
+            responseError(frame.pdu, frame.pduSize, mTargets.at(index).function), true);
+    }
+}
+
+void ConnectivityChecker::finishLineRequest(int line, const QString &error, bool responded)
+{
+    auto &state = mLines[line];
+    state.timer->stop();
+    complete(state.targets.at(state.next++), error, responded ? state.sentAt : -1);
+    // межкадровая пауза перед запросом следующему слейву линии
+    QTimer::singleShot(state.silence, state.link, [this, line]() {
+        sendLineRequest(line);
+    });
+}
+
+void ConnectivityChecker::closeLine(int line)
+{
+    auto &state = mLines[line];
+    if (!state.link) {
+        return;
+    }
+    state.link->disconnect();
+    state.link->close();
+    state.link->deleteLater();
+    state.link = nullptr;
+    state.timer = nullptr;
+    releaseSlot();
+}
+
+void ConnectivityChecker::complete(int index, const QString &error, qint64 sentAt)
+{
+    auto &result = mReport.devices[index];
+    result.error = error;
+    if (sentAt >= 0) {
+        result.latency = seconds(mClock.nsecsElapsed() - sentAt);
+    }
+    ++mDone;
+    emit progress(mDone, mTargets.size());
+    if (mDone == mTargets.size()) {
+        buildReport();
+    }
+}
+
+void ConnectivityChecker::releaseSlot()
+{
+    --mInFlight;
+    startNext();
+}
+
+void ConnectivityChecker::buildReport()
+{
+    mRunning = false;
+    mReport.elapsed = seconds(mClock.nsecsElapsed());
+    mReport.latencyBounds.clear();
+    for (int i = 0; i < latencyBoundCount; ++i) {
+        mReport.latencyBounds.append((1 << i) / 1000.0);
+    }
+    mReport.latencyBins.fill(0, latencyBoundCount + 1);
+    for (const auto &device : qAsConst(mReport.devices)) {
+        if (device.error.isEmpty()) {
+            ++mReport.okCount;
+        } else {
+            ++mReport.errors[device.error];
+        }
+        if (device.latency >= 0) {
+            const auto bound = std::upper_bound(mReport.latencyBounds.cbegin(),
+                mReport.latencyBounds.cend(), device.latency);
+            ++mReport.latencyBins[int(bound - mReport.latencyBounds.cbegin())];
+        }
+    }
+    emit finished(mReport);
+}
+
+}
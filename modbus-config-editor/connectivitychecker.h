@@ -0,0 +1,121 @@
+#pragma once
+
+#include "modbusconfigmodel.h"
+#include "modbusframe.h"
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+#include <QVector>
+
+class QTcpSocket;
+class QTimer;
+
+namespace ModbusConfig {
+
+class SerialLink;
+
+struct DeviceConnectivity {
+    QUuid devId;
+    QString description;
+    // строка подключения, как в конфигурации
+    QString endpoint;
+    // в секундах, -1 - не измерено
+    double connectTime{-1};
+    double latency{-1};
+    // пустая строка - устройство ответило на чтение
+    QString error;
+};
+
+struct ConnectivityReport {
+    QVector<DeviceConnectivity> devices;
+    // верхние границы корзин задержки ответа в секундах, последняя корзина - всё, что больше
+    QVector<double> latencyBounds;
+    QVector<int> latencyBins;
+    // текст ошибки -> число устройств
+    QMap<QString, int> errors;
+    int okCount{};
+    double elapsed{};
+};
+
+// сводка для вывода в консоль и в окно редактора, verbose - с задержкой каждого устройства
+QStringList connectivityReportText(const ConnectivityReport &report, bool verbose = false);
+
+// Проверка подключений: каждое устройство модели один раз читает первый регистр
+// своего плана опроса. TCP-устройства проверяются параллельно, не больше maxInFlight
+// одновременно; устройства одного последовательного порта - по очереди, порт занимает
+// одно место из maxInFlight.
+class ConnectivityChecker : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConnectivityChecker(QObject *parent = nullptr);
+    ~ConnectivityChecker() override;
+
+    void setMaxInFlight(int count);
+    // отдельно на подключение и на ответ, мс
+    void setTimeout(int msec);
+
+    // адреса и запросы копируются, модель после вызова можно менять
+    void start(const ModbusConfigModel &model);
+    void abort();
+    bool isRunning() const;
+
+signals:
+    void progress(int done, int total);
+    void finished(const ModbusConfig::ConnectivityReport &report);
+
+private:
+    struct Target {
+        ConnectionParams params;
+        quint8 slaveAddress{};
+        FunctionCode function{};
+        int offset{};
+        bool hasRequest{};
+    };
+
+    struct Line {
+        ConnectionParams params;
+        QVector<int> targets;
+        int next{};
+        SerialLink *link{};
+        QTimer *timer{};
+        QByteArray buffer;
+        qint64 sentAt{};
+        // межкадровая пауза RTU, мс
+        int silence{};
+    };
+
+    QByteArray requestFrame(int index, bool tcp) const;
+    void startNext();
+    void startTcp(int index);
+    void onTcpResponse(QTcpSocket *socket, int index);
+    void finishTcp(int index, const QString &error, bool responded = false);
+    void startLine(int line);
+    void sendLineRequest(int line);
+    void onLineResponse(int line);
+    void finishLineRequest(int line, const QString &error, bool responded = false);
+    void closeLine(int line);
+    void complete(int index, const QString &error, qint64 sentAt = -1);
+    void releaseSlot();
+    void buildReport();
+
+private:
+    int mMaxInFlight{256};
+    int mTimeout{1000};
+
+    QVector<Target> mTargets;
+    QVector<Line> mLines;
+    // очередь: индекс устройства TCP или -(номер линии + 1)
+    QVector<int> mQueue;
+    int mQueueHead{};
+    int mInFlight{};
+    int mDone{};
+    bool mRunning{};
+    QVector<QTcpSocket *> mSockets;
+    QVector<qint64> mSentAt;
+    QElapsedTimer mClock;
+    ConnectivityReport mReport;
+};
+
+}
@@ -0,0 +1,79 @@
+#include "cpufeatures.h"
+
+#if defined(MODBUS_CONFIG_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+#if defined(MODBUS_CONFIG_X86)
+void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+{
+#if defined(_MSC_VER)
+    int result[4];
+    __cpuidex(result, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) {
+        regs[i] = static_cast<unsigned>(result[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+unsigned long long xgetbv()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+ModbusConfig::CpuFeatures detectCpuFeatures()
+{
+    ModbusConfig::CpuFeatures result;
+#if defined(MODBUS_CONFIG_X86)
+    unsigned regs[4];
+    cpuid(0, 0, regs);
+    unsigned maxLeaf = regs[0];
+    if (maxLeaf < 1) {
+        return result;
+    }
+    cpuid(1, 0, regs);
+    const unsigned ecx = regs[2];
+    result.ssse3 = ecx & (1u << 9);
+    result.sse41 = ecx & (1u << 19);
+    result.pclmul = ecx & (1u << 1);
+    // AVX, AVX2 и FMA можно использовать только если ОС сохраняет ymm регистры
+    const bool osxsave = ecx & (1u << 27);
+    const bool avx = ecx & (1u << 28);
+    if (osxsave && avx && (xgetbv() & 0x6) == 0x6) {
+        result.avx = true;
+        result.fma = ecx & (1u << 12);
+        if (maxLeaf >= 7) {
+            cpuid(7, 0, regs);
+            result.avx2 = regs[1] & (1u << 5);
+        }
+    }
+#endif
+    return result;
+}
+
+}
+
+namespace ModbusConfig {
+
+const CpuFeatures &cpuFeatures()
+{
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MODBUS_CONFIG_X86
+#endif
+
+// функции с векторными инструкциями собираются без глобальных флагов компилятора
+// и вызываются только после проверки возможностей процессора
+#if defined(__GNUC__) || defined(__clang__)
+#define MODBUS_CONFIG_TARGET(features) __attribute__((target(features)))
+#else
+#define MODBUS_CONFIG_TARGET(features)
+#endif
+
+namespace ModbusConfig {
+
+struct CpuFeatures {
+    bool ssse3{};
+    bool sse41{};
+    bool avx{};
+    bool avx2{};
+    bool fma{};
+    bool pclmul{};
+};
+
+const CpuFeatures &cpuFeatures();
+
+}
@@ -0,0 +1,160 @@
+#include "crc16.h"
+
+#include "cpufeatures.h"
+
+#if defined(MODBUS_CONFIG_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+// многочлен x^16 + x^15 + x^2 + 1 без старшего члена, в прямом виде
+constexpr quint16 polynomial = 0x8005;
+constexpr quint16 reflectedPolynomial = 0xA001;
+constexpr quint16 initialValue = 0xFFFF;
+// короче свёртка не окупает итоговый проход по 16 байтам остатка
+constexpr int clmulMinSize = 64;
+
+// tables[0] - побайтовая таблица, tables[k][i] - CRC байта i, за которым следуют k нулей
+struct CrcTables {
+    quint16 values[8][256];
+
+    CrcTables()
+    {
+        for (int i = 0; i < 256; ++i) {
+            quint16 crc = quint16(i);
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? quint16((crc >> 1) ^ reflectedPolynomial) : quint16(crc >> 1);
+            }
+            values[0][i] = crc;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int i = 0; i < 256; ++i) {
+                const quint16 previous = values[k - 1][i];
+                values[k][i] = quint16((previous >> 8) ^ values[0][previous & 0xFF]);
+            }
+        }
+    }
+};
+
+const CrcTables &crcTables()
+{
+    static const CrcTables tables;
+    return tables;
+}
+
+quint16 updateTable(quint16 crc, const quint8 *data, int size)
+{
+    const quint16 *table = crcTables().values[0];
+    for (int i = 0; i < size; ++i) {
+        crc = quint16((crc >> 8) ^ table[(crc ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+quint16 updateSliceBy8(quint16 crc, const quint8 *data, int size)
+{
+    const auto &t = crcTables().values;
+    int i = 0;
+    // побайтовая индексация не зависит от порядка байт процессора
+    for (; i + 8 <= size; i += 8) {
+        const quint16 low = quint16(crc ^ (data[i] | (data[i + 1] << 8)));
+        crc = quint16(t[7][low & 0xFF] ^ t[6][low >> 8] ^ t[5][data[i + 2]]
+            ^ t[4][data[i + 3]] ^ t[3][data[i + 4]] ^ t[2][data[i + 5]]
+            ^ t[1][data[i + 6]] ^ t[0][data[i + 7]]);
+    }
+    return updateTable(crc, data + i, size - i);
+}
+
+#if defined(MODBUS_CONFIG_X86)
+// x^n mod P в отражённом 64-битном виде: коэффициент x^d - бит 63 - d
+quint64 reflectedPower(int n)
+{
+    quint32 remainder = 1;
+    for (int i = 0; i < n; ++i) {
+        remainder <<= 1;
+        if (remainder & 0x10000) {
+            remainder ^= 0x10000 | polynomial;
+        }
+    }
+    quint64 result = 0;
+    for (int d = 0; d < 16; ++d) {
+        if (remainder & (1u << d)) {
+            result |= quint64(1) << (63 - d);
+        }
+    }
+    return result;
+}
+
+struct FoldConstants {
+    // в 128-битном регистре младшие 64 бита - старшие степени сообщения;
+    // умножение отражённых 64-битных чисел даёт дополнительный множитель x,
+    // поэтому степени на единицу меньше сдвига 192 и 128
+    quint64 high{reflectedPower(191)};
+    quint64 low{reflectedPower(127)};
+};
+
+MODBUS_CONFIG_TARGET("sse2,pclmul")
+quint16 crc16Pclmul(const quint8 *data, int size)
+{
+    static const FoldConstants constants;
+    const __m128i k = _mm_set_epi64x(qint64(constants.low), qint64(constants.high));
+    // начальное значение CRC эквивалентно инверсии первых 16 бит сообщения
+    __m128i x = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)),
+        _mm_cvtsi32_si128(initialValue));
+    int i = 16;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i high = _mm_clmulepi64_si128(x, k, 0x00);
+        const __m128i low = _mm_clmulepi64_si128(x, k, 0x11);
+        x = _mm_xor_si128(_mm_xor_si128(high, low),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+    }
+    // сравнимый по модулю P остаток дочитывается таблицами вместе с хвостом
+    alignas(16) quint8 folded[16];
+    _mm_store_si128(reinterpret_cast<__m128i *>(folded), x);
+    return updateSliceBy8(updateSliceBy8(0, folded, 16), data + i, size - i);
+}
+#endif
+
+using Crc16Function = quint16 (*)(const quint8 *, int);
+
+Crc16Function selectLarge()
+{
+#if defined(MODBUS_CONFIG_X86)
+    if (ModbusConfig::cpuFeatures().pclmul) {
+        return crc16Pclmul;
+    }
+#endif
+    return ModbusConfig::crc16SliceBy8;
+}
+
+}
+
+namespace ModbusConfig {
+
+quint16 crc16(const quint8 *data, int size)
+{
+    static const Crc16Function large = selectLarge();
+    return size >= clmulMinSize ? large(data, size) : crc16SliceBy8(data, size);
+}
+
+quint16 crc16Table(const quint8 *data, int size)
+{
+    return updateTable(initialValue, data, size);
+}
+
+quint16 crc16SliceBy8(const quint8 *data, int size)
+{
+    return updateSliceBy8(initialValue, data, size);
+}
+
+quint16 crc16Clmul(const quint8 *data, int size)
+{
+#if defined(MODBUS_CONFIG_X86)
+    if (size >= 16 && cpuFeatures().pclmul) {
+        return crc16Pclmul(data, size);
+    }
+#endif
+    return crc16SliceBy8(data, size);
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QtGlobal>
+
+namespace ModbusConfig {
+
+// CRC-16/MODBUS (полином 0xA001 в отражённом виде, начальное значение 0xFFFF).
+// В кадре RTU передаётся младшим байтом вперёд.
+// Реализация выбирается по длине данных и возможностям процессора.
+quint16 crc16(const quint8 *data, int size);
+
+// Отдельные реализации с одинаковым результатом: побайтовая таблица, slice-by-8
+// и свёртка умножением без переносов (PCLMUL, без него - slice-by-8).
+quint16 crc16Table(const quint8 *data, int size);
+quint16 crc16SliceBy8(const quint8 *data, int size);
+quint16 crc16Clmul(const quint8 *data, int size);
+
+}
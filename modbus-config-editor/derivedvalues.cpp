@@ -0,0 +1,179 @@
+#include "derivedvalues.h"
+
+#include "modbusconfigmodel.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+constexpr double noValue = std::numeric_limits<double>::quiet_NaN();
+}
+
+namespace ModbusConfig {
+
+DerivedValueEngine::DerivedValueEngine(const ModbusConfigModel &model)
+{
+    const auto devIds = model.devicesIds();
+    for (const auto &devId : devIds) {
+        const auto &device = model.device(devId);
+        for (auto it = device.sensors.cbegin(); it != device.sensors.cend(); ++it) {
+            mIndices.insert(it.key(), mIds.size());
+            mIds.append(it.key());
+        }
+    }
+
+    const int count = mIds.size();
+    mNodes.resize(count);
+    QVector<int> dependentCounts(count, 0);
+    for (int i = 0; i < count; ++i) {
+        Node &node = mNodes[i];
+        node.program = model.sensorCorrection(mIds.at(i));
+        node.firstReference = mReferences.size();
+        if (node.program) {
+            for (const auto &reference : node.program->references()) {
+                int index = mIndices.value(reference, -1);
+                mReferences.append(index);
+                if (index >= 0) {
+                    ++dependentCounts[index];
+                }
+            }
+        }
+        node.referenceCount = mReferences.size() - node.firstReference;
+    }
+
+    // обратные рёбра в компактном виде: зависимые датчики подряд для каждого узла
+    int offset = 0;
+    for (int i = 0; i < count; ++i) {
+        mNodes[i].firstDependent = offset;
+        offset += dependentCounts.at(i);
+    }
+    mDependents.resize(offset);
+    for (int i = 0; i < count; ++i) {
+        const Node &node = mNodes.at(i);
+        for (int r = 0; r < node.referenceCount; ++r) {
+            int index = mReferences.at(node.firstReference + r);
+            if (index >= 0) {
+                Node &target = mNodes[index];
+                mDependents[target.firstDependent + target.dependentCount++] = i;
+            }
+        }
+    }
+
+    // топологический порядок (Кан), ранг - номер в этом порядке
+    QVector<int> pending(count, 0);
+    QVector<int> order;
+    order.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const Node &node = mNodes.at(i);
+        for (int r = 0; r < node.referenceCount; ++r) {
+            if (mReferences.at(node.firstReference + r) >= 0) {
+                ++pending[i];
+            }
+        }
+        if (pending.at(i) == 0) {
+            order.append(i);
+        }
+    }
+    for (int head = 0; head < order.size(); ++head) {
+        const Node &node = mNodes.at(order.at(head));
+        for (int d = 0; d < node.dependentCount; ++d) {
+            int dependent = mDependents.at(node.firstDependent + d);
+            if (--pending[dependent] == 0) {
+                order.append(dependent);
+            }
+        }
+    }
+    // циклы отсекаются моделью, но на всякий случай узлы цикла считаются последними
+    for (int i = 0; i < count; ++i) {
+        if (pending.at(i) > 0) {
+            order.append(i);
+        }
+    }
+    for (int rank = 0; rank < order.size(); ++rank) {
+        mNodes[order.at(rank)].rank = rank;
+    }
+
+    mRawValues.fill(noValue, count);
+    mValues.fill(noValue, count);
+    mVisited.fill(0, count);
+    for (int index : order) {
+        evaluate(index);
+    }
+}
+
+int DerivedValueEngine::sensorCount() const
+{
+    return mIds.size();
+}
+
+int DerivedValueEngine::sensorIndex(const QUuid &sensorId) const
+{
+    return mIndices.value(sensorId, -1);
+}
+
+QUuid DerivedValueEngine::sensorId(int index) const
+{
+    return mIds.at(index);
+}
+
+double DerivedValueEngine::value(int index) const
+{
+    return mValues.at(index);
+}
+
+void DerivedValueEngine::update(
+    const QVector<QPair<int, double>> &rawValues, QVector<int> *recomputed)
+{
+    if (++mEpoch == 0) {
+        mVisited.fill(0, mVisited.size());
+        mEpoch = 1;
+    }
+    mStack.clear();
+    mAffected.clear();
+    for (const auto &rawValue : rawValues) {
+        mRawValues[rawValue.first] = rawValue.second;
+        if (mVisited.at(rawValue.first) != mEpoch) {
+            mVisited[rawValue.first] = mEpoch;
+            mStack.append(rawValue.first);
+        }
+    }
+    while (!mStack.isEmpty()) {
+        int index = mStack.takeLast();
+        mAffected.append(index);
+        const Node &node = mNodes.at(index);
+        for (int d = 0; d < node.dependentCount; ++d) {
+            int dependent = mDependents.at(node.firstDependent + d);
+            if (mVisited.at(dependent) != mEpoch) {
+                mVisited[dependent] = mEpoch;
+                mStack.append(dependent);
+            }
+        }
+    }
+    std::sort(mAffected.begin(), mAffected.end(), [this](int l, int r) {
+        return mNodes.at(l).rank < mNodes.at(r).rank;
+    });
+    for (int index : qAsConst(mAffected)) {
+        evaluate(index);
+    }
+    if (recomputed) {
+        *recomputed = mAffected;
+    }
+}
+
+void DerivedValueEngine::evaluate(int index)
+{
+    const Node &node = mNodes.at(index);
+    const double raw = mRawValues.at(index);
+    if (!node.program) {
+        mValues[index] = raw;
+        return;
+    }
+    mArguments.resize(node.referenceCount);
+    for (int r = 0; r < node.referenceCount; ++r) {
+        int reference = mReferences.at(node.firstReference + r);
+        mArguments[r] = reference >= 0 ? mValues.at(reference) : noValue;
+    }
+    mValues[index] = node.program->evaluate(raw, mArguments.constData());
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "expressioncompiler.h"
+
+#include <QHash>
+#include <QPair>
+#include <QUuid>
+#include <QVector>
+
+namespace ModbusConfig {
+
+class ModbusConfigModel;
+
+// Значения датчиков с учётом ссылок между корректирующими функциями.
+// Граф зависимостей строится один раз по конфигурации, при поступлении результатов опроса
+// пересчитываются только датчики ниже по графу от изменившихся, в топологическом порядке.
+class DerivedValueEngine
+{
+public:
+    explicit DerivedValueEngine(const ModbusConfigModel &model);
+
+    int sensorCount() const;
+    // -1, если датчика нет
+    int sensorIndex(const QUuid &sensorId) const;
+    QUuid sensorId(int index) const;
+    double value(int index) const;
+
+    // rawValues - (индекс датчика, декодированное значение);
+    // recomputed - индексы пересчитанных датчиков в порядке пересчёта
+    void update(const QVector<QPair<int, double>> &rawValues, QVector<int> *recomputed = nullptr);
+
+private:
+    void evaluate(int index);
+
+private:
+    struct Node {
+        QSharedPointer<const ExpressionProgram> program;
+        // диапазоны в mReferences и mDependents
+        int firstReference{};
+        int referenceCount{};
+        int firstDependent{};
+        int dependentCount{};
+        int rank{};
+    };
+
+    QVector<QUuid> mIds;
+    QHash<QUuid, int> mIndices;
+    QVector<Node> mNodes;
+    // индекс датчика, на который ссылается выражение, -1 - датчик отсутствует
+    QVector<int> mReferences;
+    QVector<int> mDependents;
+    QVector<double> mRawValues;
+    QVector<double> mValues;
+
+    // рабочие буферы пересчёта, чтобы не выделять память на каждый опрос
+    QVector<quint32> mVisited;
+    quint32 mEpoch{};
+    QVector<int> mStack;
+    QVector<int> mAffected;
+    QVector<double> mArguments;
+};
+
+}
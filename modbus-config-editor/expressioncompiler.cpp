@@ -0,0 +1,958 @@
+#include "expressioncompiler.h"
+
+#include "cpufeatures.h"
+
+#include <QObject>
+#include <QVarLengthArray>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(MODBUS_CONFIG_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+using Program = ModbusConfig::ExpressionProgram;
+using OpCode = Program::OpCode;
+using Function = Program::Function;
+
+constexpr int evaluateBlock = 256;
+constexpr int maxNestingDepth = 256;
+constexpr const char *valueName = "val";
+constexpr double missingReference = std::numeric_limits<double>::quiet_NaN();
+
+// силы связывания операторов для разбора Пратта
+constexpr int additivePower = 10;
+constexpr int multiplicativePower = 20;
+constexpr int unaryPower = 30;
+constexpr int powerPower = 40;
+
+struct FunctionInfo {
+    const char *name;
+    Function function;
+    int argCount;
+};
+
+const FunctionInfo functions[] = {
+    {"abs", Function::Abs, 1},
+    {"sqrt", Function::Sqrt, 1},
+    {"exp", Function::Exp, 1},
+    {"log", Function::Log, 1},
+    {"ln", Function::Log, 1},
+    {"log10", Function::Log10, 1},
+    {"sin", Function::Sin, 1},
+    {"cos", Function::Cos, 1},
+    {"tan", Function::Tan, 1},
+    {"floor", Function::Floor, 1},
+    {"ceil", Function::Ceil, 1},
+    {"round", Function::Round, 1},
+    {"min", Function::Min, 2},
+    {"max", Function::Max, 2},
+    {"pow", Function::Pow, 2}
+};
+
+double call(Function function, double x, double y = 0)
+{
+    switch (function) {
+    case Function::Abs:
+        return std::fabs(x);
+    case Function::Sqrt:
+        return std::sqrt(x);
+    case Function::Exp:
+        return std::exp(x);
+    case Function::Log:
+        return std::log(x);
+    case Function::Log10:
+        return std::log10(x);
+    case Function::Sin:
+        return std::sin(x);
+    case Function::Cos:
+        return std::cos(x);
+    case Function::Tan:
+        return std::tan(x);
+    case Function::Floor:
+        return std::floor(x);
+    case Function::Ceil:
+        return std::ceil(x);
+    case Function::Round:
+        return std::round(x);
+    case Function::Min:
+        return std::fmin(x, y);
+    case Function::Max:
+        return std::fmax(x, y);
+    case Function::Pow:
+        return std::pow(x, y);
+    }
+    return 0;
+}
+
+double binary(OpCode op, double l, double r)
+{
+    switch (op) {
+    case OpCode::Add:
+        return l + r;
+    case OpCode::Sub:
+        return l - r;
+    case OpCode::Mul:
+        return l * r;
+    case OpCode::Div:
+        return l / r;
+    default:
+        break;
+    }
+    return 0;
+}
+
+struct Token {
+    enum class Type {
+        Number,
+        Identifier,
+        Reference,
+        Operator,
+        LeftParen,
+        RightParen,
+        Comma,
+        End
+    };
+
+    Type type;
+    int position{};
+    QString text;
+    double number{};
+};
+
+struct Node {
+    enum class Type {
+        Constant,
+        Value,
+        Reference,
+        Negate,
+        Binary,
+        Call
+    };
+
+    Type type;
+    double value{};
+    OpCode op{};
+    Function function{};
+    int reference{};
+    int args[2]{-1, -1};
+    int argCount{};
+};
+
+class Parser
+{
+public:
+    explicit Parser(const QString &text) :
+        mText(text)
+    {
+    }
+
+    // индекс корня или -1 при ошибке
+    int parse(QString *error);
+    const QVector<Node> &nodes() const
+    {
+        return mNodes;
+    }
+    const QVector<QUuid> &references() const
+    {
+        return mReferences;
+    }
+
+private:
+    bool tokenize();
+    int parseExpression(int minPower);
+    int parsePrefix();
+    int parseCall(const Token &name);
+
+    const Token &peek() const;
+    const Token &next();
+    int fail(int position, const QString &message);
+
+    int addNode(const Node &node);
+    int makeConstant(double value);
+    int makeReference(const Token &token);
+    int makeNegate(int arg);
+    int makeBinary(OpCode op, int lhs, int rhs);
+    int makeCall(Function function, const int *args, int argCount);
+
+private:
+    QString mText;
+    QVector<Token> mTokens;
+    int mCurrent{};
+    int mDepth{};
+    QVector<Node> mNodes;
+    QVector<QUuid> mReferences;
+    QString mError;
+};
+
+int Parser::parse(QString *error)
+{
+    int root = -1;
+    if (tokenize()) {
+        root = parseExpression(0);
+        if (root >= 0 && peek().type != Token::Type::End) {
+            root = fail(peek().position, QObject::tr("неожиданный символ '%0'").arg(peek().text));
+        }
+    }
+    if (error) {
+        *error = mError;
+    }
+    return root;
+}
+
+bool Parser::tokenize()
+{
+    int i = 0;
+    const int size = mText.size();
+    while (i < size) {
+        const QChar c = mText.at(i);
+        if (c.isSpace()) {
+            ++i;
+            continue;
+        }
+        Token token;
+        token.position = i;
+        if (c.isDigit() || (c == '.' && i + 1 < size && mText.at(i + 1).isDigit())) {
+            int end = i;
+            while (end < size && (mText.at(end).isDigit() || mText.at(end) == '.')) {
+                ++end;
+            }
+            if (end < size && (mText.at(end) == 'e' || mText.at(end) == 'E')) {
+                int exponent = end + 1;
+                if (exponent < size && (mText.at(exponent) == '+' || mText.at(exponent) == '-')) {
+                    ++exponent;
+                }
+                if (exponent < size && mText.at(exponent).isDigit()) {
+                    end = exponent;
+                    while (end < size && mText.at(end).isDigit()) {
+                        ++end;
+                    }
+                }
+            }
+            token.type = Token::Type::Number;
+            token.text = mText.mid(i, end - i);
+            bool ok;
+            token.number = token.text.toDouble(&ok);
+            if (!ok) {
+                fail(i, QObject::tr("некорректное число '%0'").arg(token.text));
+                return false;
+            }
+            i = end;
+        } else if (c.isLetter() || c == '_') {
+            int end = i;
+            while (end < size && (mText.at(end).isLetterOrNumber() || mText.at(end) == '_')) {
+                ++end;
+            }
+            token.type = Token::Type::Identifier;
+            token.text = mText.mid(i, end - i);
+            i = end;
+        } else if (c == '{') {
+            int end = mText.indexOf('}', i);
+            if (end < 0) {
+                fail(i, QObject::tr("ожидается '}'"));
+                return false;
+            }
+            token.type = Token::Type::Reference;
+            token.text = mText.mid(i + 1, end - i - 1).trimmed();
+            i = end + 1;
+        } else {
+            token.text = c;
+            if (c == '(') {
+                token.type = Token::Type::LeftParen;
+            } else if (c == ')') {
+                token.type = Token::Type::RightParen;
+            } else if (c == ',') {
+                token.type = Token::Type::Comma;
+            } else if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^') {
+                token.type = Token::Type::Operator;
+            } else {
+                fail(i, QObject::tr("недопустимый символ '%0'").arg(c));
+                return false;
+            }
+            ++i;
+        }
+        mTokens.append(token);
+    }
+    Token end;
+    end.type = Token::Type::End;
+    end.position = size;
+    mTokens.append(end);
+    return true;
+}
+
+int Parser::parseExpression(int minPower)
+{
+    if (++mDepth > maxNestingDepth) {
+        return fail(peek().position, QObject::tr("слишком глубокая вложенность"));
+    }
+    int lhs = parsePrefix();
+    while (lhs >= 0 && peek().type == Token::Type::Operator) {
+        const QChar op = peek().text.at(0);
+        int leftPower;
+        int rightPower;
+        OpCode code{};
+        if (op == '+' || op == '-') {
+            leftPower = additivePower;
+            rightPower = additivePower + 1;
+            code = op == '+' ? OpCode::Add : OpCode::Sub;
+        } else if (op == '*' || op == '/') {
+            leftPower = multiplicativePower;
+            rightPower = multiplicativePower + 1;
+            code = op == '*' ? OpCode::Mul : OpCode::Div;
+        } else {
+            // возведение в степень правоассоциативно
+            leftPower = powerPower;
+            rightPower = powerPower;
+        }
+        if (leftPower < minPower) {
+            break;
+        }
+        next();
+        int rhs = parseExpression(rightPower);
+        if (rhs < 0) {
+            lhs = -1;
+            break;
+        }
+        if (op == '^') {
+            const int args[] = {lhs, rhs};
+            lhs = makeCall(Function::Pow, args, 2);
+        } else {
+            lhs = makeBinary(code, lhs, rhs);
+        }
+    }
+    --mDepth;
+    return lhs;
+}
+
+int Parser::parsePrefix()
+{
+    const Token &token = next();
+    switch (token.type) {
+    case Token::Type::Number:
+        return makeConstant(token.number);
+    case Token::Type::Identifier:
+        if (peek().type == Token::Type::LeftParen) {
+            return parseCall(token);
+        }
+        if (token.text == valueName) {
+            Node node;
+            node.type = Node::Type::Value;
+            return addNode(node);
+        }
+        return fail(token.position, QObject::tr("неизвестный идентификатор '%0'").arg(token.text));
+    case Token::Type::Reference:
+        return makeReference(token);
+    case Token::Type::LeftParen: {
+        int result = parseExpression(0);
+        if (result < 0) {
+            return -1;
+        }
+        if (peek().type != Token::Type::RightParen) {
+            return fail(peek().position, QObject::tr("ожидается ')'"));
+        }
+        next();
+        return result;
+    }
+    case Token::Type::Operator:
+        if (token.text == "-") {
+            int arg = parseExpression(unaryPower);
+            return arg < 0 ? -1 : makeNegate(arg);
+        }
+        if (token.text == "+") {
+            return parseExpression(unaryPower);
+        }
+        break;
+    case Token::Type::End:
+        return fail(token.position, QObject::tr("неожиданный конец выражения"));
+    default:
+        break;
+    }
+    return fail(token.position, QObject::tr("неожиданный символ '%0'").arg(token.text));
+}
+
+int Parser::parseCall(const Token &name)
+{
+    const FunctionInfo *info = nullptr;
+    for (const auto &function : functions) {
+        if (name.text == function.name) {
+            info = &function;
+            break;
+        }
+    }
+    if (!info) {
+        return fail(name.position, QObject::tr("неизвестная функция '%0'").arg(name.text));
+    }
+    next();
+    int args[2];
+    int argCount = 0;
+    if (peek().type != Token::Type::RightParen) {
+        while (true) {
+            int arg = parseExpression(0);
+            if (arg < 0) {
+                return -1;
+            }
+            if (argCount < 2) {
+                args[argCount] = arg;
+            }
+            ++argCount;
+            if (peek().type != Token::Type::Comma) {
+                break;
+            }
+            next();
+        }
+    }
+    if (peek().type != Token::Type::RightParen) {
+        return fail(peek().position, QObject::tr("ожидается ')'"));
+    }
+    next();
+    if (argCount != info->argCount) {
+        return fail(name.position, QObject::tr("функция '%0' принимает аргументов: %1")
+            .arg(name.text).arg(info->argCount));
+    }
+    return makeCall(info->function, args, argCount);
+}
+
+const Token &Parser::peek() const
+{
+    return mTokens.at(mCurrent);
+}
+
+const Token &Parser::next()
+{
+    const Token &token = mTokens.at(mCurrent);
+    if (token.type != Token::Type::End) {
+        ++mCurrent;
+    }
+    return token;
+}
+
+int Parser::fail(int position, const QString &message)
+{
+    if (mError.isEmpty()) {
+        mError = QObject::tr("Ошибка в корректирующей функции (позиция %0): %1")
+            .arg(position + 1).arg(message);
+    }
+    return -1;
+}
+
+int Parser::addNode(const Node &node)
+{
+    mNodes.append(node);
+    return mNodes.size() - 1;
+}
+
+int Parser::makeConstant(double value)
+{
+    Node node;
+    node.type = Node::Type::Constant;
+    node.value = value;
+    return addNode(node);
+}
+
+int Parser::makeReference(const Token &token)
+{
+    QUuid id = QUuid::fromString(token.text);
+    if (id.isNull()) {
+        return fail(token.position,
+            QObject::tr("некорректный идентификатор датчика '%0'").arg(token.text));
+    }
+    Node node;
+    node.type = Node::Type::Reference;
+    node.reference = mReferences.indexOf(id);
+    if (node.reference < 0) {
+        node.reference = mReferences.size();
+        mReferences.append(id);
+    }
+    return addNode(node);
+}
+
+// свёртка констант выполняется сразу при построении дерева
+int Parser::makeNegate(int arg)
+{
+    if (mNodes.at(arg).type == Node::Type::Constant) {
+        return makeConstant(-mNodes.at(arg).value);
+    }
+    Node node;
+    node.type = Node::Type::Negate;
+    node.args[0] = arg;
+    node.argCount = 1;
+    return addNode(node);
+}
+
+int Parser::makeBinary(OpCode op, int lhs, int rhs)
+{
+    if (mNodes.at(lhs).type == Node::Type::Constant
+        && mNodes.at(rhs).type == Node::Type::Constant) {
+        return makeConstant(binary(op, mNodes.at(lhs).value, mNodes.at(rhs).value));
+    }
+    Node node;
+    node.type = Node::Type::Binary;
+    node.op = op;
+    node.args[0] = lhs;
+    node.args[1] = rhs;
+    node.argCount = 2;
+    return addNode(node);
+}
+
+int Parser::makeCall(Function function, const int *args, int argCount)
+{
+    bool constant = true;
+    for (int i = 0; i < argCount; ++i) {
+        constant = constant && mNodes.at(args[i]).type == Node::Type::Constant;
+    }
+    if (constant) {
+        const double x = mNodes.at(args[0]).value;
+        const double y = argCount > 1 ? mNodes.at(args[1]).value : 0;
+        return makeConstant(call(function, x, y));
+    }
+    Node node;
+    node.type = Node::Type::Call;
+    node.function = function;
+    for (int i = 0; i < argCount; ++i) {
+        node.args[i] = args[i];
+    }
+    node.argCount = argCount;
+    return addNode(node);
+}
+
+// выражение вида scale * val + offset (с точностью до округления)
+bool linearForm(const QVector<Node> &nodes, int index, double *scale, double *offset)
+{
+    const Node &node = nodes.at(index);
+    switch (node.type) {
+    case Node::Type::Constant:
+        *scale = 0;
+        *offset = node.value;
+        return true;
+    case Node::Type::Value:
+        *scale = 1;
+        *offset = 0;
+        return true;
+    case Node::Type::Negate:
+        if (!linearForm(nodes, node.args[0], scale, offset)) {
+            return false;
+        }
+        *scale = -*scale;
+        *offset = -*offset;
+        return true;
+    case Node::Type::Binary: {
+        double lScale, lOffset, rScale, rOffset;
+        if (!linearForm(nodes, node.args[0], &lScale, &lOffset)
+            || !linearForm(nodes, node.args[1], &rScale, &rOffset)) {
+            return false;
+        }
+        switch (node.op) {
+        case OpCode::Add:
+            *scale = lScale + rScale;
+            *offset = lOffset + rOffset;
+            return true;
+        case OpCode::Sub:
+            *scale = lScale - rScale;
+            *offset = lOffset - rOffset;
+            return true;
+        case OpCode::Mul:
+            if (rScale == 0) {
+                *scale = lScale * rOffset;
+                *offset = lOffset * rOffset;
+                return true;
+            }
+            if (lScale == 0) {
+                *scale = rScale * lOffset;
+                *offset = rOffset * lOffset;
+                return true;
+            }
+            return false;
+        case OpCode::Div:
+            if (rScale == 0) {
+                *scale = lScale / rOffset;
+                *offset = lOffset / rOffset;
+                return std::isfinite(*scale) && std::isfinite(*offset);
+            }
+            return false;
+        default:
+            break;
+        }
+        return false;
+    }
+    case Node::Type::Reference:
+    case Node::Type::Call:
+        break;
+    }
+    return false;
+}
+
+#if defined(MODBUS_CONFIG_X86)
+MODBUS_CONFIG_TARGET("avx,fma")
+int linearFma(double scale, double offset, const double *values, int count, double *out)
+{
+    const __m256d a = _mm256_set1_pd(scale);
+    const __m256d b = _mm256_set1_pd(offset);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256d first = _mm256_loadu_pd(values + i);
+        __m256d second = _mm256_loadu_pd(values + i + 4);
+        _mm256_storeu_pd(out + i, _mm256_fmadd_pd(a, first, b));
+        _mm256_storeu_pd(out + i + 4, _mm256_fmadd_pd(a, second, b));
+    }
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_fmadd_pd(a, _mm256_loadu_pd(values + i), b));
+    }
+    return i;
+}
+#endif
+
+double linearValue(double scale, double offset, double value)
+{
+    // скалярный и блочный путь должны давать одинаковый результат
+    if (ModbusConfig::cpuFeatures().fma) {
+        return std::fma(scale, value, offset);
+    }
+    return scale * value + offset;
+}
+
+void linearBlock(double scale, double offset, const double *values, int count, double *out)
+{
+    int i = 0;
+#if defined(MODBUS_CONFIG_X86)
+    if (ModbusConfig::cpuFeatures().fma) {
+        i = linearFma(scale, offset, values, count, out);
+        for (; i < count; ++i) {
+            out[i] = std::fma(scale, values[i], offset);
+        }
+        return;
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = scale * values[i] + offset;
+    }
+}
+
+void emitNode(const QVector<Node> &nodes, int index, QVector<Program::Instruction> *code,
+    QVector<double> *constants, int depth, int *maxDepth)
+{
+    const Node &node = nodes.at(index);
+    Program::Instruction instruction;
+    switch (node.type) {
+    case Node::Type::Constant:
+        instruction.op = OpCode::PushConstant;
+        instruction.arg = constants->size();
+        constants->append(node.value);
+        *maxDepth = qMax(*maxDepth, depth + 1);
+        break;
+    case Node::Type::Value:
+        instruction.op = OpCode::PushValue;
+        *maxDepth = qMax(*maxDepth, depth + 1);
+        break;
+    case Node::Type::Reference:
+        instruction.op = OpCode::PushReference;
+        instruction.arg = node.reference;
+        *maxDepth = qMax(*maxDepth, depth + 1);
+        break;
+    case Node::Type::Negate:
+        emitNode(nodes, node.args[0], code, constants, depth, maxDepth);
+        instruction.op = OpCode::Negate;
+        break;
+    case Node::Type::Binary:
+        emitNode(nodes, node.args[0], code, constants, depth, maxDepth);
+        emitNode(nodes, node.args[1], code, constants, depth + 1, maxDepth);
+        instruction.op = node.op;
+        break;
+    case Node::Type::Call:
+        for (int i = 0; i < node.argCount; ++i) {
+            emitNode(nodes, node.args[i], code, constants, depth + i, maxDepth);
+        }
+        instruction.op = node.argCount == 1 ? OpCode::Call1 : OpCode::Call2;
+        instruction.arg = static_cast<int>(node.function);
+        break;
+    }
+    code->append(instruction);
+}
+
+}
+
+namespace ModbusConfig {
+
+ExpressionProgram::Kind ExpressionProgram::kind() const
+{
+    return mKind;
+}
+
+double ExpressionProgram::scale() const
+{
+    return mScale;
+}
+
+double ExpressionProgram::offset() const
+{
+    return mOffset;
+}
+
+const QVector<ExpressionProgram::Instruction> &ExpressionProgram::code() const
+{
+    return mCode;
+}
+
+const QVector<QUuid> &ExpressionProgram::references() const
+{
+    return mReferences;
+}
+
+double ExpressionProgram::evaluate(double value, const double *references) const
+{
+    switch (mKind) {
+    case Kind::Identity:
+        return value;
+    case Kind::Constant:
+        return mOffset;
+    case Kind::Linear:
+        return linearValue(mScale, mOffset, value);
+    case Kind::General:
+        break;
+    }
+
+    QVarLengthArray<double, 32> stack(mMaxStack);
+    int top = 0;
+    for (const auto &instruction : mCode) {
+        switch (instruction.op) {
+        case OpCode::PushValue:
+            stack[top++] = value;
+            break;
+        case OpCode::PushConstant:
+            stack[top++] = mConstants.at(instruction.arg);
+            break;
+        case OpCode::PushReference:
+            stack[top++] = references ? references[instruction.arg] : missingReference;
+            break;
+        case OpCode::Negate:
+            stack[top - 1] = -stack[top - 1];
+            break;
+        case OpCode::Add:
+        case OpCode::Sub:
+        case OpCode::Mul:
+        case OpCode::Div:
+            --top;
+            stack[top - 1] = binary(instruction.op, stack[top - 1], stack[top]);
+            break;
+        case OpCode::Call1:
+            stack[top - 1] = call(static_cast<Function>(instruction.arg), stack[top - 1]);
+            break;
+        case OpCode::Call2:
+            --top;
+            stack[top - 1] =
+                call(static_cast<Function>(instruction.arg), stack[top - 1], stack[top]);
+            break;
+        }
+    }
+    return stack[0];
+}
+
+void ExpressionProgram::evaluate(
+    const double *values, int count, double *out, const double *references) const
+{
+    switch (mKind) {
+    case Kind::Identity:
+        if (out != values) {
+            std::memmove(out, values, sizeof(double) * count);
+        }
+        return;
+    case Kind::Constant:
+        std::fill(out, out + count, mOffset);
+        return;
+    case Kind::Linear:
+        linearBlock(mScale, mOffset, values, count, out);
+        return;
+    case Kind::General:
+        break;
+    }
+
+    // каждая инструкция выполняется сразу над блоком значений,
+    // стоимость разбора байткода делится на весь блок
+    QVarLengthArray<double, 8 * evaluateBlock> stack(mMaxStack * evaluateBlock);
+    for (int offset = 0; offset < count; offset += evaluateBlock) {
+        const int size = qMin(evaluateBlock, count - offset);
+        int top = 0;
+        for (const auto &instruction : mCode) {
+            double *slot = stack.data() + top * evaluateBlock;
+            double *prev = slot - evaluateBlock;
+            switch (instruction.op) {
+            case OpCode::PushValue:
+                std::memcpy(slot, values + offset, sizeof(double) * size);
+                ++top;
+                break;
+            case OpCode::PushConstant:
+                std::fill(slot, slot + size, mConstants.at(instruction.arg));
+                ++top;
+                break;
+            case OpCode::PushReference:
+                std::fill(slot, slot + size,
+                    references ? references[instruction.arg] : missingReference);
+                ++top;
+                break;
+            case OpCode::Negate:
+                for (int i = 0; i < size; ++i) {
+                    prev[i] = -prev[i];
+                }
+                break;
+            case OpCode::Add:
+                --top;
+                for (int i = 0; i < size; ++i) {
+                    prev[i - evaluateBlock] += prev[i];
+                }
+                break;
+            case OpCode::Sub:
+                --top;
+                for (int i = 0; i < size; ++i) {
+                    prev[i - evaluateBlock] -= prev[i];
+                }
+                break;
+            case OpCode::Mul:
+                --top;
+                for (int i = 0; i < size; ++i) {
+                    prev[i - evaluateBlock] *= prev[i];
+                }
+                break;
+            case OpCode::Div:
+                --top;
+                for (int i = 0; i < size; ++i) {
+                    prev[i - evaluateBlock] /= prev[i];
+                }
+                break;
+            case OpCode::Call1: {
+                const auto function = static_cast<Function>(instruction.arg);
+                for (int i = 0; i < size; ++i) {
+                    prev[i] = call(function, prev[i]);
+                }
+                break;
+            }
+            case OpCode::Call2: {
+                --top;
+                const auto function = static_cast<Function>(instruction.arg);
+                for (int i = 0; i < size; ++i) {
+                    prev[i - evaluateBlock] = call(function, prev[i - evaluateBlock], prev[i]);
+                }
+                break;
+            }
+            }
+        }
+        std::memcpy(out + offset, stack.data(), sizeof(double) * size);
+    }
+}
+
+QSharedPointer<const ExpressionProgram> ExpressionCompiler::compile(
+    const QString &text, QString *error)
+{
+    const QString key = text.trimmed();
+    auto it = mCache.constFind(key);
+    if (it != mCache.constEnd()) {
+        auto program = it.value().toStrongRef();
+        if (program) {
+            return program;
+        }
+    }
+
+    QSharedPointer<ExpressionProgram> program(new ExpressionProgram);
+    if (!key.isEmpty()) {
+        Parser parser(key);
+        QString parseError;
+        int root = parser.parse(&parseError);
+        if (root < 0) {
+            if (error) {
+                *error = parseError;
+            }
+            return {};
+        }
+        const auto &nodes = parser.nodes();
+        double scale;
+        double offset;
+        if (linearForm(nodes, root, &scale, &offset)) {
+            program->mScale = scale;
+            program->mOffset = offset;
+            if (scale == 0) {
+                program->mKind = ExpressionProgram::Kind::Constant;
+            } else if (scale == 1 && offset == 0) {
+                program->mKind = ExpressionProgram::Kind::Identity;
+            } else {
+                program->mKind = ExpressionProgram::Kind::Linear;
+            }
+        } else {
+            program->mKind = ExpressionProgram::Kind::General;
+        }
+        emitNode(nodes, root, &program->mCode, &program->mConstants, 0, &program->mMaxStack);
+        program->mReferences = parser.references();
+    }
+    if (mCache.size() >= mSweepSize) {
+        removeExpired();
+    }
+    mCache.insert(key, program);
+    return program;
+}
+
+int ExpressionCompiler::cacheSize() const
+{
+    int count = 0;
+    for (const auto &program : mCache) {
+        if (!program.isNull()) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+void ExpressionCompiler::clearCache()
+{
+    mCache.clear();
+    mSweepSize = 64;
+}
+
+void ExpressionCompiler::removeExpired()
+{
+    for (auto it = mCache.begin(); it != mCache.end();) {
+        if (it.value().isNull()) {
+            it = mCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    // порог растёт вместе с числом живых программ, чтобы очистка оставалась амортизированно O(1)
+    mSweepSize = qMax(64, 2 * mCache.size());
+}
+
+QString checkExpression(const QString &text)
+{
+    const QString trimmed = text.trimmed();
+    if (trimmed.isEmpty()) {
+        return {};
+    }
+    QString error;
+    Parser parser(trimmed);
+    parser.parse(&error);
+    return error;
+}
+
+QString replaceReference(const QString &text, const QUuid &from, const QUuid &to)
+{
+    // ссылки выделяются так же, как в лексере: от '{' до ближайшей '}'
+    QString result;
+    int position = 0;
+    while (true) {
+        const int begin = text.indexOf('{', position);
+        const int end = begin < 0 ? -1 : text.indexOf('}', begin);
+        if (end < 0) {
+            break;
+        }
+        if (QUuid::fromString(text.mid(begin + 1, end - begin - 1).trimmed()) == from) {
+            result += text.mid(position, begin - position);
+            result += to.toString();
+        } else {
+            result += text.mid(position, end + 1 - position);
+        }
+        position = end + 1;
+    }
+    result += text.mid(position);
+    return result;
+}
+
+}
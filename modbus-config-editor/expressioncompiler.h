@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QHash>
+#include <QSharedPointer>
+#include <QString>
+#include <QUuid>
+#include <QVector>
+
+namespace ModbusConfig {
+
+// Скомпилированная корректирующая функция - байткод стековой машины после свёртки констант.
+// Переменная val - значение датчика после декодирования, {uuid} - значение другого датчика.
+class ExpressionProgram
+{
+public:
+    enum class Kind {
+        // пустое выражение или val
+        Identity,
+        Constant,
+        // scale * val + offset
+        Linear,
+        General
+    };
+
+    enum class OpCode : quint8 {
+        PushValue,
+        PushConstant,
+        PushReference,
+        Negate,
+        Add,
+        Sub,
+        Mul,
+        Div,
+        Call1,
+        Call2
+    };
+
+    enum class Function {
+        Abs,
+        Sqrt,
+        Exp,
+        Log,
+        Log10,
+        Sin,
+        Cos,
+        Tan,
+        Floor,
+        Ceil,
+        Round,
+        Min,
+        Max,
+        Pow
+    };
+
+    struct Instruction {
+        OpCode op;
+        // индекс константы, индекс ссылки или функция
+        int arg{};
+    };
+
+    Kind kind() const;
+    double scale() const;
+    double offset() const;
+    const QVector<Instruction> &code() const;
+    // датчики, на которые ссылается выражение, без повторов
+    const QVector<QUuid> &references() const;
+
+    // references[i] - значение датчика references()[i], без них ссылки дают NaN
+    double evaluate(double value, const double *references = nullptr) const;
+    // выполняет программу над целым блоком значений, out может совпадать с values
+    void evaluate(const double *values, int count, double *out,
+        const double *references = nullptr) const;
+
+private:
+    friend class ExpressionCompiler;
+
+    Kind mKind{Kind::Identity};
+    double mScale{1};
+    double mOffset{};
+    QVector<Instruction> mCode;
+    QVector<double> mConstants;
+    QVector<QUuid> mReferences;
+    int mMaxStack{};
+};
+
+// Компилятор с кэшем: одинаковые тексты выражений разделяют одну программу, пока она
+// кому-то нужна. Кэш не владеет программами, записи освобождённых удаляются по мере роста.
+// Не потокобезопасен.
+class ExpressionCompiler
+{
+public:
+    ExpressionCompiler() = default;
+
+    QSharedPointer<const ExpressionProgram> compile(const QString &text, QString *error);
+
+    // количество используемых программ в кэше
+    int cacheSize() const;
+    void clearCache();
+
+private:
+    void removeExpired();
+
+private:
+    QHash<QString, QWeakPointer<const ExpressionProgram>> mCache;
+    // размер кэша, при котором удаляются записи освобождённых программ
+    int mSweepSize{64};
+};
+
+// проверка синтаксиса без кэширования, пустая строка - выражение корректно
+QString checkExpression(const QString &text);
+
+// заменяет ссылки на датчик from в тексте выражения ссылками на to
+QString replaceReference(const QString &text, const QUuid &from, const QUuid &to);
+
+}
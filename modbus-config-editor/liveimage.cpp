@@ -0,0 +1,574 @@
+#include "liveimage.h"
+
+#include "modbusconfigmodel.h"
+#include "serializer.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+constexpr char liveMagic[8] = {'M', 'B', 'L', 'I', 'V', 'E', '0', '1'};
+constexpr quint32 liveVersion = 1;
+// магия, версия, состояние писателя, число блоков, карт и датчиков, размер строк,
+// хеш конфигурации, размер файла; порядок байт - как у машины
+constexpr int headerSize = 128;
+constexpr int stateOffset = 12;
+constexpr int hashSize = 32;
+constexpr int blockEntrySize = 16;
+// устройство, имя в таблице строк, тип, размер значения, число значений, блоки
+constexpr int mapEntrySize = 48;
+constexpr int sensorEntrySize = 32;
+constexpr int cacheLine = 64;
+constexpr quint32 stateStopped = 0;
+constexpr quint32 stateLive = 1;
+
+using ModbusConfig::RegisterAddress;
+
+quint64 alignUp(quint64 value)
+{
+    return (value + cacheLine - 1) / cacheLine * cacheLine;
+}
+
+int elementSize(RegisterAddress::ValType type)
+{
+    using T = RegisterAddress::ValType;
+    switch (type) {
+    case T::Bool:
+    case T::Int8:
+    case T::UInt8:
+        return 1;
+    case T::Int16:
+    case T::UInt16:
+        return 2;
+    case T::Int32:
+    case T::UInt32:
+    case T::Float:
+        return 4;
+    case T::Int64:
+    case T::UInt64:
+    case T::Double:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+ModbusConfig::LiveBlockLayout blockLayout(int dataSize)
+{
+    ModbusConfig::LiveBlockLayout block;
+    block.dataSize = dataSize;
+    return block;
+}
+
+template <typename T>
+void put(QByteArray *out, T value)
+{
+    out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(const uchar *data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+template <typename T>
+void storeAs(uchar *data, T value)
+{
+    std::memcpy(data, &value, sizeof(value));
+}
+
+// значение вне диапазона целого типа приводится к ближайшей границе, NaN - к нулю:
+// прямое приведение такого double - неопределённое поведение
+template <typename T>
+void storeInteger(uchar *data, double value)
+{
+    // для 64-битных max() в double округляется вверх, поэтому сравнение строгое
+    const double low = static_cast<double>(std::numeric_limits<T>::min());
+    const double high = static_cast<double>(std::numeric_limits<T>::max());
+    if (!(value > low)) {
+        storeAs(data, value == value ? std::numeric_limits<T>::min() : T(0));
+    } else if (!(value < high)) {
+        storeAs(data, std::numeric_limits<T>::max());
+    } else {
+        storeAs(data, static_cast<T>(value));
+    }
+}
+}
+
+namespace ModbusConfig {
+
+void LiveImageLayoutGenerator::setBlockSize(int bytes)
+{
+    mBlockSize = qMax(bytes, 8);
+}
+
+LiveImageLayout LiveImageLayoutGenerator::generate(const ModbusConfigModel &model) const
+{
+    LiveImageLayout layout;
+    layout.configHash = Serializer::contentHash(model);
+    // номер блока и место в нём у каждого датчика, смещения - после каталога
+    QVector<int> sensorSlots;
+    const int sensorsPerBlock = mBlockSize / int(sizeof(double));
+    auto addSensors = [&](const QUuid &devId, const QVector<const Sensor *> &sensors) {
+        for (int i = 0; i < sensors.size(); ++i) {
+            if (i % sensorsPerBlock == 0) {
+                const int count = qMin(sensorsPerBlock, sensors.size() - i);
+                layout.blocks.append(blockLayout(count * int(sizeof(double))));
+            }
+            LiveSensorLayout sensor;
+            sensor.devId = devId;
+            sensor.sensorId = sensors.at(i)->id;
+            sensor.block = layout.blocks.size() - 1;
+            layout.sensors.append(sensor);
+            sensorSlots.append(i % sensorsPerBlock);
+        }
+    };
+
+    quint64 stringsSize = 0;
+    auto devicesIds = model.devicesIds();
+    std::sort(devicesIds.begin(), devicesIds.end());
+    for (const auto &devId : qAsConst(devicesIds)) {
+        const auto &device = model.device(devId);
+        QVector<const Sensor *> readSensors;
+        for (const auto &sensor : device.sensors) {
+            if (sensor.mode != Sensor::Mode::Write) {
+                readSensors.append(&sensor);
+            }
+        }
+        std::sort(readSensors.begin(), readSensors.end(), [](const Sensor *l, const Sensor *r) {
+            return qMakePair(l->mapId, qMakePair(l->mapOffset, l->id))
+                < qMakePair(r->mapId, qMakePair(r->mapOffset, r->id));
+        });
+
+        // датчики без карты (Separate) - первыми, mapId у них пустой
+        QStringList mapIds = device.maps.keys();
+        std::sort(mapIds.begin(), mapIds.end());
+        auto sensorIt = readSensors.cbegin();
+        // датчики по mapId не больше заданного, last - все оставшиеся
+        auto takeSensors = [&](const QString &mapId, bool last) {
+            QVector<const Sensor *> result;
+            for (; sensorIt != readSensors.cend() && (last || (*sensorIt)->mapId <= mapId);
+                 ++sensorIt) {
+                result.append(*sensorIt);
+            }
+            return result;
+        };
+        addSensors(devId, takeSensors(QString(), false));
+        for (const auto &mapId : qAsConst(mapIds)) {
+            const auto &map = device.maps.value(mapId);
+            LiveMapLayout mapLayout;
+            mapLayout.devId = devId;
+            mapLayout.mapId = mapId;
+            mapLayout.valType = map.registеrAddress.valType;
+            mapLayout.elementSize = elementSize(mapLayout.valType);
+            mapLayout.valueCount = map.valueCount;
+            mapLayout.firstBlock = layout.blocks.size();
+            mapLayout.valuesPerBlock = qMax(1, mBlockSize / qMax(1, mapLayout.elementSize));
+            if (mapLayout.elementSize > 0) {
+                for (int first = 0; first < map.valueCount; first += mapLayout.valuesPerBlock) {
+                    const int count = qMin(mapLayout.valuesPerBlock, map.valueCount - first);
+                    layout.blocks.append(blockLayout(count * mapLayout.elementSize));
+                }
+                layout.maps.append(mapLayout);
+                stringsSize += mapId.toUtf8().size();
+            }
+            // датчики с неизвестной картой тоже получают место - идут с ближайшей
+            addSensors(devId, takeSensors(mapId, false));
+        }
+        addSensors(devId, takeSensors(QString(), true));
+    }
+
+    layout.directorySize = headerSize + quint64(layout.blocks.size()) * blockEntrySize
+        + quint64(layout.maps.size()) * mapEntrySize
+        + quint64(layout.sensors.size()) * sensorEntrySize + stringsSize;
+    quint64 offset = alignUp(layout.directorySize);
+    for (auto &block : layout.blocks) {
+        block.offset = offset;
+        offset += cacheLine + alignUp(quint64(block.dataSize));
+    }
+    for (int i = 0; i < layout.sensors.size(); ++i) {
+        auto &sensor = layout.sensors[i];
+        sensor.valueOffset = layout.blocks.at(sensor.block).offset + cacheLine
+            + quint64(sensorSlots.at(i)) * sizeof(double);
+    }
+    layout.fileSize = offset;
+    return layout;
+}
+
+LiveImage::~LiveImage()
+{
+    close();
+}
+
+void LiveImage::close()
+{
+    if (mData) {
+        mFile.unmap(mData);
+        mData = nullptr;
+    }
+    mFile.close();
+    mSize = 0;
+    mConfigHash.clear();
+    mBlocks.clear();
+    mMaps.clear();
+    mMapIndices.clear();
+    mSensorHandles.clear();
+}
+
+bool LiveImage::isOpen() const
+{
+    return mData != nullptr;
+}
+
+QByteArray LiveImage::configHash() const
+{
+    return mConfigHash;
+}
+
+int LiveImage::blockCount() const
+{
+    return mBlocks.size();
+}
+
+int LiveImage::mapCount() const
+{
+    return mMaps.size();
+}
+
+int LiveImage::sensorCount() const
+{
+    return mSensorHandles.size();
+}
+
+LiveHandle LiveImage::sensorHandle(const QUuid &sensorId) const
+{
+    return mSensorHandles.value(sensorId);
+}
+
+int LiveImage::mapIndex(const QUuid &devId, const QString &mapId) const
+{
+    return mMapIndices.value(qMakePair(devId, mapId), -1);
+}
+
+LiveHandle LiveImage::mapValueHandle(int map, int index) const
+{
+    LiveHandle handle;
+    if (map < 0 || map >= mMaps.size() || index < 0 || index >= mMaps.at(map).valueCount) {
+        return handle;
+    }
+    const auto &layout = mMaps.at(map);
+    const auto &block = mBlocks.at(layout.firstBlock + index / layout.valuesPerBlock);
+    handle.sequenceOffset = block.offset;
+    handle.valueOffset = block.offset + cacheLine
+        + quint64(index % layout.valuesPerBlock) * layout.elementSize;
+    handle.valType = layout.valType;
+    return handle;
+}
+
+QString LiveImage::attach(const QString &path, QIODevice::OpenMode mode)
+{
+    close();
+    mFile.setFileName(path);
+    if (!mFile.open(mode)) {
+        return QObject::tr("Не удалось открыть %0: %1").arg(path, mFile.errorString());
+    }
+    mSize = mFile.size();
+    mData = mSize >= headerSize ? mFile.map(0, mSize) : nullptr;
+    const QString corrupted = QObject::tr("%0: образ значений повреждён").arg(path);
+    if (!mData || std::memcmp(mData, liveMagic, sizeof(liveMagic)) != 0
+        || get<quint32>(mData + 8) != liveVersion) {
+        close();
+        return QObject::tr("%0 не является образом значений этой версии").arg(path);
+    }
+    const int blockCount = int(get<quint32>(mData + 16));
+    const int mapCount = int(get<quint32>(mData + 20));
+    const int sensorCount = int(get<quint32>(mData + 24));
+    const quint64 stringsSize = get<quint32>(mData + 28);
+    const quint64 blocksOffset = headerSize;
+    const quint64 mapsOffset = blocksOffset + quint64(blockCount) * blockEntrySize;
+    const quint64 sensorsOffset = mapsOffset + quint64(mapCount) * mapEntrySize;
+    const quint64 stringsOffset = sensorsOffset + quint64(sensorCount) * sensorEntrySize;
+    if (get<quint64>(mData + 64) != quint64(mSize) || blockCount < 0 || mapCount < 0
+        || sensorCount < 0 || stringsOffset + stringsSize > quint64(mSize)) {
+        close();
+        return corrupted;
+    }
+    mConfigHash = QByteArray(reinterpret_cast<const char *>(mData + 32), hashSize);
+
+    for (int i = 0; i < blockCount; ++i) {
+        const uchar *entry = mData + blocksOffset + quint64(i) * blockEntrySize;
+        LiveBlockLayout block;
+        block.offset = get<quint64>(entry);
+        block.dataSize = int(get<quint32>(entry + 8));
+        if (block.offset % cacheLine != 0 || block.dataSize < 0 || block.offset > quint64(mSize)
+            || cacheLine + quint64(block.dataSize) > quint64(mSize) - block.offset) {
+            close();
+            return corrupted;
+        }
+        mBlocks.append(block);
+    }
+    for (int i = 0; i < mapCount; ++i) {
+        const uchar *entry = mData + mapsOffset + quint64(i) * mapEntrySize;
+        LiveMapLayout map;
+        map.devId = QUuid::fromRfc4122(QByteArray(reinterpret_cast<const char *>(entry), 16));
+        const quint64 nameOffset = get<quint32>(entry + 16);
+        const quint64 nameLength = get<quint32>(entry + 20);
+        map.valType = RegisterAddress::ValType(entry[24]);
+        map.elementSize = entry[25];
+        map.valueCount = int(get<quint32>(entry + 28));
+        map.firstBlock = int(get<quint32>(entry + 32));
+        map.valuesPerBlock = int(get<quint32>(entry + 36));
+        bool valid = nameOffset + nameLength <= stringsSize && map.elementSize != 0
+            && map.elementSize == elementSize(map.valType) && map.valueCount >= 0
+            && map.valuesPerBlock > 0 && map.firstBlock >= 0;
+        // каждый блок карты вмещает свои значения; firstBlock сравнивается до сложения,
+        // чтобы номер блока не переполнил int
+        for (qint64 first = 0; valid && first < map.valueCount; first += map.valuesPerBlock) {
+            valid = map.firstBlock < blockCount
+                && first / map.valuesPerBlock < blockCount - map.firstBlock;
+            if (valid) {
+                const int block = map.firstBlock + int(first / map.valuesPerBlock);
+                const qint64 count = qMin<qint64>(map.valuesPerBlock, map.valueCount - first);
+                valid = count * map.elementSize <= mBlocks.at(block).dataSize;
+            }
+        }
+        if (!valid) {
+            close();
+            return corrupted;
+        }
+        map.mapId = QString::fromUtf8(
+            reinterpret_cast<const char *>(mData + stringsOffset + nameOffset), int(nameLength));
+        mMapIndices.insert(qMakePair(map.devId, map.mapId), mMaps.size());
+        mMaps.append(map);
+    }
+    for (int i = 0; i < sensorCount; ++i) {
+        const uchar *entry = mData + sensorsOffset + quint64(i) * sensorEntrySize;
+        const QUuid sensorId =
+            QUuid::fromRfc4122(QByteArray(reinterpret_cast<const char *>(entry), 16));
+        const int block = int(get<quint32>(entry + 24));
+        LiveHandle handle;
+        handle.valueOffset = get<quint64>(entry + 16);
+        handle.valType = RegisterAddress::ValType::Double;
+        if (block < 0 || block >= blockCount) {
+            close();
+            return corrupted;
+        }
+        handle.sequenceOffset = mBlocks.at(block).offset;
+        const quint64 dataOffset = handle.sequenceOffset + cacheLine;
+        const quint64 dataSize = quint64(mBlocks.at(block).dataSize);
+        if (handle.valueOffset < dataOffset || dataSize < sizeof(double)
+            || handle.valueOffset - dataOffset > dataSize - sizeof(double)) {
+            close();
+            return corrupted;
+        }
+        mSensorHandles.insert(sensorId, handle);
+    }
+    return {};
+}
+
+std::atomic<quint32> *LiveImage::sequence(quint64 offset) const
+{
+    return reinterpret_cast<std::atomic<quint32> *>(mData + offset);
+}
+
+LiveImageWriter::~LiveImageWriter()
+{
+    if (mData) {
+        sequence(stateOffset)->store(stateStopped, std::memory_order_release);
+    }
+}
+
+QString LiveImageWriter::create(const QString &path, const LiveImageLayout &layout)
+{
+    if (mData) {
+        sequence(stateOffset)->store(stateStopped, std::memory_order_release);
+    }
+    close();
+
+    QByteArray strings;
+    QByteArray maps;
+    for (const auto &map : layout.maps) {
+        const QByteArray name = map.mapId.toUtf8();
+        maps += map.devId.toRfc4122();
+        put(&maps, quint32(strings.size()));
+        put(&maps, quint32(name.size()));
+        put(&maps, quint8(map.valType));
+        put(&maps, quint8(map.elementSize));
+        put(&maps, quint16(0));
+        put(&maps, quint32(map.valueCount));
+        put(&maps, quint32(map.firstBlock));
+        put(&maps, quint32(map.valuesPerBlock));
+        put(&maps, quint64(0));
+        strings += name;
+    }
+    QByteArray blocks;
+    for (const auto &block : layout.blocks) {
+        put(&blocks, block.offset);
+        put(&blocks, quint32(block.dataSize));
+        put(&blocks, quint32(0));
+    }
+    QByteArray sensors;
+    for (const auto &sensor : layout.sensors) {
+        sensors += sensor.sensorId.toRfc4122();
+        put(&sensors, sensor.valueOffset);
+        put(&sensors, quint32(sensor.block));
+        put(&sensors, quint32(0));
+    }
+    QByteArray header(liveMagic, sizeof(liveMagic));
+    put(&header, liveVersion);
+    put(&header, stateStopped);
+    put(&header, quint32(layout.blocks.size()));
+    put(&header, quint32(layout.maps.size()));
+    put(&header, quint32(layout.sensors.size()));
+    put(&header, quint32(strings.size()));
+    header += layout.configHash.leftJustified(hashSize, '\0', true);
+    put(&header, layout.fileSize);
+    header += QByteArray(headerSize - header.size(), '\0');
+
+    // новый файл вместо старого: у читателей остаётся прежний, помеченный остановленным
+    QFile::remove(path);
+    QFile file(path);
+    const QByteArray directory = header + blocks + maps + sensors + strings;
+    if (!file.open(QIODevice::ReadWrite) || file.write(directory) != directory.size()
+        || !file.resize(qint64(layout.fileSize))) {
+        return QObject::tr("Не удалось создать %0: %1").arg(path, file.errorString());
+    }
+    file.close();
+
+    const QString error = attach(path, QIODevice::ReadWrite);
+    if (error.isEmpty()) {
+        sequence(stateOffset)->store(stateLive, std::memory_order_release);
+    }
+    return error;
+}
+
+void LiveImageWriter::writeMapValues(int map, int firstValue, int count, const double *values)
+{
+    if (map < 0 || map >= mMaps.size()) {
+        return;
+    }
+    const auto &layout = mMaps.at(map);
+    const int last = qMin(firstValue + count, layout.valueCount);
+    for (int index = qMax(firstValue, 0); index < last;) {
+        const int blockEnd =
+            qMin(last, (index / layout.valuesPerBlock + 1) * layout.valuesPerBlock);
+        const LiveHandle first = mapValueHandle(map, index);
+        beginUpdate(first.sequenceOffset);
+        LiveHandle handle = first;
+        for (; index < blockEnd; ++index) {
+            store(handle, values[index - firstValue]);
+            handle.valueOffset += layout.elementSize;
+        }
+        endUpdate(first.sequenceOffset);
+    }
+}
+
+void LiveImageWriter::writeSensorValues(
+    const QVector<LiveHandle> &handles, const QVector<QPair<int, double>> &changes)
+{
+    quint64 current = 0;
+    for (const auto &change : changes) {
+        const LiveHandle &handle = handles.at(change.first);
+        if (!handle.isValid()) {
+            continue;
+        }
+        if (handle.sequenceOffset != current) {
+            if (current != 0) {
+                endUpdate(current);
+            }
+            current = handle.sequenceOffset;
+            beginUpdate(current);
+        }
+        store(handle, change.second);
+    }
+    if (current != 0) {
+        endUpdate(current);
+    }
+}
+
+void LiveImageWriter::beginUpdate(quint64 sequenceOffset)
+{
+    auto *counter = sequence(sequenceOffset);
+    counter->store(counter->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void LiveImageWriter::endUpdate(quint64 sequenceOffset)
+{
+    auto *counter = sequence(sequenceOffset);
+    counter->store(counter->load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void LiveImageWriter::store(const LiveHandle &handle, double value)
+{
+    using T = RegisterAddress::ValType;
+    uchar *data = mData + handle.valueOffset;
+    switch (handle.valType) {
+    case T::Bool:
+        storeAs(data, quint8(value != 0));
+        break;
+    case T::Int8:
+        storeInteger<qint8>(data, value);
+        break;
+    case T::UInt8:
+        storeInteger<quint8>(data, value);
+        break;
+    case T::Int16:
+        storeInteger<qint16>(data, value);
+        break;
+    case T::UInt16:
+        storeInteger<quint16>(data, value);
+        break;
+    case T::Int32:
+        storeInteger<qint32>(data, value);
+        break;
+    case T::UInt32:
+        storeInteger<quint32>(data, value);
+        break;
+    case T::Int64:
+        storeInteger<qint64>(data, value);
+        break;
+    case T::UInt64:
+        storeInteger<quint64>(data, value);
+        break;
+    case T::Float:
+        storeAs(data, float(value));
+        break;
+    case T::Double:
+        storeAs(data, value);
+        break;
+    default:
+        break;
+    }
+}
+
+QString LiveImageReader::open(const QString &path)
+{
+    return attach(path, QIODevice::ReadOnly);
+}
+
+bool LiveImageReader::isLive() const
+{
+    return mData && sequence(stateOffset)->load(std::memory_order_acquire) == stateLive;
+}
+
+bool LiveImageReader::readBlock(int block, void *out) const
+{
+    const auto &layout = mBlocks.at(block);
+    const std::atomic<quint32> *counter = sequence(layout.offset);
+    quint32 before;
+    while (beginRead(counter, &before)) {
+        std::memcpy(out, mData + layout.offset + cacheLine, size_t(layout.dataSize));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (counter->load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QFile>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace ModbusConfig {
+
+class ModbusConfigModel;
+
+// Образ текущих значений в общей памяти для локальных потребителей (HMI, архив,
+// сигнализация) в обход сервера УПАК. Файл (обычно в /dev/shm) состоит из заголовка,
+// каталога карт и датчиков и блоков данных. Каждый блок - своя строка кэша со
+// счётчиком seqlock и значения за ней: писатель не ждёт читателей, читатель повторяет
+// чтение, если блок менялся, поэтому 64-битные значения не бывают разорванными.
+// Значения карт хранятся в своём типе valType, датчики - double после коррекции.
+
+struct LiveBlockLayout {
+    // смещение счётчика блока от начала файла, значения идут со следующей строки кэша
+    quint64 offset{};
+    int dataSize{};
+};
+
+struct LiveMapLayout {
+    QUuid devId;
+    QString mapId;
+    RegisterAddress::ValType valType{};
+    int elementSize{};
+    int valueCount{};
+    // значения карты идут блоками по valuesPerBlock подряд с firstBlock
+    int firstBlock{};
+    int valuesPerBlock{};
+};
+
+struct LiveSensorLayout {
+    QUuid devId;
+    QUuid sensorId;
+    int block{};
+    quint64 valueOffset{};
+};
+
+struct LiveImageLayout {
+    // SHA-256 конфигурации, как у записи опроса
+    QByteArray configHash;
+    QVector<LiveBlockLayout> blocks;
+    QVector<LiveMapLayout> maps;
+    QVector<LiveSensorLayout> sensors;
+    quint64 directorySize{};
+    quint64 fileSize{};
+};
+
+// Раскладка образа по конфигурации. Порядок не зависит от порядка вставки в модель:
+// устройства, карты и датчики идут по возрастанию идентификаторов, датчики карты -
+// по смещению в карте, так что одна и та же конфигурация даёт те же смещения.
+class LiveImageLayoutGenerator
+{
+public:
+    LiveImageLayoutGenerator() = default;
+
+    // наибольший размер данных блока: чем меньше, тем реже читатель повторяет чтение
+    void setBlockSize(int bytes);
+
+    LiveImageLayout generate(const ModbusConfigModel &model) const;
+
+private:
+    int mBlockSize{4096};
+};
+
+// Заранее найденное место значения: чтение - два обращения к счётчику блока и одно
+// к значению, без поиска.
+struct LiveHandle {
+    quint64 sequenceOffset{};
+    quint64 valueOffset{};
+    RegisterAddress::ValType valType{RegisterAddress::ValType::Unknown};
+
+    bool isValid() const
+    {
+        return valType != RegisterAddress::ValType::Unknown;
+    }
+};
+
+// Общая часть писателя и читателя: отображение файла и каталог.
+class LiveImage
+{
+public:
+    LiveImage() = default;
+    virtual ~LiveImage();
+    LiveImage(const LiveImage &) = delete;
+    LiveImage &operator=(const LiveImage &) = delete;
+
+    void close();
+    bool isOpen() const;
+
+    QByteArray configHash() const;
+    int blockCount() const;
+    int mapCount() const;
+    int sensorCount() const;
+
+    // недействительный описатель, если датчика или значения нет в образе
+    LiveHandle sensorHandle(const QUuid &sensorId) const;
+    int mapIndex(const QUuid &devId, const QString &mapId) const;
+    LiveHandle mapValueHandle(int map, int index) const;
+
+protected:
+    QString attach(const QString &path, QIODevice::OpenMode mode);
+    std::atomic<quint32> *sequence(quint64 offset) const;
+
+protected:
+    QFile mFile;
+    uchar *mData{};
+    qint64 mSize{};
+    QByteArray mConfigHash;
+    QVector<LiveBlockLayout> mBlocks;
+    QVector<LiveMapLayout> mMaps;
+    QHash<QPair<QUuid, QString>, int> mMapIndices;
+    QHash<QUuid, LiveHandle> mSensorHandles;
+};
+
+// Писатель - опрос. Один писатель на блок; блоки разных карт можно писать из разных потоков.
+class LiveImageWriter : public LiveImage
+{
+public:
+    LiveImageWriter() = default;
+    // образ помечается остановленным, читатели должны открыть файл заново
+    ~LiveImageWriter() override;
+
+    // создаёт файл заново: читатели старого файла видят его остановленным
+    QString create(const QString &path, const LiveImageLayout &layout);
+
+    // values[i] - значение карты с номером firstValue + i
+    void writeMapValues(int map, int firstValue, int count, const double *values);
+    // changes - (индекс в handles, значение), например изменения из MapUpdateKernel;
+    // подряд идущие значения одного блока публикуются одной записью
+    void writeSensorValues(const QVector<LiveHandle> &handles,
+        const QVector<QPair<int, double>> &changes);
+
+private:
+    void beginUpdate(quint64 sequenceOffset);
+    void endUpdate(quint64 sequenceOffset);
+    void store(const LiveHandle &handle, double value);
+};
+
+class LiveImageReader : public LiveImage
+{
+public:
+    QString open(const QString &path);
+
+    // false - писатель остановился или пересоздал образ, файл надо открыть заново
+    bool isLive() const;
+
+    // согласованное значение без блокировок; NaN, если писатель остановился посреди
+    // записи блока
+    double read(const LiveHandle &handle) const;
+    // согласованная копия блока целиком, out - не меньше dataSize блока;
+    // false, если писатель остановился посреди записи блока
+    bool readBlock(int block, void *out) const;
+
+private:
+    // запись блока занимает микросекунды: сначала ожидание впустую, затем с уступкой
+    // процессора; столько проверок подряд с тем же нечётным счётчиком - писатель упал
+    static constexpr int spinWaits = 1 << 10;
+    static constexpr int maxBusyWaits = 1 << 20;
+
+    // чётное значение счётчика блока, false - писатель упал посреди записи
+    static bool beginRead(const std::atomic<quint32> *counter, quint32 *before);
+    static double load(const uchar *value, RegisterAddress::ValType type);
+};
+
+inline bool LiveImageReader::beginRead(const std::atomic<quint32> *counter, quint32 *before)
+{
+    quint32 busy = 0;
+    int waits = 0;
+    for (;;) {
+        const quint32 value = counter->load(std::memory_order_acquire);
+        if (!(value & 1)) {
+            *before = value;
+            return true;
+        }
+        waits = value == busy ? waits + 1 : 0;
+        busy = value;
+        if (waits == maxBusyWaits) {
+            return false;
+        }
+        if (waits > spinWaits) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline double LiveImageReader::read(const LiveHandle &handle) const
+{
+    const std::atomic<quint32> *counter = sequence(handle.sequenceOffset);
+    const uchar *value = mData + handle.valueOffset;
+    quint32 before;
+    while (beginRead(counter, &before)) {
+        const double result = load(value, handle.valType);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (counter->load(std::memory_order_relaxed) == before) {
+            return result;
+        }
+    }
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+inline double LiveImageReader::load(const uchar *value, RegisterAddress::ValType type)
+{
+    using T = RegisterAddress::ValType;
+    switch (type) {
+    case T::Bool:
+    case T::UInt8: {
+        quint8 result;
+        std::memcpy(&result, value, sizeof(result));
+        return result;
+    }
+    case T::Int8: {
+        qint8 result;
+        std::memcpy(&result, value, sizeof(result));
+        return result;
+    }
+    case T::Int16: {
+        qint16 result;
+        std::memcpy(&result, value, sizeof(result));
+        return result;
+    }
+    case T::UInt16: {
+        quint16 result;
+        std::memcpy(&result, value, sizeof(result));
+        return result;
+    }
+    case T::Int32: {
+        qint32 result;
+        std::memcpy(&result, value, sizeof(result));
+        return result;
+    }
+    case T::UInt32: {
+        quint32 result;
+        std::memcpy(&result, value, sizeof(result));
+        return result;
+    }
+    case T::Int64: {
+        qint64 result;
+        std::memcpy(&result, value, sizeof(result));
+        return double(result);
+    }
+    case T::UInt64: {
+        quint64 result;
+        std::memcpy(&result, value, sizeof(result));
+        return double(result);
+    }
+    case T::Float: {
+        float result;
+        std::memcpy(&result, value, sizeof(result));
+        return result;
+    }
+    case T::Double: {
+        double result;
+        std::memcpy(&result, value, sizeof(result));
+        return result;
+    }
+    default:
+        return 0;
+    }
+}
+
+}
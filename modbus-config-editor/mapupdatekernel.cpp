@@ -0,0 +1,323 @@
+#include "mapupdatekernel.h"
+
+#include "cpufeatures.h"
+#include "modbusconfigmodel.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+constexpr int denseChunk = 256;
+// при заполнении карты датчиками от 1/4 выгоднее декодировать блок целиком
+constexpr int denseRatio = 4;
+constexpr double noValue = std::numeric_limits<double>::quiet_NaN();
+constexpr double infinity = std::numeric_limits<double>::infinity();
+}
+
+namespace ModbusConfig {
+
+MapUpdateKernel::MapUpdateKernel(
+    const ModbusConfigModel &model, const QUuid &devId, const QString &mapId)
+{
+    const auto &device = model.device(devId);
+    auto mapIt = device.maps.find(mapId);
+    if (mapIt == device.maps.end()) {
+        return;
+    }
+    const auto &address = mapIt.value().registеrAddress;
+    mBits = isBitRegisterType(address.regType);
+    mValueSize = registerCount(address) * 2;
+    mBlockDecoder = RegisterDecoder(address);
+    mDecoder = ScalarDecoder(address);
+
+    QVector<const Sensor *> sensors;
+    QVector<const Sensor *> aggregates;
+    for (const auto &sensor : device.sensors) {
+        if (sensor.type == Sensor::Type::Separate || sensor.mapId != mapId
+            || sensor.mode == Sensor::Mode::Write) {
+            continue;
+        }
+        auto program = model.sensorCorrection(sensor.id);
+        if (program && !program->references().isEmpty()) {
+            continue;
+        }
+        if (sensor.type == Sensor::Type::Aggregate) {
+            if (sensor.aggregateCount > 0) {
+                aggregates.append(&sensor);
+            }
+        } else {
+            sensors.append(&sensor);
+        }
+    }
+    std::sort(sensors.begin(), sensors.end(), [](const Sensor *l, const Sensor *r) {
+        return l->mapOffset < r->mapOffset;
+    });
+    const int plainCount = sensors.size();
+    sensors += aggregates;
+
+    for (const Sensor *sensor : qAsConst(sensors)) {
+        if (mIds.size() < plainCount) {
+            mOffsets.append(sensor->mapOffset);
+        } else {
+            mAggregates.append({mIds.size(), sensor->mapOffset, sensor->aggregateCount,
+                sensor->aggregation, AggregateState(), 0});
+        }
+        appendSensor(model, *sensor);
+    }
+    mLastSent.fill(noValue, mIds.size());
+    mFma = cpuFeatures().fma;
+    mDense = !mBits && mBlockDecoder.isValid()
+        && mOffsets.size() * denseRatio >= mapIt.value().valueCount;
+}
+
+MapUpdateKernel::MapUpdateKernel(const ModbusConfigModel &model, const QUuid &devId,
+    quint8 slaveAddress, RegisterAddress::RegisterType regType)
+    : mSeparate(true)
+{
+    QVector<const Sensor *> sensors;
+    for (const auto &sensor : model.device(devId).sensors) {
+        const auto &address = sensor.registerAddress;
+        if (sensor.type != Sensor::Type::Separate || sensor.mode == Sensor::Mode::Write
+            || address.slaveAddress != slaveAddress || address.regType != regType) {
+            continue;
+        }
+        auto program = model.sensorCorrection(sensor.id);
+        if (program && !program->references().isEmpty()) {
+            continue;
+        }
+        sensors.append(&sensor);
+    }
+    mBits = isBitRegisterType(regType);
+    if (!mBits) {
+        sensors.erase(std::remove_if(sensors.begin(), sensors.end(), [&](const Sensor *s) {
+            return !model.sensorDecoder(s->id).isValid();
+        }), sensors.end());
+    }
+    std::sort(sensors.begin(), sensors.end(), [](const Sensor *l, const Sensor *r) {
+        return l->registerAddress.regAddress < r->registerAddress.regAddress;
+    });
+
+    mValueSize = 2;
+    for (const Sensor *sensor : qAsConst(sensors)) {
+        mOffsets.append(sensor->registerAddress.regAddress);
+        mSpans.append(registerCount(sensor->registerAddress));
+        mSensorDecoders.append(model.sensorDecoder(sensor->id));
+        appendSensor(model, *sensor);
+    }
+    mLastSent.fill(noValue, mIds.size());
+    mFma = cpuFeatures().fma;
+}
+
+int MapUpdateKernel::sensorCount() const
+{
+    return mIds.size();
+}
+
+QUuid MapUpdateKernel::sensorId(int index) const
+{
+    return mIds.at(index);
+}
+
+void MapUpdateKernel::process(
+    const quint8 *raw, int firstValue, int count, QVector<QPair<int, double>> *changes)
+{
+    if (mSeparate) {
+        processSeparate(raw, firstValue, count, changes);
+        return;
+    }
+    if (!mDecoder.isValid() && !mBits) {
+        return;
+    }
+    if (mBits) {
+        processSparse<true>(raw, firstValue, count, changes);
+    } else if (mDense) {
+        processDense(raw, firstValue, count, changes);
+    } else {
+        processSparse<false>(raw, firstValue, count, changes);
+    }
+    if (!mAggregates.isEmpty()) {
+        processAggregates(raw, firstValue, count, changes);
+    }
+}
+
+void MapUpdateKernel::reset()
+{
+    mLastSent.fill(noValue, mLastSent.size());
+    for (auto &aggregate : mAggregates) {
+        aggregate.state = AggregateState();
+        aggregate.received = 0;
+    }
+}
+
+template <bool Bits>
+void MapUpdateKernel::processSparse(
+    const quint8 *raw, int firstValue, int count, QVector<QPair<int, double>> *changes)
+{
+    auto it = std::lower_bound(mOffsets.cbegin(), mOffsets.cend(), firstValue);
+    for (int index = int(it - mOffsets.cbegin()); index < mOffsets.size(); ++index) {
+        const int position = mOffsets.at(index) - firstValue;
+        if (position >= count) {
+            break;
+        }
+        double value;
+        if (Bits) {
+            value = (raw[position / 8] >> (position % 8)) & 1;
+        } else {
+            value = mDecoder(raw + position * mValueSize);
+        }
+        emitValue(index, value, changes);
+    }
+}
+
+void MapUpdateKernel::processSeparate(
+    const quint8 *raw, int firstValue, int count, QVector<QPair<int, double>> *changes)
+{
+    auto it = std::lower_bound(mOffsets.cbegin(), mOffsets.cend(), firstValue);
+    for (int index = int(it - mOffsets.cbegin()); index < mOffsets.size(); ++index) {
+        const int position = mOffsets.at(index) - firstValue;
+        if (position >= count) {
+            break;
+        }
+        // датчик, прочитанный не целиком, ждёт ответа, где он есть полностью
+        if (position + mSpans.at(index) > count) {
+            continue;
+        }
+        const double value = mBits ? (raw[position / 8] >> (position % 8)) & 1
+                                   : mSensorDecoders.at(index)(raw + position * mValueSize);
+        emitValue(index, value, changes);
+    }
+}
+
+void MapUpdateKernel::processDense(
+    const quint8 *raw, int firstValue, int count, QVector<QPair<int, double>> *changes)
+{
+    // блок декодируется кусками, помещающимися в L1, и сразу обрабатывается
+    double decoded[denseChunk];
+    int index = int(std::lower_bound(mOffsets.cbegin(), mOffsets.cend(), firstValue)
+        - mOffsets.cbegin());
+    for (int chunk = 0; chunk < count && index < mOffsets.size(); chunk += denseChunk) {
+        const int size = qMin(denseChunk, count - chunk);
+        const int chunkEnd = firstValue + chunk + size;
+        if (mOffsets.at(index) >= chunkEnd) {
+            continue;
+        }
+        mBlockDecoder.decode(raw + chunk * mValueSize, size, decoded);
+        for (; index < mOffsets.size() && mOffsets.at(index) < chunkEnd; ++index) {
+            emitValue(index, decoded[mOffsets.at(index) - firstValue - chunk], changes);
+        }
+    }
+}
+
+void MapUpdateKernel::processAggregates(
+    const quint8 *raw, int firstValue, int count, QVector<QPair<int, double>> *changes)
+{
+    // каждый кусок блока декодируется один раз для всех агрегатов, которые его покрывают
+    double decoded[denseChunk];
+    for (int chunk = 0; chunk < count; chunk += denseChunk) {
+        const int chunkBegin = firstValue + chunk;
+        const int chunkEnd = chunkBegin + qMin(denseChunk, count - chunk);
+        bool isDecoded = false;
+        for (auto &aggregate : mAggregates) {
+            const int begin = qMax(aggregate.first, chunkBegin);
+            const int end = qMin(aggregate.first + aggregate.count, chunkEnd);
+            if (begin >= end) {
+                continue;
+            }
+            if (!isDecoded) {
+                const int size = chunkEnd - chunkBegin;
+                if (mBits) {
+                    for (int i = 0; i < size; ++i) {
+                        const int position = chunk + i;
+                        decoded[i] = (raw[position / 8] >> (position % 8)) & 1;
+                    }
+                } else if (mBlockDecoder.isValid()) {
+                    mBlockDecoder.decode(raw + chunk * mValueSize, size, decoded);
+                } else {
+                    for (int i = 0; i < size; ++i) {
+                        decoded[i] = mDecoder(raw + (chunk + i) * mValueSize);
+                    }
+                }
+                isDecoded = true;
+            }
+            // начало диапазона открывает новый цикл накопления
+            if (begin == aggregate.first) {
+                aggregate.state = AggregateState();
+                aggregate.received = 0;
+            }
+            accumulate(decoded + (begin - chunkBegin), end - begin, &aggregate.state);
+            aggregate.received += end - begin;
+            if (end == aggregate.first + aggregate.count) {
+                if (aggregate.received == aggregate.count) {
+                    emitValue(aggregate.index,
+                        aggregateValue(aggregate.aggregation, aggregate.state), changes);
+                }
+                aggregate.state = AggregateState();
+                aggregate.received = 0;
+            }
+        }
+    }
+}
+
+void MapUpdateKernel::appendSensor(const ModbusConfigModel &model, const Sensor &sensor)
+{
+    mIds.append(sensor.id);
+    auto program = model.sensorCorrection(sensor.id);
+    double scale = 1;
+    double shift = 0;
+    const ExpressionProgram *general = nullptr;
+    if (program) {
+        switch (program->kind()) {
+        case ExpressionProgram::Kind::Identity:
+            break;
+        case ExpressionProgram::Kind::Constant:
+        case ExpressionProgram::Kind::Linear:
+            scale = program->scale();
+            shift = program->offset();
+            break;
+        case ExpressionProgram::Kind::General:
+            general = program.data();
+            mProgramHolders.append(program);
+            break;
+        }
+    }
+    mScales.append(scale);
+    mShifts.append(shift);
+    mPrograms.append(general);
+    // границы учитываются, только если задан непустой диапазон
+    double minValue = -infinity;
+    double maxValue = infinity;
+    if (!sensor.minValue.isNull() && !sensor.maxValue.isNull()
+        && sensor.minValue.toDouble() < sensor.maxValue.toDouble()) {
+        minValue = sensor.minValue.toDouble();
+        maxValue = sensor.maxValue.toDouble();
+    }
+    mMinValues.append(minValue);
+    mMaxValues.append(maxValue);
+    mThresholds.append(qMax(sensor.updateThreshold, 0.0));
+}
+
+void MapUpdateKernel::emitValue(int index, double value, QVector<QPair<int, double>> *changes)
+{
+    if (const ExpressionProgram *program = mPrograms.at(index)) {
+        value = program->evaluate(value);
+    } else if (mFma) {
+        // так же, как линейный путь ExpressionProgram
+        value = std::fma(mScales.at(index), value, mShifts.at(index));
+    } else {
+        value = mScales.at(index) * value + mShifts.at(index);
+    }
+    if (std::isnan(value)) {
+        return;
+    }
+    value = qBound(mMinValues.at(index), value, mMaxValues.at(index));
+    const double last = mLastSent.at(index);
+    // NaN в last - значение ещё не отправлялось
+    if (value != last && !(std::fabs(value - last) < mThresholds.at(index))) {
+        mLastSent[index] = value;
+        changes->append(qMakePair(index, value));
+    }
+}
+
+}
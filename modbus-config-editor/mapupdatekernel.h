@@ -0,0 +1,90 @@
+#pragma once
+
+#include "aggregatekernel.h"
+#include "expressioncompiler.h"
+#include "registerdecoder.h"
+#include "scalardecoder.h"
+
+#include <QPair>
+#include <QVector>
+
+namespace ModbusConfig {
+
+class ModbusConfigModel;
+
+// Преобразование блока значений карты регистров в обновления датчиков за один проход:
+// декодирование по typeOrder, корректирующая функция, ограничение minValue / maxValue
+// и порог updateThreshold относительно последнего отправленного значения.
+// Агрегированные датчики накапливают свёртку по мере прихода своего диапазона
+// и выдают значение, когда получено последнее значение диапазона.
+// Датчики, ссылающиеся на другие датчики, пересчитываются DerivedValueEngine и здесь не участвуют.
+class MapUpdateKernel
+{
+public:
+    MapUpdateKernel(const ModbusConfigModel &model, const QUuid &devId, const QString &mapId);
+    // Отдельные датчики слейва с регистрами одного типа: значения - регистры (биты)
+    // по адресу регистра, каждый датчик декодируется своим декодером
+    MapUpdateKernel(const ModbusConfigModel &model, const QUuid &devId, quint8 slaveAddress,
+        RegisterAddress::RegisterType regType);
+
+    int sensorCount() const;
+    QUuid sensorId(int index) const;
+
+    // raw - значения карты с номера firstValue в том виде, как пришли по сети;
+    // в changes добавляются (индекс датчика, новое значение) только для изменившихся датчиков
+    void process(const quint8 *raw, int firstValue, int count,
+        QVector<QPair<int, double>> *changes);
+    // забыть отправленные значения, следующий process отдаст все датчики
+    void reset();
+
+private:
+    template <bool Bits>
+    void processSparse(const quint8 *raw, int firstValue, int count,
+        QVector<QPair<int, double>> *changes);
+    void processDense(const quint8 *raw, int firstValue, int count,
+        QVector<QPair<int, double>> *changes);
+    void processSeparate(const quint8 *raw, int firstValue, int count,
+        QVector<QPair<int, double>> *changes);
+    void processAggregates(const quint8 *raw, int firstValue, int count,
+        QVector<QPair<int, double>> *changes);
+    void appendSensor(const ModbusConfigModel &model, const Sensor &sensor);
+    void emitValue(int index, double value, QVector<QPair<int, double>> *changes);
+
+private:
+    bool mSeparate{};
+    bool mBits{};
+    bool mDense{};
+    bool mFma{};
+    int mValueSize{};
+    RegisterDecoder mBlockDecoder;
+    ScalarDecoder mDecoder;
+
+    struct Aggregate {
+        int index;
+        int first;
+        int count;
+        Sensor::Aggregation aggregation;
+        AggregateState state;
+        int received;
+    };
+
+    // датчики отсортированы по смещению в карте, данные разложены по массивам;
+    // агрегаты идут после обычных датчиков, mOffsets содержит только обычные
+    QVector<QUuid> mIds;
+    QVector<int> mOffsets;
+    // для отдельных датчиков: число регистров и декодер датчика
+    QVector<int> mSpans;
+    QVector<ScalarDecoder> mSensorDecoders;
+    // корректирующая функция вида scale * val + offset, для остальных - программа
+    QVector<double> mScales;
+    QVector<double> mShifts;
+    QVector<const ExpressionProgram *> mPrograms;
+    QVector<QSharedPointer<const ExpressionProgram>> mProgramHolders;
+    QVector<double> mMinValues;
+    QVector<double> mMaxValues;
+    QVector<double> mThresholds;
+    QVector<double> mLastSent;
+    QVector<Aggregate> mAggregates;
+};
+
+}
@@ -1,4 +1,4 @@
-QT       += core gui network
+QT       += core gui network concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -8,35 +8,29 @@ CONFIG += c++11
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(modbusconfigcore.pri)
+
 SOURCES += \
     main.cpp \
     modbusconfigeditorcontroller.cpp \
     modbusconfigeditormainwindow.cpp \
-    modbusconfigmodel.cpp \
-    modbusentities.cpp \
-    serializer.cpp \
-    serializerhelper.cpp \
     settingsmodel.cpp \
-    utils.cpp \
     widgets/modbusdevicesettingswidget.cpp \
     widgets/registeraddresseditwidget.cpp \
     widgets/sensormapwidget.cpp \
     widgets/sensorsettingswidget.cpp \
+    widgets/stalenessreportwidget.cpp \
     widgets/upaksettingswidget.cpp
 
 HEADERS += \
     modbusconfigeditorcontroller.h \
     modbusconfigeditormainwindow.h \
-    modbusconfigmodel.h \
-    modbusentities.h \
-    serializer.h \
-    serializerhelper.h \
     settingsmodel.h \
-    utils.h \
     widgets/modbusdevicesettingswidget.h \
     widgets/registeraddresseditwidget.h \
     widgets/sensormapwidget.h \
     widgets/sensorsettingswidget.h \
+    widgets/stalenessreportwidget.h \
     widgets/upaksettingswidget.h
 
 FORMS += \
@@ -45,6 +39,7 @@ FORMS += \
     widgets/registeraddresseditwidget.ui \
     widgets/sensormapwidget.ui \
     widgets/sensorsettingswidget.ui \
+    widgets/stalenessreportwidget.ui \
     widgets/upaksettingswidget.ui
 
 # Default rules for deployment.
@@ -0,0 +1,64 @@
+# Модель конфигурации, сериализация и ядро опроса без виджетов:
+# общие для редактора и вспомогательных утилит (симулятор и т.д.)
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/aggregatekernel.cpp \
+    $$PWD/byteorderinference.cpp \
+    $$PWD/configpartitioner.cpp \
+    $$PWD/connectivitychecker.cpp \
+    $$PWD/cpufeatures.cpp \
+    $$PWD/crc16.cpp \
+    $$PWD/derivedvalues.cpp \
+    $$PWD/expressioncompiler.cpp \
+    $$PWD/liveimage.cpp \
+    $$PWD/mapupdatekernel.cpp \
+    $$PWD/modbusconfigmodel.cpp \
+    $$PWD/modbusentities.cpp \
+    $$PWD/modbusframe.cpp \
+    $$PWD/pollplan.cpp \
+    $$PWD/pollplanner.cpp \
+    $$PWD/pollplanoptimizer.cpp \
+    $$PWD/registerdecoder.cpp \
+    $$PWD/registerprober.cpp \
+    $$PWD/registertrace.cpp \
+    $$PWD/scalardecoder.cpp \
+    $$PWD/serializer.cpp \
+    $$PWD/serializerhelper.cpp \
+    $$PWD/seriallink.cpp \
+    $$PWD/slavediscovery.cpp \
+    $$PWD/stalenessanalyzer.cpp \
+    $$PWD/thresholdtuner.cpp \
+    $$PWD/tracereplayer.cpp \
+    $$PWD/utils.cpp
+
+HEADERS += \
+    $$PWD/aggregatekernel.h \
+    $$PWD/byteorderinference.h \
+    $$PWD/configpartitioner.h \
+    $$PWD/connectivitychecker.h \
+    $$PWD/cpufeatures.h \
+    $$PWD/crc16.h \
+    $$PWD/derivedvalues.h \
+    $$PWD/expressioncompiler.h \
+    $$PWD/liveimage.h \
+    $$PWD/mapupdatekernel.h \
+    $$PWD/modbusconfigmodel.h \
+    $$PWD/modbusentities.h \
+    $$PWD/modbusframe.h \
+    $$PWD/pollplan.h \
+    $$PWD/pollplanner.h \
+    $$PWD/pollplanoptimizer.h \
+    $$PWD/registerdecoder.h \
+    $$PWD/registerprober.h \
+    $$PWD/registertrace.h \
+    $$PWD/scalardecoder.h \
+    $$PWD/serializer.h \
+    $$PWD/serializerhelper.h \
+    $$PWD/seriallink.h \
+    $$PWD/slavediscovery.h \
+    $$PWD/stalenessanalyzer.h \
+    $$PWD/thresholdtuner.h \
+    $$PWD/tracereplayer.h \
+    $$PWD/utils.h
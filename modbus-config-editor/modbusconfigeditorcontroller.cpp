@@ -4,8 +4,14 @@
 
 #include <QDebug>
 #include <QJsonDocument>
+#include <QSet>
 
 #include "serializer.h"
+#include "configpartitioner.h"
+#include "pollplanoptimizer.h"
+#include "registertrace.h"
+#include "stalenessanalyzer.h"
+#include "thresholdtuner.h"
 
 namespace ModbusConfig {
 
@@ -48,6 +54,42 @@ ModbusConfigEditorController::ModbusConfigEditorController(
         this, &ModbusConfigEditorController::onDeleteSensorMapRequest);
     connect(mModbusConfigEditorMainWindow, &ModbusConfigEditorMainWindow::deleteSensorRequest,
         this, &ModbusConfigEditorController::onDeleteSensorRequest);
+    connect(mModbusConfigEditorMainWindow, &ModbusConfigEditorMainWindow::optimizePollPlanRequest,
+        this, &ModbusConfigEditorController::onOptimizePollPlanRequest);
+    connect(mModbusConfigEditorMainWindow, &ModbusConfigEditorMainWindow::stalenessAnalysisRequest,
+        this, &ModbusConfigEditorController::onStalenessAnalysisRequest);
+    connect(mModbusConfigEditorMainWindow, &ModbusConfigEditorMainWindow::partitionRequest,
+        this, &ModbusConfigEditorController::onPartitionRequest);
+    connect(mModbusConfigEditorMainWindow, &ModbusConfigEditorMainWindow::connectivityCheckRequest,
+        this, &ModbusConfigEditorController::onConnectivityCheckRequest);
+    connect(&mConnectivityChecker, &ConnectivityChecker::progress,
+        this, [this](int done, int total) {
+            mModbusConfigEditorMainWindow->showMessage(
+                tr("Проверка подключений: %0 из %1").arg(done).arg(total));
+        });
+    connect(&mConnectivityChecker, &ConnectivityChecker::finished,
+        this, &ModbusConfigEditorController::onConnectivityCheckFinished);
+    connect(mModbusConfigEditorMainWindow, &ModbusConfigEditorMainWindow::slaveDiscoveryRequest,
+        this, &ModbusConfigEditorController::onSlaveDiscoveryRequest);
+    connect(&mSlaveDiscovery, &SlaveDiscovery::progress,
+        this, [this](int done, int total) {
+            mModbusConfigEditorMainWindow->showMessage(
+                tr("Поиск слейвов: %0 из %1").arg(done).arg(total));
+        });
+    connect(&mSlaveDiscovery, &SlaveDiscovery::finished,
+        this, &ModbusConfigEditorController::onSlaveDiscoveryFinished);
+    connect(mModbusConfigEditorMainWindow, &ModbusConfigEditorMainWindow::registerProbeRequest,
+        this, &ModbusConfigEditorController::onRegisterProbeRequest);
+    connect(&mRegisterProber, &RegisterProber::progress,
+        this, [this](int requestCount, int readableCount) {
+            mModbusConfigEditorMainWindow->showMessage(
+                tr("Поиск регистров: запросов %0, читаемых регистров %1")
+                    .arg(requestCount).arg(readableCount));
+        });
+    connect(&mRegisterProber, &RegisterProber::finished,
+        this, &ModbusConfigEditorController::onRegisterProbeFinished);
+    connect(mModbusConfigEditorMainWindow, &ModbusConfigEditorMainWindow::thresholdTuningRequest,
+        this, &ModbusConfigEditorController::onThresholdTuningRequest);
 }
 
 void ModbusConfigEditorController::onUpakSettingRequest()
@@ -235,4 +277,211 @@ void ModbusConfigEditorController::onShowJsonRequest()
         QString::fromUtf8(QJsonDocument(serializer.serialize(*mModbusConfigModel)).toJson()));
 }
 
+void ModbusConfigEditorController::onOptimizePollPlanRequest()
+{
+    PollPlanOptimizer optimizer;
+    auto results = optimizer.optimize(*mModbusConfigModel);
+    auto error = PollPlanOptimizer::apply(mModbusConfigModel, results);
+    mModbusConfigEditorMainWindow->setError(error);
+    if (!error.isEmpty()) {
+        return;
+    }
+    double before = 0;
+    double after = 0;
+    for (const auto &result : qAsConst(results)) {
+        before += result.cycleTimeBefore;
+        after += result.cycleTimeAfter;
+    }
+    mModbusConfigEditorMainWindow->showMessage(
+        tr("Суммарное время цикла опроса: %0 мс -> %1 мс")
+            .arg(before * 1000, 0, 'f', 1).arg(after * 1000, 0, 'f', 1));
+    onShowJsonRequest();
+}
+
+void ModbusConfigEditorController::onStalenessAnalysisRequest()
+{
+    StalenessAnalyzer analyzer;
+    mModbusConfigEditorMainWindow->setStalenessReport(analyzer.analyze(*mModbusConfigModel));
+}
+
+void ModbusConfigEditorController::onPartitionRequest(int nodeCount, const QString &dirPath)
+{
+    ConfigPartitioner partitioner;
+    PartitionReport report;
+    auto partitions = partitioner.partition(*mModbusConfigModel, nodeCount, &report);
+    auto error = ConfigPartitioner::write(partitions, report, dirPath, "modbus-config-node");
+    mModbusConfigEditorMainWindow->setError(error);
+    if (!error.isEmpty()) {
+        return;
+    }
+    QStringList loads;
+    for (const auto &node : qAsConst(report.nodes)) {
+        loads << tr("%0 уст. / %1 мс").arg(node.deviceCount).arg(node.busTime * 1000, 0, 'f', 1);
+    }
+    mModbusConfigEditorMainWindow->showMessage(
+        tr("Конфигурация разделена по узлам: %0").arg(loads.join(", ")));
+}
+
+void ModbusConfigEditorController::onConnectivityCheckRequest()
+{
+    if (mConnectivityChecker.isRunning()) {
+        mModbusConfigEditorMainWindow->showMessage(tr("Проверка подключений уже выполняется"));
+        return;
+    }
+    mConnectivityChecker.start(*mModbusConfigModel);
+}
+
+void ModbusConfigEditorController::onConnectivityCheckFinished(const ConnectivityReport &report)
+{
+    mModbusConfigEditorMainWindow->showMessage(
+        tr("Проверка подключений завершена: ответили %0 из %1")
+            .arg(report.okCount).arg(report.devices.size()));
+    mModbusConfigEditorMainWindow->setReportText(connectivityReportText(report).join('\n'));
+}
+
+void ModbusConfigEditorController::onSlaveDiscoveryRequest(const QUuid &deviceId)
+{
+    if (mSlaveDiscovery.isRunning()) {
+        mModbusConfigEditorMainWindow->showMessage(tr("Поиск слейвов уже выполняется"));
+        return;
+    }
+    mSlaveDiscovery.start(mModbusConfigModel->device(deviceId).settings.connectionParams);
+}
+
+void ModbusConfigEditorController::onSlaveDiscoveryFinished(const SlaveDiscoveryReport &report)
+{
+    mModbusConfigEditorMainWindow->setReportText(slaveDiscoveryReportText(report).join('\n'));
+    if (!report.error.isEmpty()) {
+        mModbusConfigEditorMainWindow->setError(report.error);
+        return;
+    }
+
+    // слейвы, уже описанные в конфигурации на той же линии, не дублируются
+    const QString channel = channelKey(report.params);
+    QSet<int> known;
+    for (const auto &devId : mModbusConfigModel->devicesIds()) {
+        const auto &device = mModbusConfigModel->device(devId);
+        if (channelKey(device.settings.connectionParams) != channel) {
+            continue;
+        }
+        for (const auto &map : device.maps) {
+            known.insert(map.registеrAddress.slaveAddress);
+        }
+        for (const auto &sensor : device.sensors) {
+            known.insert(sensor.registerAddress.slaveAddress);
+        }
+    }
+
+    int added = 0;
+    for (const auto &device : discoveredDevices(report)) {
+        const auto &map = *device.maps.cbegin();
+        if (known.contains(map.registеrAddress.slaveAddress)) {
+            continue;
+        }
+        QString error = mModbusConfigModel->insertDevice(device);
+        if (!error.isEmpty()) {
+            mModbusConfigEditorMainWindow->setError(error);
+            return;
+        }
+        mModbusConfigEditorMainWindow->addDevice(device.settings.id, device.settings.description);
+        mModbusConfigEditorMainWindow->addSensorMap(device.settings.id, map.id);
+        ++added;
+    }
+    mModbusConfigEditorMainWindow->showMessage(
+        tr("Поиск слейвов завершён: найдено %0, добавлено устройств %1")
+            .arg(report.slaves.size()).arg(added));
+    if (added > 0) {
+        onShowJsonRequest();
+    }
+}
+
+void ModbusConfigEditorController::onRegisterProbeRequest(const QUuid &deviceId)
+{
+    if (mRegisterProber.isRunning()) {
+        mModbusConfigEditorMainWindow->showMessage(tr("Поиск регистров уже выполняется"));
+        return;
+    }
+    // адрес слейва устройства - из его карт и датчиков, у нового устройства - 1
+    const auto &device = mModbusConfigModel->device(deviceId);
+    quint8 slave = 1;
+    if (!device.maps.isEmpty()) {
+        slave = device.maps.cbegin().value().registеrAddress.slaveAddress;
+    } else if (!device.sensors.isEmpty()) {
+        slave = device.sensors.cbegin().value().registerAddress.slaveAddress;
+    }
+    mProbedDeviceId = deviceId;
+    mRegisterProber.start(device.settings.connectionParams, slave);
+}
+
+void ModbusConfigEditorController::onRegisterProbeFinished(const RegisterProbeReport &report)
+{
+    mModbusConfigEditorMainWindow->setReportText(registerProbeReportText(report).join('\n'));
+    if (!report.error.isEmpty()) {
+        mModbusConfigEditorMainWindow->setError(report.error);
+        return;
+    }
+    if (!mModbusConfigModel->devicesIds().contains(mProbedDeviceId)) {
+        // устройство удалили, пока шёл поиск
+        return;
+    }
+    const auto previousMaps = mModbusConfigModel->device(mProbedDeviceId).maps;
+    QString error = applyProbedSensorMaps(mModbusConfigModel, mProbedDeviceId, report);
+    mModbusConfigEditorMainWindow->setError(error);
+    for (const auto &map : probedSensorMaps(report)) {
+        if (!previousMaps.contains(map.id)
+            && mModbusConfigModel->device(mProbedDeviceId).maps.contains(map.id)) {
+            mModbusConfigEditorMainWindow->addSensorMap(mProbedDeviceId, map.id);
+        }
+    }
+    mModbusConfigEditorMainWindow->showMessage(
+        tr("Поиск регистров завершён: диапазонов %0, запросов %1")
+            .arg(report.spans.size()).arg(report.requestCount));
+    onShowJsonRequest();
+}
+
+void ModbusConfigEditorController::onThresholdTuningRequest(
+    const QString &tracePath, double targetRate)
+{
+    RegisterTrace trace;
+    QString error = trace.open(tracePath);
+    mModbusConfigEditorMainWindow->setError(error);
+    if (!error.isEmpty()) {
+        return;
+    }
+    QStringList lines;
+    if (trace.configHash() != Serializer::contentHash(*mModbusConfigModel)) {
+        lines << tr("Запись сделана по другой версии конфигурации, "
+                    "изменённые карты и датчики могут быть пропущены");
+    }
+    ThresholdTuner tuner;
+    const auto report = tuner.tune(*mModbusConfigModel, trace, targetRate);
+    lines += thresholdTuningReportText(report);
+    mModbusConfigEditorMainWindow->setReportText(lines.join('\n'));
+    if (!report.error.isEmpty()) {
+        mModbusConfigEditorMainWindow->setError(report.error);
+        return;
+    }
+    const QString question = tr("Поток на сервер: %0 сообщ./с -> %1 сообщ./с. "
+                                "Применить предложенные пороги?")
+                                 .arg(report.currentRate, 0, 'f', 1)
+                                 .arg(report.proposedRate, 0, 'f', 1);
+    if (!mModbusConfigEditorMainWindow->askConfirmation(tr("Подбор порогов обновления"),
+            question)) {
+        return;
+    }
+    error = applyThresholdTuning(mModbusConfigModel, report);
+    mModbusConfigEditorMainWindow->setError(error);
+    if (!error.isEmpty()) {
+        return;
+    }
+    mModbusConfigEditorMainWindow->showMessage(
+        tr("Пороги обновления применены: поток на сервер %0 сообщ./с -> %1 сообщ./с")
+            .arg(report.currentRate, 0, 'f', 1).arg(report.proposedRate, 0, 'f', 1));
+    // открытая страница датчика не должна показывать старый порог
+    if (!mCurrentSensorId.isNull()) {
+        onSensorSettingsRequest(mCurrentDeviceId, mCurrentSensorId);
+    }
+    onShowJsonRequest();
+}
+
 }
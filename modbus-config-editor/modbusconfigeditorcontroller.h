@@ -2,8 +2,11 @@
 
 #include <QObject>
 
+#include "connectivitychecker.h"
 #include "modbusconfigeditormainwindow.h"
 #include "modbusconfigmodel.h"
+#include "registerprober.h"
+#include "slavediscovery.h"
 
 
 namespace ModbusConfig {
@@ -36,6 +39,16 @@ private:
     void onSensorMapSettingsChanged(const ModbusConfig::SensorsMap &settings);
     void onSensorSettingsChanged(const ModbusConfig::Sensor &settings);
     void onShowJsonRequest();
+    void onOptimizePollPlanRequest();
+    void onStalenessAnalysisRequest();
+    void onPartitionRequest(int nodeCount, const QString &dirPath);
+    void onConnectivityCheckRequest();
+    void onConnectivityCheckFinished(const ModbusConfig::ConnectivityReport &report);
+    void onSlaveDiscoveryRequest(const QUuid &deviceId);
+    void onSlaveDiscoveryFinished(const ModbusConfig::SlaveDiscoveryReport &report);
+    void onRegisterProbeRequest(const QUuid &deviceId);
+    void onRegisterProbeFinished(const ModbusConfig::RegisterProbeReport &report);
+    void onThresholdTuningRequest(const QString &tracePath, double targetRate);
 
 private:
     ModbusConfigEditorMainWindow *mModbusConfigEditorMainWindow;
@@ -43,6 +56,10 @@ private:
     QUuid mCurrentDeviceId;
     QUuid mCurrentSensorId;
     QString mCurrentMapId;
+    ConnectivityChecker mConnectivityChecker;
+    SlaveDiscovery mSlaveDiscovery;
+    RegisterProber mRegisterProber;
+    QUuid mProbedDeviceId;
 
 };
 
@@ -2,6 +2,9 @@
 #include "ui_modbusconfigeditormainwindow.h"
 
 #include <QDebug>
+#include <QFileDialog>
+#include <QInputDialog>
+#include <QMessageBox>
 
 ModbusConfigEditorMainWindow::ModbusConfigEditorMainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -10,6 +13,7 @@ ModbusConfigEditorMainWindow::ModbusConfigEditorMainWindow(QWidget *parent)
     , mSensorSettingsWidget(new SensorSettingsWidget(this))
     , mUpakSettingsWidget(new UpakSettingsWidget(this))
     , mSensorMapWidget(new SensorMapWidget(this))
+    , mStalenessReportWidget(new StalenessReportWidget(this))
     , mTextEdit(new QTextEdit(this))
     , mFakeWidget(new QWidget(this))
 {
@@ -20,6 +24,7 @@ ModbusConfigEditorMainWindow::ModbusConfigEditorMainWindow(QWidget *parent)
     ui->stackedWidget->addWidget(mSensorSettingsWidget);
     ui->stackedWidget->addWidget(mModbusDeviceSettingsWidget);
     ui->stackedWidget->addWidget(mTextEdit);
+    ui->stackedWidget->addWidget(mStalenessReportWidget);
     ui->stackedWidget->setCurrentWidget(mFakeWidget);
 
     ui->treeView->setModel(&mSettingsModel);
@@ -59,6 +64,11 @@ void ModbusConfigEditorMainWindow::setError(const QString &error)
     ui->statusbar->showMessage(error);
 }
 
+void ModbusConfigEditorMainWindow::showMessage(const QString &message)
+{
+    ui->statusbar->showMessage(message);
+}
+
 void ModbusConfigEditorMainWindow::setCommonSetting(const ModbusConfig::Settings &settings)
 {
     mUpakSettingsWidget->setSettings(settings);
@@ -83,6 +93,24 @@ void ModbusConfigEditorMainWindow::setSensorSettings(
     mSensorSettingsWidget->setSettings(mSettingsModel.sensorMapsForDevice(devId), settings);
 }
 
+void ModbusConfigEditorMainWindow::setStalenessReport(
+    const ModbusConfig::StalenessReport &report)
+{
+    mStalenessReportWidget->setReport(report);
+    ui->stackedWidget->setCurrentWidget(mStalenessReportWidget);
+}
+
+void ModbusConfigEditorMainWindow::setReportText(const QString &text)
+{
+    mTextEdit->setPlainText(text);
+    ui->stackedWidget->setCurrentWidget(mTextEdit);
+}
+
+bool ModbusConfigEditorMainWindow::askConfirmation(const QString &title, const QString &question)
+{
+    return QMessageBox::question(this, title, question) == QMessageBox::Yes;
+}
+
 void ModbusConfigEditorMainWindow::updateDeviceInModel(
     const QUuid &prevId, const ModbusConfig::DeviceSettings &settings)
 {
@@ -150,6 +178,38 @@ void ModbusConfigEditorMainWindow::requestAddSensor(const QUuid &devId)
     emit addSensorRequest(devId);
 }
 
+void ModbusConfigEditorMainWindow::requestPartition()
+{
+    bool ok;
+    int nodeCount = QInputDialog::getInt(this, tr("Разделение конфигурации"),
+        tr("Количество узлов опроса"), 2, 1, 1000, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    QString dirPath = QFileDialog::getExistingDirectory(
+        this, tr("Каталог для конфигураций узлов"));
+    if (dirPath.isEmpty()) {
+        return;
+    }
+    emit partitionRequest(nodeCount, dirPath);
+}
+
+void ModbusConfigEditorMainWindow::requestThresholdTuning()
+{
+    QString tracePath = QFileDialog::getOpenFileName(this, tr("Запись опроса"), QString(),
+        tr("Записи опроса (*.trc);;Все файлы (*)"));
+    if (tracePath.isEmpty()) {
+        return;
+    }
+    bool ok;
+    double targetRate = QInputDialog::getDouble(this, tr("Подбор порогов обновления"),
+        tr("Целевой поток на сервер, сообщений в секунду"), 100, 0.01, 1e6, 2, &ok);
+    if (!ok) {
+        return;
+    }
+    emit thresholdTuningRequest(tracePath, targetRate);
+}
+
 void ModbusConfigEditorMainWindow::addAndExpandItem(QStandardItem *item)
 {
     if (item && item->parent() && item->parent()->rowCount() == 0x01) {
@@ -242,6 +302,22 @@ QMenu *ModbusConfigEditorMainWindow::modbusRootMenuContextMenu(QStandardItem *it
     auto action = menu->addAction(tr("Добавить новое modbus устройствo"));
     connect(action, &QAction::triggered,
         this, &ModbusConfigEditorMainWindow::addModbusDeviceRequest);
+    menu->addSeparator();
+    action = menu->addAction(tr("Оптимизировать параметры опроса"));
+    connect(action, &QAction::triggered,
+        this, &ModbusConfigEditorMainWindow::optimizePollPlanRequest);
+    action = menu->addAction(tr("Анализ актуальности данных"));
+    connect(action, &QAction::triggered,
+        this, &ModbusConfigEditorMainWindow::stalenessAnalysisRequest);
+    action = menu->addAction(tr("Разделить конфигурацию по узлам..."));
+    connect(action, &QAction::triggered,
+        this, &ModbusConfigEditorMainWindow::requestPartition);
+    action = menu->addAction(tr("Проверить подключения"));
+    connect(action, &QAction::triggered,
+        this, &ModbusConfigEditorMainWindow::connectivityCheckRequest);
+    action = menu->addAction(tr("Подобрать пороги обновления по записи опроса..."));
+    connect(action, &QAction::triggered,
+        this, &ModbusConfigEditorMainWindow::requestThresholdTuning);
     return menu;
 }
 
@@ -251,8 +327,18 @@ QMenu *ModbusConfigEditorMainWindow::modbusDeviceMenuContextMenu(QStandardItem *
     QUuid devId = mSettingsModel.getDeviceId(item);
     addAddSensorsMapMenuAction(menu, devId, item->text());
     addAddSensorMenuAction(menu, devId, item->text());
+    auto action = menu->addAction(tr("Найти слейвы на линии устройства"));
+    connect(action, &QAction::triggered,
+        this, [this, devId]() {
+            emit slaveDiscoveryRequest(devId);
+        });
+    action = menu->addAction(tr("Найти читаемые регистры устройства"));
+    connect(action, &QAction::triggered,
+        this, [this, devId]() {
+            emit registerProbeRequest(devId);
+        });
     menu->addSeparator();
-    auto action = menu->addAction(tr("Удалить устройствo '%0'").arg(item->text()));
+    action = menu->addAction(tr("Удалить устройствo '%0'").arg(item->text()));
     connect(action, &QAction::triggered,
         this, [this, devId]() {
             requestDeleteDevice(devId);
@@ -6,6 +6,7 @@
 #include "widgets/sensorsettingswidget.h"
 #include "widgets/upaksettingswidget.h"
 #include "widgets/sensormapwidget.h"
+#include "widgets/stalenessreportwidget.h"
 
 #include "settingsmodel.h"
 
@@ -25,10 +26,14 @@ public:
 
     void setJson(const QString &text);
     void setError(const QString &error);
+    void showMessage(const QString &message);
     void setCommonSetting(const ModbusConfig::Settings &settings);
     void setDeviceSettings(const QUuid &prevId, const ModbusConfig::DeviceSettings &settings);
     void setSensorMapSettings(const ModbusConfig::SensorsMap &settings);
     void setSensorSettings(const QUuid &devId, const ModbusConfig::Sensor &settings);
+    void setStalenessReport(const ModbusConfig::StalenessReport &report);
+    void setReportText(const QString &text);
+    bool askConfirmation(const QString &title, const QString &question);
     void updateDeviceInModel(const QUuid &prevId, const ModbusConfig::DeviceSettings &settings);
     void updateSensorMapInModel(const QUuid &devId, const QString &prevId,
         const ModbusConfig::SensorsMap &settings);
@@ -56,6 +61,8 @@ private:
     void requestDeleteDevice(const QUuid &id);
     void requestAddRegisterMap(const QUuid &devId);
     void requestAddSensor(const QUuid &devId);
+    void requestPartition();
+    void requestThresholdTuning();
 
     void addAndExpandItem(QStandardItem *item);
 
@@ -97,6 +104,13 @@ signals:
     void sensorSettingsChanged(const ModbusConfig::Sensor &settings);
 
     void showJsonRequest();
+    void optimizePollPlanRequest();
+    void stalenessAnalysisRequest();
+    void partitionRequest(int nodeCount, const QString &dirPath);
+    void connectivityCheckRequest();
+    void slaveDiscoveryRequest(const QUuid &deviceId);
+    void registerProbeRequest(const QUuid &deviceId);
+    void thresholdTuningRequest(const QString &tracePath, double targetRate);
 
 private:
     Ui::ModbusConfigEditorMainWindow *ui;
@@ -109,6 +123,7 @@ private:
     SensorSettingsWidget *mSensorSettingsWidget;
     UpakSettingsWidget *mUpakSettingsWidget;
     SensorMapWidget *mSensorMapWidget;
+    StalenessReportWidget *mStalenessReportWidget;
     QTextEdit *mTextEdit;
     QWidget *mFakeWidget;
 
@@ -3,6 +3,8 @@
 #include "utils.h"
 
 #include <QList>
+#include <QMap>
+#include <QSet>
 #include <QUrl>
 
 namespace ModbusConfig {
@@ -39,6 +41,11 @@ QString ModbusConfigModel::upsertDevice(
             dev.settings.id = devId;
             dev.settings.connectionParams = connectionParams;
             mDevices[devId] = dev;
+            for (auto sensorIt = dev.sensors.cbegin(); sensorIt != dev.sensors.cend(); ++sensorIt) {
+                mSensorDevices[sensorIt.key()] = devId;
+            }
+            mPollPlan.removeDevice(prevDevId);
+            mPollPlan.addDevice(dev);
         }
     } else {
         Device dev;
@@ -46,10 +53,57 @@ QString ModbusConfigModel::upsertDevice(
         dev.settings.connectionParams = connectionParams;
         dev.settings.id = devId;
         mDevices[devId] = dev;
+        mPollPlan.addDevice(dev);
     }
     return {};
 }
 
+QString ModbusConfigModel::setDevicePollSettings(
+    const QUuid &devId, const PollSettings &settings)
+{
+    auto it = mDevices.find(devId);
+    if (it == mDevices.end()) {
+        return QObject::tr("Ошибка обновления параметров опроса: "
+                           "устройство с идентификатором %0 не найдено")
+            .arg(toString(devId));
+    }
+    if (settings.maxRegisterGap < -1) {
+        return QObject::tr("Допустимый разрыв между регистрами не может быть отрицательным");
+    }
+    if (settings.maxRequestSize == 0 || settings.maxRequestSize < -1
+        || settings.maxRequestSize > 125) {
+        return QObject::tr("Максимальный размер запроса должен быть в диапазоне от 1 до 125");
+    }
+    it.value().settings.pollSettings = settings;
+    mPollPlan.setDevicePollSettings(devId, settings);
+    return {};
+}
+
+QString ModbusConfigModel::insertDevice(const Device &device)
+{
+    const QUuid &devId = device.settings.id;
+    if (devId.isNull()) {
+        return QObject::tr("Идентификатор устройства должен быть валидный UUID");
+    }
+    if (mDevices.contains(devId)) {
+        return QObject::tr(
+            "Устройство с идентификатором %0 уже присутствует").arg(toString(devId));
+    }
+    for (auto it = device.sensors.cbegin(); it != device.sensors.cend(); ++it) {
+        if (mSensorDevices.contains(it.key())) {
+            return QObject::tr(
+                "Датчик с идентификатором %0 уже присутствует").arg(toString(it.key()));
+        }
+    }
+    mDevices[devId] = device;
+    for (auto it = device.sensors.cbegin(); it != device.sensors.cend(); ++it) {
+        mSensorDevices[it.key()] = devId;
+        updateSensorRuntime(it.value());
+    }
+    mPollPlan.addDevice(device);
+    return {};
+}
+
 QString ModbusConfigModel::setCommonSettings(const Settings &settings)
 {
     QUrl url = QUrl::fromUserInput(settings.upakServeUrl);
@@ -67,6 +121,12 @@ void ModbusConfigModel::clear()
     mSettings.upakServeUrl = "http://localhost:8888";
     mSettings.writeRequestTtl = 180;
     mDevices.clear();
+    mSensorDevices.clear();
+    mSensorDecoders.clear();
+    mSensorCorrections.clear();
+    mSensorReferences.clear();
+    mExpressions.clearCache();
+    mPollPlan.clear();
 }
 
 QString ModbusConfigModel::upsertSensor(
@@ -89,26 +149,58 @@ QString ModbusConfigModel::upsertSensor(
         return errorString;
     }
 
+    errorString = checkSensorBit(dev, sensor, sensorId);
+    if (!errorString.isEmpty()) {
+        return errorString;
+    }
+
+    // выражение с ошибкой не мешает сохранить датчик: редактор показывает ошибку сразу,
+    // а конфигурации, сохранённые до появления компилятора, должны загружаться
+    const auto correction = mExpressions.compile(sensor.correctFunction, nullptr);
+    errorString = checkSensorReferences(
+        sensor, correction ? correction->references() : QVector<QUuid>());
+    if (!errorString.isEmpty()) {
+        return errorString;
+    }
+
     if (sensorId.isNull() || sensorId != sensor.id) {
-        for (const auto &dev :qAsConst(mDevices)) {
-            if (dev.sensors.count(sensor.id) != 0) {
-                return QObject::tr(
-                    "Датчик с идентификатором %0 уже присутствует").arg(toString(sensor.id));
-            }
+        if (mSensorDevices.contains(sensor.id)) {
+            return QObject::tr(
+                "Датчик с идентификатором %0 уже присутствует").arg(toString(sensor.id));
         }
     }
 
+    bool renamed = false;
     auto sensorIt = dev.sensors.find(sensorId);
     if (sensorIt == dev.sensors.end()) {
         dev.sensors[sensor.id] = sensor;
         // insert
     } else {
+        mPollPlan.removeSensor(devId, sensorIt.value());
         if (sensorId == sensor.id) {
             sensorIt.value() = sensor;
         } else {
             // update
             dev.sensors.erase(sensorIt);
             dev.sensors[sensor.id] = sensor;
+            mSensorDevices.remove(sensorId);
+            removeSensorRuntime(sensorId);
+            renamed = true;
+        }
+    }
+    mSensorDevices[sensor.id] = devId;
+    updateSensorRuntime(sensor);
+    mPollPlan.addSensor(devId, sensor);
+
+    if (renamed) {
+        // как и при переименовании карты регистров, ссылки других датчиков переводятся
+        // на новый идентификатор
+        const auto dependents = dependentSensors(sensorId);
+        for (const auto &dependentId : dependents) {
+            Sensor &dependent = mDevices[mSensorDevices.value(dependentId)].sensors[dependentId];
+            dependent.correctFunction =
+                replaceReference(dependent.correctFunction, sensorId, sensor.id);
+            updateSensorRuntime(dependent);
         }
     }
     return {};
@@ -141,9 +233,13 @@ QString ModbusConfigModel::upsertSensorMap(
         // при переименовании идентификаторов карты регистров так же переименовывать эти
         // идентфиикаторы в привязанных датчиках
         for (auto it = dev.sensors.begin(); it != dev.sensors.end(); ++it) {
-            if (it.value().type == Sensor::Type::Map && it.value().mapId == mapId) {
+            if (it.value().type != Sensor::Type::Separate && it.value().mapId == mapId) {
                 toRename.append(it);
-                if (it.value().mapOffset >= map.valueCount) {
+                int lastOffset = it.value().mapOffset;
+                if (it.value().type == Sensor::Type::Aggregate) {
+                    lastOffset += it.value().aggregateCount - 1;
+                }
+                if (lastOffset >= map.valueCount) {
                     return QObject::tr(
                         "Нельзя обновить карту регистров, так как количество занчений в ней меньше "
                         "используемого смещения привязанного датчика '%0'")
@@ -153,20 +249,29 @@ QString ModbusConfigModel::upsertSensorMap(
         }
     }
 
-    for (auto it : toRename) {
-        it.value().mapId = map.id;
-    }
-
+    // все проверки - до изменения датчиков, чтобы отказ не оставил их без карты
     QString error = checkRegisterAddress(map.registеrAddress);
     if (!error.isEmpty()) {
         return error;
     }
+    if (map.registеrAddress.bitOffset >= 0) {
+        return QObject::tr("Номер бита в регистре не может быть задан для карты регистров");
+    }
+
+    for (auto it : toRename) {
+        it.value().mapId = map.id;
+    }
 
     // TODO: проверить, что значение по умолчанию не выходит за диапазно типа значений карты регистров
+    auto prevMapIt = dev.maps.find(mapId);
+    if (prevMapIt != dev.maps.end()) {
+        mPollPlan.removeMap(devId, prevMapIt.value());
+    }
     if (mapId != map.id) {
         dev.maps.remove(mapId);
     }
     dev.maps[map.id] = map;
+    mPollPlan.addMap(devId, map);
 
     return {};
 }
@@ -184,7 +289,16 @@ QString ModbusConfigModel::deleteSensor(const QUuid &devId, const QUuid &sensorI
         return QObject::tr("Ошибка удаления датчика: "
                            "датчик с идентификатором %0 не найдено").arg(toString(sensorId));
     }
+    const auto dependents = dependentSensors(sensorId);
+    if (!dependents.isEmpty()) {
+        return QObject::tr("Ошибка удаления датчика: на него ссылается "
+                           "корректирующая функция датчика '%0'")
+            .arg(sensorDescription(dependents.first()));
+    }
+    mPollPlan.removeSensor(devId, sensorIt.value());
     dev.sensors.erase(sensorIt);
+    mSensorDevices.remove(sensorId);
+    removeSensorRuntime(sensorId);
     return {};
 }
 
@@ -204,12 +318,13 @@ QString ModbusConfigModel::deleteSensorMap(const QUuid &devId, const QString &ma
     }
 
     for (const auto &sensor : qAsConst(dev.sensors)) {
-        if (sensor.type == Sensor::Type::Map && sensor.mapId == mapId) {
+        if (sensor.type != Sensor::Type::Separate && sensor.mapId == mapId) {
             return QObject::tr("Ошибка удаления карты регистров: "
                                "карта регистров привязана к датчику '%0'").arg(sensor.description);
         }
     }
 
+    mPollPlan.removeMap(devId, mapIt.value());
     dev.maps.erase(mapIt);
     return {};
 }
@@ -221,7 +336,26 @@ QString ModbusConfigModel::deleteDevice(const QUuid &devId)
         return QObject::tr("Ошибка удаления устройства: "
                            "устройство с идентификатором %0 не найдено").arg(toString(devId));
     }
+    const auto &sensors = it.value().sensors;
+    for (auto refIt = mSensorReferences.cbegin(); refIt != mSensorReferences.cend(); ++refIt) {
+        if (sensors.contains(refIt.key())) {
+            continue;
+        }
+        for (const auto &reference : refIt.value()) {
+            if (sensors.contains(reference)) {
+                return QObject::tr("Ошибка удаления устройства: на датчик '%0' ссылается "
+                                   "корректирующая функция датчика '%1' другого устройства")
+                    .arg(sensors.value(reference).description, sensorDescription(refIt.key()));
+            }
+        }
+    }
+    for (auto sensorIt = it.value().sensors.cbegin(); sensorIt != it.value().sensors.cend();
+         ++sensorIt) {
+        mSensorDevices.remove(sensorIt.key());
+        removeSensorRuntime(sensorIt.key());
+    }
     mDevices.erase(it);
+    mPollPlan.removeDevice(devId);
     return {};
 }
 
@@ -239,6 +373,31 @@ QString ModbusConfigModel::checkSingleSensor(const Device &dev, const Sensor &se
     return {};
 }
 
+QString ModbusConfigModel::checkSensorBit(
+    const Device &dev, const Sensor &sensor, const QUuid &replacedId) const
+{
+    const auto &address = sensor.registerAddress;
+    if (sensor.type != Sensor::Type::Separate || address.bitOffset < 0) {
+        return {};
+    }
+    // разные биты одного регистра не конфликтуют, один и тот же бит занимать нельзя
+    for (const auto &other : dev.sensors) {
+        const auto &otherAddress = other.registerAddress;
+        if (other.id != sensor.id && other.id != replacedId
+            && other.type == Sensor::Type::Separate
+            && otherAddress.bitOffset == address.bitOffset
+            && otherAddress.regAddress == address.regAddress
+            && otherAddress.regType == address.regType
+            && otherAddress.slaveAddress == address.slaveAddress) {
+            return QObject::tr("Бит %0 регистра %1 уже занят датчиком '%2'")
+                .arg(address.bitOffset)
+                .arg(address.regAddress)
+                .arg(other.description);
+        }
+    }
+    return {};
+}
+
 QString ModbusConfigModel::checkMapSensor(const Device &dev, const Sensor &sensor)
 {
     if (sensor.id.isNull()) {
@@ -265,6 +424,51 @@ QString ModbusConfigModel::checkMapSensor(const Device &dev, const Sensor &senso
     return {};
 }
 
+QString ModbusConfigModel::checkAggregateSensor(const Device &dev, const Sensor &sensor)
+{
+    QString error = checkMapSensor(dev, sensor);
+    if (!error.isEmpty()) {
+        return error;
+    }
+    if (sensor.mode != Sensor::Mode::Read) {
+        return QObject::tr("Агрегированный датчик может работать только в режиме чтения");
+    }
+    if (sensor.aggregateCount < 1) {
+        return QObject::tr("Количество агрегируемых значений должно быть больше нуля");
+    }
+    const int valueCount = dev.maps.value(sensor.mapId).valueCount;
+    if (sensor.aggregateCount > valueCount - sensor.mapOffset) {
+        return QObject::tr(
+            "Агрегируемый диапазон выходит за пределы карты регистров (%0 значений)")
+            .arg(valueCount);
+    }
+    return {};
+}
+
+QString ModbusConfigModel::checkVirtualSensor(const Sensor &sensor)
+{
+    if (sensor.mode != Sensor::Mode::Read) {
+        return QObject::tr("Вычисляемый датчик может работать только в режиме чтения");
+    }
+    // у вычисляемого датчика значение даёт только выражение, поэтому оно обязано компилироваться
+    QString error;
+    const auto program = mExpressions.compile(sensor.correctFunction, &error);
+    if (!program) {
+        return QObject::tr("Ошибка в корректирующей функции вычисляемого датчика: %0")
+            .arg(error);
+    }
+    if (program->references().isEmpty()) {
+        return QObject::tr("Вычисляемый датчик должен ссылаться хотя бы на один датчик");
+    }
+    for (const auto &instruction : program->code()) {
+        if (instruction.op == ExpressionProgram::OpCode::PushValue) {
+            return QObject::tr(
+                "У вычисляемого датчика нет собственного значения, val использовать нельзя");
+        }
+    }
+    return {};
+}
+
 QString ModbusConfigModel::checkSensor(const Device &dev, const Sensor &sensor)
 {
     switch (sensor.type) {
@@ -272,10 +476,95 @@ QString ModbusConfigModel::checkSensor(const Device &dev, const Sensor &sensor)
         return checkMapSensor(dev, sensor);
     case Sensor::Type::Separate:
         return checkSingleSensor(dev, sensor);
+    case Sensor::Type::Aggregate:
+        return checkAggregateSensor(dev, sensor);
+    case Sensor::Type::Virtual:
+        return checkVirtualSensor(sensor);
     }
     return QObject::tr("Внутрення ошибка - непредвиденный тип датчика");
 }
 
+QString ModbusConfigModel::checkSensorReferences(
+    const Sensor &sensor, const QVector<QUuid> &references) const
+{
+    // датчик не должен быть достижим из своих ссылок, иначе граф зависимостей получит цикл;
+    // наличие датчиков здесь не проверяется - при загрузке порядок датчиков произвольный,
+    // его проверяет checkReferencedSensors; при правке висячие ссылки не возникают: датчик,
+    // на который ссылаются, удалить нельзя, а смена его идентификатора переписывает ссылки
+    QSet<QUuid> visited;
+    QVector<QUuid> stack = references;
+    while (!stack.isEmpty()) {
+        QUuid current = stack.takeLast();
+        if (current == sensor.id) {
+            return QObject::tr("Корректирующая функция датчика '%0' образует циклическую "
+                               "зависимость между датчиками").arg(sensor.description);
+        }
+        if (visited.contains(current)) {
+            continue;
+        }
+        visited.insert(current);
+        stack.append(mSensorReferences.value(current));
+    }
+    return {};
+}
+
+QString ModbusConfigModel::checkReferencedSensors() const
+{
+    for (auto it = mSensorReferences.cbegin(); it != mSensorReferences.cend(); ++it) {
+        for (const auto &reference : it.value()) {
+            if (!mSensorDevices.contains(reference)) {
+                return QObject::tr("Корректирующая функция датчика '%0' ссылается "
+                                   "на отсутствующий датчик %1")
+                    .arg(sensorDescription(it.key()), toString(reference));
+            }
+        }
+    }
+    return {};
+}
+
+QVector<QUuid> ModbusConfigModel::dependentSensors(const QUuid &sensorId) const
+{
+    QVector<QUuid> result;
+    for (auto it = mSensorReferences.cbegin(); it != mSensorReferences.cend(); ++it) {
+        if (it.value().contains(sensorId)) {
+            result.append(it.key());
+        }
+    }
+    return result;
+}
+
+QString ModbusConfigModel::sensorDescription(const QUuid &sensorId) const
+{
+    return device(mSensorDevices.value(sensorId)).sensors.value(sensorId).description;
+}
+
+void ModbusConfigModel::updateSensorRuntime(const Sensor &sensor)
+{
+    if (sensor.type == Sensor::Type::Separate) {
+        mSensorDecoders[sensor.id] = ScalarDecoder(sensor.registerAddress);
+    } else {
+        mSensorDecoders.remove(sensor.id);
+    }
+    auto correction = mExpressions.compile(sensor.correctFunction, nullptr);
+    if (correction) {
+        mSensorCorrections[sensor.id] = correction;
+    } else {
+        mSensorCorrections.remove(sensor.id);
+    }
+    if (correction && !correction->references().isEmpty()) {
+        mSensorReferences[sensor.id] = correction->references();
+    } else {
+        mSensorReferences.remove(sensor.id);
+    }
+}
+
+void ModbusConfigModel::removeSensorRuntime(const QUuid &sensorId)
+{
+    mSensorDecoders.remove(sensorId);
+    mSensorCorrections.remove(sensorId);
+    mSensorReferences.remove(sensorId);
+}
+
 const Settings &ModbusConfigModel::commonSettings() const
 {
     return mSettings;
@@ -296,4 +585,37 @@ const Device &ModbusConfigModel::device(const QUuid &devId) const
     return it.value();
 }
 
+const PollPlan &ModbusConfigModel::pollPlan() const
+{
+    mPollPlan.update();
+    return mPollPlan;
+}
+
+void ModbusConfigModel::setPrecomputedPollPlan(
+    const QUuid &devId, const QVector<PollRequest> &requests)
+{
+    QMap<QPair<int, int>, QVector<PollRequest>> groups;
+    for (const auto &request : requests) {
+        groups[qMakePair(int(request.slaveAddress), toInt(request.regType))].append(request);
+    }
+    for (auto it = groups.cbegin(); it != groups.cend(); ++it) {
+        PollGroupKey key;
+        key.devId = devId;
+        key.slaveAddress = static_cast<quint8>(it.key().first);
+        key.regType = static_cast<RegisterAddress::RegisterType>(it.key().second);
+        mPollPlan.setGroupRequests(key, it.value());
+    }
+}
+
+ScalarDecoder ModbusConfigModel::sensorDecoder(const QUuid &sensorId) const
+{
+    return mSensorDecoders.value(sensorId);
+}
+
+QSharedPointer<const ExpressionProgram> ModbusConfigModel::sensorCorrection(
+    const QUuid &sensorId) const
+{
+    return mSensorCorrections.value(sensorId);
+}
+
 }
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "expressioncompiler.h"
 #include "modbusentities.h"
+#include "pollplan.h"
+#include "scalardecoder.h"
 
 namespace ModbusConfig {
 
@@ -15,6 +18,8 @@ public:
     QString upsertDevice(
         const QUuid &devId, const QUuid &prevDevId, const ConnectionParams &connectionParams,
         const QString &name);
+    QString setDevicePollSettings(const QUuid &devId, const PollSettings &settings);
+    QString insertDevice(const Device &device);
 
     QString upsertSensor(const QUuid &devId, const QUuid &sensorId, const Sensor &sensor);
     QString upsertSensorMap(const QUuid &devId, const QString mapId, const SensorsMap &map);
@@ -28,15 +33,45 @@ public:
 
     const Device &device(const QUuid &devId) const;
 
+    // план опроса пересчитывается лениво и только для изменённых групп
+    const PollPlan &pollPlan() const;
+    void setPrecomputedPollPlan(const QUuid &devId, const QVector<PollRequest> &requests);
+
+    // декодер отдельного датчика выбирается один раз при добавлении / изменении датчика
+    ScalarDecoder sensorDecoder(const QUuid &sensorId) const;
+    // скомпилированная корректирующая функция, одинаковые тексты разделяют одну программу;
+    // нулевая, если выражение не компилируется - значение идёт без коррекции
+    QSharedPointer<const ExpressionProgram> sensorCorrection(const QUuid &sensorId) const;
+    // все ссылки корректирующих функций указывают на датчики модели; при загрузке датчики
+    // приходят в произвольном порядке, поэтому проверка выполняется после загрузки всех
+    QString checkReferencedSensors() const;
+
 private:
     QString checkSingleSensor(const Device &dev, const Sensor &sensor);
     QString checkMapSensor(const Device &dev, const Sensor &sensor);
+    QString checkAggregateSensor(const Device &dev, const Sensor &sensor);
+    QString checkVirtualSensor(const Sensor &sensor);
     QString checkSensor(const Device &dev, const Sensor &sensor);
+    QString checkSensorBit(const Device &dev, const Sensor &sensor, const QUuid &replacedId) const;
+    QString checkSensorReferences(const Sensor &sensor, const QVector<QUuid> &references) const;
+    // датчики, корректирующие функции которых ссылаются на sensorId
+    QVector<QUuid> dependentSensors(const QUuid &sensorId) const;
+    QString sensorDescription(const QUuid &sensorId) const;
+    void updateSensorRuntime(const Sensor &sensor);
+    void removeSensorRuntime(const QUuid &sensorId);
 
 
 private:
     Settings mSettings;
     QHash<QUuid, Device> mDevices;
+    // идентификатор датчика -> идентификатор устройства
+    QHash<QUuid, QUuid> mSensorDevices;
+    QHash<QUuid, ScalarDecoder> mSensorDecoders;
+    QHash<QUuid, QSharedPointer<const ExpressionProgram>> mSensorCorrections;
+    // датчик -> датчики, на которые ссылается его корректирующая функция
+    QHash<QUuid, QVector<QUuid>> mSensorReferences;
+    ExpressionCompiler mExpressions;
+    mutable PollPlan mPollPlan;
 };
 
 }
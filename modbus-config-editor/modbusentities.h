@@ -43,6 +43,8 @@ struct RegisterAddress {
     QString typeOrder;
     ValType valType;
     RegisterType regType;
+    // номер бита в регистре (0 - младший) для битовых полей, -1 - значение занимает регистр
+    int bitOffset{-1};
 };
 
 struct SensorsMap {
@@ -106,7 +108,18 @@ struct Sensor {
 
     enum class Type {
         Separate,
-        Map
+        Map,
+        // свёртка диапазона значений карты регистров в одно значение
+        Aggregate,
+        // вычисляемый по другим датчикам, регистров не занимает
+        Virtual
+    };
+
+    enum class Aggregation {
+        Sum,
+        Min,
+        Max,
+        Average
     };
 
     QUuid id;
@@ -121,12 +134,23 @@ struct Sensor {
 
     QString mapId;
     int mapOffset{};
+
+    // для агрегатов: значения карты [mapOffset, mapOffset + aggregateCount)
+    int aggregateCount{};
+    Aggregation aggregation{Aggregation::Sum};
+};
+
+struct PollSettings {
+    // -1 - использовать значение по умолчанию
+    int maxRegisterGap{-1};
+    int maxRequestSize{-1};
 };
 
 struct DeviceSettings {
     QUuid id;
     QString description;
     ConnectionParams connectionParams;
+    PollSettings pollSettings;
 };
 
 struct Device {
@@ -0,0 +1,263 @@
+#include "modbusframe.h"
+
+#include "crc16.h"
+#include "pollplanner.h"
+
+namespace {
+using ModbusConfig::FunctionCode;
+
+constexpr int maxReadBits = 2000;
+constexpr int maxReadRegisters = 125;
+constexpr int maxWriteBits = 1968;
+constexpr int maxWriteRegisters = 123;
+
+inline int word(const quint8 *data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+inline void putWord(quint8 *data, int value)
+{
+    data[0] = quint8(value >> 8);
+    data[1] = quint8(value);
+}
+
+// адрес конфигурации, соответствующий смещению PDU 0
+int firstAddress(ModbusConfig::RegisterAddress::RegisterType type)
+{
+    using RegisterType = ModbusConfig::RegisterAddress::RegisterType;
+    switch (type) {
+    case RegisterType::DiscreteOutputCoils:
+        return 1;
+    case RegisterType::DiscreteInputContacts:
+        return 10001;
+    case RegisterType::AnalogInputRegisters:
+        return 30001;
+    case RegisterType::AnalogOutputHoldingRegisters:
+        return 40001;
+    default:
+        break;
+    }
+    return 0;
+}
+
+// длина больше допустимой - мусор на линии, его отбросит пауза
+int checkedLength(int length)
+{
+    return length <= ModbusConfig::maxRtuFrameSize ? length : 0;
+}
+
+bool isBitFunction(FunctionCode function)
+{
+    return function == FunctionCode::ReadCoils || function == FunctionCode::ReadDiscreteInputs;
+}
+}
+
+namespace ModbusConfig {
+
+int pduAddress(RegisterAddress::RegisterType type, int address)
+{
+    const int base = firstAddress(type);
+    return base > 0 ? address - base : -1;
+}
+
+int configAddress(RegisterAddress::RegisterType type, int offset)
+{
+    const int base = firstAddress(type);
+    return base > 0 ? offset + base : -1;
+}
+
+FunctionCode readFunction(RegisterAddress::RegisterType type)
+{
+    switch (type) {
+    case RegisterAddress::RegisterType::DiscreteOutputCoils:
+        return FunctionCode::ReadCoils;
+    case RegisterAddress::RegisterType::DiscreteInputContacts:
+        return FunctionCode::ReadDiscreteInputs;
+    case RegisterAddress::RegisterType::AnalogInputRegisters:
+        return FunctionCode::ReadInputRegisters;
+    default:
+        break;
+    }
+    return FunctionCode::ReadHoldingRegisters;
+}
+
+int parseTcpFrame(const quint8 *data, int size, ModbusFrame *frame)
+{
+    if (size < mbapHeaderSize) {
+        return -1;
+    }
+    // длина считает адрес слейва и PDU, идентификатор протокола Modbus - 0
+    const int length = word(data + 4);
+    if (word(data + 2) != 0 || length < 2 || length > maxPduSize + 1) {
+        return 0;
+    }
+    if (size < 6 + length) {
+        return -1;
+    }
+    frame->transactionId = quint16(word(data));
+    frame->unit = data[6];
+    frame->pdu = data + tcpPduOffset;
+    frame->pduSize = length - 1;
+    return 6 + length;
+}
+
+int rtuRequestLength(const quint8 *data, int size)
+{
+    if (size < 2) {
+        return -1;
+    }
+    switch (FunctionCode(data[1])) {
+    case FunctionCode::ReadCoils:
+    case FunctionCode::ReadDiscreteInputs:
+    case FunctionCode::ReadHoldingRegisters:
+    case FunctionCode::ReadInputRegisters:
+    case FunctionCode::WriteSingleCoil:
+    case FunctionCode::WriteSingleRegister:
+        return 8;
+    case FunctionCode::WriteMultipleCoils:
+    case FunctionCode::WriteMultipleRegisters:
+        return size < 7 ? -1 : checkedLength(9 + data[6]);
+    case FunctionCode::ReadWriteMultipleRegisters:
+        return size < 11 ? -1 : checkedLength(13 + data[10]);
+    }
+    return 0;
+}
+
+int rtuResponseLength(const quint8 *data, int size)
+{
+    if (size < 2) {
+        return -1;
+    }
+    if (data[1] & 0x80) {
+        return 5;
+    }
+    switch (FunctionCode(data[1])) {
+    case FunctionCode::ReadCoils:
+    case FunctionCode::ReadDiscreteInputs:
+    case FunctionCode::ReadHoldingRegisters:
+    case FunctionCode::ReadInputRegisters:
+    case FunctionCode::ReadWriteMultipleRegisters:
+        return size < 3 ? -1 : checkedLength(5 + data[2]);
+    case FunctionCode::WriteSingleCoil:
+    case FunctionCode::WriteSingleRegister:
+    case FunctionCode::WriteMultipleCoils:
+    case FunctionCode::WriteMultipleRegisters:
+        return 8;
+    }
+    return 0;
+}
+
+bool parseRtuFrame(const quint8 *data, int size, ModbusFrame *frame)
+{
+    if (size < rtuOverhead + 1 || size > maxRtuFrameSize
+        || crc16(data, size - 2) != (data[size - 2] | (data[size - 1] << 8))) {
+        return false;
+    }
+    frame->transactionId = 0;
+    frame->unit = data[0];
+    frame->pdu = data + rtuPduOffset;
+    frame->pduSize = size - rtuOverhead;
+    return true;
+}
+
+int finishTcpFrame(quint8 *frame, quint16 transactionId, quint8 unit, int pduSize)
+{
+    putWord(frame, transactionId);
+    putWord(frame + 2, 0);
+    putWord(frame + 4, pduSize + 1);
+    frame[6] = unit;
+    return mbapHeaderSize + pduSize;
+}
+
+int finishRtuFrame(quint8 *frame, quint8 unit, int pduSize)
+{
+    frame[0] = unit;
+    const int size = rtuPduOffset + pduSize;
+    const quint16 crc = crc16(frame, size);
+    // CRC передаётся младшим байтом вперёд
+    frame[size] = quint8(crc);
+    frame[size + 1] = quint8(crc >> 8);
+    return size + 2;
+}
+
+int encodeReadRequest(quint8 *pdu, FunctionCode function, int offset, int count)
+{
+    pdu[0] = quint8(function);
+    putWord(pdu + 1, offset);
+    putWord(pdu + 3, count);
+    return 5;
+}
+
+int encodeReadRequest(quint8 *pdu, const PollRequest &request)
+{
+    return encodeReadRequest(pdu, readFunction(request.regType),
+        pduAddress(request.regType, request.startAddress), request.count);
+}
+
+int encodeWriteSingleCoil(quint8 *pdu, int offset, bool value)
+{
+    pdu[0] = quint8(FunctionCode::WriteSingleCoil);
+    putWord(pdu + 1, offset);
+    putWord(pdu + 3, value ? 0xFF00 : 0);
+    return 5;
+}
+
+int encodeWriteSingleRegister(quint8 *pdu, int offset, quint16 value)
+{
+    pdu[0] = quint8(FunctionCode::WriteSingleRegister);
+    putWord(pdu + 1, offset);
+    putWord(pdu + 3, value);
+    return 5;
+}
+
+int encodeWriteMultipleCoils(quint8 *pdu, int offset, const quint8 *bits, int count)
+{
+    count = qBound(0, count, maxWriteBits);
+    const int bytes = (count + 7) / 8;
+    pdu[0] = quint8(FunctionCode::WriteMultipleCoils);
+    putWord(pdu + 1, offset);
+    putWord(pdu + 3, count);
+    pdu[5] = quint8(bytes);
+    for (int i = 0; i < bytes; ++i) {
+        pdu[6 + i] = 0;
+    }
+    for (int i = 0; i < count; ++i) {
+        pdu[6 + i / 8] |= quint8((bits[i] & 1) << (i % 8));
+    }
+    return 6 + bytes;
+}
+
+int encodeWriteMultipleRegisters(quint8 *pdu, int offset, const quint16 *values, int count)
+{
+    count = qBound(0, count, maxWriteRegisters);
+    pdu[0] = quint8(FunctionCode::WriteMultipleRegisters);
+    putWord(pdu + 1, offset);
+    putWord(pdu + 3, count);
+    pdu[5] = quint8(count * 2);
+    for (int i = 0; i < count; ++i) {
+        putWord(pdu + 6 + i * 2, values[i]);
+    }
+    return 6 + count * 2;
+}
+
+int readResponseData(const quint8 *pdu, int size, FunctionCode function, int count,
+    const quint8 **data)
+{
+    if (size == 2 && pdu[0] == (quint8(function) | 0x80)) {
+        // кода исключения 0 не бывает, иначе такой ответ сошёл бы за успешный
+        return pdu[1] != 0 ? pdu[1] : -1;
+    }
+    const bool bits = isBitFunction(function);
+    if (count < 1 || count > (bits ? maxReadBits : maxReadRegisters)) {
+        return -1;
+    }
+    const int bytes = bits ? (count + 7) / 8 : count * 2;
+    if (size != 2 + bytes || pdu[0] != quint8(function) || pdu[1] != bytes) {
+        return -1;
+    }
+    *data = pdu + 2;
+    return 0;
+}
+
+}
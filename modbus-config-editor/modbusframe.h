@@ -0,0 +1,89 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QtGlobal>
+
+namespace ModbusConfig {
+
+struct PollRequest;
+
+enum class FunctionCode : quint8 {
+    ReadCoils = 0x01,
+    ReadDiscreteInputs = 0x02,
+    ReadHoldingRegisters = 0x03,
+    ReadInputRegisters = 0x04,
+    WriteSingleCoil = 0x05,
+    WriteSingleRegister = 0x06,
+    WriteMultipleCoils = 0x0F,
+    WriteMultipleRegisters = 0x10,
+    ReadWriteMultipleRegisters = 0x17
+};
+
+enum class ExceptionCode : quint8 {
+    IllegalFunction = 0x01,
+    IllegalDataAddress = 0x02,
+    IllegalDataValue = 0x03,
+    ServerDeviceFailure = 0x04,
+    GatewayPathUnavailable = 0x0A,
+    GatewayTargetFailed = 0x0B
+};
+
+// максимальный размер PDU по спецификации Modbus
+constexpr int maxPduSize = 253;
+// MBAP: транзакция, протокол, длина, адрес слейва
+constexpr int mbapHeaderSize = 7;
+// RTU: адрес слейва и CRC
+constexpr int rtuOverhead = 3;
+constexpr int maxTcpFrameSize = mbapHeaderSize + maxPduSize;
+constexpr int maxRtuFrameSize = rtuOverhead + maxPduSize;
+// смещение PDU в кадре
+constexpr int tcpPduOffset = mbapHeaderSize;
+constexpr int rtuPduOffset = 1;
+
+// адрес из конфигурации (например 40001) в смещение PDU (0) и обратно, -1 для Unknown
+int pduAddress(RegisterAddress::RegisterType type, int address);
+int configAddress(RegisterAddress::RegisterType type, int offset);
+FunctionCode readFunction(RegisterAddress::RegisterType type);
+
+// Кадр, разобранный на месте: pdu указывает в разбираемый буфер.
+struct ModbusFrame {
+    // только TCP
+    quint16 transactionId{};
+    quint8 unit{};
+    const quint8 *pdu{};
+    int pduSize{};
+};
+
+// Кадр Modbus TCP из начала data: длина кадра, -1 - данных пока мало,
+// 0 - заголовок некорректен и поток дальше не разобрать.
+int parseTcpFrame(const quint8 *data, int size, ModbusFrame *frame);
+// Длина кадра RTU по его началу: -1 - данных пока мало, 0 - функция неизвестна
+// (или длина больше maxRtuFrameSize) и конец кадра определяется только паузой на линии.
+int rtuRequestLength(const quint8 *data, int size);
+int rtuResponseLength(const quint8 *data, int size);
+// Кадр RTU целиком, false - короткий кадр или CRC не сходится.
+bool parseRtuFrame(const quint8 *data, int size, ModbusFrame *frame);
+
+// PDU пишется в буфер кадра с tcpPduOffset или rtuPduOffset, затем кадр
+// дополняется заголовком MBAP или адресом и CRC; возвращается длина кадра.
+int finishTcpFrame(quint8 *frame, quint16 transactionId, quint8 unit, int pduSize);
+int finishRtuFrame(quint8 *frame, quint8 unit, int pduSize);
+
+// Запросы в буфер PDU, offset - смещение PDU; возвращают длину PDU.
+int encodeReadRequest(quint8 *pdu, FunctionCode function, int offset, int count);
+// чтение по запросу плана опроса (адрес из конфигурации)
+int encodeReadRequest(quint8 *pdu, const PollRequest &request);
+int encodeWriteSingleCoil(quint8 *pdu, int offset, bool value);
+int encodeWriteSingleRegister(quint8 *pdu, int offset, quint16 value);
+// bits - байт на бит
+int encodeWriteMultipleCoils(quint8 *pdu, int offset, const quint8 *bits, int count);
+int encodeWriteMultipleRegisters(quint8 *pdu, int offset, const quint16 *values, int count);
+
+// Ответ на чтение count регистров или битов функцией function: 0 - данные по *data
+// (регистры big-endian или упакованные биты), код исключения слейва или -1,
+// если ответ не соответствует запросу.
+int readResponseData(const quint8 *pdu, int size, FunctionCode function, int count,
+    const quint8 **data);
+
+}
@@ -0,0 +1,233 @@
+#include "pollplan.h"
+
+#include "utils.h"
+
+#include <algorithm>
+
+namespace {
+// после стольких вставок в группу до её пересчёта дешевле отсортировать всё разом
+constexpr int maxSortedInserts = 16;
+}
+
+namespace ModbusConfig {
+
+bool operator==(const PollGroupKey &l, const PollGroupKey &r)
+{
+    return l.devId == r.devId && l.slaveAddress == r.slaveAddress && l.regType == r.regType;
+}
+
+bool operator<(const PollGroupKey &l, const PollGroupKey &r)
+{
+    if (l.devId != r.devId) {
+        return l.devId < r.devId;
+    }
+    if (l.slaveAddress != r.slaveAddress) {
+        return l.slaveAddress < r.slaveAddress;
+    }
+    return toInt(l.regType) < toInt(r.regType);
+}
+
+uint qHash(const PollGroupKey &key, uint seed)
+{
+    return qHash(key.devId, seed) ^ (uint(key.slaveAddress) << 8) ^ uint(toInt(key.regType));
+}
+
+void PollPlan::clear()
+{
+    mGroups.clear();
+    mDeviceGroups.clear();
+    mDeviceSettings.clear();
+    mDirtyGroups.clear();
+}
+
+void PollPlan::addDevice(const Device &device)
+{
+    const QUuid &devId = device.settings.id;
+    mDeviceSettings[devId] = device.settings.pollSettings;
+    for (const auto &sensor : device.sensors) {
+        addSensor(devId, sensor);
+    }
+    for (const auto &map : device.maps) {
+        addMap(devId, map);
+    }
+}
+
+void PollPlan::removeDevice(const QUuid &devId)
+{
+    const auto keys = mDeviceGroups.take(devId);
+    for (const auto &key : keys) {
+        mGroups.remove(key);
+        mDirtyGroups.remove(key);
+    }
+    mDeviceSettings.remove(devId);
+}
+
+void PollPlan::setDevicePollSettings(const QUuid &devId, const PollSettings &settings)
+{
+    mDeviceSettings[devId] = settings;
+    const auto keys = mDeviceGroups.value(devId);
+    for (const auto &key : keys) {
+        mDirtyGroups.insert(key);
+    }
+}
+
+void PollPlan::addSensor(const QUuid &devId, const Sensor &sensor)
+{
+    PollSpan span;
+    if (PollPlanner::sensorSpan(sensor, &span)) {
+        insertSpan(groupKey(devId, sensor.registerAddress), span);
+    }
+}
+
+void PollPlan::removeSensor(const QUuid &devId, const Sensor &sensor)
+{
+    PollSpan span;
+    if (PollPlanner::sensorSpan(sensor, &span)) {
+        removeSpan(groupKey(devId, sensor.registerAddress), span);
+    }
+}
+
+void PollPlan::addMap(const QUuid &devId, const SensorsMap &map)
+{
+    PollSpan span;
+    if (PollPlanner::mapSpan(map, &span)) {
+        insertSpan(groupKey(devId, map.registеrAddress), span);
+    }
+}
+
+void PollPlan::removeMap(const QUuid &devId, const SensorsMap &map)
+{
+    PollSpan span;
+    if (PollPlanner::mapSpan(map, &span)) {
+        removeSpan(groupKey(devId, map.registеrAddress), span);
+    }
+}
+
+void PollPlan::setGroupRequests(const PollGroupKey &key, const QVector<PollRequest> &requests)
+{
+    auto it = mGroups.find(key);
+    if (it == mGroups.end()) {
+        return;
+    }
+    it.value().requests = requests;
+    mDirtyGroups.remove(key);
+}
+
+void PollPlan::update()
+{
+    for (const auto &key : qAsConst(mDirtyGroups)) {
+        auto it = mGroups.find(key);
+        if (it == mGroups.end()) {
+            continue;
+        }
+        Group &group = it.value();
+        if (!group.sorted) {
+            std::sort(group.group.spans.begin(), group.group.spans.end(), pollSpanLess);
+            group.sorted = true;
+        }
+        group.pendingInserts = 0;
+        group.requests = mPlanner.planGroup(group.group, mDeviceSettings.value(key.devId));
+    }
+    mDirtyGroups.clear();
+}
+
+bool PollPlan::isUpToDate() const
+{
+    return mDirtyGroups.isEmpty();
+}
+
+QList<PollGroupKey> PollPlan::groupKeys() const
+{
+    auto result = mGroups.keys();
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+QVector<PollRequest> PollPlan::groupRequests(const PollGroupKey &key) const
+{
+    return mGroups.value(key).requests;
+}
+
+QVector<PollRequest> PollPlan::deviceRequests(const QUuid &devId) const
+{
+    auto keys = mDeviceGroups.value(devId).values();
+    std::sort(keys.begin(), keys.end());
+    QVector<PollRequest> result;
+    for (const auto &key : qAsConst(keys)) {
+        result.append(mGroups.value(key).requests);
+    }
+    return result;
+}
+
+PollGroupKey PollPlan::groupKey(const QUuid &devId, const RegisterAddress &address)
+{
+    PollGroupKey key;
+    key.devId = devId;
+    key.slaveAddress = address.slaveAddress;
+    key.regType = address.regType;
+    return key;
+}
+
+void PollPlan::insertSpan(const PollGroupKey &key, const PollSpan &span)
+{
+    auto it = mGroups.find(key);
+    if (it == mGroups.end()) {
+        it = mGroups.insert(key, Group());
+        it.value().group.slaveAddress = key.slaveAddress;
+        it.value().group.regType = key.regType;
+        mDeviceGroups[key.devId].insert(key);
+    }
+    Group &group = it.value();
+    auto &spans = group.group.spans;
+    if (group.sorted && group.pendingInserts < maxSortedInserts) {
+        spans.insert(std::upper_bound(spans.begin(), spans.end(), span, pollSpanLess), span);
+    } else {
+        spans.append(span);
+        group.sorted = false;
+    }
+    ++group.pendingInserts;
+    mDirtyGroups.insert(key);
+}
+
+void PollPlan::removeSpan(const PollGroupKey &key, const PollSpan &span)
+{
+    auto it = mGroups.find(key);
+    if (it == mGroups.end()) {
+        return;
+    }
+    Group &group = it.value();
+    auto &spans = group.group.spans;
+    auto sameItem = [&span](const PollSpan &other) {
+        return other.type == span.type && other.startAddress == span.startAddress
+            && other.sensorId == span.sensorId && other.mapId == span.mapId;
+    };
+    auto spanIt = spans.end();
+    if (group.sorted) {
+        auto range = std::equal_range(spans.begin(), spans.end(), span, pollSpanLess);
+        spanIt = std::find_if(range.first, range.second, sameItem);
+        if (spanIt == range.second) {
+            spanIt = spans.end();
+        }
+    } else {
+        spanIt = std::find_if(spans.begin(), spans.end(), sameItem);
+    }
+    if (spanIt == spans.end()) {
+        return;
+    }
+    spans.erase(spanIt);
+    if (spans.isEmpty()) {
+        mGroups.erase(it);
+        mDirtyGroups.remove(key);
+        auto devIt = mDeviceGroups.find(key.devId);
+        if (devIt != mDeviceGroups.end()) {
+            devIt.value().remove(key);
+            if (devIt.value().isEmpty()) {
+                mDeviceGroups.erase(devIt);
+            }
+        }
+        return;
+    }
+    mDirtyGroups.insert(key);
+}
+
+}
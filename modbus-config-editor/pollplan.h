@@ -0,0 +1,68 @@
+#pragma once
+
+#include "pollplanner.h"
+
+#include <QHash>
+#include <QSet>
+
+namespace ModbusConfig {
+
+struct PollGroupKey {
+    QUuid devId;
+    quint8 slaveAddress{};
+    RegisterAddress::RegisterType regType;
+};
+
+bool operator==(const PollGroupKey &l, const PollGroupKey &r);
+bool operator<(const PollGroupKey &l, const PollGroupKey &r);
+uint qHash(const PollGroupKey &key, uint seed = 0);
+
+class PollPlan
+{
+public:
+    PollPlan() = default;
+
+    void clear();
+
+    void addDevice(const Device &device);
+    void removeDevice(const QUuid &devId);
+    void setDevicePollSettings(const QUuid &devId, const PollSettings &settings);
+
+    void addSensor(const QUuid &devId, const Sensor &sensor);
+    void removeSensor(const QUuid &devId, const Sensor &sensor);
+    void addMap(const QUuid &devId, const SensorsMap &map);
+    void removeMap(const QUuid &devId, const SensorsMap &map);
+
+    // устанавливает заранее рассчитанные запросы группы без пересчёта
+    void setGroupRequests(const PollGroupKey &key, const QVector<PollRequest> &requests);
+
+    // пересчитывает запросы только изменённых групп
+    void update();
+    bool isUpToDate() const;
+
+    QList<PollGroupKey> groupKeys() const;
+    QVector<PollRequest> groupRequests(const PollGroupKey &key) const;
+    QVector<PollRequest> deviceRequests(const QUuid &devId) const;
+
+private:
+    struct Group {
+        PollGroup group;
+        QVector<PollRequest> requests;
+        bool sorted{true};
+        int pendingInserts{};
+    };
+
+    static PollGroupKey groupKey(const QUuid &devId, const RegisterAddress &address);
+
+    void insertSpan(const PollGroupKey &key, const PollSpan &span);
+    void removeSpan(const PollGroupKey &key, const PollSpan &span);
+
+private:
+    PollPlanner mPlanner;
+    QHash<PollGroupKey, Group> mGroups;
+    QHash<QUuid, QSet<PollGroupKey>> mDeviceGroups;
+    QHash<QUuid, PollSettings> mDeviceSettings;
+    QSet<PollGroupKey> mDirtyGroups;
+};
+
+}
@@ -0,0 +1,347 @@
+#include "pollplanner.h"
+
+#include "utils.h"
+
+#include <QMap>
+
+#include <algorithm>
+
+namespace {
+constexpr int maxRegistersPerRequest = 125;
+constexpr int maxBitsPerRequest = 2000;
+constexpr int bitsPerRegister = 16;
+constexpr int defaultMaxRegisterGap = 4;
+constexpr quint32 defaultBaudrate = 9600;
+constexpr quint32 fixedSilenceBaudrate = 19200;
+// для скоростей выше 19200 стандарт фиксирует t3.5 равным 1.75 мс
+constexpr double fixedSilenceTime = 0.00175;
+constexpr double serialTurnaroundTime = 0.002;
+constexpr double tcpRoundTripTime = 0.001;
+constexpr double tcpBitRate = 10e6;
+constexpr int rtuRequestBytes = 8;
+constexpr int rtuResponseOverheadBytes = 5;
+constexpr int tcpRequestBytes = 12;
+constexpr int tcpResponseOverheadBytes = 9;
+constexpr int rtuWriteRequestOverheadBytes = 9;
+constexpr int rtuWriteResponseBytes = 8;
+constexpr int tcpWriteRequestOverheadBytes = 13;
+constexpr int tcpWriteResponseBytes = 12;
+
+struct Piece {
+    int span;
+    int itemOffset;
+    int startAddress;
+    int count;
+};
+
+QVector<Piece> splitSpans(const QVector<ModbusConfig::PollSpan> &spans, int maxSize)
+{
+    QVector<Piece> result;
+    result.reserve(spans.size());
+    bool needSort = false;
+    for (int i = 0; i < spans.size(); ++i) {
+        const auto &span = spans.at(i);
+        if (span.count <= maxSize) {
+            result.append({i, 0, span.startAddress, span.count});
+            continue;
+        }
+        // большие карты режутся по границе значения
+        int chunk = maxSize;
+        if (span.valueSize > 1 && span.valueSize <= maxSize) {
+            chunk = maxSize / span.valueSize * span.valueSize;
+        }
+        for (int offset = 0; offset < span.count; offset += chunk) {
+            result.append({i, offset, span.startAddress + offset, qMin(chunk, span.count - offset)});
+        }
+        needSort = true;
+    }
+    if (needSort) {
+        std::stable_sort(result.begin(), result.end(), [](const Piece &l, const Piece &r) {
+            return l.startAddress < r.startAddress;
+        });
+    }
+    return result;
+}
+
+// onRequest(first, last, startAddress, count) вызывается для каждого запроса,
+// куски [first, last) попадают в этот запрос
+template <typename F>
+void mergePieces(const QVector<Piece> &pieces, int maxGap, int maxSize, F onRequest)
+{
+    if (pieces.isEmpty()) {
+        return;
+    }
+    int first = 0;
+    int start = pieces.at(0).startAddress;
+    int end = start + pieces.at(0).count;
+    for (int i = 1; i < pieces.size(); ++i) {
+        const auto &piece = pieces.at(i);
+        int pieceEnd = piece.startAddress + piece.count;
+        int newEnd = qMax(end, pieceEnd);
+        if (piece.startAddress <= end + maxGap && newEnd - start <= maxSize) {
+            end = newEnd;
+            continue;
+        }
+        onRequest(first, i, start, end - start);
+        first = i;
+        start = piece.startAddress;
+        end = pieceEnd;
+    }
+    onRequest(first, pieces.size(), start, end - start);
+}
+
+double stopBitsCount(ModbusConfig::ConnectionParams::StopBits stopBits)
+{
+    using SB = ModbusConfig::ConnectionParams::StopBits;
+    switch (stopBits) {
+    case SB::OneAndHalfStop:
+        return 1.5;
+    case SB::TwoStop:
+        return 2;
+    default:
+        break;
+    }
+    return 1;
+}
+
+}
+
+namespace ModbusConfig {
+
+bool operator==(const PollItem &l, const PollItem &r)
+{
+    return l.type == r.type && l.sensorId == r.sensorId && l.mapId == r.mapId
+        && l.requestOffset == r.requestOffset && l.itemOffset == r.itemOffset
+        && l.count == r.count;
+}
+
+bool operator==(const PollRequest &l, const PollRequest &r)
+{
+    return l.slaveAddress == r.slaveAddress && l.regType == r.regType
+        && l.startAddress == r.startAddress && l.count == r.count && l.items == r.items;
+}
+
+bool pollSpanLess(const PollSpan &l, const PollSpan &r)
+{
+    if (l.startAddress != r.startAddress) {
+        return l.startAddress < r.startAddress;
+    }
+    if (l.count != r.count) {
+        return l.count > r.count;
+    }
+    // полный порядок нужен, чтобы инкрементальный план совпадал с полным пересчётом
+    if (l.type != r.type) {
+        return l.type == PollItem::Type::Map;
+    }
+    if (l.type == PollItem::Type::Map) {
+        return l.mapId < r.mapId;
+    }
+    return l.sensorId < r.sensorId;
+}
+
+PollCostModel::PollCostModel(const ConnectionParams &params) :
+    mSerial(params.type == ConnectionParams::Type::RtuSerial)
+{
+    if (!mSerial) {
+        return;
+    }
+    quint32 baudrate = params.baudrate > 0 ? params.baudrate : defaultBaudrate;
+    double bits = 1 + (params.databits > 0 ? params.databits : 8) + stopBitsCount(params.stopBits);
+    if (params.parity != ConnectionParams::Parity::NoParity) {
+        bits += 1;
+    }
+    mCharTime = bits / baudrate;
+    if (baudrate > fixedSilenceBaudrate) {
+        mSilenceTime = fixedSilenceTime;
+    } else {
+        mSilenceTime = 3.5 * mCharTime;
+    }
+}
+
+double PollCostModel::requestTime(RegisterAddress::RegisterType type, int count) const
+{
+    int dataBytes = isBitRegisterType(type) ? (count + 7) / 8 : count * 2;
+    if (mSerial) {
+        return frameTime(rtuRequestBytes, rtuResponseOverheadBytes + dataBytes);
+    }
+    return frameTime(tcpRequestBytes, tcpResponseOverheadBytes + dataBytes);
+}
+
+double PollCostModel::writeTime(RegisterAddress::RegisterType type, int count) const
+{
+    int dataBytes = isBitRegisterType(type) ? (count + 7) / 8 : count * 2;
+    if (mSerial) {
+        return frameTime(rtuWriteRequestOverheadBytes + dataBytes, rtuWriteResponseBytes);
+    }
+    return frameTime(tcpWriteRequestOverheadBytes + dataBytes, tcpWriteResponseBytes);
+}
+
+double PollCostModel::cycleTime(const QVector<PollRequest> &requests) const
+{
+    double result = 0;
+    for (const auto &request : requests) {
+        result += requestTime(request.regType, request.count);
+    }
+    return result;
+}
+
+double PollCostModel::charTime() const
+{
+    return mCharTime;
+}
+
+double PollCostModel::silenceTime() const
+{
+    return mSilenceTime;
+}
+
+double PollCostModel::frameTime(int requestBytes, int responseBytes) const
+{
+    if (mSerial) {
+        return (requestBytes + responseBytes) * mCharTime + 2 * mSilenceTime
+            + serialTurnaroundTime;
+    }
+    return tcpRoundTripTime + (requestBytes + responseBytes) * 8 / tcpBitRate;
+}
+
+PollSettings PollPlanner::effectiveSettings(const PollSettings &settings)
+{
+    PollSettings result;
+    result.maxRegisterGap =
+        settings.maxRegisterGap >= 0 ? settings.maxRegisterGap : defaultMaxRegisterGap;
+    result.maxRequestSize = settings.maxRequestSize > 0
+        ? qMin(settings.maxRequestSize, maxRegistersPerRequest) : maxRegistersPerRequest;
+    return result;
+}
+
+int PollPlanner::maxRequestSize(RegisterAddress::RegisterType type, const PollSettings &settings)
+{
+    int size = effectiveSettings(settings).maxRequestSize;
+    if (isBitRegisterType(type)) {
+        return qMin(size * bitsPerRegister, maxBitsPerRequest);
+    }
+    return size;
+}
+
+int PollPlanner::maxGap(RegisterAddress::RegisterType type, const PollSettings &settings)
+{
+    int gap = effectiveSettings(settings).maxRegisterGap;
+    if (isBitRegisterType(type)) {
+        return gap * bitsPerRegister;
+    }
+    return gap;
+}
+
+bool PollPlanner::sensorSpan(const Sensor &sensor, PollSpan *span)
+{
+    if (sensor.type != Sensor::Type::Separate || sensor.mode == Sensor::Mode::Write) {
+        return false;
+    }
+    span->type = PollItem::Type::Sensor;
+    span->sensorId = sensor.id;
+    span->mapId.clear();
+    span->startAddress = sensor.registerAddress.regAddress;
+    span->valueSize = registerCount(sensor.registerAddress);
+    span->count = span->valueSize;
+    return true;
+}
+
+bool PollPlanner::mapSpan(const SensorsMap &map, PollSpan *span)
+{
+    if (map.valueCount <= 0) {
+        return false;
+    }
+    span->type = PollItem::Type::Map;
+    span->sensorId = QUuid();
+    span->mapId = map.id;
+    span->startAddress = map.registеrAddress.regAddress;
+    span->valueSize = registerCount(map.registеrAddress);
+    span->count = map.valueCount * span->valueSize;
+    return true;
+}
+
+QVector<PollGroup> PollPlanner::groups(const Device &device) const
+{
+    QMap<QPair<int, int>, PollGroup> groups;
+    auto groupFor = [&groups](const RegisterAddress &address) -> PollGroup & {
+        auto &group = groups[qMakePair(int(address.slaveAddress), toInt(address.regType))];
+        group.slaveAddress = address.slaveAddress;
+        group.regType = address.regType;
+        return group;
+    };
+
+    PollSpan span;
+    for (const auto &sensor : device.sensors) {
+        if (sensorSpan(sensor, &span)) {
+            groupFor(sensor.registerAddress).spans.append(span);
+        }
+    }
+
+    for (const auto &map : device.maps) {
+        if (mapSpan(map, &span)) {
+            groupFor(map.registеrAddress).spans.append(span);
+        }
+    }
+
+    QVector<PollGroup> result;
+    result.reserve(groups.size());
+    for (auto &group : groups) {
+        std::sort(group.spans.begin(), group.spans.end(), pollSpanLess);
+        result.append(group);
+    }
+    return result;
+}
+
+QVector<PollRequest> PollPlanner::planGroup(
+    const PollGroup &group, const PollSettings &settings) const
+{
+    QVector<PollRequest> result;
+    auto pieces = splitSpans(group.spans, maxRequestSize(group.regType, settings));
+    mergePieces(pieces, maxGap(group.regType, settings), maxRequestSize(group.regType, settings),
+        [&](int first, int last, int start, int count) {
+            PollRequest request;
+            request.slaveAddress = group.slaveAddress;
+            request.regType = group.regType;
+            request.startAddress = start;
+            request.count = count;
+            request.items.reserve(last - first);
+            for (int i = first; i < last; ++i) {
+                const auto &piece = pieces.at(i);
+                const auto &span = group.spans.at(piece.span);
+                PollItem item;
+                item.type = span.type;
+                item.sensorId = span.sensorId;
+                item.mapId = span.mapId;
+                item.requestOffset = piece.startAddress - start;
+                item.itemOffset = piece.itemOffset;
+                item.count = piece.count;
+                request.items.append(item);
+            }
+            result.append(request);
+        });
+    return result;
+}
+
+double PollPlanner::estimateGroup(
+    const PollGroup &group, const PollSettings &settings, const PollCostModel &cost) const
+{
+    double result = 0;
+    auto pieces = splitSpans(group.spans, maxRequestSize(group.regType, settings));
+    mergePieces(pieces, maxGap(group.regType, settings), maxRequestSize(group.regType, settings),
+        [&](int, int, int, int count) {
+            result += cost.requestTime(group.regType, count);
+        });
+    return result;
+}
+
+QVector<PollRequest> PollPlanner::plan(const Device &device) const
+{
+    QVector<PollRequest> result;
+    const auto deviceGroups = groups(device);
+    for (const auto &group : deviceGroups) {
+        result.append(planGroup(group, device.settings.pollSettings));
+    }
+    return result;
+}
+
+}
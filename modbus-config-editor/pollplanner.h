@@ -0,0 +1,94 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QVector>
+
+namespace ModbusConfig {
+
+struct PollItem {
+    enum class Type {
+        Sensor,
+        Map
+    };
+
+    Type type;
+    QUuid sensorId;
+    QString mapId;
+    // смещение данных элемента от начала запроса
+    int requestOffset{};
+    // смещение от начала элемента (карта может быть разбита на несколько запросов)
+    int itemOffset{};
+    int count{};
+};
+
+struct PollRequest {
+    quint8 slaveAddress{};
+    RegisterAddress::RegisterType regType;
+    int startAddress{};
+    int count{};
+    QVector<PollItem> items;
+};
+
+struct PollSpan {
+    PollItem::Type type;
+    QUuid sensorId;
+    QString mapId;
+    int startAddress{};
+    int count{};
+    int valueSize{1};
+};
+
+bool operator==(const PollItem &l, const PollItem &r);
+bool operator==(const PollRequest &l, const PollRequest &r);
+bool pollSpanLess(const PollSpan &l, const PollSpan &r);
+
+struct PollGroup {
+    quint8 slaveAddress{};
+    RegisterAddress::RegisterType regType;
+    QVector<PollSpan> spans;
+};
+
+class PollCostModel
+{
+public:
+    explicit PollCostModel(const ConnectionParams &params);
+
+    double requestTime(RegisterAddress::RegisterType type, int count) const;
+    double writeTime(RegisterAddress::RegisterType type, int count) const;
+    double cycleTime(const QVector<PollRequest> &requests) const;
+
+    // длительность символа и межкадровой паузы RTU в секундах
+    double charTime() const;
+    double silenceTime() const;
+
+private:
+    double frameTime(int requestBytes, int responseBytes) const;
+
+private:
+    bool mSerial;
+    double mCharTime{};
+    double mSilenceTime{};
+};
+
+class PollPlanner
+{
+public:
+    PollPlanner() = default;
+
+    static PollSettings effectiveSettings(const PollSettings &settings);
+    static int maxRequestSize(RegisterAddress::RegisterType type, const PollSettings &settings);
+    static int maxGap(RegisterAddress::RegisterType type, const PollSettings &settings);
+
+    static bool sensorSpan(const Sensor &sensor, PollSpan *span);
+    static bool mapSpan(const SensorsMap &map, PollSpan *span);
+
+    QVector<PollGroup> groups(const Device &device) const;
+    QVector<PollRequest> planGroup(const PollGroup &group, const PollSettings &settings) const;
+    double estimateGroup(
+        const PollGroup &group, const PollSettings &settings, const PollCostModel &cost) const;
+
+    QVector<PollRequest> plan(const Device &device) const;
+};
+
+}
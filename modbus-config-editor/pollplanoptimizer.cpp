@@ -0,0 +1,104 @@
+#include "pollplanoptimizer.h"
+
+#include "pollplanner.h"
+
+#include <QtConcurrent>
+
+namespace {
+// выигрыш меньше этой величины не стоит переопределения настроек устройства
+constexpr double minImprovement = 1e-6;
+}
+
+namespace ModbusConfig {
+
+PollPlanOptimizer::PollPlanOptimizer() :
+    mGaps({0, 1, 2, 4, 8, 16, 32, 64}),
+    mRequestSizes({125, 100, 64, 32, 16, 8})
+{
+
+}
+
+void PollPlanOptimizer::setCandidateGaps(const QVector<int> &gaps)
+{
+    mGaps = gaps;
+}
+
+void PollPlanOptimizer::setCandidateRequestSizes(const QVector<int> &sizes)
+{
+    mRequestSizes = sizes;
+}
+
+QVector<PollPlanOptimization> PollPlanOptimizer::optimize(const ModbusConfigModel &model) const
+{
+    QVector<PollPlanOptimization> result;
+    const auto devicesIds = model.devicesIds();
+    result.reserve(devicesIds.size());
+    for (const auto &devId : devicesIds) {
+        PollPlanOptimization item;
+        item.devId = devId;
+        result.append(item);
+    }
+
+    QtConcurrent::blockingMap(result, [this, &model](PollPlanOptimization &item) {
+        item = optimizeDevice(model.device(item.devId));
+    });
+    return result;
+}
+
+QString PollPlanOptimizer::apply(
+    ModbusConfigModel *model, const QVector<PollPlanOptimization> &results)
+{
+    for (const auto &item : results) {
+        const auto &current = model->device(item.devId).settings.pollSettings;
+        if (current.maxRegisterGap == item.settings.maxRegisterGap
+            && current.maxRequestSize == item.settings.maxRequestSize) {
+            continue;
+        }
+        QString error = model->setDevicePollSettings(item.devId, item.settings);
+        if (!error.isEmpty()) {
+            return error;
+        }
+    }
+    return {};
+}
+
+PollPlanOptimization PollPlanOptimizer::optimizeDevice(const Device &device) const
+{
+    PollPlanOptimization result;
+    result.devId = device.settings.id;
+    result.settings = device.settings.pollSettings;
+
+    PollPlanner planner;
+    PollCostModel cost(device.settings.connectionParams);
+    const auto groups = planner.groups(device);
+
+    auto estimate = [&](const PollSettings &settings) {
+        double time = 0;
+        for (const auto &group : groups) {
+            time += planner.estimateGroup(group, settings, cost);
+        }
+        return time;
+    };
+
+    result.cycleTimeBefore = estimate(device.settings.pollSettings);
+    result.cycleTimeAfter = result.cycleTimeBefore;
+    if (groups.isEmpty()) {
+        return result;
+    }
+
+    for (int size : mRequestSizes) {
+        for (int gap : mGaps) {
+            PollSettings candidate;
+            candidate.maxRegisterGap = gap;
+            candidate.maxRequestSize = size;
+            double time = estimate(candidate);
+            if (time < result.cycleTimeAfter - minImprovement) {
+                result.cycleTimeAfter = time;
+                result.settings = candidate;
+            }
+        }
+    }
+    return result;
+}
+
+}
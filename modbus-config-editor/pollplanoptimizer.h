@@ -0,0 +1,35 @@
+#pragma once
+
+#include "modbusconfigmodel.h"
+
+#include <QVector>
+
+namespace ModbusConfig {
+
+struct PollPlanOptimization {
+    QUuid devId;
+    PollSettings settings;
+    double cycleTimeBefore{};
+    double cycleTimeAfter{};
+};
+
+class PollPlanOptimizer
+{
+public:
+    PollPlanOptimizer();
+
+    void setCandidateGaps(const QVector<int> &gaps);
+    void setCandidateRequestSizes(const QVector<int> &sizes);
+
+    QVector<PollPlanOptimization> optimize(const ModbusConfigModel &model) const;
+    static QString apply(ModbusConfigModel *model, const QVector<PollPlanOptimization> &results);
+
+private:
+    PollPlanOptimization optimizeDevice(const Device &device) const;
+
+private:
+    QVector<int> mGaps;
+    QVector<int> mRequestSizes;
+};
+
+}
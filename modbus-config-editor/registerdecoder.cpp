@@ -0,0 +1,364 @@
+#include "registerdecoder.h"
+
+#include "cpufeatures.h"
+
+#include <QSysInfo>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(MODBUS_CONFIG_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+using ValType = ModbusConfig::RegisterAddress::ValType;
+
+constexpr int decodeChunk = 256;
+constexpr int maxValueSize = 8;
+
+int valueSize(ValType type)
+{
+    switch (type) {
+    case ValType::Bool:
+    case ValType::Int8:
+    case ValType::UInt8:
+    case ValType::Int16:
+    case ValType::UInt16:
+        return 2;
+    case ValType::Int32:
+    case ValType::UInt32:
+    case ValType::Float:
+        return 4;
+    case ValType::Int64:
+    case ValType::UInt64:
+    case ValType::Double:
+        return 8;
+    case ValType::Unknown:
+        break;
+    }
+    return 0;
+}
+
+#if defined(MODBUS_CONFIG_X86)
+MODBUS_CONFIG_TARGET("ssse3")
+int shuffleSsse3(const quint8 *mask, const quint8 *raw, int bytes, quint8 *out)
+{
+    const __m128i shuffleMask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask));
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(raw + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+            _mm_shuffle_epi8(value, shuffleMask));
+    }
+    return i;
+}
+
+MODBUS_CONFIG_TARGET("avx2")
+int shuffleAvx2(const quint8 *mask, const quint8 *raw, int bytes, quint8 *out)
+{
+    // vpshufb переставляет байты внутри 128-битных половин, поэтому маска повторяется
+    const __m128i halfMask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask));
+    const __m256i shuffleMask = _mm256_broadcastsi128_si256(halfMask);
+    int i = 0;
+    for (; i + 64 <= bytes; i += 64) {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(raw + i));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(raw + i + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+            _mm256_shuffle_epi8(first, shuffleMask));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 32),
+            _mm256_shuffle_epi8(second, shuffleMask));
+    }
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(raw + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+            _mm256_shuffle_epi8(value, shuffleMask));
+    }
+    return i;
+}
+#endif
+
+template <typename T>
+void toDouble(const quint8 *native, int count, double *out)
+{
+    const T *values = reinterpret_cast<const T *>(native);
+    for (int i = 0; i < count; ++i) {
+        out[i] = static_cast<double>(values[i]);
+    }
+}
+
+void toDouble(ValType type, const quint8 *native, int count, double *out)
+{
+    const quint16 *words = reinterpret_cast<const quint16 *>(native);
+    switch (type) {
+    case ValType::Bool:
+        for (int i = 0; i < count; ++i) {
+            out[i] = words[i] != 0 ? 1 : 0;
+        }
+        break;
+    // 8-битное значение занимает младший байт регистра
+    case ValType::Int8:
+        for (int i = 0; i < count; ++i) {
+            out[i] = static_cast<qint8>(words[i] & 0xff);
+        }
+        break;
+    case ValType::UInt8:
+        for (int i = 0; i < count; ++i) {
+            out[i] = words[i] & 0xff;
+        }
+        break;
+    case ValType::Int16:
+        toDouble<qint16>(native, count, out);
+        break;
+    case ValType::UInt16:
+        toDouble<quint16>(native, count, out);
+        break;
+    case ValType::Int32:
+        toDouble<qint32>(native, count, out);
+        break;
+    case ValType::UInt32:
+        toDouble<quint32>(native, count, out);
+        break;
+    case ValType::Int64:
+        toDouble<qint64>(native, count, out);
+        break;
+    case ValType::UInt64:
+        toDouble<quint64>(native, count, out);
+        break;
+    case ValType::Float:
+        toDouble<float>(native, count, out);
+        break;
+    case ValType::Double:
+        toDouble<double>(native, count, out);
+        break;
+    case ValType::Unknown:
+        break;
+    }
+}
+
+template <typename T>
+void fromDouble(const double *values, int count, quint8 *native)
+{
+    // границы в double: для 64-битных max() округляется вверх, поэтому сравнение строгое
+    const double low = static_cast<double>(std::numeric_limits<T>::min());
+    const double high = static_cast<double>(std::numeric_limits<T>::max());
+    T *out = reinterpret_cast<T *>(native);
+    for (int i = 0; i < count; ++i) {
+        const double value = std::nearbyint(values[i]);
+        if (!(value > low)) {
+            out[i] = value == value ? std::numeric_limits<T>::min() : T(0);
+        } else if (!(value < high)) {
+            out[i] = std::numeric_limits<T>::max();
+        } else {
+            out[i] = static_cast<T>(value);
+        }
+    }
+}
+
+template <typename T>
+void fromDoubleFloat(const double *values, int count, quint8 *native)
+{
+    T *out = reinterpret_cast<T *>(native);
+    for (int i = 0; i < count; ++i) {
+        out[i] = static_cast<T>(values[i]);
+    }
+}
+
+void fromDouble(ValType type, const double *values, int count, quint8 *native)
+{
+    quint16 *words = reinterpret_cast<quint16 *>(native);
+    switch (type) {
+    case ValType::Bool:
+        for (int i = 0; i < count; ++i) {
+            words[i] = values[i] != 0 && values[i] == values[i] ? 1 : 0;
+        }
+        break;
+    case ValType::Int8:
+        fromDouble<qint16>(values, count, native);
+        for (int i = 0; i < count; ++i) {
+            words[i] = quint16(qBound<qint16>(-128, qint16(words[i]), 127) & 0xff);
+        }
+        break;
+    case ValType::UInt8:
+        fromDouble<quint16>(values, count, native);
+        for (int i = 0; i < count; ++i) {
+            words[i] = qMin<quint16>(words[i], 0xff);
+        }
+        break;
+    case ValType::Int16:
+        fromDouble<qint16>(values, count, native);
+        break;
+    case ValType::UInt16:
+        fromDouble<quint16>(values, count, native);
+        break;
+    case ValType::Int32:
+        fromDouble<qint32>(values, count, native);
+        break;
+    case ValType::UInt32:
+        fromDouble<quint32>(values, count, native);
+        break;
+    case ValType::Int64:
+        fromDouble<qint64>(values, count, native);
+        break;
+    case ValType::UInt64:
+        fromDouble<quint64>(values, count, native);
+        break;
+    case ValType::Float:
+        fromDoubleFloat<float>(values, count, native);
+        break;
+    case ValType::Double:
+        fromDoubleFloat<double>(values, count, native);
+        break;
+    case ValType::Unknown:
+        break;
+    }
+}
+
+}
+
+namespace ModbusConfig {
+
+int typeOrderPermutation(RegisterAddress::ValType type, const QString &typeOrder, quint8 *order)
+{
+    const int size = ::valueSize(type);
+    if (size == 0) {
+        return 0;
+    }
+    const bool byteType = type == ValType::Bool || type == ValType::Int8 || type == ValType::UInt8;
+    if (!typeOrder.isEmpty() && (byteType || typeOrder.size() != size)) {
+        return 0;
+    }
+    bool used[maxValueSize]{};
+    for (int p = 0; p < size; ++p) {
+        int wireByte = p;
+        if (!typeOrder.isEmpty()) {
+            wireByte = typeOrder.at(p).digitValue() - 1;
+            if (wireByte < 0 || wireByte >= size || used[wireByte]) {
+                return 0;
+            }
+        }
+        used[wireByte] = true;
+        order[p] = static_cast<quint8>(wireByte);
+    }
+    return size;
+}
+
+RegisterDecoder::RegisterDecoder(RegisterAddress::ValType type, const QString &typeOrder) :
+    mType(type)
+{
+    quint8 order[maxValueSize];
+    mSize = typeOrderPermutation(type, typeOrder, order);
+    if (mSize == 0) {
+        return;
+    }
+
+    if (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+        for (int j = 0; j < mSize; ++j) {
+            mOrder[j] = order[mSize - 1 - j];
+        }
+    } else {
+        std::memcpy(mOrder, order, mSize);
+    }
+    for (int j = 0; j < mSize; ++j) {
+        mInverse[mOrder[j]] = static_cast<quint8>(j);
+    }
+    for (int i = 0; i < 16; ++i) {
+        mMask[i] = static_cast<quint8>(i / mSize * mSize + mOrder[i % mSize]);
+        mInverseMask[i] = static_cast<quint8>(i / mSize * mSize + mInverse[i % mSize]);
+    }
+
+#if defined(MODBUS_CONFIG_X86)
+    const auto &features = cpuFeatures();
+    if (features.avx2) {
+        mShuffle = shuffleAvx2;
+    } else if (features.ssse3) {
+        mShuffle = shuffleSsse3;
+    }
+#endif
+}
+
+RegisterDecoder::RegisterDecoder(const RegisterAddress &address) :
+    RegisterDecoder(address.valType, address.typeOrder)
+{
+}
+
+bool RegisterDecoder::isValid() const
+{
+    return mSize != 0;
+}
+
+RegisterAddress::ValType RegisterDecoder::valType() const
+{
+    return mType;
+}
+
+int RegisterDecoder::registersPerValue() const
+{
+    return mSize / 2;
+}
+
+int RegisterDecoder::valueSize() const
+{
+    return mSize;
+}
+
+void RegisterDecoder::decodeNative(const quint8 *raw, int count, void *out) const
+{
+    if (!isValid() || count <= 0) {
+        return;
+    }
+    shuffle(mMask, mOrder, raw, count, static_cast<quint8 *>(out));
+}
+
+void RegisterDecoder::decode(const quint8 *raw, int count, double *out) const
+{
+    if (!isValid()) {
+        return;
+    }
+    // промежуточный буфер небольшой, чтобы оставаться в L1
+    alignas(16) quint8 native[decodeChunk * maxValueSize];
+    for (int offset = 0; offset < count; offset += decodeChunk) {
+        int chunk = qMin(decodeChunk, count - offset);
+        shuffle(mMask, mOrder, raw + offset * mSize, chunk, native);
+        toDouble(mType, native, chunk, out + offset);
+    }
+}
+
+double RegisterDecoder::decodeOne(const quint8 *raw) const
+{
+    double result = 0;
+    decode(raw, 1, &result);
+    return result;
+}
+
+void RegisterDecoder::encode(const double *values, int count, quint8 *raw) const
+{
+    if (!isValid()) {
+        return;
+    }
+    alignas(16) quint8 native[decodeChunk * maxValueSize];
+    for (int offset = 0; offset < count; offset += decodeChunk) {
+        int chunk = qMin(decodeChunk, count - offset);
+        fromDouble(mType, values + offset, chunk, native);
+        shuffle(mInverseMask, mInverse, native, chunk, raw + offset * mSize);
+    }
+}
+
+void RegisterDecoder::shuffle(const quint8 *mask, const quint8 *order, const quint8 *in,
+    int count, quint8 *out) const
+{
+    const int bytes = count * mSize;
+    int done = 0;
+    if (mShuffle) {
+        done = mShuffle(mask, in, bytes, out);
+    }
+    // хвост (и весь блок без SSSE3) переставляется по таблице
+    for (; done < bytes; done += mSize) {
+        for (int j = 0; j < mSize; ++j) {
+            out[done + j] = in[done + order[j]];
+        }
+    }
+}
+
+}
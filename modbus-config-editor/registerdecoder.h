@@ -0,0 +1,57 @@
+#pragma once
+
+#include "modbusentities.h"
+
+namespace ModbusConfig {
+
+// Разбирает порядок байт: order[p] - байт в сети (с 0) для p-го по старшинству байта значения.
+// Возвращает размер значения в байтах или 0, если тип или порядок некорректны.
+int typeOrderPermutation(RegisterAddress::ValType type, const QString &typeOrder, quint8 *order);
+
+// Декодер блока регистров в том виде, в каком он пришёл по сети
+// (каждый регистр - старший байт первым, регистры подряд).
+// typeOrder[i] - номер байта в сети (с 1), который становится i-м по старшинству
+// байтом значения; пустой порядок соответствует "12..N".
+// Порядок компилируется в маску перестановки один раз, сам декодер дешево копируется.
+class RegisterDecoder
+{
+public:
+    RegisterDecoder() = default;
+    RegisterDecoder(RegisterAddress::ValType type, const QString &typeOrder);
+    explicit RegisterDecoder(const RegisterAddress &address);
+
+    bool isValid() const;
+    RegisterAddress::ValType valType() const;
+    // количество регистров и байт на одно значение (2, 4 или 8 байт)
+    int registersPerValue() const;
+    int valueSize() const;
+
+    // значения в нативном порядке байт: quint16 для 8-битных и Bool, иначе тип valType
+    void decodeNative(const quint8 *raw, int count, void *out) const;
+    void decode(const quint8 *raw, int count, double *out) const;
+    double decodeOne(const quint8 *raw) const;
+
+    // обратное преобразование в байты для сети: целые округляются и ограничиваются
+    // диапазоном типа, NaN записывается как 0
+    void encode(const double *values, int count, quint8 *raw) const;
+
+private:
+    void shuffle(const quint8 *mask, const quint8 *order, const quint8 *in, int count,
+        quint8 *out) const;
+
+private:
+    using ShuffleFunction = int (*)(const quint8 *mask, const quint8 *raw, int bytes, quint8 *out);
+
+    RegisterAddress::ValType mType{RegisterAddress::ValType::Unknown};
+    int mSize{};
+    // нативный байт j берётся из байта mOrder[j] значения в сети
+    quint8 mOrder[8]{};
+    // маска для pshufb, повторяет mOrder на все 16 байт
+    quint8 mMask[16]{};
+    // обратная перестановка для кодирования: байт в сети k берётся из нативного mInverse[k]
+    quint8 mInverse[8]{};
+    quint8 mInverseMask[16]{};
+    ShuffleFunction mShuffle{};
+};
+
+}
@@ -0,0 +1,749 @@
+#include "registerprober.h"
+
+#include "modbusframe.h"
+#include "pollplanner.h"
+#include "seriallink.h"
+#include "utils.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace {
+constexpr int maxReadRegisters = 125;
+constexpr int maxReadBits = 2000;
+constexpr int maxReconnects = 3;
+// столько таймаутов подряд без единого ответа - устройство считается недоступным
+constexpr int maxSilentTimeouts = 3;
+
+double seconds(qint64 ns)
+{
+    return ns / 1e9;
+}
+
+int milliseconds(qint64 ns)
+{
+    return qMax(1, int((ns + 999999) / 1000000));
+}
+
+int maxReadCount(ModbusConfig::RegisterAddress::RegisterType type)
+{
+    return ModbusConfig::isBitRegisterType(type) ? maxReadBits : maxReadRegisters;
+}
+}
+
+namespace ModbusConfig {
+
+QStringList registerProbeReportText(const RegisterProbeReport &report)
+{
+    QStringList lines;
+    if (!report.error.isEmpty()) {
+        lines << report.error;
+        return lines;
+    }
+    lines << QObject::tr("%0, слейв %1: диапазонов: %2, запросов: %3, время поиска: %4 с")
+                 .arg(toString(report.params))
+                 .arg(report.slaveAddress)
+                 .arg(report.spans.size())
+                 .arg(report.requestCount)
+                 .arg(report.elapsed, 0, 'f', 2);
+    lines << QObject::tr("Исключений: %0, таймаутов: %1, испорченных ответов: %2")
+                 .arg(report.exceptionCount)
+                 .arg(report.timeoutCount)
+                 .arg(report.badFrames);
+    for (auto type : report.unsupportedTypes) {
+        lines << QObject::tr("    %0: чтение не поддерживается").arg(toHumanString(type));
+    }
+    for (const auto &span : report.spans) {
+        const int first = configAddress(span.type, span.offset);
+        lines << QObject::tr("    %0: %1 - %2 (%3)")
+                     .arg(toHumanString(span.type))
+                     .arg(first)
+                     .arg(first + span.count - 1)
+                     .arg(span.count);
+    }
+    for (const auto &span : report.uncheckedSpans) {
+        const int first = configAddress(span.type, span.offset);
+        lines << QObject::tr("    %0: %1 - %2 проверены через %3, более короткие диапазоны "
+                             "могли быть пропущены")
+                     .arg(toHumanString(span.type))
+                     .arg(first)
+                     .arg(first + span.count - 1)
+                     .arg(report.minSpan);
+    }
+    return lines;
+}
+
+QVector<SensorsMap> probedSensorMaps(const RegisterProbeReport &report)
+{
+    QVector<SensorsMap> maps;
+    for (const auto &span : report.spans) {
+        const bool bits = isBitRegisterType(span.type);
+        SensorsMap map;
+        map.registеrAddress.slaveAddress = report.slaveAddress;
+        map.registеrAddress.regAddress = configAddress(span.type, span.offset);
+        map.registеrAddress.regType = span.type;
+        map.registеrAddress.valType =
+            bits ? RegisterAddress::ValType::Bool : RegisterAddress::ValType::UInt16;
+        map.registеrAddress.typeOrder = bits ? QString() : QString("21");
+        map.id = QString("probe_%0_%1").arg(report.slaveAddress)
+                     .arg(map.registеrAddress.regAddress);
+        map.valueCount = span.count;
+        map.defaultValue = 0;
+        maps.append(map);
+    }
+    return maps;
+}
+
+QString applyProbedSensorMaps(ModbusConfigModel *model, const QUuid &devId,
+    const RegisterProbeReport &report)
+{
+    // карты применяются к копии: ошибка в одной из них не оставляет конфигурацию
+    // применённой наполовину
+    ModbusConfigModel result = *model;
+    const auto &device = result.device(devId);
+    for (const auto &map : probedSensorMaps(report)) {
+        const QString mapId = device.maps.contains(map.id) ? map.id : QString();
+        const QString error = result.upsertSensorMap(devId, mapId, map);
+        if (!error.isEmpty()) {
+            return error;
+        }
+    }
+    *model = result;
+    return {};
+}
+
+RegisterProber::RegisterProber(QObject *parent)
+    : QObject(parent)
+    , mTypes({RegisterAddress::RegisterType::DiscreteOutputCoils,
+          RegisterAddress::RegisterType::DiscreteInputContacts,
+          RegisterAddress::RegisterType::AnalogInputRegisters,
+          RegisterAddress::RegisterType::AnalogOutputHoldingRegisters})
+{
+}
+
+RegisterProber::~RegisterProber()
+{
+    abort();
+}
+
+void RegisterProber::setTypes(const QVector<RegisterAddress::RegisterType> &types)
+{
+    mTypes = types;
+}
+
+void RegisterProber::setRange(int firstOffset, int lastOffset)
+{
+    mFirst = qBound(0, firstOffset, 0xFFFF);
+    mLast = qBound(mFirst, lastOffset, 0xFFFF);
+}
+
+void RegisterProber::setMinSpan(int count)
+{
+    mMinSpan = qBound(1, count, maxReadRegisters);
+}
+
+void RegisterProber::setWindow(int count)
+{
+    mWindow = qMax(1, count);
+}
+
+void RegisterProber::setTimeout(int msec)
+{
+    mTimeout = qMax(1, msec);
+}
+
+void RegisterProber::setResponseDelay(int msec)
+{
+    mResponseDelay = qMax(0, msec);
+}
+
+void RegisterProber::start(const ConnectionParams &params, quint8 slaveAddress)
+{
+    abort();
+    mParams = params;
+    mSlave = slaveAddress;
+    mReport = RegisterProbeReport();
+    mReport.params = params;
+    mReport.slaveAddress = slaveAddress;
+    mReport.minSpan = mMinSpan;
+    mEdgePhase = false;
+    mProbes.clear();
+    mSearches.clear();
+    mQueue.clear();
+    mQueueHead = 0;
+    mResponses = 0;
+    mReadable = 0;
+    mReconnects = 0;
+    mPending.clear();
+    mSent.clear();
+    mSentHead = 0;
+    mCurrent = -1;
+    mBuffer.clear();
+
+    // всё адресное пространство - блоками максимального размера
+    for (auto type : mTypes) {
+        const int step = maxReadCount(type);
+        for (int offset = mFirst; offset <= mLast; offset += step) {
+            mQueue.append(addProbe(type, offset, qMin(step, mLast - offset + 1)));
+        }
+    }
+
+    mRunning = true;
+    mClock.start();
+    mTimer = new QTimer(this);
+    mTimer->setSingleShot(true);
+    if (isTcp()) {
+        connect(mTimer, &QTimer::timeout, this, &RegisterProber::onTcpTimer);
+        connectToDevice();
+        return;
+    }
+
+    mLink = new SerialLink(this);
+    const QString error = mLink->open(params);
+    if (!error.isEmpty()) {
+        finish(error);
+        return;
+    }
+    PollCostModel cost(params);
+    mCharTime = qint64(cost.charTime() * 1e9);
+    mSilenceTime = qint64(cost.silenceTime() * 1e9);
+    connect(mLink, &SerialLink::readyRead, this, &RegisterProber::onLineData);
+    connect(mTimer, &QTimer::timeout, this, &RegisterProber::onLineTimer);
+    dispatch();
+}
+
+void RegisterProber::abort()
+{
+    if (!mRunning) {
+        return;
+    }
+    mRunning = false;
+    release();
+}
+
+bool RegisterProber::isRunning() const
+{
+    return mRunning;
+}
+
+int RegisterProber::addProbe(RegisterAddress::RegisterType type, int offset, int count)
+{
+    Probe probe;
+    probe.type = type;
+    probe.offset = offset;
+    probe.count = count;
+    mProbes.append(probe);
+    return mProbes.size() - 1;
+}
+
+void RegisterProber::onProbeResult(int index, int result)
+{
+    Probe &probe = mProbes[index];
+    if (!isSupported(probe.type)) {
+        probe.state = State::Dropped;
+        return;
+    }
+    probe.state = result == 0 ? State::Ok : State::Failed;
+    if (probe.kind == Kind::Edge) {
+        EdgeSearch &edge = mSearches[probe.search];
+        if (result == 0) {
+            edge.low = probe.count;
+        } else {
+            edge.high = probe.count;
+        }
+        if (edge.high - edge.low > 1) {
+            queueEdgeProbe(probe.search);
+        }
+        return;
+    }
+    if (result == int(ExceptionCode::IllegalFunction)) {
+        // функция чтения этого типа не поддерживается: остальные блоки типа не читаются
+        mReport.unsupportedTypes.append(probe.type);
+        return;
+    }
+    if (result == 0) {
+        mReadable += probe.count;
+        emit progress(mReport.requestCount, mReadable);
+        return;
+    }
+
+    // копия: постановка запросов в очередь дополняет mProbes
+    const Probe failed = probe;
+    if (failed.kind == Kind::Block) {
+        // сетка одиночных чтений: диапазон не короче mMinSpan содержит её узел
+        const int first = mFirst + (failed.offset - mFirst + mMinSpan - 1) / mMinSpan * mMinSpan;
+        for (int offset = first; offset < failed.offset + failed.count; offset += mMinSpan) {
+            const int point = addProbe(failed.type, offset, 1);
+            mProbes[point].kind = Kind::Point;
+            mQueue.append(point);
+        }
+    } else if (failed.kind == Kind::Gap) {
+        // промежуток между читаемыми узлами читается не весь: ищутся оба края
+        addEdgeSearch(failed.type, failed.offset, 1, failed.count);
+        addEdgeSearch(failed.type, failed.offset + failed.count - 1, -1, failed.count);
+    }
+}
+
+bool RegisterProber::isSupported(RegisterAddress::RegisterType type) const
+{
+    return !mReport.unsupportedTypes.contains(type);
+}
+
+bool RegisterProber::startGapProbes()
+{
+    struct Known {
+        int offset;
+        int count;
+        bool readable;
+    };
+    for (auto type : mTypes) {
+        if (!isSupported(type)) {
+            continue;
+        }
+        // прочитанные блоки и узлы сетки; не читавшиеся блоки покрыты узлами
+        QVector<Known> known;
+        for (const auto &probe : mProbes) {
+            if (probe.type == type && (probe.state == State::Ok
+                    || (probe.kind == Kind::Point && probe.state == State::Failed))) {
+                known.append({probe.offset, probe.count, probe.state == State::Ok});
+            }
+        }
+        std::sort(known.begin(), known.end(), [](const Known &l, const Known &r) {
+            return l.offset < r.offset;
+        });
+        // границы диапазона поиска - как нечитаемые регистры
+        known.append({mLast + 1, 0, false});
+
+        int end = mFirst;
+        bool readable = false;
+        for (const auto &item : known) {
+            const int gap = item.offset - end;
+            if (gap > 0 && readable && item.readable) {
+                const int index = addProbe(type, end, gap);
+                mProbes[index].kind = Kind::Gap;
+                mQueue.append(index);
+            } else if (gap > 0 && readable) {
+                addEdgeSearch(type, end, 1, gap + 1);
+            } else if (gap > 0 && item.readable) {
+                addEdgeSearch(type, item.offset - 1, -1, gap + 1);
+            } else if (gap > 0) {
+                // между нечитаемыми узлами сетки регистры не читались; участки, разделённые
+                // одним узлом, объединяются
+                auto &unchecked = mReport.uncheckedSpans;
+                if (!unchecked.isEmpty() && unchecked.last().type == type
+                    && unchecked.last().offset + unchecked.last().count + 1 >= end) {
+                    unchecked.last().count = end + gap - unchecked.last().offset;
+                } else {
+                    RegisterSpan span;
+                    span.type = type;
+                    span.offset = end;
+                    span.count = gap;
+                    unchecked.append(span);
+                }
+            }
+            end = item.offset + item.count;
+            readable = item.readable;
+        }
+    }
+    return mQueueHead < mQueue.size();
+}
+
+void RegisterProber::addEdgeSearch(RegisterAddress::RegisterType type, int origin,
+    int direction, int high)
+{
+    if (high < 2) {
+        return;
+    }
+    EdgeSearch edge;
+    edge.type = type;
+    edge.origin = origin;
+    edge.direction = direction;
+    edge.high = high;
+    mSearches.append(edge);
+    queueEdgeProbe(mSearches.size() - 1);
+}
+
+void RegisterProber::queueEdgeProbe(int search)
+{
+    const EdgeSearch &edge = mSearches.at(search);
+    const int count = (edge.low + edge.high) / 2;
+    const int offset = edge.direction > 0 ? edge.origin : edge.origin - count + 1;
+    const int index = addProbe(edge.type, offset, count);
+    mProbes[index].kind = Kind::Edge;
+    mProbes[index].search = search;
+    mQueue.append(index);
+}
+
+int RegisterProber::nextQueued()
+{
+    while (mQueueHead < mQueue.size()) {
+        const int index = mQueue.at(mQueueHead++);
+        if (isSupported(mProbes.at(index).type)) {
+            return index;
+        }
+        mProbes[index].state = State::Dropped;
+    }
+    // блоки и сетка прочитаны, когда нет ни очереди, ни запросов без ответа
+    if (!mEdgePhase && mPending.isEmpty() && mCurrent < 0) {
+        mEdgePhase = true;
+        if (startGapProbes()) {
+            return nextQueued();
+        }
+    }
+    return -1;
+}
+
+void RegisterProber::dispatch()
+{
+    if (!isTcp()) {
+        const int index = nextQueued();
+        if (index < 0) {
+            finish();
+            return;
+        }
+        sendLineRequest(index);
+        return;
+    }
+
+    QByteArray frames;
+    const qint64 now = mClock.nsecsElapsed();
+    while (mPending.size() < mWindow) {
+        const int index = nextQueued();
+        if (index < 0) {
+            break;
+        }
+        const quint16 transactionId = mNextTransaction++;
+        Probe &probe = mProbes[index];
+        probe.state = State::Sent;
+        probe.sentAt = now;
+        probe.transactionId = transactionId;
+        mPending.insert(transactionId, index);
+        mSent.append(index);
+        ++mReport.requestCount;
+        frames += requestFrame(index, transactionId);
+    }
+    if (!frames.isEmpty()) {
+        mSocket->write(frames);
+    }
+    if (mPending.isEmpty()) {
+        finish();
+        return;
+    }
+    armTcpTimer();
+}
+
+QByteArray RegisterProber::requestFrame(int index, quint16 transactionId) const
+{
+    const bool tcp = isTcp();
+    const Probe &probe = mProbes.at(index);
+    QByteArray frame(tcp ? maxTcpFrameSize : maxRtuFrameSize, Qt::Uninitialized);
+    auto data = reinterpret_cast<quint8 *>(frame.data());
+    const int pduSize = encodeReadRequest(data + (tcp ? tcpPduOffset : rtuPduOffset),
+        readFunction(probe.type), probe.offset, probe.count);
+    frame.resize(tcp ? finishTcpFrame(data, transactionId, mSlave, pduSize)
+                     : finishRtuFrame(data, mSlave, pduSize));
+    return frame;
+}
+
+bool RegisterProber::isTcp() const
+{
+    return mParams.type == ConnectionParams::Type::Tcp;
+}
+
+void RegisterProber::connectToDevice()
+{
+    mSocket = new QTcpSocket(this);
+    connect(mSocket, &QTcpSocket::connected, this, &RegisterProber::onConnected);
+    connect(mSocket, &QTcpSocket::readyRead, this, &RegisterProber::onTcpData);
+    connect(mSocket, &QAbstractSocket::errorOccurred, this, &RegisterProber::onSocketError);
+    mTimer->start(mTimeout);
+    mSocket->connectToHost(mParams.address, mParams.port);
+}
+
+void RegisterProber::onConnected()
+{
+    mSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    dispatch();
+}
+
+void RegisterProber::onSocketError()
+{
+    if (mReport.requestCount == 0) {
+        finish(tr("Не удалось подключиться к %0: %1")
+                   .arg(toString(mParams), mSocket->errorString()));
+        return;
+    }
+    if (++mReconnects > maxReconnects) {
+        finish(tr("%0 разрывает соединение: %1").arg(toString(mParams), mSocket->errorString()));
+        return;
+    }
+    // неотвеченные блоки повторяются после переподключения
+    for (; mSentHead < mSent.size(); ++mSentHead) {
+        const int index = mSent.at(mSentHead);
+        if (mProbes.at(index).state == State::Sent) {
+            mProbes[index].state = State::Queued;
+            mQueue.append(index);
+        }
+    }
+    mPending.clear();
+    mBuffer.clear();
+    mSocket->disconnect(this);
+    mSocket->abort();
+    mSocket->deleteLater();
+    connectToDevice();
+}
+
+void RegisterProber::onTcpData()
+{
+    mBuffer += mSocket->readAll();
+    const auto data = reinterpret_cast<const quint8 *>(mBuffer.constData());
+    int offset = 0;
+    while (mRunning) {
+        ModbusFrame frame;
+        const int length = parseTcpFrame(data + offset, mBuffer.size() - offset, &frame);
+        if (length < 0) {
+            break;
+        }
+        if (length == 0) {
+            ++mReport.badFrames;
+            finish(tr("%0: поток ответов не по протоколу Modbus TCP").arg(toString(mParams)));
+            return;
+        }
+        offset += length;
+        // ответ после таймаута уже не ждут: блок засчитан нечитаемым
+        auto it = mPending.find(frame.transactionId);
+        if (it == mPending.end()) {
+            continue;
+        }
+        const int index = it.value();
+        mPending.erase(it);
+        if (frame.unit != mSlave) {
+            ++mReport.badFrames;
+            onProbeResult(index, -1);
+            continue;
+        }
+        onResponse(index, frame.pdu, frame.pduSize);
+    }
+    if (!mRunning) {
+        return;
+    }
+    mBuffer.remove(0, offset);
+    dispatch();
+}
+
+void RegisterProber::onTcpTimer()
+{
+    if (mSocket->state() != QAbstractSocket::ConnectedState) {
+        finish(tr("%0: нет подключения за %1 мс").arg(toString(mParams)).arg(mTimeout));
+        return;
+    }
+    const qint64 now = mClock.nsecsElapsed();
+    const qint64 timeout = qint64(mTimeout) * 1000000;
+    for (; mRunning && mSentHead < mSent.size(); ++mSentHead) {
+        const int index = mSent.at(mSentHead);
+        const Probe &probe = mProbes.at(index);
+        if (probe.state != State::Sent) {
+            continue;
+        }
+        if (probe.sentAt + timeout > now) {
+            break;
+        }
+        mPending.remove(probe.transactionId);
+        onTimeout(index);
+    }
+    if (mRunning) {
+        dispatch();
+    }
+}
+
+void RegisterProber::armTcpTimer()
+{
+    // запросы отправлены по порядку, ближайший дедлайн - у первого неотвеченного
+    while (mSentHead < mSent.size() && mProbes.at(mSent.at(mSentHead)).state != State::Sent) {
+        ++mSentHead;
+    }
+    if (mSentHead == mSent.size()) {
+        mTimer->stop();
+        return;
+    }
+    const qint64 deadline = mProbes.at(mSent.at(mSentHead)).sentAt + qint64(mTimeout) * 1000000;
+    mTimer->start(milliseconds(qMax<qint64>(0, deadline - mClock.nsecsElapsed())));
+}
+
+void RegisterProber::sendLineRequest(int index)
+{
+    mCurrent = index;
+    mLink->clear();
+    mBuffer.clear();
+    Probe &probe = mProbes[index];
+    probe.state = State::Sent;
+    probe.sentAt = mClock.nsecsElapsed();
+    ++mReport.requestCount;
+    const QString error = mLink->write(requestFrame(index, 0));
+    if (!error.isEmpty()) {
+        finish(error);
+        return;
+    }
+    // запрос и ответ на скорости линии и допустимая задержка устройства
+    const qint64 timeout = qint64(PollCostModel(mParams).requestTime(probe.type, probe.count) * 1e9)
+        + qint64(mResponseDelay) * 1000000;
+    mTimer->start(milliseconds(timeout));
+}
+
+void RegisterProber::onLineData()
+{
+    mBuffer += mLink->readAll();
+    if (mCurrent < 0) {
+        return;
+    }
+    const auto data = reinterpret_cast<const quint8 *>(mBuffer.constData());
+    const int length = rtuResponseLength(data, mBuffer.size());
+    if (length < 0 || mBuffer.size() < length) {
+        // кадр ещё идёт: ожидание продлевается на оставшиеся символы
+        const int remaining = length > 0 ? length - mBuffer.size() : rtuOverhead;
+        mTimer->start(milliseconds(remaining * mCharTime + mSilenceTime));
+        return;
+    }
+    const int index = mCurrent;
+    finishLineRequest();
+    ModbusFrame frame;
+    if (length == 0 || mBuffer.size() > length || !parseRtuFrame(data, length, &frame)
+        || frame.unit != mSlave) {
+        ++mReport.badFrames;
+        onProbeResult(index, -1);
+        return;
+    }
+    onResponse(index, frame.pdu, frame.pduSize);
+}
+
+void RegisterProber::onLineTimer()
+{
+    if (mCurrent < 0) {
+        dispatch();
+        return;
+    }
+    const int index = mCurrent;
+    if (!mBuffer.isEmpty()) {
+        ++mReport.badFrames;
+    }
+    finishLineRequest();
+    onTimeout(index);
+}
+
+void RegisterProber::finishLineRequest()
+{
+    mCurrent = -1;
+    // тот же таймер отсчитывает межкадровую паузу перед следующим запросом
+    mTimer->start(milliseconds(mSilenceTime));
+}
+
+void RegisterProber::onResponse(int index, const quint8 *pdu, int size)
+{
+    const Probe &probe = mProbes.at(index);
+    const quint8 *data = nullptr;
+    const int result = readResponseData(pdu, size, readFunction(probe.type), probe.count, &data);
+    if (result < 0) {
+        ++mReport.badFrames;
+        onProbeResult(index, -1);
+        return;
+    }
+    ++mResponses;
+    if (result == int(ExceptionCode::GatewayPathUnavailable)
+        || result == int(ExceptionCode::GatewayTargetFailed)) {
+        finish(tr("%0: шлюз не получил ответа от слейва %1")
+                   .arg(toString(mParams)).arg(mSlave));
+        return;
+    }
+    if (result > 0) {
+        ++mReport.exceptionCount;
+    }
+    onProbeResult(index, result);
+}
+
+void RegisterProber::onTimeout(int index)
+{
+    ++mReport.timeoutCount;
+    if (mResponses == 0 && mReport.timeoutCount >= maxSilentTimeouts) {
+        finish(tr("%0: слейв %1 не отвечает").arg(toString(mParams)).arg(mSlave));
+        return;
+    }
+    // часть устройств молчит в ответ на чтение несуществующих регистров
+    onProbeResult(index, -1);
+}
+
+void RegisterProber::finish(const QString &error)
+{
+    if (!mRunning) {
+        return;
+    }
+    mRunning = false;
+    release();
+    mReport.error = error;
+    mReport.elapsed = seconds(mClock.nsecsElapsed());
+    if (!error.isEmpty()) {
+        emit finished(mReport);
+        return;
+    }
+
+    // прочитанные блоки, узлы и промежутки и найденные продолжения за их краями
+    QVector<RegisterSpan> spans;
+    auto addSpan = [&spans](RegisterAddress::RegisterType type, int offset, int count) {
+        RegisterSpan span;
+        span.type = type;
+        span.offset = offset;
+        span.count = count;
+        spans.append(span);
+    };
+    for (const auto &probe : mProbes) {
+        if (probe.kind != Kind::Edge && probe.state == State::Ok && isSupported(probe.type)) {
+            addSpan(probe.type, probe.offset, probe.count);
+        }
+    }
+    for (const auto &edge : mSearches) {
+        if (edge.low > 0) {
+            const int offset = edge.direction > 0 ? edge.origin : edge.origin - edge.low + 1;
+            addSpan(edge.type, offset, edge.low);
+        }
+    }
+    std::sort(spans.begin(), spans.end(), [this](const RegisterSpan &l, const RegisterSpan &r) {
+        return l.type != r.type ? mTypes.indexOf(l.type) < mTypes.indexOf(r.type)
+                                : l.offset < r.offset;
+    });
+    for (const auto &span : spans) {
+        if (!mReport.spans.isEmpty()) {
+            auto &last = mReport.spans.last();
+            if (last.type == span.type && last.offset + last.count >= span.offset) {
+                last.count = qMax(last.count, span.offset + span.count - last.offset);
+                continue;
+            }
+        }
+        mReport.spans.append(span);
+    }
+    emit finished(mReport);
+}
+
+void RegisterProber::release()
+{
+    // вызывается из обработчиков сигналов сокета и порта: удаление отложено
+    if (mSocket) {
+        mSocket->disconnect(this);
+        mSocket->abort();
+        mSocket->deleteLater();
+        mSocket = nullptr;
+    }
+    if (mLink) {
+        mLink->disconnect(this);
+        mLink->close();
+        mLink->deleteLater();
+        mLink = nullptr;
+    }
+    if (mTimer) {
+        mTimer->stop();
+        mTimer->deleteLater();
+        mTimer = nullptr;
+    }
+}
+
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "modbusconfigmodel.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QVector>
+
+class QTcpSocket;
+class QTimer;
+
+namespace ModbusConfig {
+
+class SerialLink;
+
+struct RegisterSpan {
+    RegisterAddress::RegisterType type{};
+    // смещение PDU первого регистра
+    int offset{};
+    int count{};
+};
+
+struct RegisterProbeReport {
+    ConnectionParams params;
+    quint8 slaveAddress{};
+    // читаемые диапазоны по возрастанию адреса, соседние диапазоны объединены
+    QVector<RegisterSpan> spans;
+    // участки внутри нечитаемых блоков, где читались только узлы сетки через minSpan:
+    // диапазоны короче minSpan в них не найдены бы, карты для них не создаются
+    QVector<RegisterSpan> uncheckedSpans;
+    int minSpan{};
+    // типы, на чтение которых устройство ответило "функция не поддерживается"
+    QVector<RegisterAddress::RegisterType> unsupportedTypes;
+    int requestCount{};
+    int exceptionCount{};
+    int timeoutCount{};
+    int badFrames{};
+    double elapsed{};
+    // устройство недоступно: порт не открылся, нет подключения или ответов
+    QString error;
+};
+
+// сводка для вывода в консоль и в окно редактора
+QStringList registerProbeReportText(const RegisterProbeReport &report);
+
+// Карты регистров по найденным диапазонам: карта на диапазон, идентификатор - адрес
+// первого регистра, повторное применение обновляет те же карты.
+QVector<SensorsMap> probedSensorMaps(const RegisterProbeReport &report);
+QString applyProbedSensorMaps(ModbusConfigModel *model, const QUuid &devId,
+    const RegisterProbeReport &report);
+
+// Поиск читаемых диапазонов регистров устройства без документации.
+// Адресное пространство каждого типа читается блоками максимального размера. Внутри
+// блока с исключением читаются одиночные регистры через minSpan: любой диапазон не
+// короче minSpan попадает на такой узел. Затем промежутки между читаемыми узлами
+// читаются целиком, а края диапазонов ищутся делением пополам до нечитаемого соседа.
+// Короткие диапазоны между узлами сетки могут быть пропущены; minSpan 1 - полный поиск.
+class RegisterProber : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RegisterProber(QObject *parent = nullptr);
+    ~RegisterProber() override;
+
+    void setTypes(const QVector<RegisterAddress::RegisterType> &types);
+    // смещения PDU, по умолчанию всё допустимое в конфигурации (0..9998)
+    void setRange(int firstOffset, int lastOffset);
+    void setMinSpan(int count);
+    // TCP: запросов в полёте
+    void setWindow(int count);
+    // TCP: ожидание ответа, мс
+    void setTimeout(int msec);
+    // RTU: задержка ответа устройства сверх времени передачи, мс
+    void setResponseDelay(int msec);
+
+    void start(const ConnectionParams &params, quint8 slaveAddress);
+    void abort();
+    bool isRunning() const;
+
+signals:
+    void progress(int requestCount, int readableCount);
+    void finished(const ModbusConfig::RegisterProbeReport &report);
+
+private:
+    enum class Kind {
+        Block,
+        Point,
+        Gap,
+        Edge
+    };
+
+    enum class State {
+        Queued,
+        Sent,
+        Ok,
+        Failed,
+        Dropped
+    };
+
+    struct Probe {
+        RegisterAddress::RegisterType type{};
+        int offset{};
+        int count{};
+        Kind kind{Kind::Block};
+        State state{State::Queued};
+        // только Edge: номер поиска края
+        int search{-1};
+        qint64 sentAt{};
+        quint16 transactionId{};
+    };
+
+    // двоичный поиск длины читаемого продолжения диапазона за его краем
+    struct EdgeSearch {
+        RegisterAddress::RegisterType type{};
+        // первый регистр за краем и направление: 1 - вверх, -1 - вниз
+        int origin{};
+        int direction{};
+        // длина low читается, high - нет
+        int low{};
+        int high{};
+    };
+
+    int addProbe(RegisterAddress::RegisterType type, int offset, int count);
+    void onProbeResult(int index, int result);
+    bool isSupported(RegisterAddress::RegisterType type) const;
+    bool startGapProbes();
+    void addEdgeSearch(RegisterAddress::RegisterType type, int origin, int direction, int high);
+    void queueEdgeProbe(int search);
+    int nextQueued();
+    void dispatch();
+
+    QByteArray requestFrame(int index, quint16 transactionId) const;
+    bool isTcp() const;
+    void connectToDevice();
+    void onConnected();
+    void onSocketError();
+    void onTcpData();
+    void onTcpTimer();
+    void armTcpTimer();
+    void sendLineRequest(int index);
+    void onLineData();
+    void onLineTimer();
+    void finishLineRequest();
+    void onResponse(int index, const quint8 *pdu, int size);
+    void onTimeout(int index);
+    void finish(const QString &error = QString());
+    void release();
+
+private:
+    QVector<RegisterAddress::RegisterType> mTypes;
+    int mFirst{0};
+    int mLast{9998};
+    int mMinSpan{16};
+    int mWindow{4};
+    int mTimeout{1000};
+    int mResponseDelay{20};
+
+    ConnectionParams mParams;
+    quint8 mSlave{};
+    bool mRunning{};
+    bool mEdgePhase{};
+    QTcpSocket *mSocket{};
+    SerialLink *mLink{};
+    QTimer *mTimer{};
+    QElapsedTimer mClock;
+    QByteArray mBuffer;
+
+    QVector<Probe> mProbes;
+    QVector<EdgeSearch> mSearches;
+    QVector<int> mQueue;
+    int mQueueHead{};
+    int mResponses{};
+    int mReadable{};
+    int mReconnects{};
+
+    // TCP: идентификатор транзакции -> блок, блоки в порядке отправки
+    QHash<quint16, int> mPending;
+    QVector<int> mSent;
+    int mSentHead{};
+    quint16 mNextTransaction{};
+
+    // RTU: текущий блок и времена в нс
+    int mCurrent{-1};
+    qint64 mCharTime{};
+    qint64 mSilenceTime{};
+
+    RegisterProbeReport mReport;
+};
+
+}
@@ -0,0 +1,506 @@
+#include "registertrace.h"
+
+#include "modbusconfigmodel.h"
+#include "serializer.h"
+#include "modbusframe.h"
+#include "utils.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+using ModbusConfig::traceChunkSize;
+
+constexpr char traceMagic[8] = {'M', 'B', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr quint32 traceVersion = 1;
+// магия, версия, число блоков, хеш конфигурации, смещение таблицы блоков, размер файла
+constexpr int headerSize = 64;
+constexpr int hashSize = 32;
+// устройство, слейв, тип, число регистров, адрес, число отсчётов, резерв,
+// первая и последняя метки времени, смещения столбца времени и таблицы столбцов
+constexpr int blockEntrySize = 64;
+// чтение упакованных бит словами по 8 байт может заходить за конец последнего куска
+constexpr int tailPadding = 16;
+// кусок слов: база и ширина; кусок времени: база, минимальная разность и ширина
+constexpr int wordChunkHeader = 3;
+constexpr int timeChunkHeader = 17;
+constexpr int maxWordWidth = 16;
+// разности шире maxPackedTimeWidth бит хранятся как есть, по 8 байт
+constexpr int maxPackedTimeWidth = 56;
+constexpr int rawTimeWidth = 64;
+
+template <typename T>
+void put(QByteArray *out, T value)
+{
+    value = qToLittleEndian(value);
+    out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+T get(const uchar *data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+quint64 load64(const uchar *data)
+{
+    quint64 value;
+    std::memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+int bitWidth(quint64 value)
+{
+    int width = 0;
+    for (; value != 0; value >>= 1) {
+        ++width;
+    }
+    return width;
+}
+
+int chunkPayloadSize(int width)
+{
+    return width == rawTimeWidth ? traceChunkSize * 8 : traceChunkSize * width / 8;
+}
+
+// traceChunkSize значений по width бит подряд, младшими битами вперёд
+void packBits(const quint64 *values, int width, QByteArray *out)
+{
+    if (width == rawTimeWidth) {
+        for (int i = 0; i < traceChunkSize; ++i) {
+            put(out, values[i]);
+        }
+        return;
+    }
+    quint64 accumulator = 0;
+    int filled = 0;
+    for (int i = 0; i < traceChunkSize; ++i) {
+        accumulator |= values[i] << filled;
+        filled += width;
+        for (; filled >= 8; filled -= 8) {
+            out->append(char(accumulator));
+            accumulator >>= 8;
+        }
+    }
+}
+
+void encodeWordColumn(const quint16 *words, int stride, int count, QByteArray *out)
+{
+    quint64 zigzag[traceChunkSize];
+    quint16 previous = count > 0 ? words[0] : 0;
+    for (int first = 0; first < count; first += traceChunkSize) {
+        const int size = qMin(traceChunkSize, count - first);
+        put(out, previous);
+        quint64 all = 0;
+        for (int i = 0; i < traceChunkSize; ++i) {
+            if (i < size) {
+                const quint16 value = words[(first + i) * stride];
+                const qint16 delta = qint16(quint16(value - previous));
+                zigzag[i] = quint16((quint16(delta) << 1) ^ quint16(delta >> 15));
+                previous = value;
+            } else {
+                zigzag[i] = 0;
+            }
+            all |= zigzag[i];
+        }
+        const int width = bitWidth(all);
+        out->append(char(width));
+        packBits(zigzag, width, out);
+    }
+}
+
+void encodeTimeColumn(const qint64 *timestamps, int count, QByteArray *out)
+{
+    quint64 packed[traceChunkSize];
+    qint64 previous = count > 0 ? timestamps[0] : 0;
+    for (int first = 0; first < count; first += traceChunkSize) {
+        const int size = qMin(traceChunkSize, count - first);
+        qint64 minDelta = timestamps[first] - previous;
+        for (int i = 1; i < size; ++i) {
+            minDelta = qMin(minDelta, timestamps[first + i] - timestamps[first + i - 1]);
+        }
+        put(out, previous);
+        put(out, minDelta);
+        quint64 all = 0;
+        for (int i = 0; i < traceChunkSize; ++i) {
+            packed[i] = 0;
+            if (i < size) {
+                packed[i] = quint64(timestamps[first + i] - previous - minDelta);
+                previous = timestamps[first + i];
+            }
+            all |= packed[i];
+        }
+        int width = bitWidth(all);
+        if (width > maxPackedTimeWidth) {
+            width = rawTimeWidth;
+        }
+        out->append(char(width));
+        packBits(packed, width, out);
+    }
+}
+
+// разбор куска слов фиксированной ширины: распаковка, zigzag и префиксная сумма за проход
+template <int Width>
+void decodeWords(const uchar *payload, quint16 previous, int count, quint16 *out)
+{
+    if (Width == 0) {
+        std::fill(out, out + count, previous);
+        return;
+    }
+    constexpr quint64 mask = (quint64(1) << Width) - 1;
+    for (int i = 0; i < count; ++i) {
+        const int bit = i * Width;
+        const quint32 zigzag = quint32((load64(payload + (bit >> 3)) >> (bit & 7)) & mask);
+        previous = quint16(previous + ((zigzag >> 1) ^ (0u - (zigzag & 1))));
+        out[i] = previous;
+    }
+}
+
+using WordDecoder = void (*)(const uchar *payload, quint16 previous, int count, quint16 *out);
+
+constexpr WordDecoder wordDecoders[maxWordWidth + 1] = {
+    decodeWords<0>, decodeWords<1>, decodeWords<2>, decodeWords<3>, decodeWords<4>,
+    decodeWords<5>, decodeWords<6>, decodeWords<7>, decodeWords<8>, decodeWords<9>,
+    decodeWords<10>, decodeWords<11>, decodeWords<12>, decodeWords<13>, decodeWords<14>,
+    decodeWords<15>, decodeWords<16>};
+
+QByteArray blockKey(const QUuid &devId, quint8 slaveAddress,
+    ModbusConfig::RegisterAddress::RegisterType type, int firstAddress, int count)
+{
+    QByteArray key = devId.toRfc4122();
+    put(&key, slaveAddress);
+    put(&key, quint8(type));
+    put(&key, qint32(firstAddress));
+    put(&key, qint32(count));
+    return key;
+}
+}
+
+namespace ModbusConfig {
+
+TraceWordCursor::TraceWordCursor(const uchar *data, int sampleCount)
+    : mData(data)
+    , mRemaining(sampleCount)
+{
+}
+
+int TraceWordCursor::next(quint16 *out)
+{
+    if (mRemaining <= 0) {
+        return 0;
+    }
+    const int count = qMin(traceChunkSize, mRemaining);
+    const int width = mData[2];
+    wordDecoders[width](mData + wordChunkHeader, get<quint16>(mData), count, out);
+    mData += wordChunkHeader + chunkPayloadSize(width);
+    mRemaining -= count;
+    return count;
+}
+
+TraceTimeCursor::TraceTimeCursor(const uchar *data, int sampleCount)
+    : mData(data)
+    , mRemaining(sampleCount)
+{
+}
+
+int TraceTimeCursor::next(qint64 *out)
+{
+    if (mRemaining <= 0) {
+        return 0;
+    }
+    const int count = qMin(traceChunkSize, mRemaining);
+    qint64 previous = get<qint64>(mData);
+    const qint64 minDelta = get<qint64>(mData + 8);
+    const int width = mData[16];
+    const uchar *payload = mData + timeChunkHeader;
+    const quint64 mask = width == rawTimeWidth ? ~quint64(0) : (quint64(1) << width) - 1;
+    for (int i = 0; i < count; ++i) {
+        quint64 delta = 0;
+        if (width == rawTimeWidth) {
+            delta = load64(payload + i * 8);
+        } else if (width > 0) {
+            const int bit = i * width;
+            delta = (load64(payload + (bit >> 3)) >> (bit & 7)) & mask;
+        }
+        // в беззнаковых: повреждённые приращения не переполняют qint64
+        previous = qint64(quint64(previous) + quint64(minDelta) + delta);
+        out[i] = previous;
+    }
+    mData += timeChunkHeader + chunkPayloadSize(width);
+    mRemaining -= count;
+    return count;
+}
+
+RegisterTraceRecorder::RegisterTraceRecorder(const ModbusConfigModel &model)
+    : mConfigHash(Serializer::contentHash(model))
+{
+}
+
+void RegisterTraceRecorder::record(const QUuid &devId, quint8 slaveAddress,
+    RegisterAddress::RegisterType type, int firstAddress, int count, const quint8 *data,
+    qint64 timestamp)
+{
+    const QByteArray key = blockKey(devId, slaveAddress, type, firstAddress, count);
+    auto it = mBlockIndices.find(key);
+    if (it == mBlockIndices.end()) {
+        Block block;
+        block.info.devId = devId;
+        block.info.slaveAddress = slaveAddress;
+        block.info.regType = type;
+        block.info.firstAddress = firstAddress;
+        block.info.registerCount = count;
+        block.info.firstTimestamp = timestamp;
+        mBlocks.append(block);
+        it = mBlockIndices.insert(key, mBlocks.size() - 1);
+    }
+    Block &block = mBlocks[it.value()];
+    block.timestamps.append(timestamp);
+    block.info.lastTimestamp = timestamp;
+    ++block.info.sampleCount;
+    const int offset = block.words.size();
+    block.words.resize(offset + count);
+    quint16 *words = block.words.data() + offset;
+    if (isBitRegisterType(type)) {
+        for (int i = 0; i < count; ++i) {
+            words[i] = (data[i / 8] >> (i % 8)) & 1;
+        }
+    } else {
+        for (int i = 0; i < count; ++i) {
+            words[i] = quint16(data[2 * i] << 8 | data[2 * i + 1]);
+        }
+    }
+    mSampleCount += count;
+}
+
+qint64 RegisterTraceRecorder::sampleCount() const
+{
+    return mSampleCount;
+}
+
+void RegisterTraceRecorder::clear()
+{
+    mBlockIndices.clear();
+    mBlocks.clear();
+    mSampleCount = 0;
+}
+
+QString RegisterTraceRecorder::save(const QString &path) const
+{
+    // столбцы кодируются заранее: смещения нужны в таблицах до данных
+    QVector<QByteArray> timeColumns;
+    QVector<QVector<QByteArray>> wordColumns;
+    quint64 offset = headerSize + quint64(mBlocks.size()) * blockEntrySize;
+    for (const auto &block : mBlocks) {
+        offset += quint64(block.info.registerCount) * sizeof(quint64);
+    }
+    QByteArray table;
+    QByteArray columnTables;
+    quint64 columnTableOffset = headerSize + quint64(mBlocks.size()) * blockEntrySize;
+    for (const auto &block : mBlocks) {
+        const auto &info = block.info;
+        QByteArray time;
+        encodeTimeColumn(block.timestamps.constData(), info.sampleCount, &time);
+        table += info.devId.toRfc4122();
+        put(&table, info.slaveAddress);
+        put(&table, quint8(info.regType));
+        put(&table, quint16(info.registerCount));
+        put(&table, qint32(info.firstAddress));
+        put(&table, quint32(info.sampleCount));
+        put(&table, quint32(0));
+        put(&table, info.firstTimestamp);
+        put(&table, info.lastTimestamp);
+        put(&table, offset);
+        put(&table, columnTableOffset);
+        offset += time.size();
+        timeColumns.append(time);
+
+        QVector<QByteArray> columns;
+        for (int reg = 0; reg < info.registerCount; ++reg) {
+            QByteArray column;
+            encodeWordColumn(block.words.constData() + reg, info.registerCount,
+                info.sampleCount, &column);
+            put(&columnTables, offset);
+            offset += column.size();
+            columns.append(column);
+        }
+        columnTableOffset += quint64(info.registerCount) * sizeof(quint64);
+        wordColumns.append(columns);
+    }
+
+    QByteArray header(traceMagic, sizeof(traceMagic));
+    put(&header, traceVersion);
+    put(&header, quint32(mBlocks.size()));
+    header += mConfigHash.leftJustified(hashSize, '\0', true);
+    put(&header, quint64(headerSize));
+    put(&header, quint64(offset + tailPadding));
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return QObject::tr("Не удалось открыть %0: %1").arg(path, file.errorString());
+    }
+    bool ok = file.write(header) == header.size() && file.write(table) == table.size()
+        && file.write(columnTables) == columnTables.size();
+    for (int i = 0; ok && i < mBlocks.size(); ++i) {
+        ok = file.write(timeColumns.at(i)) == timeColumns.at(i).size();
+        for (const auto &column : wordColumns.at(i)) {
+            ok = ok && file.write(column) == column.size();
+        }
+    }
+    ok = ok && file.write(QByteArray(tailPadding, '\0')) == tailPadding;
+    if (!ok) {
+        return QObject::tr("Ошибка записи %0: %1").arg(path, file.errorString());
+    }
+    return {};
+}
+
+RegisterTrace::~RegisterTrace()
+{
+    close();
+}
+
+QString RegisterTrace::open(const QString &path)
+{
+    close();
+    mFile.setFileName(path);
+    if (!mFile.open(QIODevice::ReadOnly)) {
+        return QObject::tr("Не удалось открыть %0: %1").arg(path, mFile.errorString());
+    }
+    mSize = mFile.size();
+    mData = mSize >= headerSize ? mFile.map(0, mSize) : nullptr;
+    QString error = mData ? validate() : QObject::tr("%0 не является записью опроса").arg(path);
+    if (!error.isEmpty()) {
+        close();
+    }
+    return error;
+}
+
+void RegisterTrace::close()
+{
+    if (mData) {
+        mFile.unmap(const_cast<uchar *>(mData));
+        mData = nullptr;
+    }
+    mFile.close();
+    mSize = 0;
+    mConfigHash.clear();
+    mBlocks.clear();
+    mTimeOffsets.clear();
+    mColumnOffsets.clear();
+    mFirstColumns.clear();
+}
+
+bool RegisterTrace::isOpen() const
+{
+    return mData != nullptr;
+}
+
+QByteArray RegisterTrace::configHash() const
+{
+    return mConfigHash;
+}
+
+int RegisterTrace::blockCount() const
+{
+    return mBlocks.size();
+}
+
+const TraceBlock &RegisterTrace::block(int index) const
+{
+    return mBlocks.at(index);
+}
+
+qint64 RegisterTrace::registerSampleCount() const
+{
+    qint64 result = 0;
+    for (const auto &block : mBlocks) {
+        result += qint64(block.sampleCount) * block.registerCount;
+    }
+    return result;
+}
+
+TraceTimeCursor RegisterTrace::timestamps(int block) const
+{
+    return TraceTimeCursor(mData + mTimeOffsets.at(block), mBlocks.at(block).sampleCount);
+}
+
+TraceWordCursor RegisterTrace::registers(int block, int reg) const
+{
+    return TraceWordCursor(mData + mColumnOffsets.at(mFirstColumns.at(block) + reg),
+        mBlocks.at(block).sampleCount);
+}
+
+QString RegisterTrace::validate()
+{
+    const QString corrupted = QObject::tr("%0: запись опроса повреждена").arg(mFile.fileName());
+    if (std::memcmp(mData, traceMagic, sizeof(traceMagic)) != 0
+        || get<quint32>(mData + 8) != traceVersion) {
+        return QObject::tr("%0 не является записью опроса этой версии").arg(mFile.fileName());
+    }
+    const quint32 blockCount = get<quint32>(mData + 12);
+    mConfigHash = QByteArray(reinterpret_cast<const char *>(mData + 16), hashSize);
+    const quint64 tableOffset = get<quint64>(mData + 48);
+    // смещения из файла произвольны: сначала сравнение с пределом, затем вычитание,
+    // чтобы сумма не переполнилась
+    const quint64 size = quint64(mSize);
+    if (get<quint64>(mData + 56) != size || tableOffset > size
+        || quint64(blockCount) * blockEntrySize > size - tableOffset) {
+        return corrupted;
+    }
+
+    // каждый кусок каждого столбца должен лежать в файле: курсоры дальше не проверяют
+    const quint64 dataEnd = size - tailPadding;
+    auto checkColumn = [this, dataEnd](quint64 offset, int samples, int header, int widthAt,
+                           bool time) {
+        for (int i = 0; i < samples; i += traceChunkSize) {
+            if (offset > dataEnd || quint64(header) > dataEnd - offset) {
+                return false;
+            }
+            const int width = mData[offset + widthAt];
+            const bool validWidth = time
+                ? width <= maxPackedTimeWidth || width == rawTimeWidth
+                : width <= maxWordWidth;
+            const quint64 chunkSize = quint64(header) + chunkPayloadSize(width);
+            if (!validWidth || chunkSize > dataEnd - offset) {
+                return false;
+            }
+            offset += chunkSize;
+        }
+        return true;
+    };
+    for (quint32 i = 0; i < blockCount; ++i) {
+        const uchar *entry = mData + tableOffset + quint64(i) * blockEntrySize;
+        TraceBlock block;
+        block.devId = QUuid::fromRfc4122(QByteArray(reinterpret_cast<const char *>(entry), 16));
+        block.slaveAddress = entry[16];
+        block.regType = RegisterAddress::RegisterType(entry[17]);
+        block.registerCount = get<quint16>(entry + 18);
+        block.firstAddress = get<qint32>(entry + 20);
+        block.sampleCount = int(get<quint32>(entry + 24));
+        block.firstTimestamp = get<qint64>(entry + 32);
+        block.lastTimestamp = get<qint64>(entry + 40);
+        const quint64 timeOffset = get<quint64>(entry + 48);
+        const quint64 columnTable = get<quint64>(entry + 56);
+        const bool knownType = entry[17] > quint8(RegisterAddress::RegisterType::Unknown)
+            && entry[17] <= quint8(RegisterAddress::RegisterType::AnalogOutputHoldingRegisters);
+        if (!knownType || block.sampleCount < 0 || pduAddress(block.regType, block.firstAddress) < 0
+            || block.firstTimestamp > block.lastTimestamp || columnTable > dataEnd
+            || quint64(block.registerCount) * sizeof(quint64) > dataEnd - columnTable
+            || !checkColumn(timeOffset, block.sampleCount, timeChunkHeader, 16, true)) {
+            return corrupted;
+        }
+        mFirstColumns.append(mColumnOffsets.size());
+        for (int reg = 0; reg < block.registerCount; ++reg) {
+            const quint64 offset = get<quint64>(mData + columnTable + quint64(reg) * 8);
+            if (!checkColumn(offset, block.sampleCount, wordChunkHeader, 2, false)) {
+                return corrupted;
+            }
+            mColumnOffsets.append(offset);
+        }
+        mTimeOffsets.append(timeOffset);
+        mBlocks.append(block);
+    }
+    return {};
+}
+
+}
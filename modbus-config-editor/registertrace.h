@@ -0,0 +1,129 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QFile>
+#include <QHash>
+#include <QVector>
+
+namespace ModbusConfig {
+
+class ModbusConfigModel;
+
+// Файл записи опроса: для каждого запроса (устройство, слейв, тип, первый регистр,
+// количество) - столбец меток времени и столбец на каждый регистр. Столбцы хранятся
+// кусками по traceChunkSize отсчётов: у куска своя база, разности упакованы
+// минимальным числом бит, так что неизменный регистр занимает 3 байта на кусок.
+// Файл читается через отображение в память, куски разбираются без копирования.
+constexpr int traceChunkSize = 128;
+
+struct TraceBlock {
+    QUuid devId;
+    quint8 slaveAddress{};
+    RegisterAddress::RegisterType regType{};
+    // адрес из конфигурации, как в PollRequest
+    int firstAddress{};
+    int registerCount{};
+    int sampleCount{};
+    // нс, часы записывающей стороны
+    qint64 firstTimestamp{};
+    qint64 lastTimestamp{};
+};
+
+// Последовательное чтение столбца регистра: next разбирает следующий кусок,
+// возвращает число значений (не больше traceChunkSize), 0 - столбец кончился.
+class TraceWordCursor
+{
+public:
+    TraceWordCursor() = default;
+    TraceWordCursor(const uchar *data, int sampleCount);
+
+    int next(quint16 *out);
+
+private:
+    const uchar *mData{};
+    int mRemaining{};
+};
+
+class TraceTimeCursor
+{
+public:
+    TraceTimeCursor() = default;
+    TraceTimeCursor(const uchar *data, int sampleCount);
+
+    int next(qint64 *out);
+
+private:
+    const uchar *mData{};
+    int mRemaining{};
+};
+
+// Запись ответов опроса в памяти с сохранением в файл одним вызовом.
+class RegisterTraceRecorder
+{
+public:
+    // запоминает хеш содержимого конфигурации, по которой идёт опрос
+    explicit RegisterTraceRecorder(const ModbusConfigModel &model);
+
+    // data - данные ответа на чтение, как их отдаёт readResponseData: регистры
+    // старшим байтом вперёд или упакованные биты; timestamp - нс
+    void record(const QUuid &devId, quint8 slaveAddress, RegisterAddress::RegisterType type,
+        int firstAddress, int count, const quint8 *data, qint64 timestamp);
+    qint64 sampleCount() const;
+    void clear();
+
+    QString save(const QString &path) const;
+
+private:
+    struct Block {
+        TraceBlock info;
+        QVector<qint64> timestamps;
+        // по отсчётам: registerCount слов на отсчёт
+        QVector<quint16> words;
+    };
+
+    QByteArray mConfigHash;
+    QHash<QByteArray, int> mBlockIndices;
+    QVector<Block> mBlocks;
+    qint64 mSampleCount{};
+};
+
+// Файл записи, отображённый в память.
+class RegisterTrace
+{
+public:
+    RegisterTrace() = default;
+    ~RegisterTrace();
+    RegisterTrace(const RegisterTrace &) = delete;
+    RegisterTrace &operator=(const RegisterTrace &) = delete;
+
+    QString open(const QString &path);
+    void close();
+    bool isOpen() const;
+
+    // SHA-256 содержимого конфигурации на момент записи
+    QByteArray configHash() const;
+    int blockCount() const;
+    const TraceBlock &block(int index) const;
+    // число значений регистров во всех отсчётах
+    qint64 registerSampleCount() const;
+
+    TraceTimeCursor timestamps(int block) const;
+    TraceWordCursor registers(int block, int reg) const;
+
+private:
+    QString validate();
+
+private:
+    QFile mFile;
+    const uchar *mData{};
+    qint64 mSize{};
+    QByteArray mConfigHash;
+    QVector<TraceBlock> mBlocks;
+    QVector<quint64> mTimeOffsets;
+    // смещения столбцов регистров, блоки подряд
+    QVector<quint64> mColumnOffsets;
+    QVector<int> mFirstColumns;
+};
+
+}
@@ -0,0 +1,313 @@
+#include "scalardecoder.h"
+
+#include "registerdecoder.h"
+
+#include <cstring>
+
+namespace {
+using ValType = ModbusConfig::RegisterAddress::ValType;
+using Function = ModbusConfig::ScalarDecoder::Function;
+
+// все перестановки из 4 элементов в лексикографическом порядке
+constexpr quint8 permutations4[24][4] = {
+    {0, 1, 2, 3}, {0, 1, 3, 2}, {0, 2, 1, 3}, {0, 2, 3, 1}, {0, 3, 1, 2}, {0, 3, 2, 1},
+    {1, 0, 2, 3}, {1, 0, 3, 2}, {1, 2, 0, 3}, {1, 2, 3, 0}, {1, 3, 0, 2}, {1, 3, 2, 0},
+    {2, 0, 1, 3}, {2, 0, 3, 1}, {2, 1, 0, 3}, {2, 1, 3, 0}, {2, 3, 0, 1}, {2, 3, 1, 0},
+    {3, 0, 1, 2}, {3, 0, 2, 1}, {3, 1, 0, 2}, {3, 1, 2, 0}, {3, 2, 0, 1}, {3, 2, 1, 0}
+};
+
+template <int... I>
+struct Indices {};
+
+template <int N, int... I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+template <int... I>
+struct MakeIndices<0, I...> {
+    using Type = Indices<I...>;
+};
+
+// Layout<Size>::wireByte(perm, p) - байт в сети для p-го по старшинству байта значения
+template <int Size>
+struct Layout;
+
+template <>
+struct Layout<2> {
+    static constexpr int count = 2;
+    static constexpr int wireByte(int perm, int p)
+    {
+        return perm == 0 ? p : 1 - p;
+    }
+};
+
+template <>
+struct Layout<4> {
+    static constexpr int count = 24;
+    static constexpr int wireByte(int perm, int p)
+    {
+        return permutations4[perm][p];
+    }
+};
+
+// перестановка регистров и единый для всех регистров порядок байт внутри регистра
+template <>
+struct Layout<8> {
+    static constexpr int count = 48;
+    static constexpr int wireByte(int perm, int p)
+    {
+        return 2 * permutations4[perm / 2][p / 2] + ((p % 2) ^ (perm % 2));
+    }
+};
+
+template <ValType Type>
+struct ValueTraits;
+
+// 8-битные значения и Bool занимают регистр целиком
+template <>
+struct ValueTraits<ValType::Bool> {
+    using Bits = quint16;
+    static double convert(Bits bits) { return bits != 0 ? 1 : 0; }
+};
+
+template <>
+struct ValueTraits<ValType::Int8> {
+    using Bits = quint16;
+    static double convert(Bits bits) { return static_cast<qint8>(bits & 0xff); }
+};
+
+template <>
+struct ValueTraits<ValType::UInt8> {
+    using Bits = quint16;
+    static double convert(Bits bits) { return bits & 0xff; }
+};
+
+template <>
+struct ValueTraits<ValType::Int16> {
+    using Bits = quint16;
+    static double convert(Bits bits) { return static_cast<qint16>(bits); }
+};
+
+template <>
+struct ValueTraits<ValType::UInt16> {
+    using Bits = quint16;
+    static double convert(Bits bits) { return bits; }
+};
+
+template <>
+struct ValueTraits<ValType::Int32> {
+    using Bits = quint32;
+    static double convert(Bits bits) { return static_cast<qint32>(bits); }
+};
+
+template <>
+struct ValueTraits<ValType::UInt32> {
+    using Bits = quint32;
+    static double convert(Bits bits) { return bits; }
+};
+
+template <>
+struct ValueTraits<ValType::Int64> {
+    using Bits = quint64;
+    static double convert(Bits bits) { return static_cast<qint64>(bits); }
+};
+
+template <>
+struct ValueTraits<ValType::UInt64> {
+    using Bits = quint64;
+    static double convert(Bits bits) { return static_cast<double>(bits); }
+};
+
+template <>
+struct ValueTraits<ValType::Float> {
+    using Bits = quint32;
+    static double convert(Bits bits)
+    {
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+template <>
+struct ValueTraits<ValType::Double> {
+    using Bits = quint64;
+    static double convert(Bits bits)
+    {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+template <int Size, int Perm, int P>
+struct WireByte {
+    static constexpr int value = Layout<Size>::wireByte(Perm, P);
+};
+
+// индексы байт - константы времени компиляции, сборка значения сводится к загрузкам и сдвигам
+template <typename Bits, int Perm, int... P>
+Bits gather(const quint8 *raw, Indices<P...>)
+{
+    const quint8 bytes[] = {raw[WireByte<sizeof(Bits), Perm, P>::value]...};
+    Bits bits = 0;
+    for (quint8 byte : bytes) {
+        bits = static_cast<Bits>((bits << 8) | byte);
+    }
+    return bits;
+}
+
+template <ValType Type, int Perm>
+double decodeSpecialized(const quint8 *raw, const quint8 *)
+{
+    using Traits = ValueTraits<Type>;
+    using Bits = typename Traits::Bits;
+    return Traits::convert(
+        gather<Bits, Perm>(raw, typename MakeIndices<sizeof(Bits)>::Type()));
+}
+
+template <ValType Type>
+double decodeGeneric(const quint8 *raw, const quint8 *order)
+{
+    using Traits = ValueTraits<Type>;
+    using Bits = typename Traits::Bits;
+    Bits bits = 0;
+    for (int p = 0; p < int(sizeof(Bits)); ++p) {
+        bits = static_cast<Bits>((bits << 8) | raw[order[p]]);
+    }
+    return Traits::convert(bits);
+}
+
+// битовое поле: order[0] - номер бита в регистре, raw - регистр в порядке big-endian
+double decodeBit(const quint8 *raw, const quint8 *order)
+{
+    const unsigned word = (unsigned(raw[0]) << 8) | raw[1];
+    return (word >> order[0]) & 1u;
+}
+
+template <ValType Type, int... Perm>
+const Function *makeTable(Indices<Perm...>)
+{
+    static const Function table[] = {decodeSpecialized<Type, Perm>...};
+    return table;
+}
+
+template <ValType Type>
+const Function *specializations()
+{
+    constexpr int size = sizeof(typename ValueTraits<Type>::Bits);
+    return makeTable<Type>(typename MakeIndices<Layout<size>::count>::Type());
+}
+
+// индекс специализации для перестановки или -1, если её нет
+int specializationIndex(const quint8 *order, int size)
+{
+    if (size == 2) {
+        return order[0] == 0 ? 0 : 1;
+    }
+    const int words = size / 2;
+    quint8 wordOrder[4];
+    int swap = 0;
+    if (size == 8) {
+        swap = order[0] % 2;
+        for (int w = 0; w < words; ++w) {
+            wordOrder[w] = order[2 * w] / 2;
+            if (order[2 * w] != 2 * wordOrder[w] + swap
+                || order[2 * w + 1] != 2 * wordOrder[w] + (1 - swap)) {
+                return -1;
+            }
+        }
+    } else {
+        std::memcpy(wordOrder, order, 4);
+    }
+    for (int perm = 0; perm < 24; ++perm) {
+        if (std::memcmp(permutations4[perm], wordOrder, 4) == 0) {
+            return size == 8 ? perm * 2 + swap : perm;
+        }
+    }
+    return -1;
+}
+
+template <ValType Type>
+Function select(int index)
+{
+    return index >= 0 ? specializations<Type>()[index] : decodeGeneric<Type>;
+}
+
+}
+
+namespace ModbusConfig {
+
+ScalarDecoder::ScalarDecoder(RegisterAddress::ValType type, const QString &typeOrder)
+{
+    const int size = typeOrderPermutation(type, typeOrder, mOrder);
+    if (size == 0) {
+        return;
+    }
+    const int index = specializationIndex(mOrder, size);
+    mSpecialized = index >= 0;
+    switch (type) {
+    case ValType::Bool:
+        mFunction = select<ValType::Bool>(index);
+        break;
+    case ValType::Int8:
+        mFunction = select<ValType::Int8>(index);
+        break;
+    case ValType::UInt8:
+        mFunction = select<ValType::UInt8>(index);
+        break;
+    case ValType::Int16:
+        mFunction = select<ValType::Int16>(index);
+        break;
+    case ValType::UInt16:
+        mFunction = select<ValType::UInt16>(index);
+        break;
+    case ValType::Int32:
+        mFunction = select<ValType::Int32>(index);
+        break;
+    case ValType::UInt32:
+        mFunction = select<ValType::UInt32>(index);
+        break;
+    case ValType::Int64:
+        mFunction = select<ValType::Int64>(index);
+        break;
+    case ValType::UInt64:
+        mFunction = select<ValType::UInt64>(index);
+        break;
+    case ValType::Float:
+        mFunction = select<ValType::Float>(index);
+        break;
+    case ValType::Double:
+        mFunction = select<ValType::Double>(index);
+        break;
+    case ValType::Unknown:
+        break;
+    }
+}
+
+ScalarDecoder::ScalarDecoder(const RegisterAddress &address) :
+    ScalarDecoder(address.valType, address.typeOrder)
+{
+    if (address.bitOffset < 0 || !isValid()) {
+        return;
+    }
+    if (address.valType != ValType::Bool || address.bitOffset > 15) {
+        mFunction = nullptr;
+        mSpecialized = false;
+        return;
+    }
+    mFunction = decodeBit;
+    mSpecialized = true;
+    mOrder[0] = quint8(address.bitOffset);
+}
+
+bool ScalarDecoder::isValid() const
+{
+    return mFunction != nullptr;
+}
+
+bool ScalarDecoder::isSpecialized() const
+{
+    return mSpecialized;
+}
+
+}
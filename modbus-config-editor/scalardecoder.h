@@ -0,0 +1,35 @@
+#pragma once
+
+#include "modbusentities.h"
+
+namespace ModbusConfig {
+
+// Декодер одного значения отдельного датчика. Функция выбирается один раз из таблицы
+// специализаций по (тип значения, перестановка байт), само декодирование - один
+// косвенный вызов без ветвлений. Для 8-байтных типов специализированы только
+// перестановки, сохраняющие регистры целыми, остальные декодируются общей функцией.
+// Битовые поля (bitOffset >= 0) извлекаются из регистра сдвигом и маской.
+class ScalarDecoder
+{
+public:
+    using Function = double (*)(const quint8 *raw, const quint8 *order);
+
+    ScalarDecoder() = default;
+    ScalarDecoder(RegisterAddress::ValType type, const QString &typeOrder);
+    explicit ScalarDecoder(const RegisterAddress &address);
+
+    bool isValid() const;
+    bool isSpecialized() const;
+
+    double operator()(const quint8 *raw) const
+    {
+        return mFunction(raw, mOrder);
+    }
+
+private:
+    Function mFunction{};
+    bool mSpecialized{};
+    quint8 mOrder[8]{};
+};
+
+}
@@ -3,15 +3,24 @@
 #include "utils.h"
 #include "serializerhelper.h"
 
+#include <QCryptographicHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+
 namespace  {
 constexpr const char * sensorsMapKey = "sensors_map";
 constexpr const char * sensorsKey = "sensors";
 constexpr const char * settingsKey = "settings";
+constexpr const char * pollPlanKey = "poll_plan";
+constexpr const char * hashKey = "hash";
+constexpr const char * devicesKey = "devices";
+// меняется при любом изменении алгоритма планирования, чтобы старые планы не использовались
+constexpr int pollPlanVersion = 1;
 }
 
 namespace ModbusConfig {
 
-QJsonObject Serializer::serialize(const ModbusConfigModel &model)
+QJsonObject Serializer::serialize(const ModbusConfigModel &model, bool withPollPlan)
 {
     QJsonObject root;
 
@@ -29,6 +38,7 @@ QJsonObject Serializer::serialize(const ModbusConfigModel &model)
         SerializerHelper helper(deviceObj);
         helper.setAddress(toString(device.settings.connectionParams));
         helper.setDescription(device.settings.description);
+        helper.setPollSettings(device.settings.pollSettings);
 
         QJsonObject sensorsObj;
         for (auto it = device.sensors.begin(); it != device.sensors.end(); ++it) {
@@ -61,15 +71,24 @@ QJsonObject Serializer::serialize(const ModbusConfigModel &model)
     if (!settingsObj.isEmpty()) {
         root[settingsKey] = settingsObj;
     }
+    if (withPollPlan) {
+        root[pollPlanKey] = pollPlanObject(model, root);
+    }
     return root;
 }
 
-ModbusConfigModel Serializer::deserialize(const QJsonObject &root, QString *error)
+ModbusConfigModel Serializer::deserialize(
+    const QJsonObject &root, QString *error, EmbeddedPollPlan *pollPlanStatus)
 {
     QString fakeError;
     if (!error) {
         error = &fakeError;
     }
+    EmbeddedPollPlan fakePollPlanStatus;
+    if (!pollPlanStatus) {
+        pollPlanStatus = &fakePollPlanStatus;
+    }
+    *pollPlanStatus = EmbeddedPollPlan::Absent;
     ModbusConfigModel result;
 
     Settings settings;
@@ -98,6 +117,10 @@ ModbusConfigModel Serializer::deserialize(const QJsonObject &root, QString *erro
         }
 
         result.upsertDevice(devId, {}, connectionParams, description);
+        *error = result.setDevicePollSettings(devId, helper.pollSettings());
+        if (!error->isEmpty()) {
+            return {};
+        }
 
         auto sensorsMapsObj = deviceObj.value(sensorsMapKey).toObject();
         auto sensorsObj = deviceObj.value(sensorsKey).toObject();
@@ -130,8 +153,89 @@ ModbusConfigModel Serializer::deserialize(const QJsonObject &root, QString *erro
             }
         }
     }
+    *error = result.checkReferencedSensors();
+    if (!error->isEmpty()) {
+        return {};
+    }
+
+    // при несовпадении хэша план будет рассчитан моделью заново
+    const QJsonObject pollPlanObj = root.value(pollPlanKey).toObject();
+    if (!pollPlanObj.isEmpty()) {
+        bool used = pollPlanObj.value(hashKey).toString() == inputsHash(root)
+            && readPollPlan(pollPlanObj, &result);
+        *pollPlanStatus = used ? EmbeddedPollPlan::Used : EmbeddedPollPlan::Outdated;
+    }
+
+    return result;
+}
+
+QByteArray Serializer::contentHash(const ModbusConfigModel &model)
+{
+    const QJsonObject root = Serializer().serialize(model);
+    return QCryptographicHash::hash(QJsonDocument(root).toJson(QJsonDocument::Compact),
+        QCryptographicHash::Sha256);
+}
+
+QString Serializer::inputsHash(const QJsonObject &root)
+{
+    QJsonObject inputs = root;
+    inputs.remove(pollPlanKey);
+    QByteArray data = QByteArray::number(pollPlanVersion);
+    data.append(QJsonDocument(inputs).toJson(QJsonDocument::Compact));
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+}
+
+QJsonObject Serializer::pollPlanObject(const ModbusConfigModel &model, const QJsonObject &root)
+{
+    const auto &plan = model.pollPlan();
+    QJsonObject devicesObj;
+    auto devicesIds = model.devicesIds();
+    for (const auto &devId : qAsConst(devicesIds)) {
+        QJsonArray requestsArray;
+        const auto requests = plan.deviceRequests(devId);
+        for (const auto &request : requests) {
+            QJsonObject requestObj;
+            SerializerHelper helper(requestObj);
+            helper.setPollRequest(request);
+            requestsArray.append(requestObj);
+        }
+        if (!requestsArray.isEmpty()) {
+            devicesObj[toString(devId)] = requestsArray;
+        }
+    }
 
+    QJsonObject result;
+    result[hashKey] = inputsHash(root);
+    result[devicesKey] = devicesObj;
     return result;
 }
 
+bool Serializer::readPollPlan(const QJsonObject &pollPlanObj, ModbusConfigModel *model)
+{
+    QHash<QUuid, QVector<PollRequest>> plan;
+    const QJsonObject devicesObj = pollPlanObj.value(devicesKey).toObject();
+    for (auto it = devicesObj.begin(); it != devicesObj.end(); ++it) {
+        auto devId = toUuid(it.key());
+        if (model->device(devId).settings.id != devId) {
+            return false;
+        }
+        auto &requests = plan[devId];
+        const auto requestsArray = it.value().toArray();
+        for (const auto &value : requestsArray) {
+            const QJsonObject requestObj = value.toObject();
+            SerializerHelper helper(requestObj);
+            QString error;
+            auto request = helper.pollRequest(&error);
+            if (!error.isEmpty()) {
+                return false;
+            }
+            requests.append(request);
+        }
+    }
+    for (auto it = plan.cbegin(); it != plan.cend(); ++it) {
+        model->setPrecomputedPollPlan(it.key(), it.value());
+    }
+    return true;
+}
+
 }
@@ -6,13 +6,27 @@
 
 namespace ModbusConfig {
 
+enum class EmbeddedPollPlan {
+    Absent,
+    Used,
+    Outdated
+};
+
 class Serializer
 {
 public:
     Serializer() = default;
 
-    QJsonObject serialize(const ModbusConfigModel &model);
-    ModbusConfigModel deserialize(const QJsonObject &root, QString *error);
+    QJsonObject serialize(const ModbusConfigModel &model, bool withPollPlan = false);
+    ModbusConfigModel deserialize(const QJsonObject &root, QString *error,
+        EmbeddedPollPlan *pollPlanStatus = nullptr);
+    // SHA-256 сериализованной конфигурации без плана опроса
+    static QByteArray contentHash(const ModbusConfigModel &model);
+
+private:
+    static QString inputsHash(const QJsonObject &root);
+    QJsonObject pollPlanObject(const ModbusConfigModel &model, const QJsonObject &root);
+    bool readPollPlan(const QJsonObject &pollPlanObj, ModbusConfigModel *model);
 };
 
 }
@@ -2,6 +2,8 @@
 
 #include "utils.h"
 
+#include <QJsonArray>
+
 namespace  {
 constexpr const char * descriptionKey = "description";
 constexpr const char * writeRequestTtlKey = "write_request_ttl";
@@ -25,6 +27,17 @@ constexpr const char * mapOffsetKey = "map_offset";
 constexpr const char * slaveAddrKey = "slave_addr";
 constexpr const char * updateTresholdKey = "update_treshold";
 constexpr const char * modeKey = "mode";
+constexpr const char * maxRegisterGapKey = "max_register_gap";
+constexpr const char * maxRequestSizeKey = "max_request_size";
+constexpr const char * countKey = "count";
+constexpr const char * itemsKey = "items";
+constexpr const char * sensorIdKey = "sensor_id";
+constexpr const char * offsetKey = "offset";
+constexpr const char * itemOffsetKey = "item_offset";
+constexpr const char * bitOffsetKey = "bit_offset";
+constexpr const char * aggregateKey = "aggregate";
+constexpr const char * aggregateCountKey = "aggregate_count";
+constexpr const char * virtualKey = "virtual";
 }
 
 namespace ModbusConfig {
@@ -116,6 +129,7 @@ RegisterAddress SerializerHelper::registerAddress(
         return address;
     }
     address.typeOrder = getHelper(valTypeOrderKey).toString();
+    address.bitOffset = getHelper(bitOffsetKey).toInt(-1);
     return address;
 }
 
@@ -128,6 +142,9 @@ void SerializerHelper::setRegisterAddress(RegisterAddressType type, const Regist
     setHelper(getRegAddressKey(type), address.regAddress);
     setHelper(valTypeKey, toString(address.valType));
     setHelper(regTypeKey, toString(address.regType));
+    if (address.bitOffset >= 0) {
+        setHelper(bitOffsetKey, address.bitOffset);
+    }
 }
 
 QString SerializerHelper::upakServerUrl() const
@@ -192,6 +209,24 @@ void SerializerHelper::setDescription(const QString &description)
     setStringHelper(descriptionKey, description);
 }
 
+PollSettings SerializerHelper::pollSettings() const
+{
+    PollSettings result;
+    result.maxRegisterGap = getHelper(maxRegisterGapKey).toInt(-1);
+    result.maxRequestSize = getHelper(maxRequestSizeKey).toInt(-1);
+    return result;
+}
+
+void SerializerHelper::setPollSettings(const PollSettings &settings)
+{
+    if (settings.maxRegisterGap >= 0) {
+        setHelper(maxRegisterGapKey, settings.maxRegisterGap);
+    }
+    if (settings.maxRequestSize > 0) {
+        setHelper(maxRequestSizeKey, settings.maxRequestSize);
+    }
+}
+
 Sensor SerializerHelper::singleSensor(Sensor sensor, QString *errorString) const
 {
     sensor.type = Sensor::Type::Separate;
@@ -226,11 +261,24 @@ Sensor SerializerHelper::sensor(QString *errorString) const
     if (maxVal.isDouble()) {
         result.maxValue = maxVal;
     }
+    if (getHelper(virtualKey).toBool()) {
+        result.type = Sensor::Type::Virtual;
+        return result;
+    }
     if (result.mapId.isEmpty()) {
         return singleSensor(result, errorString);
     }
     result.mapOffset = getHelper(mapOffsetKey).toInt();
     result.type = Sensor::Type::Map;
+    QString aggregation = getStringHelper(aggregateKey);
+    if (aggregation.isEmpty()) {
+        return result;
+    }
+    result.type = Sensor::Type::Aggregate;
+    result.aggregateCount = getHelper(aggregateCountKey).toInt();
+    if (!toAggregation(aggregation, &result.aggregation) && errorString) {
+        *errorString = QObject::tr("Некорректный тип агрегирования '%0'").arg(aggregation);
+    }
     return result;
 }
 
@@ -250,12 +298,20 @@ void SerializerHelper::setSensor(const Sensor &sensor)
     }
     setStringHelper(correctFuncKey, sensor.correctFunction);
     setStringHelper(modeKey, toString(sensor.mode));
+    if (sensor.type == Sensor::Type::Virtual) {
+        setHelper(virtualKey, true);
+        return;
+    }
     if (sensor.type == Sensor::Type::Separate) {
         setSingleSensor(sensor);
         return;
     }
     setStringHelper(mapIdKey, sensor.mapId);
     setHelper(mapOffsetKey, sensor.mapOffset);
+    if (sensor.type == Sensor::Type::Aggregate) {
+        setStringHelper(aggregateKey, toString(sensor.aggregation));
+        setHelper(aggregateCountKey, sensor.aggregateCount);
+    }
 }
 
 SensorsMap SerializerHelper::sensorMap(QString *errorString) const
@@ -284,6 +340,76 @@ void SerializerHelper::setSensorMap(const SensorsMap &sensorMap)
     }
 }
 
+PollRequest SerializerHelper::pollRequest(QString *errorString) const
+{
+    QString fakeErrorString;
+    if (!errorString) {
+        errorString = &fakeErrorString;
+    }
+    PollRequest result;
+    int slaveAddress = getHelper(slaveAddrKey).toInt(-1);
+    if (slaveAddress < 0 || slaveAddress > 255) {
+        *errorString = QObject::tr("Адрес слейва должен быть в диапазоне от 0 до 255 включительно");
+        return result;
+    }
+    result.slaveAddress = static_cast<quint8>(slaveAddress);
+    result.regType = toRegisterType(getHelper(regTypeKey).toString());
+    result.startAddress = getHelper(startRegAddressKey).toInt(-1);
+    result.count = getHelper(countKey).toInt();
+    *errorString = checkRegisterAddress(result.regType, result.startAddress);
+    if (!errorString->isEmpty()) {
+        return result;
+    }
+
+    const auto items = getHelper(itemsKey).toArray();
+    result.items.reserve(items.size());
+    for (const auto &value : items) {
+        const auto itemObj = value.toObject();
+        PollItem item;
+        if (itemObj.contains(sensorIdKey)) {
+            item.type = PollItem::Type::Sensor;
+            item.sensorId = toUuid(itemObj.value(sensorIdKey).toString());
+        } else {
+            item.type = PollItem::Type::Map;
+            item.mapId = itemObj.value(mapIdKey).toString();
+        }
+        item.requestOffset = itemObj.value(offsetKey).toInt(-1);
+        item.itemOffset = itemObj.value(itemOffsetKey).toInt();
+        item.count = itemObj.value(countKey).toInt();
+        if (item.requestOffset < 0 || item.requestOffset + item.count > result.count) {
+            *errorString = QObject::tr("Элемент плана опроса выходит за границы запроса");
+            return result;
+        }
+        result.items.append(item);
+    }
+    return result;
+}
+
+void SerializerHelper::setPollRequest(const PollRequest &request)
+{
+    setHelper(slaveAddrKey, request.slaveAddress);
+    setHelper(regTypeKey, toString(request.regType));
+    setHelper(startRegAddressKey, request.startAddress);
+    setHelper(countKey, request.count);
+
+    QJsonArray items;
+    for (const auto &item : request.items) {
+        QJsonObject itemObj;
+        if (item.type == PollItem::Type::Sensor) {
+            itemObj[sensorIdKey] = toString(item.sensorId);
+        } else {
+            itemObj[mapIdKey] = item.mapId;
+        }
+        itemObj[offsetKey] = item.requestOffset;
+        if (item.itemOffset != 0) {
+            itemObj[itemOffsetKey] = item.itemOffset;
+        }
+        itemObj[countKey] = item.count;
+        items.append(itemObj);
+    }
+    setHelper(itemsKey, items);
+}
+
 QJsonValue SerializerHelper::getHelper(const QString &key) const
 {
     if (mObj) {
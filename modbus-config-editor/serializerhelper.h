@@ -4,6 +4,7 @@
 #include <QUuid>
 
 #include "modbusentities.h"
+#include "pollplanner.h"
 
 namespace ModbusConfig {
 
@@ -40,12 +41,18 @@ public:
     QString description() const;
     void setDescription(const QString &description);
 
+    PollSettings pollSettings() const;
+    void setPollSettings(const PollSettings &settings);
+
     Sensor sensor(QString *errorString = nullptr) const;
     void setSensor(const Sensor &sensor);
 
     SensorsMap sensorMap(QString *errorString = nullptr) const;
     void setSensorMap(const SensorsMap &sensorMap);
 
+    PollRequest pollRequest(QString *errorString = nullptr) const;
+    void setPollRequest(const PollRequest &request);
+
 
 private:
     QJsonValue getHelper(const QString &key) const;
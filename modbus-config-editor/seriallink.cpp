@@ -0,0 +1,226 @@
+#include "seriallink.h"
+
+#include <QFile>
+#include <QSocketNotifier>
+
+#if defined(Q_OS_UNIX)
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#if defined(Q_OS_UNIX)
+speed_t speedConstant(quint32 baudrate)
+{
+    switch (baudrate) {
+    case 1200: return B1200;
+    case 2400: return B2400;
+    case 4800: return B4800;
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#if defined(B460800)
+    case 460800: return B460800;
+#endif
+#if defined(B921600)
+    case 921600: return B921600;
+#endif
+    default:
+        break;
+    }
+    return B0;
+}
+
+QString systemError()
+{
+    return QString::fromLocal8Bit(std::strerror(errno));
+}
+
+QString configure(int fd, const ModbusConfig::ConnectionParams &params)
+{
+    using ModbusConfig::ConnectionParams;
+    termios tio{};
+    if (::tcgetattr(fd, &tio) != 0) {
+        return systemError();
+    }
+    ::cfmakeraw(&tio);
+    const speed_t speed = speedConstant(params.baudrate);
+    if (speed == B0) {
+        return QObject::tr("неподдерживаемая скорость %0").arg(params.baudrate);
+    }
+    ::cfsetispeed(&tio, speed);
+    ::cfsetospeed(&tio, speed);
+
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~CSIZE;
+    switch (params.databits) {
+    case 5: tio.c_cflag |= CS5; break;
+    case 6: tio.c_cflag |= CS6; break;
+    case 7: tio.c_cflag |= CS7; break;
+    default: tio.c_cflag |= CS8; break;
+    }
+
+    tio.c_cflag &= ~(PARENB | PARODD);
+    switch (params.parity) {
+    case ConnectionParams::Parity::EvenParity:
+        tio.c_cflag |= PARENB;
+        break;
+    case ConnectionParams::Parity::OddParity:
+        tio.c_cflag |= PARENB | PARODD;
+        break;
+    case ConnectionParams::Parity::SpaceParity:
+    case ConnectionParams::Parity::MarkParity:
+#if defined(CMSPAR)
+        tio.c_cflag |= PARENB | CMSPAR;
+        if (params.parity == ConnectionParams::Parity::MarkParity) {
+            tio.c_cflag |= PARODD;
+        }
+        break;
+#else
+        return QObject::tr("чётность space / mark не поддерживается");
+#endif
+    default:
+        break;
+    }
+
+    // полтора стоп-бита termios не умеет, ближайшее - два
+    if (params.stopBits == ConnectionParams::StopBits::OneStop) {
+        tio.c_cflag &= ~CSTOPB;
+    } else {
+        tio.c_cflag |= CSTOPB;
+    }
+
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    if (params.flowControl == ConnectionParams::FlowControl::HardwareControl) {
+        tio.c_cflag |= CRTSCTS;
+    } else if (params.flowControl == ConnectionParams::FlowControl::SoftwareControl) {
+        tio.c_iflag |= IXON | IXOFF;
+    }
+
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if (::tcsetattr(fd, TCSANOW, &tio) != 0) {
+        return systemError();
+    }
+    ::tcflush(fd, TCIOFLUSH);
+    return {};
+}
+#endif
+}
+
+namespace ModbusConfig {
+
+SerialLink::SerialLink(QObject *parent)
+    : QObject(parent)
+{
+}
+
+SerialLink::~SerialLink()
+{
+    close();
+}
+
+QString SerialLink::open(const ConnectionParams &params)
+{
+    close();
+#if defined(Q_OS_UNIX)
+    const QByteArray path = QFile::encodeName(params.deviceName);
+    mFd = ::open(path.constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (mFd < 0) {
+        return tr("Не удалось открыть %0: %1").arg(params.deviceName, systemError());
+    }
+    const QString error = configure(mFd, params);
+    if (!error.isEmpty()) {
+        close();
+        return tr("Не удалось настроить %0: %1").arg(params.deviceName, error);
+    }
+    mNotifier = new QSocketNotifier(mFd, QSocketNotifier::Read, this);
+    connect(mNotifier, &QSocketNotifier::activated, this, &SerialLink::readyRead);
+    return {};
+#else
+    return tr("Последовательный порт %0: поддерживается только в Unix").arg(params.deviceName);
+#endif
+}
+
+void SerialLink::close()
+{
+    delete mNotifier;
+    mNotifier = nullptr;
+#if defined(Q_OS_UNIX)
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
+#endif
+    mFd = -1;
+}
+
+bool SerialLink::isOpen() const
+{
+    return mFd >= 0;
+}
+
+void SerialLink::clear()
+{
+#if defined(Q_OS_UNIX)
+    if (mFd >= 0) {
+        ::tcflush(mFd, TCIFLUSH);
+    }
+#endif
+}
+
+QString SerialLink::write(const QByteArray &data)
+{
+#if defined(Q_OS_UNIX)
+    int written = 0;
+    while (mFd >= 0 && written < data.size()) {
+        const ssize_t result = ::write(mFd, data.constData() + written, size_t(data.size() - written));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            // кадр не больше 256 байт, переполненный буфер передачи - уже ошибка линии
+            return tr("Ошибка записи в последовательный порт: %0").arg(systemError());
+        }
+        written += int(result);
+    }
+    if (written == data.size()) {
+        return {};
+    }
+#else
+    Q_UNUSED(data)
+#endif
+    return tr("Последовательный порт не открыт");
+}
+
+QByteArray SerialLink::readAll()
+{
+    QByteArray result;
+#if defined(Q_OS_UNIX)
+    char buffer[512];
+    while (mFd >= 0) {
+        const ssize_t size = ::read(mFd, buffer, sizeof(buffer));
+        if (size > 0) {
+            result.append(buffer, int(size));
+            continue;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK && mNotifier) {
+            // другая сторона закрыта (EIO у псевдотерминала): иначе уведомления пойдут без конца
+            mNotifier->setEnabled(false);
+        }
+        break;
+    }
+#endif
+    return result;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QObject>
+
+class QSocketNotifier;
+
+namespace ModbusConfig {
+
+// Последовательный порт без модуля serialport: дескриптор termios и QSocketNotifier
+// в цикле событий Qt. Поддерживается только в Unix.
+class SerialLink : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SerialLink(QObject *parent = nullptr);
+    ~SerialLink() override;
+
+    QString open(const ConnectionParams &params);
+    void close();
+    bool isOpen() const;
+
+    // отбрасывает принятое, но не прочитанное (остатки прошлых ответов)
+    void clear();
+    QString write(const QByteArray &data);
+    QByteArray readAll();
+
+signals:
+    void readyRead();
+
+private:
+    int mFd{-1};
+    QSocketNotifier *mNotifier{};
+};
+
+}
@@ -0,0 +1,477 @@
+#include "slavediscovery.h"
+
+#include "modbusframe.h"
+#include "pollplanner.h"
+#include "seriallink.h"
+#include "utils.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace {
+// адрес 0 - широковещательный, 248-255 зарезервированы
+constexpr int maxSlaveAddress = 247;
+constexpr int maxReconnects = 3;
+
+double seconds(qint64 ns)
+{
+    return ns / 1e9;
+}
+
+int milliseconds(qint64 ns)
+{
+    return qMax(1, int((ns + 999999) / 1000000));
+}
+}
+
+namespace ModbusConfig {
+
+QStringList slaveDiscoveryReportText(const SlaveDiscoveryReport &report)
+{
+    QStringList lines;
+    if (!report.error.isEmpty()) {
+        lines << report.error;
+        return lines;
+    }
+    lines << QObject::tr("%0: найдено слейвов: %1, запросов: %2, время поиска: %3 с")
+                 .arg(toString(report.params))
+                 .arg(report.slaves.size())
+                 .arg(report.requestCount)
+                 .arg(report.elapsed, 0, 'f', 2);
+    if (report.badFrames > 0) {
+        lines << QObject::tr("Испорченных ответов: %0").arg(report.badFrames);
+    }
+    for (const auto &slave : report.slaves) {
+        QString line = QObject::tr("    слейв %0: %1 мс")
+                           .arg(slave.slaveAddress)
+                           .arg(slave.latency * 1000, 0, 'f', 1);
+        if (slave.exception != 0) {
+            line += QObject::tr(", исключение %0").arg(slave.exception);
+        }
+        lines << line;
+    }
+    return lines;
+}
+
+QVector<Device> discoveredDevices(const SlaveDiscoveryReport &report)
+{
+    const bool bits = isBitRegisterType(report.probeType);
+    QVector<Device> devices;
+    for (const auto &slave : report.slaves) {
+        Device device;
+        device.settings.id = QUuid::createUuid();
+        device.settings.description = QObject::tr("Слейв %0").arg(slave.slaveAddress);
+        device.settings.connectionParams = report.params;
+
+        SensorsMap map;
+        map.id = QString("slave_%0").arg(slave.slaveAddress);
+        map.defaultValue = 0;
+        map.valueCount = 1;
+        map.registеrAddress.slaveAddress = slave.slaveAddress;
+        map.registеrAddress.regAddress = report.probeAddress;
+        map.registеrAddress.regType = report.probeType;
+        map.registеrAddress.valType =
+            bits ? RegisterAddress::ValType::Bool : RegisterAddress::ValType::UInt16;
+        map.registеrAddress.typeOrder = bits ? QString() : QString("21");
+        device.maps.insert(map.id, map);
+        devices.append(device);
+    }
+    return devices;
+}
+
+SlaveDiscovery::SlaveDiscovery(QObject *parent)
+    : QObject(parent)
+{
+}
+
+SlaveDiscovery::~SlaveDiscovery()
+{
+    abort();
+}
+
+void SlaveDiscovery::setRange(int first, int last)
+{
+    mFirst = qBound(1, first, maxSlaveAddress);
+    mLast = qBound(mFirst, last, maxSlaveAddress);
+}
+
+void SlaveDiscovery::setProbeRegister(RegisterAddress::RegisterType type, int address)
+{
+    mProbeType = type;
+    mProbeAddress = address;
+}
+
+void SlaveDiscovery::setWindow(int count)
+{
+    mWindow = qMax(1, count);
+}
+
+void SlaveDiscovery::setTimeout(int msec)
+{
+    mTimeout = qMax(1, msec);
+}
+
+void SlaveDiscovery::setResponseDelay(int msec)
+{
+    mResponseDelay = qMax(0, msec);
+}
+
+void SlaveDiscovery::start(const ConnectionParams &params)
+{
+    abort();
+    mParams = params;
+    mReport = SlaveDiscoveryReport();
+    mReport.params = params;
+    mReport.probeType = mProbeType;
+    mReport.probeAddress = mProbeAddress;
+    mStates.fill(State::Queued, maxSlaveAddress + 1);
+    mSentAt.fill(-1, maxSlaveAddress + 1);
+    mSent.clear();
+    mSentHead = 0;
+    mRetry.clear();
+    mNext = mFirst;
+    mInFlight = 0;
+    mDone = 0;
+    mReconnects = 0;
+    mCurrent = -1;
+    mBuffer.clear();
+
+    mRunning = true;
+    mClock.start();
+    mTimer = new QTimer(this);
+    mTimer->setSingleShot(true);
+    if (isTcp()) {
+        connect(mTimer, &QTimer::timeout, this, &SlaveDiscovery::onTcpTimer);
+        connectToGateway();
+        return;
+    }
+
+    mLink = new SerialLink(this);
+    const QString error = mLink->open(params);
+    if (!error.isEmpty()) {
+        finish(error);
+        return;
+    }
+    PollCostModel cost(params);
+    mCharTime = qint64(cost.charTime() * 1e9);
+    mSilenceTime = qint64(cost.silenceTime() * 1e9);
+    // запрос, пауза, ответ на скорости линии и допустимая задержка устройства
+    mFrameTimeout = qint64(cost.requestTime(mProbeType, 1) * 1e9)
+        + qint64(mResponseDelay) * 1000000;
+    connect(mLink, &SerialLink::readyRead, this, &SlaveDiscovery::onLineData);
+    connect(mTimer, &QTimer::timeout, this, &SlaveDiscovery::onLineTimer);
+    sendLineRequest();
+}
+
+void SlaveDiscovery::abort()
+{
+    if (!mRunning) {
+        return;
+    }
+    mRunning = false;
+    release();
+}
+
+bool SlaveDiscovery::isRunning() const
+{
+    return mRunning;
+}
+
+QByteArray SlaveDiscovery::requestFrame(int slave) const
+{
+    const bool tcp = isTcp();
+    QByteArray frame(tcp ? maxTcpFrameSize : maxRtuFrameSize, Qt::Uninitialized);
+    auto data = reinterpret_cast<quint8 *>(frame.data());
+    const int pduSize = encodeReadRequest(data + (tcp ? tcpPduOffset : rtuPduOffset),
+        readFunction(mProbeType), pduAddress(mProbeType, mProbeAddress), 1);
+    // идентификатор транзакции - адрес слейва: опоздавший ответ не спутать с другим
+    frame.resize(tcp ? finishTcpFrame(data, quint16(slave), quint8(slave), pduSize)
+                     : finishRtuFrame(data, quint8(slave), pduSize));
+    return frame;
+}
+
+bool SlaveDiscovery::isTcp() const
+{
+    return mParams.type == ConnectionParams::Type::Tcp;
+}
+
+void SlaveDiscovery::connectToGateway()
+{
+    mSocket = new QTcpSocket(this);
+    connect(mSocket, &QTcpSocket::connected, this, &SlaveDiscovery::onConnected);
+    connect(mSocket, &QTcpSocket::readyRead, this, &SlaveDiscovery::onTcpData);
+    connect(mSocket, &QAbstractSocket::errorOccurred, this, &SlaveDiscovery::onSocketError);
+    mTimer->start(mTimeout);
+    mSocket->connectToHost(mParams.address, mParams.port);
+}
+
+void SlaveDiscovery::onConnected()
+{
+    mSocket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    fillWindow();
+}
+
+void SlaveDiscovery::onSocketError()
+{
+    if (mReport.requestCount == 0) {
+        finish(tr("Не удалось подключиться к %0: %1")
+                   .arg(toString(mParams), mSocket->errorString()));
+        return;
+    }
+    if (++mReconnects > maxReconnects) {
+        finish(tr("%0 разрывает соединение: %1").arg(toString(mParams), mSocket->errorString()));
+        return;
+    }
+    // шлюз закрыл соединение: неотвеченные запросы повторяются после переподключения
+    for (; mSentHead < mSent.size(); ++mSentHead) {
+        const int slave = mSent.at(mSentHead);
+        if (mStates.at(slave) == State::Sent) {
+            mStates[slave] = State::Queued;
+            mRetry.append(slave);
+        }
+    }
+    mInFlight = 0;
+    mBuffer.clear();
+    mSocket->disconnect(this);
+    mSocket->abort();
+    mSocket->deleteLater();
+    connectToGateway();
+}
+
+void SlaveDiscovery::onTcpData()
+{
+    mBuffer += mSocket->readAll();
+    const auto data = reinterpret_cast<const quint8 *>(mBuffer.constData());
+    int offset = 0;
+    while (true) {
+        ModbusFrame frame;
+        const int length = parseTcpFrame(data + offset, mBuffer.size() - offset, &frame);
+        if (length < 0) {
+            break;
+        }
+        if (length == 0) {
+            ++mReport.badFrames;
+            finish(tr("%0: поток ответов не по протоколу Modbus TCP").arg(toString(mParams)));
+            return;
+        }
+        offset += length;
+        const int slave = frame.transactionId;
+        if (slave < mFirst || slave > mLast || frame.unit != slave
+            || (mStates.at(slave) != State::Sent && mStates.at(slave) != State::TimedOut)) {
+            ++mReport.badFrames;
+            continue;
+        }
+        // ответ после таймаута тоже засчитывается: шлюз мог долго ждать свою линию
+        if (mStates.at(slave) == State::Sent) {
+            --mInFlight;
+            markDone();
+        }
+        mStates[slave] = State::Done;
+        onResponse(slave, frame.pdu, frame.pduSize);
+    }
+    mBuffer.remove(0, offset);
+    fillWindow();
+}
+
+void SlaveDiscovery::fillWindow()
+{
+    QByteArray frames;
+    const qint64 now = mClock.nsecsElapsed();
+    while (mInFlight < mWindow) {
+        int slave = -1;
+        if (!mRetry.isEmpty()) {
+            slave = mRetry.takeFirst();
+        } else if (mNext <= mLast) {
+            slave = mNext++;
+        } else {
+            break;
+        }
+        frames += requestFrame(slave);
+        mStates[slave] = State::Sent;
+        mSentAt[slave] = now;
+        mSent.append(slave);
+        ++mInFlight;
+        ++mReport.requestCount;
+    }
+    if (!frames.isEmpty()) {
+        // окно запросов уходит одной записью
+        mSocket->write(frames);
+    }
+    if (mInFlight == 0) {
+        finish();
+        return;
+    }
+    armTcpTimer();
+}
+
+void SlaveDiscovery::onTcpTimer()
+{
+    if (mSocket->state() != QAbstractSocket::ConnectedState) {
+        finish(tr("%0: нет подключения за %1 мс").arg(toString(mParams)).arg(mTimeout));
+        return;
+    }
+    const qint64 now = mClock.nsecsElapsed();
+    const qint64 timeout = qint64(mTimeout) * 1000000;
+    for (; mSentHead < mSent.size(); ++mSentHead) {
+        const int slave = mSent.at(mSentHead);
+        if (mStates.at(slave) != State::Sent) {
+            continue;
+        }
+        if (mSentAt.at(slave) + timeout > now) {
+            break;
+        }
+        mStates[slave] = State::TimedOut;
+        --mInFlight;
+        markDone();
+    }
+    fillWindow();
+}
+
+void SlaveDiscovery::armTcpTimer()
+{
+    // запросы отправлены по порядку, ближайший дедлайн - у первого неотвеченного
+    while (mSentHead < mSent.size() && mStates.at(mSent.at(mSentHead)) != State::Sent) {
+        ++mSentHead;
+    }
+    if (mSentHead == mSent.size()) {
+        mTimer->stop();
+        return;
+    }
+    const qint64 deadline = mSentAt.at(mSent.at(mSentHead)) + qint64(mTimeout) * 1000000;
+    mTimer->start(milliseconds(qMax<qint64>(0, deadline - mClock.nsecsElapsed())));
+}
+
+void SlaveDiscovery::sendLineRequest()
+{
+    if (mNext > mLast) {
+        finish();
+        return;
+    }
+    mCurrent = mNext++;
+    mLink->clear();
+    mBuffer.clear();
+    mStates[mCurrent] = State::Sent;
+    mSentAt[mCurrent] = mClock.nsecsElapsed();
+    ++mReport.requestCount;
+    const QString error = mLink->write(requestFrame(mCurrent));
+    if (!error.isEmpty()) {
+        finish(error);
+        return;
+    }
+    mTimer->start(milliseconds(mFrameTimeout));
+}
+
+void SlaveDiscovery::onLineData()
+{
+    mBuffer += mLink->readAll();
+    if (mCurrent < 0 || mStates.at(mCurrent) != State::Sent) {
+        return;
+    }
+    const auto data = reinterpret_cast<const quint8 *>(mBuffer.constData());
+    const int length = rtuResponseLength(data, mBuffer.size());
+    if (length < 0 || mBuffer.size() < length) {
+        // кадр ещё идёт: ожидание продлевается на оставшиеся символы
+        const int remaining = length > 0 ? length - mBuffer.size() : rtuOverhead;
+        mTimer->start(milliseconds(remaining * mCharTime + mSilenceTime));
+        return;
+    }
+    ModbusFrame frame;
+    if (length == 0 || mBuffer.size() > length || !parseRtuFrame(data, length, &frame)
+        || frame.unit != mCurrent) {
+        // коллизия или помеха: слейв не засчитывается
+        ++mReport.badFrames;
+    } else {
+        onResponse(mCurrent, frame.pdu, frame.pduSize);
+    }
+    mStates[mCurrent] = State::Done;
+    finishLineRequest();
+}
+
+void SlaveDiscovery::onLineTimer()
+{
+    if (mCurrent >= 0 && mStates.at(mCurrent) == State::Sent) {
+        if (!mBuffer.isEmpty()) {
+            ++mReport.badFrames;
+        }
+        mStates[mCurrent] = State::TimedOut;
+        finishLineRequest();
+        return;
+    }
+    sendLineRequest();
+}
+
+void SlaveDiscovery::finishLineRequest()
+{
+    markDone();
+    // тот же таймер отсчитывает межкадровую паузу перед следующим адресом
+    if (mRunning) {
+        mTimer->start(milliseconds(mSilenceTime));
+    }
+}
+
+void SlaveDiscovery::onResponse(int slave, const quint8 *pdu, int size)
+{
+    const quint8 *data = nullptr;
+    const int result = readResponseData(pdu, size, readFunction(mProbeType), 1, &data);
+    if (result < 0) {
+        ++mReport.badFrames;
+        return;
+    }
+    if (result == int(ExceptionCode::GatewayPathUnavailable)
+        || result == int(ExceptionCode::GatewayTargetFailed)) {
+        return;
+    }
+    DiscoveredSlave found;
+    found.slaveAddress = quint8(slave);
+    found.latency = seconds(mClock.nsecsElapsed() - mSentAt.at(slave));
+    found.exception = result;
+    mReport.slaves.append(found);
+}
+
+void SlaveDiscovery::markDone()
+{
+    ++mDone;
+    emit progress(mDone, mLast - mFirst + 1);
+}
+
+void SlaveDiscovery::finish(const QString &error)
+{
+    if (!mRunning) {
+        return;
+    }
+    mRunning = false;
+    release();
+    mReport.error = error;
+    mReport.elapsed = seconds(mClock.nsecsElapsed());
+    std::sort(mReport.slaves.begin(), mReport.slaves.end(),
+        [](const DiscoveredSlave &l, const DiscoveredSlave &r) {
+            return l.slaveAddress < r.slaveAddress;
+        });
+    emit finished(mReport);
+}
+
+void SlaveDiscovery::release()
+{
+    // вызывается из обработчиков сигналов сокета и порта: удаление отложено
+    if (mSocket) {
+        mSocket->disconnect(this);
+        mSocket->abort();
+        mSocket->deleteLater();
+        mSocket = nullptr;
+    }
+    if (mLink) {
+        mLink->disconnect(this);
+        mLink->close();
+        mLink->deleteLater();
+        mLink = nullptr;
+    }
+    if (mTimer) {
+        mTimer->stop();
+        mTimer->deleteLater();
+        mTimer = nullptr;
+    }
+}
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVector>
+
+class QTcpSocket;
+class QTimer;
+
+namespace ModbusConfig {
+
+class SerialLink;
+
+struct DiscoveredSlave {
+    quint8 slaveAddress{};
+    // в секундах
+    double latency{};
+    // 0 - слейв вернул данные, иначе код исключения: слейв есть, но регистр ему неизвестен
+    int exception{};
+};
+
+struct SlaveDiscoveryReport {
+    ConnectionParams params;
+    RegisterAddress::RegisterType probeType{
+        RegisterAddress::RegisterType::AnalogOutputHoldingRegisters};
+    int probeAddress{};
+    QVector<DiscoveredSlave> slaves;
+    int requestCount{};
+    // ответы с неверной CRC, чужим адресом или не по протоколу
+    int badFrames{};
+    double elapsed{};
+    // линия недоступна: порт не открылся или шлюз не принял соединение
+    QString error;
+};
+
+// сводка для вывода в консоль и в окно редактора
+QStringList slaveDiscoveryReportText(const SlaveDiscoveryReport &report);
+
+// Устройства для найденных слейвов: адрес слейва хранится только в регистрах,
+// поэтому у каждого устройства одна карта из регистра, прочитанного при поиске.
+QVector<Device> discoveredDevices(const SlaveDiscoveryReport &report);
+
+// Поиск слейвов на линии: каждому адресу из диапазона одно чтение регистра.
+// Через шлюз TCP запросы идут по одному соединению окном из нескольких транзакций,
+// ответ "шлюз не достучался" (0x0A, 0x0B) означает отсутствие слейва.
+// На RTU запросы последовательные, таймаут - время передачи кадров на скорости
+// линии плюс допустимая задержка ответа устройства.
+class SlaveDiscovery : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SlaveDiscovery(QObject *parent = nullptr);
+    ~SlaveDiscovery() override;
+
+    void setRange(int first, int last);
+    // адрес из конфигурации, например 40001
+    void setProbeRegister(RegisterAddress::RegisterType type, int address);
+    void setWindow(int count);
+    // TCP: ожидание ответа, мс
+    void setTimeout(int msec);
+    // RTU: задержка ответа устройства сверх времени передачи, мс
+    void setResponseDelay(int msec);
+
+    void start(const ConnectionParams &params);
+    void abort();
+    bool isRunning() const;
+
+signals:
+    void progress(int done, int total);
+    void finished(const ModbusConfig::SlaveDiscoveryReport &report);
+
+private:
+    enum class State {
+        Queued,
+        Sent,
+        TimedOut,
+        Done
+    };
+
+    QByteArray requestFrame(int slave) const;
+    bool isTcp() const;
+    void connectToGateway();
+    void onConnected();
+    void onSocketError();
+    void onTcpData();
+    void fillWindow();
+    void onTcpTimer();
+    void armTcpTimer();
+    void sendLineRequest();
+    void onLineData();
+    void onLineTimer();
+    void finishLineRequest();
+    void onResponse(int slave, const quint8 *pdu, int size);
+    void markDone();
+    void finish(const QString &error = QString());
+    void release();
+
+private:
+    int mFirst{1};
+    int mLast{247};
+    RegisterAddress::RegisterType mProbeType{
+        RegisterAddress::RegisterType::AnalogOutputHoldingRegisters};
+    int mProbeAddress{40001};
+    int mWindow{16};
+    int mTimeout{1000};
+    int mResponseDelay{20};
+
+    ConnectionParams mParams;
+    bool mRunning{};
+    QTcpSocket *mSocket{};
+    SerialLink *mLink{};
+    QTimer *mTimer{};
+    QElapsedTimer mClock;
+    QByteArray mBuffer;
+
+    // по адресу слейва, он же идентификатор транзакции TCP
+    QVector<State> mStates;
+    QVector<qint64> mSentAt;
+    // слейвы в порядке отправки (дедлайны растут) и повторы после переподключения
+    QVector<int> mSent;
+    int mSentHead{};
+    QVector<int> mRetry;
+    int mNext{};
+    int mInFlight{};
+    int mDone{};
+    int mReconnects{};
+
+    // RTU: текущий слейв и дедлайны в нс
+    int mCurrent{-1};
+    qint64 mCharTime{};
+    qint64 mSilenceTime{};
+    qint64 mFrameTimeout{};
+
+    SlaveDiscoveryReport mReport;
+};
+
+}
@@ -0,0 +1,254 @@
+#include "stalenessanalyzer.h"
+
+#include "pollplanner.h"
+#include "utils.h"
+
+#include <QMap>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+struct ScheduledRequest {
+    double start;
+    double end;
+};
+
+double typeRange(ModbusConfig::RegisterAddress::ValType type)
+{
+    using T = ModbusConfig::RegisterAddress::ValType;
+    switch (type) {
+    case T::Bool:
+        return 1;
+    case T::Int8:
+    case T::UInt8:
+        return std::numeric_limits<quint8>::max();
+    case T::Int16:
+    case T::UInt16:
+        return std::numeric_limits<quint16>::max();
+    case T::Int32:
+    case T::UInt32:
+        return std::numeric_limits<quint32>::max();
+    default:
+        break;
+    }
+    return std::numeric_limits<double>::infinity();
+}
+
+// диапазон значений, с которым ядро обновления сравнивает порог: после корректирующей
+// функции и ограничения minValue / maxValue; NaN - диапазон неизвестен
+double valueRange(const ModbusConfig::Sensor &sensor, ModbusConfig::RegisterAddress::ValType type,
+    const ModbusConfig::ExpressionProgram *program)
+{
+    using Kind = ModbusConfig::ExpressionProgram::Kind;
+    double result = typeRange(type);
+    if (program) {
+        switch (program->kind()) {
+        case Kind::Identity:
+            break;
+        case Kind::Constant:
+            result = 0;
+            break;
+        case Kind::Linear:
+            result = program->scale() == 0 ? 0 : result * std::fabs(program->scale());
+            break;
+        case Kind::General:
+            result = std::numeric_limits<double>::quiet_NaN();
+            break;
+        }
+    }
+    if (!sensor.minValue.isNull() && !sensor.maxValue.isNull()) {
+        double range = sensor.maxValue.toDouble() - sensor.minValue.toDouble();
+        if (range >= 0) {
+            result = std::isnan(result) ? range : qMin(result, range);
+        }
+    }
+    return result;
+}
+
+}
+
+namespace ModbusConfig {
+
+void StalenessReport::sort(SensorStaleness::Column column, Qt::SortOrder order)
+{
+    auto key = [column](const SensorStaleness &item) -> double {
+        using C = SensorStaleness::Column;
+        switch (column) {
+        case C::PollPeriod:
+            return item.pollPeriod;
+        case C::TypicalAge:
+            return item.typicalAge;
+        case C::WorstAge:
+            return item.worstAge;
+        case C::WriteWait:
+            return item.writeWait;
+        case C::WriteSlack:
+            return item.writeSlack;
+        default:
+            break;
+        }
+        return 0;
+    };
+    auto less = [column, key](const SensorStaleness &l, const SensorStaleness &r) {
+        switch (column) {
+        case SensorStaleness::Column::Device:
+            return l.devId < r.devId;
+        case SensorStaleness::Column::Sensor:
+            return l.description < r.description;
+        default:
+            break;
+        }
+        return key(l) < key(r);
+    };
+    if (order == Qt::AscendingOrder) {
+        std::stable_sort(sensors.begin(), sensors.end(), less);
+    } else {
+        std::stable_sort(sensors.begin(), sensors.end(),
+            [less](const SensorStaleness &l, const SensorStaleness &r) {
+                return less(r, l);
+            });
+    }
+}
+
+void StalenessAnalyzer::setHistogramBinCount(int count)
+{
+    mHistogramBinCount = qMax(1, count);
+}
+
+StalenessReport StalenessAnalyzer::analyze(const ModbusConfigModel &model) const
+{
+    StalenessReport result;
+    const double ttl = model.commonSettings().writeRequestTtl;
+
+    QMap<QString, QList<QUuid>> channels;
+    const auto devicesIds = model.devicesIds();
+    for (const auto &devId : devicesIds) {
+        channels[channelKey(model.device(devId).settings.connectionParams)].append(devId);
+    }
+
+    for (auto &channelDevices : channels) {
+        std::sort(channelDevices.begin(), channelDevices.end());
+
+        // один цикл опроса канала: устройства на общей линии опрашиваются по очереди
+        QHash<QUuid, QVector<PollRequest>> requests;
+        QHash<QUuid, QVector<ScheduledRequest>> schedule;
+        double time = 0;
+        double longestRequest = 0;
+        for (const auto &devId : qAsConst(channelDevices)) {
+            const auto &device = model.device(devId);
+            PollCostModel cost(device.settings.connectionParams);
+            auto deviceRequests = model.pollPlan().deviceRequests(devId);
+            QVector<ScheduledRequest> deviceSchedule;
+            deviceSchedule.reserve(deviceRequests.size());
+            for (const auto &request : qAsConst(deviceRequests)) {
+                double duration = cost.requestTime(request.regType, request.count);
+                deviceSchedule.append({time, time + duration});
+                time += duration;
+                longestRequest = qMax(longestRequest, duration);
+            }
+            requests[devId] = deviceRequests;
+            schedule[devId] = deviceSchedule;
+        }
+        const double cycle = time;
+
+        for (const auto &devId : qAsConst(channelDevices)) {
+            const auto &device = model.device(devId);
+            const auto &deviceRequests = requests[devId];
+            const auto &deviceSchedule = schedule[devId];
+            PollCostModel cost(device.settings.connectionParams);
+
+            QHash<QUuid, int> sensorRequest;
+            QHash<QString, QVector<QPair<int, PollItem>>> mapRequests;
+            for (int i = 0; i < deviceRequests.size(); ++i) {
+                for (const auto &item : deviceRequests.at(i).items) {
+                    if (item.type == PollItem::Type::Sensor) {
+                        sensorRequest[item.sensorId] = i;
+                    } else {
+                        mapRequests[item.mapId].append(qMakePair(i, item));
+                    }
+                }
+            }
+
+            DeviceStalenessHistogram histogram;
+            histogram.devId = devId;
+            histogram.description = device.settings.description;
+            QVector<double> worstAges;
+
+            for (const auto &sensor : device.sensors) {
+                SensorStaleness item;
+                item.devId = devId;
+                item.sensorId = sensor.id;
+                item.description = sensor.description;
+
+                RegisterAddress address = sensor.registerAddress;
+                int requestIndex = -1;
+                if (sensor.type == Sensor::Type::Separate) {
+                    requestIndex = sensorRequest.value(sensor.id, -1);
+                } else if (sensor.type != Sensor::Type::Virtual) {
+                    address = device.maps.value(sensor.mapId).registеrAddress;
+                    // агрегат обновляется запросом, в котором приходит конец диапазона
+                    int lastValue = sensor.mapOffset;
+                    if (sensor.type == Sensor::Type::Aggregate) {
+                        lastValue += qMax(sensor.aggregateCount, 1) - 1;
+                    }
+                    int offset = lastValue * registerCount(address);
+                    for (const auto &piece : mapRequests.value(sensor.mapId)) {
+                        if (offset >= piece.second.itemOffset
+                            && offset < piece.second.itemOffset + piece.second.count) {
+                            requestIndex = piece.first;
+                            break;
+                        }
+                    }
+                }
+
+                if (requestIndex >= 0 && sensor.mode != Sensor::Mode::Write) {
+                    const auto &scheduled = deviceSchedule.at(requestIndex);
+                    double duration = scheduled.end - scheduled.start;
+                    item.polled = true;
+                    item.pollPeriod = cycle;
+                    // изменение сразу после опроса будет замечено только в следующем цикле
+                    item.typicalAge = cycle / 2 + duration;
+                    item.worstAge = cycle + duration;
+                    worstAges.append(item.worstAge);
+                }
+                if (sensor.mode != Sensor::Mode::Read) {
+                    // запись ждёт окончания текущего запроса на линии
+                    item.writeWait = longestRequest
+                        + cost.writeTime(address.regType, registerCount(address));
+                    item.writeSlack = ttl - item.writeWait;
+                }
+                // вычисляемый датчик не привязан к типу регистра
+                const auto valType = sensor.type == Sensor::Type::Virtual
+                    ? RegisterAddress::ValType::Double
+                    : address.valType;
+                const double range =
+                    valueRange(sensor, valType, model.sensorCorrection(sensor.id).data());
+                item.thresholdUnknown = sensor.updateThreshold > 0 && std::isnan(range);
+                item.thresholdUnreachable = sensor.updateThreshold > range;
+                result.sensors.append(item);
+            }
+
+            double maxAge = 0;
+            for (double age : qAsConst(worstAges)) {
+                maxAge = qMax(maxAge, age);
+            }
+            histogram.bins.fill(0, mHistogramBinCount);
+            if (maxAge > 0) {
+                histogram.binWidth = maxAge / mHistogramBinCount;
+                for (double age : qAsConst(worstAges)) {
+                    int bin = qMin(static_cast<int>(age / histogram.binWidth),
+                        mHistogramBinCount - 1);
+                    ++histogram.bins[bin];
+                }
+            }
+            result.histograms.append(histogram);
+        }
+    }
+    result.sort(SensorStaleness::Column::WorstAge, Qt::DescendingOrder);
+    return result;
+}
+
+}
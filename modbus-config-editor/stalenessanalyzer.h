@@ -0,0 +1,64 @@
+#pragma once
+
+#include "modbusconfigmodel.h"
+
+#include <QVector>
+
+namespace ModbusConfig {
+
+struct SensorStaleness {
+    enum class Column {
+        Device,
+        Sensor,
+        PollPeriod,
+        TypicalAge,
+        WorstAge,
+        WriteWait,
+        WriteSlack
+    };
+
+    QUuid devId;
+    QUuid sensorId;
+    QString description;
+    bool polled{};
+    // все времена в секундах, -1 - неприменимо
+    double pollPeriod{-1};
+    double typicalAge{-1};
+    double worstAge{-1};
+    double writeWait{-1};
+    double writeSlack{-1};
+    // порог больше всего диапазона значений после корректирующей функции: как и в ядре
+    // обновления, изменение ровно на порог ещё отправляется
+    bool thresholdUnreachable{};
+    // диапазон после нелинейной корректирующей функции неизвестен, порог не проверялся
+    bool thresholdUnknown{};
+};
+
+struct DeviceStalenessHistogram {
+    QUuid devId;
+    QString description;
+    double binWidth{};
+    QVector<int> bins;
+};
+
+struct StalenessReport {
+    QVector<SensorStaleness> sensors;
+    QVector<DeviceStalenessHistogram> histograms;
+
+    void sort(SensorStaleness::Column column, Qt::SortOrder order = Qt::AscendingOrder);
+};
+
+class StalenessAnalyzer
+{
+public:
+    StalenessAnalyzer() = default;
+
+    void setHistogramBinCount(int count);
+
+    StalenessReport analyze(const ModbusConfigModel &model) const;
+
+private:
+    int mHistogramBinCount{10};
+};
+
+}
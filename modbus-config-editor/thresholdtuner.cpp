@@ -0,0 +1,274 @@
+#include "thresholdtuner.h"
+
+#include "modbusconfigmodel.h"
+#include "registertrace.h"
+#include "tracereplayer.h"
+#include "utils.h"
+
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+// допуск сравнения ошибок: пороги кандидатов округлены, ошибки - разности значений
+constexpr double errorTolerance = 1e-12;
+
+using ModbusConfig::ThresholdCurvePoint;
+using ModbusConfig::SensorThresholdTuning;
+
+// как MapUpdateKernel::emitValue: значение уходит, если отличается от отправленного
+// не меньше чем на порог
+ThresholdCurvePoint simulate(const QVector<double> &values, double threshold)
+{
+    ThresholdCurvePoint point;
+    point.threshold = threshold;
+    double last = values.first();
+    point.updates = 1;
+    for (int i = 1; i < values.size(); ++i) {
+        const double value = values.at(i);
+        const double error = std::fabs(value - last);
+        if (value != last && !(error < threshold)) {
+            last = value;
+            ++point.updates;
+        } else {
+            point.maxError = qMax(point.maxError, error);
+        }
+    }
+    return point;
+}
+
+// два значащих разряда: пороги вида 0.037, 1.5, 120
+double roundThreshold(double value)
+{
+    const double unit = std::pow(10.0, std::floor(std::log10(value)) - 1);
+    return std::round(value / unit) * unit;
+}
+
+// наименьшее число отправок среди порогов с ошибкой не больше relativeError разброса
+const ThresholdCurvePoint &pickPoint(const SensorThresholdTuning &tuning, double relativeError)
+{
+    const double limit = relativeError * tuning.span * (1 + errorTolerance);
+    const ThresholdCurvePoint *best = &tuning.curve.first();
+    for (const auto &point : tuning.curve) {
+        if (point.maxError <= limit
+            && (point.updates < best->updates
+                || (point.updates == best->updates && point.maxError < best->maxError))) {
+            best = &point;
+        }
+    }
+    return *best;
+}
+
+qint64 totalUpdates(const QVector<SensorThresholdTuning> &sensors, double relativeError)
+{
+    qint64 result = 0;
+    for (const auto &tuning : sensors) {
+        result += pickPoint(tuning, relativeError).updates;
+    }
+    return result;
+}
+}
+
+namespace ModbusConfig {
+
+QStringList thresholdTuningReportText(const ThresholdTuningReport &report)
+{
+    if (!report.error.isEmpty()) {
+        return {report.error};
+    }
+    QStringList lines;
+    lines << QObject::tr("Запись: %0 с, датчиков %1, нет значений в записи: %2")
+                 .arg(report.traceDuration, 0, 'f', 1)
+                 .arg(report.sensors.size())
+                 .arg(report.missingSensors);
+    lines << QObject::tr("Поток на сервер: сейчас %0 сообщ./с, с предложенными порогами "
+                         "%1 сообщ./с, цель %2 сообщ./с")
+                 .arg(report.currentRate, 0, 'f', 1)
+                 .arg(report.proposedRate, 0, 'f', 1)
+                 .arg(report.targetRate, 0, 'f', 1);
+    if (report.derivedSensors > 0) {
+        lines << QObject::tr("Датчики, вычисляемые по другим датчикам (%0), не подбираются, "
+                             "их отправки в поток не входят")
+                     .arg(report.derivedSensors);
+    }
+    if (!report.targetReached) {
+        lines << QObject::tr("Цель недостижима: на записи не меньше стольких отправок "
+                             "даёт любой порог");
+    }
+    lines << QObject::tr("Ошибка каждого датчика не больше %0 % разброса его значений")
+                 .arg(report.relativeError * 100, 0, 'g', 3);
+    for (const auto &tuning : report.sensors) {
+        if (tuning.proposed.threshold == tuning.current.threshold) {
+            continue;
+        }
+        lines << QObject::tr("    %0 (%1): порог %2 -> %3, сообщ./с %4 -> %5, ошибка %6 -> %7")
+                     .arg(tuning.description, toString(tuning.sensorId))
+                     .arg(tuning.current.threshold, 0, 'g', 4)
+                     .arg(tuning.proposed.threshold, 0, 'g', 4)
+                     .arg(tuning.current.updates / report.traceDuration, 0, 'f', 2)
+                     .arg(tuning.proposed.updates / report.traceDuration, 0, 'f', 2)
+                     .arg(tuning.current.maxError, 0, 'g', 4)
+                     .arg(tuning.proposed.maxError, 0, 'g', 4);
+    }
+    return lines;
+}
+
+QString applyThresholdTuning(ModbusConfigModel *model, const ThresholdTuningReport &report)
+{
+    // пороги применяются к копии: ошибка на одном из датчиков не оставляет конфигурацию
+    // применённой наполовину
+    ModbusConfigModel result = *model;
+    for (const auto &tuning : report.sensors) {
+        Sensor sensor = result.device(tuning.devId).sensors.value(tuning.sensorId);
+        if (sensor.id != tuning.sensorId
+            || sensor.updateThreshold == tuning.proposed.threshold) {
+            continue;
+        }
+        sensor.updateThreshold = tuning.proposed.threshold;
+        const QString error = result.upsertSensor(tuning.devId, tuning.sensorId, sensor);
+        if (!error.isEmpty()) {
+            return error;
+        }
+    }
+    *model = result;
+    return {};
+}
+
+void ThresholdTuner::setCandidateCount(int count)
+{
+    mCandidateCount = qMax(count, 2);
+}
+
+ThresholdTuningReport ThresholdTuner::tune(const ModbusConfigModel &model,
+    const RegisterTrace &trace, double targetRate) const
+{
+    ThresholdTuningReport report;
+    report.targetRate = targetRate;
+
+    // ряд значений датчика - всё, что ушло бы на сервер при нулевом пороге
+    ModbusConfigModel unfiltered = model;
+    QHash<QUuid, QUuid> sensorDevices;
+    int readSensors = 0;
+    for (const auto &devId : model.devicesIds()) {
+        for (auto sensor : model.device(devId).sensors) {
+            sensorDevices.insert(sensor.id, devId);
+            const auto program = model.sensorCorrection(sensor.id);
+            const bool derived = sensor.type == Sensor::Type::Virtual
+                || (program && !program->references().isEmpty());
+            if (sensor.mode != Sensor::Mode::Write && derived) {
+                ++report.derivedSensors;
+            } else if (sensor.mode != Sensor::Mode::Write) {
+                ++readSensors;
+            }
+            if (sensor.updateThreshold != 0) {
+                sensor.updateThreshold = 0;
+                unfiltered.upsertSensor(devId, sensor.id, sensor);
+            }
+        }
+    }
+    TraceReplayer replayer(unfiltered, trace);
+    QVector<QVector<double>> series(replayer.sensorCount());
+    const ReplayStats stats = replayer.replay(
+        [&series](const QUuid &, qint64, const QVector<QPair<int, double>> &changes) {
+            for (const auto &change : changes) {
+                series[change.first].append(change.second);
+            }
+        });
+    report.traceDuration = stats.traceDuration;
+    if (report.traceDuration <= 0) {
+        report.error = QObject::tr("В записи нет значений датчиков конфигурации");
+        return report;
+    }
+
+    QVector<int> indices;
+    for (int i = 0; i < series.size(); ++i) {
+        if (!series.at(i).isEmpty()) {
+            indices.append(i);
+        }
+    }
+    report.sensors.resize(indices.size());
+    auto *out = report.sensors.data();
+    QVector<int> positions(indices.size());
+    std::iota(positions.begin(), positions.end(), 0);
+    QtConcurrent::blockingMap(positions, [&](int slot) {
+        const QUuid sensorId = replayer.sensorId(indices.at(slot));
+        const QUuid devId = sensorDevices.value(sensorId);
+        const Sensor &sensor = model.device(devId).sensors.value(sensorId);
+        out[slot] = tuneSensor(series.at(indices.at(slot)), sensor.updateThreshold);
+        out[slot].devId = devId;
+        out[slot].sensorId = sensorId;
+        out[slot].description = sensor.description;
+    });
+    report.missingSensors = readSensors - report.sensors.size();
+
+    // суммарные отправки не растут с допустимой ошибкой: ищется наименьшая подходящая
+    QVector<double> errors{0};
+    qint64 currentUpdates = 0;
+    for (const auto &tuning : qAsConst(report.sensors)) {
+        currentUpdates += tuning.current.updates;
+        for (const auto &point : tuning.curve) {
+            if (tuning.span > 0) {
+                errors.append(point.maxError / tuning.span);
+            }
+        }
+    }
+    std::sort(errors.begin(), errors.end());
+    errors.erase(std::unique(errors.begin(), errors.end()), errors.end());
+    const double targetUpdates = targetRate * report.traceDuration;
+    auto found = std::partition_point(errors.begin(), errors.end(),
+        [&report, targetUpdates](double error) {
+            return totalUpdates(report.sensors, error) > targetUpdates;
+        });
+    report.targetReached = found != errors.end();
+    report.relativeError = report.targetReached ? *found : errors.last();
+
+    qint64 proposedUpdates = 0;
+    for (auto &tuning : report.sensors) {
+        tuning.proposed = pickPoint(tuning, report.relativeError);
+        proposedUpdates += tuning.proposed.updates;
+    }
+    report.currentRate = currentUpdates / report.traceDuration;
+    report.proposedRate = proposedUpdates / report.traceDuration;
+    return report;
+}
+
+SensorThresholdTuning ThresholdTuner::tuneSensor(
+    const QVector<double> &values, double currentThreshold) const
+{
+    SensorThresholdTuning result;
+    const auto range = std::minmax_element(values.begin(), values.end());
+    result.span = *range.second - *range.first;
+    double minStep = result.span;
+    for (int i = 1; i < values.size(); ++i) {
+        const double step = std::fabs(values.at(i) - values.at(i - 1));
+        if (step > 0) {
+            minStep = qMin(minStep, step);
+        }
+    }
+
+    // ноль, текущий порог и геометрическая сетка от наименьшего шага до разброса;
+    // порог больше разброса оставляет одну отправку
+    QVector<double> thresholds{0, currentThreshold};
+    if (result.span > 0) {
+        const double ratio = result.span / minStep;
+        for (int i = 0; i < mCandidateCount; ++i) {
+            thresholds.append(roundThreshold(
+                minStep * std::pow(ratio, double(i) / (mCandidateCount - 1))));
+        }
+        thresholds.append(roundThreshold(result.span * 2));
+    }
+    std::sort(thresholds.begin(), thresholds.end());
+    thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+    for (double threshold : qAsConst(thresholds)) {
+        result.curve.append(simulate(values, threshold));
+        if (threshold == currentThreshold) {
+            result.current = result.curve.last();
+        }
+    }
+    result.proposed = result.current;
+    return result;
+}
+
+}
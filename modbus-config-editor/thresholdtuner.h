@@ -0,0 +1,82 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QStringList>
+#include <QVector>
+
+namespace ModbusConfig {
+
+class ModbusConfigModel;
+class RegisterTrace;
+
+struct ThresholdCurvePoint {
+    double threshold{};
+    // отправок на сервер за время записи
+    qint64 updates{};
+    // наибольшее отклонение неотправленного значения от последнего отправленного
+    double maxError{};
+};
+
+struct SensorThresholdTuning {
+    QUuid devId;
+    QUuid sensorId;
+    QString description;
+    // разброс значений в записи, по нему сравниваются ошибки разных датчиков
+    double span{};
+    ThresholdCurvePoint current;
+    ThresholdCurvePoint proposed;
+    // по возрастанию порога
+    QVector<ThresholdCurvePoint> curve;
+};
+
+struct ThresholdTuningReport {
+    // в секундах
+    double traceDuration{};
+    // сообщений в секунду на сервер
+    double targetRate{};
+    double currentRate{};
+    double proposedRate{};
+    // ошибка относительно разброса значений, одна на все датчики
+    double relativeError{};
+    bool targetReached{};
+    QVector<SensorThresholdTuning> sensors;
+    // датчики конфигурации, значений которых нет в записи
+    int missingSensors{};
+    // вычисляемые и ссылающиеся на другие датчики: не подбираются и в поток не входят
+    int derivedSensors{};
+    QString error;
+};
+
+// сводка для вывода в консоль и в окно редактора
+QStringList thresholdTuningReportText(const ThresholdTuningReport &report);
+
+// записывает предложенные пороги в модель: все или, при ошибке, ни одного
+QString applyThresholdTuning(ModbusConfigModel *model, const ThresholdTuningReport &report);
+
+// Подбор updateThreshold по записи опроса. Запись прогоняется через ядро обновления
+// датчиков с нулевыми порогами, и для каждого датчика по его ряду значений
+// считается, сколько отправок и какую наибольшую ошибку даёт каждый порог-кандидат
+// (датчики обрабатываются параллельно). Затем ищется наименьшая общая ошибка
+// относительно разброса значений, при которой суммарный поток укладывается в целевой.
+// Датчики, вычисляемые по другим датчикам, по записи не воспроизводятся: их отправки
+// в оценку потока не входят и считаются в report.derivedSensors.
+class ThresholdTuner
+{
+public:
+    ThresholdTuner() = default;
+
+    // число порогов-кандидатов на датчик, кроме нулевого и текущего
+    void setCandidateCount(int count);
+
+    ThresholdTuningReport tune(const ModbusConfigModel &model, const RegisterTrace &trace,
+        double targetRate) const;
+
+private:
+    SensorThresholdTuning tuneSensor(const QVector<double> &values, double currentThreshold) const;
+
+private:
+    int mCandidateCount{32};
+};
+
+}
@@ -0,0 +1,227 @@
+#include "tracereplayer.h"
+
+#include "modbusconfigmodel.h"
+#include "utils.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace {
+// разобранный кусок блока: отсчёты строками, регистры старшим байтом вперёд, как в ответе
+struct BlockChunk {
+    ModbusConfig::TraceTimeCursor time;
+    QVector<ModbusConfig::TraceWordCursor> columns;
+    QVector<qint64> timestamps;
+    QVector<quint8> rows;
+    int size{};
+    int position{};
+};
+
+bool fillChunk(BlockChunk *chunk, quint16 *words)
+{
+    chunk->size = chunk->time.next(chunk->timestamps.data());
+    chunk->position = 0;
+    const int registers = chunk->columns.size();
+    for (int reg = 0; reg < registers; ++reg) {
+        chunk->columns[reg].next(words);
+        quint8 *row = chunk->rows.data() + reg * 2;
+        for (int i = 0; i < chunk->size; ++i, row += registers * 2) {
+            row[0] = quint8(words[i] >> 8);
+            row[1] = quint8(words[i]);
+        }
+    }
+    return chunk->size > 0;
+}
+}
+
+namespace ModbusConfig {
+
+TraceReplayer::TraceReplayer(const ModbusConfigModel &model, const RegisterTrace &trace)
+    : mTrace(trace)
+{
+    QHash<QPair<QUuid, QString>, int> kernelIndices;
+    QHash<QPair<QUuid, QPair<int, int>>, int> separateIndices;
+    const auto appendKernel = [this](const QSharedPointer<MapUpdateKernel> &kernel) {
+        mFirstSensors.append(mSensorIds.size());
+        for (int i = 0; i < kernel->sensorCount(); ++i) {
+            mSensorIds.append(kernel->sensorId(i));
+        }
+        mKernels.append(kernel);
+        return mKernels.size() - 1;
+    };
+    for (int b = 0; b < trace.blockCount(); ++b) {
+        const auto &block = trace.block(b);
+        const auto &device = model.device(block.devId);
+        QVector<Binding> bindings;
+        // отдельные датчики слейва и типа регистров: значения - регистры блока
+        const auto separateKey = qMakePair(
+            block.devId, qMakePair(int(block.slaveAddress), int(block.regType)));
+        auto separateIt = separateIndices.find(separateKey);
+        if (separateIt == separateIndices.end()) {
+            QSharedPointer<MapUpdateKernel> kernel(new MapUpdateKernel(
+                model, block.devId, block.slaveAddress, block.regType));
+            separateIt = separateIndices.insert(
+                separateKey, kernel->sensorCount() > 0 ? appendKernel(kernel) : -1);
+        }
+        if (separateIt.value() >= 0 && block.registerCount > 0) {
+            bindings.append({separateIt.value(), 0, block.firstAddress, block.registerCount});
+        }
+        QStringList mapIds = device.maps.keys();
+        std::sort(mapIds.begin(), mapIds.end());
+        for (const auto &mapId : qAsConst(mapIds)) {
+            const auto &map = device.maps.value(mapId);
+            const auto &address = map.registеrAddress;
+            if (address.slaveAddress != block.slaveAddress || address.regType != block.regType) {
+                continue;
+            }
+            // в ответ попадают только значения карты, прочитанные целиком
+            const int valueSize = isBitRegisterType(address.regType) ? 1 : registerCount(address);
+            const int mapEnd = address.regAddress + map.valueCount * valueSize;
+            const int first = qMax(block.firstAddress, address.regAddress);
+            const int last = qMin(block.firstAddress + block.registerCount, mapEnd);
+            const int firstValue = (first - address.regAddress + valueSize - 1) / valueSize;
+            const int count = (last - address.regAddress) / valueSize - firstValue;
+            if (count <= 0) {
+                continue;
+            }
+            const auto key = qMakePair(block.devId, mapId);
+            auto it = kernelIndices.find(key);
+            if (it == kernelIndices.end()) {
+                QSharedPointer<MapUpdateKernel> kernel(
+                    new MapUpdateKernel(model, block.devId, mapId));
+                if (kernel->sensorCount() == 0) {
+                    continue;
+                }
+                it = kernelIndices.insert(key, appendKernel(kernel));
+            }
+            const int firstRegister = address.regAddress + firstValue * valueSize
+                - block.firstAddress;
+            bindings.append({it.value(), firstRegister, firstValue, count});
+        }
+        mBindings.append(bindings);
+    }
+}
+
+int TraceReplayer::sensorCount() const
+{
+    return mSensorIds.size();
+}
+
+QUuid TraceReplayer::sensorId(int index) const
+{
+    return mSensorIds.at(index);
+}
+
+ReplayStats TraceReplayer::decode() const
+{
+    QElapsedTimer timer;
+    timer.start();
+    ReplayStats stats;
+    QVector<qint64> timestamps(traceChunkSize);
+    QVector<quint16> words(traceChunkSize);
+    qint64 first = std::numeric_limits<qint64>::max();
+    qint64 last = std::numeric_limits<qint64>::min();
+    for (int b = 0; b < mTrace.blockCount(); ++b) {
+        const auto &block = mTrace.block(b);
+        auto time = mTrace.timestamps(b);
+        while (time.next(timestamps.data()) > 0) {
+        }
+        for (int reg = 0; reg < block.registerCount; ++reg) {
+            auto column = mTrace.registers(b, reg);
+            for (int n = column.next(words.data()); n > 0; n = column.next(words.data())) {
+                stats.samples += n;
+            }
+        }
+        stats.polls += block.sampleCount;
+        if (block.sampleCount > 0) {
+            first = qMin(first, block.firstTimestamp);
+            last = qMax(last, block.lastTimestamp);
+        }
+    }
+    stats.traceDuration = stats.polls > 0 ? (double(last) - double(first)) / 1e9 : 0;
+    stats.elapsed = timer.nsecsElapsed() / 1e9;
+    return stats;
+}
+
+ReplayStats TraceReplayer::replay(const Sink &sink)
+{
+    QElapsedTimer timer;
+    timer.start();
+    ReplayStats stats;
+    for (const auto &kernel : qAsConst(mKernels)) {
+        kernel->reset();
+    }
+
+    QVector<BlockChunk> chunks(mTrace.blockCount());
+    QVector<quint16> words(traceChunkSize);
+    using Entry = QPair<qint64, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (int b = 0; b < mTrace.blockCount(); ++b) {
+        const auto &block = mTrace.block(b);
+        auto &chunk = chunks[b];
+        chunk.time = mTrace.timestamps(b);
+        for (int reg = 0; reg < block.registerCount; ++reg) {
+            chunk.columns.append(mTrace.registers(b, reg));
+        }
+        chunk.timestamps.resize(traceChunkSize);
+        chunk.rows.resize(traceChunkSize * block.registerCount * 2);
+        if (!mBindings.at(b).isEmpty() && fillChunk(&chunk, words.data())) {
+            queue.push(qMakePair(chunk.timestamps.at(0), b));
+        }
+    }
+
+    QVector<quint8> bits;
+    QVector<QPair<int, double>> local;
+    QVector<QPair<int, double>> changes;
+    qint64 first = 0;
+    qint64 last = 0;
+    while (!queue.empty()) {
+        const qint64 timestamp = queue.top().first;
+        const int b = queue.top().second;
+        queue.pop();
+        if (stats.polls++ == 0) {
+            first = timestamp;
+        }
+        last = timestamp;
+        const auto &block = mTrace.block(b);
+        auto &chunk = chunks[b];
+        const quint8 *row = chunk.rows.constData() + chunk.position * block.registerCount * 2;
+        stats.samples += block.registerCount;
+
+        changes.clear();
+        for (const auto &binding : mBindings.at(b)) {
+            const quint8 *raw = row + binding.firstRegister * 2;
+            if (isBitRegisterType(block.regType)) {
+                // биты ответа упакованы младшими вперёд от первого значения
+                bits.fill(0, (binding.count + 7) / 8);
+                for (int i = 0; i < binding.count; ++i) {
+                    bits[i / 8] |= quint8((raw[i * 2 + 1] & 1) << (i % 8));
+                }
+                raw = bits.constData();
+            }
+            local.clear();
+            mKernels.at(binding.kernel)->process(raw, binding.firstValue, binding.count, &local);
+            const int firstSensor = mFirstSensors.at(binding.kernel);
+            for (const auto &change : qAsConst(local)) {
+                changes.append(qMakePair(firstSensor + change.first, change.second));
+            }
+        }
+        stats.changes += changes.size();
+        if (sink && !changes.isEmpty()) {
+            sink(block.devId, timestamp, changes);
+        }
+
+        if (++chunk.position < chunk.size || fillChunk(&chunk, words.data())) {
+            queue.push(qMakePair(chunk.timestamps.at(chunk.position), b));
+        }
+    }
+    stats.traceDuration = (double(last) - double(first)) / 1e9;
+    stats.elapsed = timer.nsecsElapsed() / 1e9;
+    return stats;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "mapupdatekernel.h"
+#include "registertrace.h"
+
+#include <QPair>
+#include <QSharedPointer>
+#include <QVector>
+
+#include <functional>
+
+namespace ModbusConfig {
+
+struct ReplayStats {
+    // прочитанные значения регистров и ответы (отсчёты блоков)
+    qint64 samples{};
+    qint64 polls{};
+    qint64 changes{};
+    // в секундах
+    double traceDuration{};
+    double elapsed{};
+};
+
+// Прогон записи опроса через ядро обновления датчиков быстрее реального времени:
+// ответы всех блоков идут в порядке меток времени, значения карт, попавшие в ответ
+// целиком, передаются MapUpdateKernel своей карты, регистры блока - ядру отдельных
+// датчиков слейва. Датчики с корректирующей функцией от других датчиков
+// не воспроизводятся.
+class TraceReplayer
+{
+public:
+    // devId, метка времени ответа (нс) и (индекс датчика, значение) изменившихся датчиков
+    using Sink = std::function<void(const QUuid &devId, qint64 timestamp,
+        const QVector<QPair<int, double>> &changes)>;
+
+    TraceReplayer(const ModbusConfigModel &model, const RegisterTrace &trace);
+
+    // датчики всех карт и отдельные датчики, индексы общие для всех устройств
+    int sensorCount() const;
+    QUuid sensorId(int index) const;
+
+    // только разбор столбцов, без декодирования карт: предел скорости чтения записи
+    ReplayStats decode() const;
+    ReplayStats replay(const Sink &sink = Sink());
+
+private:
+    // значения карты [firstValue, firstValue + count) с регистра firstRegister блока
+    struct Binding {
+        int kernel;
+        int firstRegister;
+        int firstValue;
+        int count;
+    };
+
+    const RegisterTrace &mTrace;
+    QVector<QSharedPointer<MapUpdateKernel>> mKernels;
+    QVector<int> mFirstSensors;
+    QVector<QUuid> mSensorIds;
+    QVector<QVector<Binding>> mBindings;
+};
+
+}
@@ -533,6 +533,18 @@ QString toString(const ConnectionParams &params)
     return {};
 }
 
+QString channelKey(const ConnectionParams &params)
+{
+    // устройства с одним ключом канала делят одну физическую линию
+    switch (params.type) {
+    case ConnectionParams::Type::RtuSerial:
+        return QStringLiteral("serial_rtu:%0").arg(params.deviceName);
+    case ConnectionParams::Type::Tcp:
+        return QStringLiteral("tcp:%0").arg(params.address);
+    }
+    return {};
+}
+
 QString checkRegisterAddress(const RegisterAddress &address)
 {
     auto result = checkRegisterAddress(address.regType, address.regAddress);
@@ -570,6 +582,18 @@ QString checkRegisterAddress(const RegisterAddress &address)
             return error;
         }
     }
+    if (address.bitOffset != -1) {
+        if (address.bitOffset < 0 || address.bitOffset > 15) {
+            return QObject::tr("Номер бита в регистре должен быть в диапазоне от 0 до 15");
+        }
+        if (isBitRegisterType(address.regType)) {
+            return QObject::tr("Номер бита задаётся только для входных и holding регистров");
+        }
+        if (address.valType != RegisterAddress::ValType::Bool) {
+            return QObject::tr("Для битового поля тип значения должен быть '%0'")
+                .arg(toString(RegisterAddress::ValType::Bool));
+        }
+    }
     return {};
 }
 
@@ -589,6 +613,32 @@ QString checkSensorMode(RegisterAddress::RegisterType type, Sensor::Mode mode)
       .arg(toHumanString(type), toHumanString(mode));
 }
 
+bool isBitRegisterType(RegisterAddress::RegisterType type)
+{
+    return type == RegisterAddress::RegisterType::DiscreteOutputCoils
+        || type == RegisterAddress::RegisterType::DiscreteInputContacts;
+}
+
+int registerCount(const RegisterAddress &address)
+{
+    if (isBitRegisterType(address.regType)) {
+        return 1;
+    }
+    switch (address.valType) {
+    case RegisterAddress::ValType::Int32:
+    case RegisterAddress::ValType::UInt32:
+    case RegisterAddress::ValType::Float:
+        return 2;
+    case RegisterAddress::ValType::Int64:
+    case RegisterAddress::ValType::UInt64:
+    case RegisterAddress::ValType::Double:
+        return 4;
+    default:
+        break;
+    }
+    return 1;
+}
+
 QString toHumanString(Sensor::Mode mode)
 {
     switch (mode) {
@@ -615,6 +665,53 @@ QString toString(Sensor::Mode mode)
     return {};
 }
 
+QString toString(Sensor::Aggregation aggregation)
+{
+    switch (aggregation) {
+    case Sensor::Aggregation::Sum:
+        return "sum";
+    case Sensor::Aggregation::Min:
+        return "min";
+    case Sensor::Aggregation::Max:
+        return "max";
+    case Sensor::Aggregation::Average:
+        return "avg";
+    }
+    return {};
+}
+
+QString toHumanString(Sensor::Aggregation aggregation)
+{
+    switch (aggregation) {
+    case Sensor::Aggregation::Sum:
+        return QObject::tr("Сумма");
+    case Sensor::Aggregation::Min:
+        return QObject::tr("Минимум");
+    case Sensor::Aggregation::Max:
+        return QObject::tr("Максимум");
+    case Sensor::Aggregation::Average:
+        return QObject::tr("Среднее");
+    }
+    return {};
+}
+
+bool toAggregation(const QString &str, Sensor::Aggregation *aggregation)
+{
+    const QList<Sensor::Aggregation> all = {
+        Sensor::Aggregation::Sum,
+        Sensor::Aggregation::Min,
+        Sensor::Aggregation::Max,
+        Sensor::Aggregation::Average
+    };
+    for (auto item : all) {
+        if (str.compare(toString(item), Qt::CaseInsensitive) == 0) {
+            *aggregation = item;
+            return true;
+        }
+    }
+    return false;
+}
+
 void setComboboxBasedOnValue(QComboBox *combobox, int data) {
     int index = combobox->findData(data);
     if (index >= 0) {
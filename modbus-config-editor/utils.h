@@ -29,19 +29,26 @@ QString toHumanString(RegisterAddress::RegisterType type);
 QString toHumanString(Sensor::Mode mode);
 QString toString(Sensor::Mode mode);
 QString toString(RegisterAddress::ValType type);
+QString toString(Sensor::Aggregation aggregation);
+QString toHumanString(Sensor::Aggregation aggregation);
 
 RegisterAddress::RegisterType toRegisterType(const QString &str);
 RegisterAddress::ValType toValueType(const QString &str);
+bool toAggregation(const QString &str, Sensor::Aggregation *aggregation);
 QString checkRegisterAddress(RegisterAddress::RegisterType type, int address);
 QString checkRegisterAddress(const RegisterAddress &address);
 QString checkSensorMode(RegisterAddress::RegisterType type, Sensor::Mode mode);
 
+bool isBitRegisterType(RegisterAddress::RegisterType type);
+int registerCount(const RegisterAddress &address);
+
 QJsonValue toJsonValue(const QVariant &value, RegisterAddress::ValType type);
 QVariant toVariant(const QJsonValue &value, RegisterAddress::ValType type);
 
 ConnectionParams toConnectionParams(
     const QString &address, const QString &serverId, QString *error);
 QString toString(const ConnectionParams &params);
+QString channelKey(const ConnectionParams &params);
 
 
 } // namespace ModbusConfig
@@ -27,6 +27,9 @@ RegisterAddressEditWidget::RegisterAddressEditWidget(QWidget *parent) :
     connect(ui->spinBoxSlaveAddress,
         static_cast<void (QSpinBox::*)(const QString &)>(&QSpinBox::valueChanged),
         this, &RegisterAddressEditWidget::onTextChanged);
+    connect(ui->spinBoxBitOffset,
+        static_cast<void (QSpinBox::*)(const QString &)>(&QSpinBox::valueChanged),
+        this, &RegisterAddressEditWidget::onTextChanged);
 }
 
 RegisterAddressEditWidget::~RegisterAddressEditWidget()
@@ -39,12 +42,14 @@ void RegisterAddressEditWidget::setSettings(const RegisterAddress &address)
     auto blockSignalsHelper = [this](bool b) {
         ui->spinBoxRegisterAddress->blockSignals(b);
         ui->spinBoxSlaveAddress->blockSignals(b);
+        ui->spinBoxBitOffset->blockSignals(b);
         ui->comboBoxRegisterType->blockSignals(b);
         ui->comboBoxValueType->blockSignals(b);
     };
     blockSignalsHelper(true);
     ui->spinBoxRegisterAddress->setValue(address.regAddress);
     ui->spinBoxSlaveAddress->setValue(address.slaveAddress);
+    ui->spinBoxBitOffset->setValue(address.bitOffset);
     ui->lineEditValueOrder->setText(address.typeOrder);
     setComboboxBasedOnValue(ui->comboBoxRegisterType, toInt(address.regType));
     setComboboxBasedOnValue(ui->comboBoxValueType, toInt(address.valType));
@@ -57,6 +62,7 @@ ModbusConfig::RegisterAddress RegisterAddressEditWidget::settings() const
     result.regAddress = ui->spinBoxRegisterAddress->value();
     result.slaveAddress = ui->spinBoxSlaveAddress->value();
     result.typeOrder = ui->lineEditValueOrder->text();
+    result.bitOffset = ui->spinBoxBitOffset->value();
     result.regType =
         getValueBasedOnCombobox<RegisterAddress::RegisterType>(ui->comboBoxRegisterType);
     result.valType = getValueBasedOnCombobox<RegisterAddress::ValType>(ui->comboBoxValueType);
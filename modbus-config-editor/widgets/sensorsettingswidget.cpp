@@ -1,6 +1,7 @@
 #include "sensorsettingswidget.h"
 #include "ui_sensorsettingswidget.h"
 
+#include "../expressioncompiler.h"
 #include "../utils.h"
 
 using namespace ModbusConfig;
@@ -16,12 +17,19 @@ SensorSettingsWidget::SensorSettingsWidget(QWidget *parent) :
     lay->addItem(new QSpacerItem(0, 0, QSizePolicy::Minimum, QSizePolicy::Expanding));
     fillSensorModeCombobox();
     fillSensorTypeCombobox();
+    fillAggregationCombobox();
 
     connect(mRegisterAddressEditWidget, &RegisterAddressEditWidget::settingsChanged,
         this, &SensorSettingsWidget::onRegisterAddressChanged);
     connect(ui->spinBoxMapOffset,
         static_cast<void (QSpinBox::*)(const QString &)>(&QSpinBox::valueChanged),
         this, &SensorSettingsWidget::onTextChanged);
+    connect(ui->spinBoxAggregateCount,
+        static_cast<void (QSpinBox::*)(const QString &)>(&QSpinBox::valueChanged),
+        this, &SensorSettingsWidget::onTextChanged);
+    connect(ui->comboBoxAggregation,
+        static_cast<void (QComboBox::*)(const QString &)>(&QComboBox::currentTextChanged),
+        this, &SensorSettingsWidget::onTextChanged);
     connect(ui->doubleSpinBoxMaxValue,
         static_cast<void (QDoubleSpinBox::*)(const QString &)>(&QDoubleSpinBox::valueChanged),
         this, &SensorSettingsWidget::onTextChanged);
@@ -43,7 +51,7 @@ SensorSettingsWidget::SensorSettingsWidget(QWidget *parent) :
     connect(ui->lineEditId, &QLineEdit::textEdited,
         this, &SensorSettingsWidget::onTextChanged);
     connect(ui->lineEditCorrectFunc, &QLineEdit::textEdited,
-        this, &SensorSettingsWidget::onTextChanged);
+        this, &SensorSettingsWidget::onCorrectFunctionChanged);
     connect(ui->lineEditDescription, &QLineEdit::textEdited,
         this, &SensorSettingsWidget::onTextChanged);
 }
@@ -61,6 +69,8 @@ void SensorSettingsWidget::setSettings(const QStringList &sensorsMaps, const Sen
         ui->comboBoxSensorType->blockSignals(block);
         ui->comboBoxSensorsMap->blockSignals(block);
         ui->spinBoxMapOffset->blockSignals(block);
+        ui->spinBoxAggregateCount->blockSignals(block);
+        ui->comboBoxAggregation->blockSignals(block);
         ui->doubleSpinBoxMaxValue->blockSignals(block);
         ui->doubleSpinBoxMinValue->blockSignals(block);
         ui->doubleSpinBoxUpdateThreshold->blockSignals(block);
@@ -74,18 +84,17 @@ void SensorSettingsWidget::setSettings(const QStringList &sensorsMaps, const Sen
     setComboboxBasedOnValue(ui->comboBoxMode, toInt(settings.mode));
     setComboboxBasedOnValue(ui->comboBoxSensorType, toInt(settings.type));
     ui->lineEditCorrectFunc->setText(settings.correctFunction);
+    updateCorrectFunctionError(settings.correctFunction);
     ui->lineEditDescription->setText(settings.description);
     ui->lineEditId->setText(toString(settings.id));
     ui->spinBoxMapOffset->setValue(settings.mapOffset);
+    ui->spinBoxAggregateCount->setValue(settings.aggregateCount);
+    setComboboxBasedOnValue(ui->comboBoxAggregation, toInt(settings.aggregation));
     ui->doubleSpinBoxMaxValue->setValue(settings.maxValue.toDouble());
     ui->doubleSpinBoxMinValue->setValue(settings.minValue.toDouble());
     ui->doubleSpinBoxUpdateThreshold->setValue(settings.updateThreshold);
 
-    if (settings.type == Sensor::Type::Separate) {
-        ui->stackedWidget->setCurrentWidget(ui->pageSingleSensor);
-    } else {
-        ui->stackedWidget->setCurrentWidget(ui->pageMapSensor);
-    }
+    showSensorTypePage(settings.type);
     blockSignalsHelper(false);
 }
 
@@ -103,6 +112,11 @@ ModbusConfig::Sensor SensorSettingsWidget::settings() const
     result.updateThreshold = ui->doubleSpinBoxUpdateThreshold->value();
     result.mode = getValueBasedOnCombobox<Sensor::Mode>(ui->comboBoxMode);
     result.type = getValueBasedOnCombobox<Sensor::Type>(ui->comboBoxSensorType);
+    if (result.type == Sensor::Type::Aggregate) {
+        result.aggregateCount = ui->spinBoxAggregateCount->value();
+        result.aggregation =
+            getValueBasedOnCombobox<Sensor::Aggregation>(ui->comboBoxAggregation);
+    }
     return result;
 }
 
@@ -110,6 +124,34 @@ void SensorSettingsWidget::fillSensorTypeCombobox()
 {
     ui->comboBoxSensorType->addItem(tr("Отдельный датчик"), toInt(Sensor::Type::Separate));
     ui->comboBoxSensorType->addItem(tr("Датчик в карте регистров"), toInt(Sensor::Type::Map));
+    ui->comboBoxSensorType->addItem(
+        tr("Агрегат значений карты регистров"), toInt(Sensor::Type::Aggregate));
+    ui->comboBoxSensorType->addItem(tr("Вычисляемый датчик"), toInt(Sensor::Type::Virtual));
+}
+
+void SensorSettingsWidget::fillAggregationCombobox()
+{
+    QList<Sensor::Aggregation> aggregations = {
+        Sensor::Aggregation::Sum,
+        Sensor::Aggregation::Min,
+        Sensor::Aggregation::Max,
+        Sensor::Aggregation::Average
+    };
+    for (auto aggregation : aggregations) {
+        ui->comboBoxAggregation->addItem(toHumanString(aggregation), toInt(aggregation));
+    }
+}
+
+void SensorSettingsWidget::showSensorTypePage(Sensor::Type type)
+{
+    if (type == Sensor::Type::Separate) {
+        ui->stackedWidget->setCurrentWidget(ui->pageSingleSensor);
+    } else {
+        ui->stackedWidget->setCurrentWidget(ui->pageMapSensor);
+    }
+    ui->widgetAggregate->setVisible(type == Sensor::Type::Aggregate);
+    // у вычисляемого датчика есть только корректирующая функция со ссылками
+    ui->stackedWidget->setVisible(type != Sensor::Type::Virtual);
 }
 
 void SensorSettingsWidget::fillSensorModeCombobox()
@@ -140,6 +182,13 @@ void SensorSettingsWidget::fillSensorMapCombobox(
     ui->comboBoxSensorsMap->blockSignals(false);
 }
 
+void SensorSettingsWidget::updateCorrectFunctionError(const QString &text)
+{
+    QString error = checkExpression(text);
+    ui->labelCorrectFuncError->setText(error);
+    ui->labelCorrectFuncError->setVisible(!error.isEmpty());
+}
+
 void SensorSettingsWidget::onRegisterAddressChanged()
 {
     emit settingChanged(settings());
@@ -150,12 +199,15 @@ void SensorSettingsWidget::onTextChanged(const QString &)
     onRegisterAddressChanged();
 }
 
+void SensorSettingsWidget::onCorrectFunctionChanged(const QString &text)
+{
+    updateCorrectFunctionError(text);
+    onRegisterAddressChanged();
+}
+
 void SensorSettingsWidget::onCurrentIndexChangedOnTypeCombobox(int index)
 {
-    if (index == 0) {
-        ui->stackedWidget->setCurrentWidget(ui->pageSingleSensor);
-    } else {
-        ui->stackedWidget->setCurrentWidget(ui->pageMapSensor);
-    }
+    Q_UNUSED(index);
+    showSensorTypePage(getValueBasedOnCombobox<Sensor::Type>(ui->comboBoxSensorType));
     onRegisterAddressChanged();
 }
@@ -28,12 +28,16 @@ private:
 
     void fillSensorTypeCombobox();
     void fillSensorModeCombobox();
+    void fillAggregationCombobox();
+    void showSensorTypePage(ModbusConfig::Sensor::Type type);
 
     void fillSensorMapCombobox(const QStringList &sensorsMaps, const QString &currentMap);
+    void updateCorrectFunctionError(const QString &text);
 
 private: //slots
     void onRegisterAddressChanged();
     void onTextChanged(const QString &);
+    void onCorrectFunctionChanged(const QString &text);
     void onCurrentIndexChangedOnTypeCombobox(int index);
 
 private:
@@ -0,0 +1,105 @@
+#include "stalenessreportwidget.h"
+#include "ui_stalenessreportwidget.h"
+
+#include "../utils.h"
+
+#include <QHeaderView>
+
+using namespace ModbusConfig;
+
+namespace {
+
+QStandardItem *timeItem(double seconds)
+{
+    auto item = new QStandardItem;
+    if (seconds < 0) {
+        item->setText("-");
+    } else {
+        item->setText(QString::number(seconds * 1000, 'f', 1));
+    }
+    item->setData(seconds, Qt::UserRole);
+    item->setEditable(false);
+    return item;
+}
+
+QStandardItem *textItem(const QString &text)
+{
+    auto item = new QStandardItem(text);
+    item->setData(text, Qt::UserRole);
+    item->setEditable(false);
+    return item;
+}
+
+}
+
+StalenessReportWidget::StalenessReportWidget(QWidget *parent) :
+    QWidget(parent),
+    ui(new Ui::StalenessReportWidget)
+{
+    ui->setupUi(this);
+    mModel.setSortRole(Qt::UserRole);
+    ui->tableView->setModel(&mModel);
+    ui->tableView->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+}
+
+StalenessReportWidget::~StalenessReportWidget()
+{
+    delete ui;
+}
+
+void StalenessReportWidget::setReport(const StalenessReport &report)
+{
+    mModel.clear();
+    mModel.setHorizontalHeaderLabels({
+        tr("Устройство"),
+        tr("Датчик"),
+        tr("Период опроса (мс)"),
+        tr("Типичный возраст (мс)"),
+        tr("Худший возраст (мс)"),
+        tr("Ожидание записи (мс)"),
+        tr("Запас до истечения TTL (мс)"),
+        tr("Порог обновления")
+    });
+
+    for (const auto &sensor : report.sensors) {
+        QList<QStandardItem *> row;
+        row << textItem(toString(sensor.devId))
+            << textItem(sensor.description)
+            << timeItem(sensor.pollPeriod)
+            << timeItem(sensor.typicalAge)
+            << timeItem(sensor.worstAge)
+            << timeItem(sensor.writeWait)
+            << timeItem(sensor.writeSlack)
+            << textItem(sensor.thresholdUnreachable
+                    ? tr("никогда не сработает")
+                    : sensor.thresholdUnknown ? tr("не проверен: нелинейная коррекция")
+                                              : QString());
+        if (sensor.writeWait >= 0 && sensor.writeSlack < 0) {
+            row.at(6)->setForeground(Qt::red);
+        }
+        if (sensor.thresholdUnreachable) {
+            row.at(7)->setForeground(Qt::red);
+        }
+        mModel.appendRow(row);
+    }
+    fillHistograms(report);
+}
+
+void StalenessReportWidget::fillHistograms(const StalenessReport &report)
+{
+    QStringList lines;
+    for (const auto &histogram : report.histograms) {
+        lines << QString("%0 (%1)").arg(histogram.description, toString(histogram.devId));
+        if (histogram.binWidth <= 0) {
+            lines << tr("    нет опрашиваемых датчиков");
+            continue;
+        }
+        for (int i = 0; i < histogram.bins.size(); ++i) {
+            lines << QString("    %0 - %1 мс: %2")
+                         .arg(i * histogram.binWidth * 1000, 0, 'f', 1)
+                         .arg((i + 1) * histogram.binWidth * 1000, 0, 'f', 1)
+                         .arg(histogram.bins.at(i));
+        }
+    }
+    ui->plainTextEditHistograms->setPlainText(lines.join('\n'));
+}
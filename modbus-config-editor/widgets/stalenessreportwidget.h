@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QWidget>
+#include <QStandardItemModel>
+
+#include "../stalenessanalyzer.h"
+
+namespace Ui {
+class StalenessReportWidget;
+}
+
+class StalenessReportWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit StalenessReportWidget(QWidget *parent = nullptr);
+    ~StalenessReportWidget();
+
+    void setReport(const ModbusConfig::StalenessReport &report);
+
+private:
+    void fillHistograms(const ModbusConfig::StalenessReport &report);
+
+private:
+    Ui::StalenessReportWidget *ui;
+    QStandardItemModel mModel;
+};
@@ -0,0 +1,439 @@
+#include "byteorderinference.h"
+#include "connectivitychecker.h"
+#include "liveimage.h"
+#include "registerprober.h"
+#include "registertrace.h"
+#include "serializer.h"
+#include "slavediscovery.h"
+#include "thresholdtuner.h"
+#include "tracereplayer.h"
+#include "utils.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QTimer>
+
+#include <sys/resource.h>
+
+namespace {
+// соединение на устройство - лимита дескрипторов по умолчанию может не хватить
+void raiseFileLimit()
+{
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int checkConnections(QCoreApplication &app, const ModbusConfig::ModbusConfigModel &model,
+    int parallel, int timeout, bool verbose)
+{
+    using namespace ModbusConfig;
+    ConnectivityChecker checker;
+    checker.setMaxInFlight(parallel);
+    checker.setTimeout(timeout);
+    QObject::connect(&checker, &ConnectivityChecker::finished,
+        &app, [&app, verbose](const ConnectivityReport &report) {
+            for (const auto &line : connectivityReportText(report, verbose)) {
+                qInfo().noquote() << line;
+            }
+            app.exit(report.okCount == report.devices.size() ? 0 : 2);
+        });
+    // отчёт без сетевых запросов приходит прямо из start: запуск - уже в цикле событий
+    QTimer::singleShot(0, &checker, [&checker, &model]() { checker.start(model); });
+    return app.exec();
+}
+
+int discoverSlaves(QCoreApplication &app, ModbusConfig::SlaveDiscovery &discovery,
+    const ModbusConfig::ConnectionParams &params, const QString &outputPath)
+{
+    using namespace ModbusConfig;
+    QObject::connect(&discovery, &SlaveDiscovery::finished,
+        &app, [&app, outputPath](const SlaveDiscoveryReport &report) {
+            for (const auto &line : slaveDiscoveryReportText(report)) {
+                qInfo().noquote() << line;
+            }
+            if (!report.error.isEmpty()) {
+                app.exit(2);
+                return;
+            }
+            if (!outputPath.isEmpty()) {
+                ModbusConfigModel model;
+                for (const auto &device : discoveredDevices(report)) {
+                    model.insertDevice(device);
+                }
+                QFile output(outputPath);
+                if (!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                    qCritical().noquote() << QObject::tr("Не удалось открыть %0: %1")
+                        .arg(output.fileName(), output.errorString());
+                    app.exit(1);
+                    return;
+                }
+                output.write(QJsonDocument(Serializer().serialize(model)).toJson());
+            }
+            app.exit(report.slaves.isEmpty() ? 2 : 0);
+        });
+    QTimer::singleShot(0, &discovery, [&discovery, params]() { discovery.start(params); });
+    return app.exec();
+}
+
+int probeRegisters(QCoreApplication &app, ModbusConfig::RegisterProber &prober,
+    const ModbusConfig::ConnectionParams &params, int slave, const QString &outputPath)
+{
+    using namespace ModbusConfig;
+    QObject::connect(&prober, &RegisterProber::finished,
+        &app, [&app, outputPath](const RegisterProbeReport &report) {
+            for (const auto &line : registerProbeReportText(report)) {
+                qInfo().noquote() << line;
+            }
+            if (!report.error.isEmpty()) {
+                app.exit(2);
+                return;
+            }
+            if (!outputPath.isEmpty()) {
+                Device device;
+                device.settings.id = QUuid::createUuid();
+                device.settings.description = QObject::tr("Слейв %0").arg(report.slaveAddress);
+                device.settings.connectionParams = report.params;
+                ModbusConfigModel model;
+                model.insertDevice(device);
+                QString error = applyProbedSensorMaps(&model, device.settings.id, report);
+                QFile output(outputPath);
+                if (error.isEmpty() && !output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                    error = QObject::tr("Не удалось открыть %0: %1")
+                                .arg(output.fileName(), output.errorString());
+                }
+                if (!error.isEmpty()) {
+                    qCritical().noquote() << error;
+                    app.exit(1);
+                    return;
+                }
+                output.write(QJsonDocument(Serializer().serialize(model)).toJson());
+            }
+            app.exit(report.spans.isEmpty() ? 2 : 0);
+        });
+    QTimer::singleShot(0, &prober, [&prober, params, slave]() {
+        prober.start(params, quint8(slave));
+    });
+    return app.exec();
+}
+
+int replayTrace(const ModbusConfig::ModbusConfigModel &model, const QString &tracePath,
+    const QString &livePath)
+{
+    using namespace ModbusConfig;
+    RegisterTrace trace;
+    const QString error = trace.open(tracePath);
+    if (!error.isEmpty()) {
+        qCritical().noquote() << error;
+        return 1;
+    }
+    if (trace.configHash() != Serializer::contentHash(model)) {
+        qWarning().noquote() << QObject::tr("Запись сделана по другой версии конфигурации");
+    }
+    TraceReplayer replayer(model, trace);
+    const ReplayStats decoded = replayer.decode();
+
+    // изменения датчиков публикуются в образ значений, как при опросе
+    LiveImageWriter writer;
+    QVector<LiveHandle> handles;
+    TraceReplayer::Sink sink;
+    if (!livePath.isEmpty()) {
+        const auto layout = LiveImageLayoutGenerator().generate(model);
+        const QString liveError = writer.create(livePath, layout);
+        if (!liveError.isEmpty()) {
+            qCritical().noquote() << liveError;
+            return 1;
+        }
+        qInfo().noquote() << QObject::tr("Образ значений %0: блоков %1, карт %2, датчиков %3, "
+                                         "%4 КиБ")
+                                 .arg(livePath)
+                                 .arg(writer.blockCount())
+                                 .arg(writer.mapCount())
+                                 .arg(writer.sensorCount())
+                                 .arg(layout.fileSize / 1024);
+        for (int i = 0; i < replayer.sensorCount(); ++i) {
+            handles.append(writer.sensorHandle(replayer.sensorId(i)));
+        }
+        sink = [&writer, &handles](const QUuid &, qint64,
+                   const QVector<QPair<int, double>> &changes) {
+            writer.writeSensorValues(handles, changes);
+        };
+    }
+    const ReplayStats replayed = replayer.replay(sink);
+    qInfo().noquote() << QObject::tr("Запись: блоков %0, ответов %1, значений регистров %2, %3 с")
+                             .arg(trace.blockCount())
+                             .arg(decoded.polls)
+                             .arg(decoded.samples)
+                             .arg(decoded.traceDuration, 0, 'f', 1);
+    qInfo().noquote() << QObject::tr("Разбор записи: %0 млн значений/с")
+                             .arg(decoded.samples / decoded.elapsed / 1e6, 0, 'f', 1);
+    qInfo().noquote() << QObject::tr("Обновление датчиков: %0 датчиков, %1 изменений, "
+                                     "%2 млн значений/с, быстрее реального времени в %3 раз")
+                             .arg(replayer.sensorCount())
+                             .arg(replayed.changes)
+                             .arg(replayed.samples / replayed.elapsed / 1e6, 0, 'f', 1)
+                             .arg(replayed.traceDuration / replayed.elapsed, 0, 'f', 0);
+    return 0;
+}
+
+int tuneThresholds(ModbusConfig::ModbusConfigModel model, const QString &tracePath,
+    double targetRate, const QString &outputPath)
+{
+    using namespace ModbusConfig;
+    RegisterTrace trace;
+    QString error = trace.open(tracePath);
+    if (!error.isEmpty()) {
+        qCritical().noquote() << error;
+        return 1;
+    }
+    if (trace.configHash() != Serializer::contentHash(model)) {
+        qWarning().noquote() << QObject::tr("Запись сделана по другой версии конфигурации");
+    }
+    const auto report = ThresholdTuner().tune(model, trace, targetRate);
+    for (const auto &line : thresholdTuningReportText(report)) {
+        qInfo().noquote() << line;
+    }
+    if (!report.error.isEmpty()) {
+        return 2;
+    }
+    if (!outputPath.isEmpty()) {
+        error = applyThresholdTuning(&model, report);
+        QFile output(outputPath);
+        if (error.isEmpty() && !output.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            error = QObject::tr("Не удалось открыть %0: %1")
+                        .arg(output.fileName(), output.errorString());
+        }
+        if (!error.isEmpty()) {
+            qCritical().noquote() << error;
+            return 1;
+        }
+        output.write(QJsonDocument(Serializer().serialize(model)).toJson());
+    }
+    return report.targetReached ? 0 : 2;
+}
+// capturePath - регистры подряд, как пришли по сети; лучшие порядки печатаются первыми
+int inferByteOrder(const QString &capturePath, const QString &valType, const QString &minValue,
+    const QString &maxValue, int resultCount)
+{
+    using namespace ModbusConfig;
+    ByteOrderCapture capture;
+    capture.valType = toValueType(valType);
+    if (capture.valType == RegisterAddress::ValType::Unknown) {
+        qCritical().noquote() << QObject::tr("Неизвестный тип значения %0").arg(valType);
+        return 1;
+    }
+    if (!minValue.isEmpty() && !maxValue.isEmpty()) {
+        capture.minValue = minValue.toDouble();
+        capture.maxValue = maxValue.toDouble();
+    }
+    QFile file(capturePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical().noquote() << QObject::tr("Не удалось открыть %0: %1")
+            .arg(file.fileName(), file.errorString());
+        return 1;
+    }
+    capture.registers = file.readAll();
+    ByteOrderInference inference;
+    inference.setResultCount(resultCount);
+    const auto candidates = inference.rank(capture);
+    if (candidates.isEmpty() || candidates.first().inRange == 0) {
+        qCritical().noquote() << QObject::tr("В %0 нет значений типа %1")
+            .arg(capturePath, valType);
+        return 2;
+    }
+    for (const auto &candidate : candidates) {
+        qInfo().noquote() << QObject::tr("%0: в диапазоне %1%, скачки %2, оценка %3")
+                                 .arg(candidate.typeOrder.isEmpty()
+                                         ? QObject::tr("без перестановки")
+                                         : candidate.typeOrder)
+                                 .arg(candidate.inRange * 100, 0, 'f', 1)
+                                 .arg(candidate.jitter, 0, 'g', 3)
+                                 .arg(candidate.score, 0, 'f', 4);
+    }
+    return 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    using namespace ModbusConfig;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QObject::tr(
+        "Проверка устройств Modbus по файлу конфигурации\n\n"
+        "Команды:\n"
+        "  check     один запрос чтения каждому устройству: задержки и ошибки\n"
+        "  discover  поиск слейвов на линии, вместо файла - строка подключения,\n"
+        "            например tcp:192.168.0.10:502 или serial_rtu:/dev/ttyS0:9600:8:N:1\n"
+        "  registers поиск читаемых диапазонов регистров слейва, вместо файла - строка\n"
+        "            подключения, как у discover\n"
+        "  replay    прогон записи опроса (--trace) через обновление датчиков конфигурации,\n"
+        "            с --live-image - с публикацией значений в образ в общей памяти\n"
+        "  thresholds подбор порогов обновления датчиков по записи опроса (--trace) под\n"
+        "            целевой поток на сервер (--rate); датчики, вычисляемые по другим\n"
+        "            датчикам, не подбираются и в поток не входят"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("command"), QObject::tr("Команда"));
+    parser.addPositionalArgument(QStringLiteral("target"),
+        QObject::tr("Файл конфигурации или строка подключения"));
+    QCommandLineOption parallelOption(QStringLiteral("parallel"),
+        QObject::tr("Не больше стольких устройств одновременно"), QStringLiteral("count"),
+        QStringLiteral("256"));
+    QCommandLineOption timeoutOption(QStringLiteral("timeout"),
+        QObject::tr("Таймаут подключения и ответа, мс"), QStringLiteral("msec"),
+        QStringLiteral("1000"));
+    QCommandLineOption verboseOption(QStringLiteral("verbose"),
+        QObject::tr("Печатать результат каждого устройства"));
+    QCommandLineOption firstOption(QStringLiteral("first"),
+        QObject::tr("discover: первый адрес слейва"), QStringLiteral("address"),
+        QStringLiteral("1"));
+    QCommandLineOption lastOption(QStringLiteral("last"),
+        QObject::tr("discover: последний адрес слейва"), QStringLiteral("address"),
+        QStringLiteral("247"));
+    QCommandLineOption registerOption(QStringLiteral("register"),
+        QObject::tr("discover: читаемый регистр"), QStringLiteral("address"),
+        QStringLiteral("40001"));
+    QCommandLineOption registerTypeOption(QStringLiteral("register-type"),
+        QObject::tr("discover: тип регистра, как в конфигурации"), QStringLiteral("type"),
+        QStringLiteral("analog_output_holding_registers"));
+    QCommandLineOption windowOption(QStringLiteral("window"),
+        QObject::tr("discover, registers: запросов в полёте по TCP (по умолчанию 16 и 4)"),
+        QStringLiteral("count"));
+    QCommandLineOption responseDelayOption(QStringLiteral("response-delay"),
+        QObject::tr("discover, registers: задержка ответа на RTU сверх времени передачи, мс"),
+        QStringLiteral("msec"), QStringLiteral("20"));
+    QCommandLineOption slaveOption(QStringLiteral("slave"),
+        QObject::tr("registers: адрес слейва"), QStringLiteral("address"), QStringLiteral("1"));
+    QCommandLineOption minSpanOption(QStringLiteral("min-span"),
+        QObject::tr("registers: диапазоны короче могут быть пропущены, 1 - полный поиск"),
+        QStringLiteral("count"), QStringLiteral("16"));
+    QCommandLineOption outputOption(QStringLiteral("output"),
+        QObject::tr("discover, registers, thresholds: записать результат в файл конфигурации"),
+        QStringLiteral("file"));
+    QCommandLineOption traceOption(QStringLiteral("trace"),
+        QObject::tr("replay, thresholds: файл записи опроса"), QStringLiteral("file"));
+    QCommandLineOption liveImageOption(QStringLiteral("live-image"),
+        QObject::tr("replay: файл образа значений, например /dev/shm/modbus.live"),
+        QStringLiteral("file"));
+    QCommandLineOption rateOption(QStringLiteral("rate"),
+        QObject::tr("thresholds: целевой поток на сервер, сообщений в секунду"),
+        QStringLiteral("count"), QStringLiteral("100"));
+    parser.addOption(parallelOption);
+    parser.addOption(timeoutOption);
+    parser.addOption(verboseOption);
+    parser.addOption(firstOption);
+    parser.addOption(lastOption);
+    parser.addOption(registerOption);
+    parser.addOption(registerTypeOption);
+    parser.addOption(windowOption);
+    parser.addOption(responseDelayOption);
+    parser.addOption(slaveOption);
+    parser.addOption(minSpanOption);
+    parser.addOption(outputOption);
+    parser.addOption(traceOption);
+    parser.addOption(liveImageOption);
+    QCommandLineOption valTypeOption(QStringLiteral("val-type"),
+        QObject::tr("byte-order: тип значения, как в конфигурации"), QStringLiteral("type"));
+    QCommandLineOption minOption(QStringLiteral("min"),
+        QObject::tr("byte-order: ожидаемый минимум значений"), QStringLiteral("value"));
+    QCommandLineOption maxOption(QStringLiteral("max"),
+        QObject::tr("byte-order: ожидаемый максимум значений"), QStringLiteral("value"));
+    QCommandLineOption candidatesOption(QStringLiteral("candidates"),
+        QObject::tr("byte-order: сколько лучших порядков печатать"), QStringLiteral("count"),
+        QStringLiteral("8"));
+    parser.addOption(rateOption);
+    parser.addOption(valTypeOption);
+    parser.addOption(minOption);
+    parser.addOption(maxOption);
+    parser.addOption(candidatesOption);
+    parser.process(a);
+
+    const QStringList arguments = parser.positionalArguments();
+    const QString command = arguments.value(0);
+    if (arguments.size() != 2
+        || (command != QStringLiteral("check") && command != QStringLiteral("discover")
+            && command != QStringLiteral("registers") && command != QStringLiteral("replay")
+            && command != QStringLiteral("thresholds") && command != QStringLiteral("byte-order"))
+        || ((command == QStringLiteral("replay") || command == QStringLiteral("thresholds"))
+            && !parser.isSet(traceOption))
+        || (command == QStringLiteral("byte-order") && !parser.isSet(valTypeOption))) {
+        parser.showHelp(1);
+    }
+
+    if (command == QStringLiteral("byte-order")) {
+        return inferByteOrder(arguments.at(1), parser.value(valTypeOption),
+            parser.value(minOption), parser.value(maxOption),
+            parser.value(candidatesOption).toInt());
+    }
+
+    if (command == QStringLiteral("registers")) {
+        QString error;
+        const auto params = toConnectionParams(arguments.at(1), arguments.at(1), &error);
+        if (!error.isEmpty()) {
+            qCritical().noquote() << error;
+            return 1;
+        }
+        RegisterProber prober;
+        prober.setMinSpan(parser.value(minSpanOption).toInt());
+        if (parser.isSet(windowOption)) {
+            prober.setWindow(parser.value(windowOption).toInt());
+        }
+        prober.setTimeout(parser.value(timeoutOption).toInt());
+        prober.setResponseDelay(parser.value(responseDelayOption).toInt());
+        return probeRegisters(a, prober, params, parser.value(slaveOption).toInt(),
+            parser.value(outputOption));
+    }
+
+    if (command == QStringLiteral("discover")) {
+        QString error;
+        const auto params = toConnectionParams(arguments.at(1), arguments.at(1), &error);
+        const auto registerType = toRegisterType(parser.value(registerTypeOption));
+        if (error.isEmpty() && registerType == RegisterAddress::RegisterType::Unknown) {
+            error = QObject::tr("Неизвестный тип регистра %0")
+                        .arg(parser.value(registerTypeOption));
+        }
+        if (!error.isEmpty()) {
+            qCritical().noquote() << error;
+            return 1;
+        }
+        SlaveDiscovery discovery;
+        discovery.setRange(parser.value(firstOption).toInt(), parser.value(lastOption).toInt());
+        discovery.setProbeRegister(registerType, parser.value(registerOption).toInt());
+        if (parser.isSet(windowOption)) {
+            discovery.setWindow(parser.value(windowOption).toInt());
+        }
+        discovery.setTimeout(parser.value(timeoutOption).toInt());
+        discovery.setResponseDelay(parser.value(responseDelayOption).toInt());
+        return discoverSlaves(a, discovery, params, parser.value(outputOption));
+    }
+    QFile file(arguments.at(1));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical().noquote() << QObject::tr("Не удалось открыть %0: %1")
+            .arg(file.fileName(), file.errorString());
+        return 1;
+    }
+    QString error;
+    const auto model = Serializer().deserialize(
+        QJsonDocument::fromJson(file.readAll()).object(), &error);
+    if (!error.isEmpty()) {
+        qCritical().noquote() << error;
+        return 1;
+    }
+
+    if (command == QStringLiteral("replay")) {
+        return replayTrace(model, parser.value(traceOption), parser.value(liveImageOption));
+    }
+    if (command == QStringLiteral("thresholds")) {
+        return tuneThresholds(model, parser.value(traceOption),
+            parser.value(rateOption).toDouble(), parser.value(outputOption));
+    }
+    raiseFileLimit();
+    return checkConnections(a, model, parser.value(parallelOption).toInt(),
+        parser.value(timeoutOption).toInt(), parser.isSet(verboseOption));
+}
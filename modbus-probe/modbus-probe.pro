@@ -0,0 +1,17 @@
+QT       += core gui network concurrent
+
+# utils.h из ядра конфигурации использует QComboBox
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(../modbus-config-editor/modbusconfigcore.pri)
+
+SOURCES += \
+    main.cpp
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,129 @@
+#include "eventloop.h"
+
+#include <QObject>
+
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+constexpr int maxEvents = 64;
+// период проверки флага остановки
+constexpr int pollTimeout = 100;
+
+QString systemError(const QString &what)
+{
+    return QObject::tr("%0: %1").arg(what, QString::fromLocal8Bit(std::strerror(errno)));
+}
+}
+
+namespace ModbusSimulator {
+
+qint64 monotonicNow()
+{
+    timespec now{};
+    ::clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+void setTimerDeadline(int timer, qint64 deadline)
+{
+    itimerspec spec{};
+    if (deadline > 0) {
+        spec.it_value.tv_sec = deadline / 1000000000;
+        spec.it_value.tv_nsec = deadline % 1000000000;
+    }
+    ::timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+EventLoop::EventLoop()
+    : mEpoll(::epoll_create1(EPOLL_CLOEXEC))
+{
+}
+
+EventLoop::~EventLoop()
+{
+    for (const auto &source : mSources) {
+        if (source.timer) {
+            ::close(source.fd);
+        }
+    }
+    if (mEpoll >= 0) {
+        ::close(mEpoll);
+    }
+}
+
+QString EventLoop::addReader(int fd, const Handler &handler)
+{
+    return add(fd, false, handler);
+}
+
+QString EventLoop::addTimer(int interval, const Handler &handler)
+{
+    const int fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        return systemError(QStringLiteral("timerfd_create"));
+    }
+    itimerspec spec{};
+    spec.it_interval.tv_sec = interval / 1000;
+    spec.it_interval.tv_nsec = (interval % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (::timerfd_settime(fd, 0, &spec, nullptr) != 0) {
+        const QString error = systemError(QStringLiteral("timerfd_settime"));
+        ::close(fd);
+        return error;
+    }
+    const QString error = add(fd, true, handler);
+    if (!error.isEmpty()) {
+        ::close(fd);
+    }
+    return error;
+}
+
+QString EventLoop::run(const std::atomic<bool> &stop)
+{
+    epoll_event events[maxEvents];
+    while (!stop.load(std::memory_order_relaxed)) {
+        const int count = ::epoll_wait(mEpoll, events, maxEvents, pollTimeout);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return systemError(QStringLiteral("epoll_wait"));
+        }
+        for (int i = 0; i < count; ++i) {
+            const Source &source = mSources.at(int(events[i].data.u32));
+            if (source.timer) {
+                quint64 expirations = 0;
+                if (::read(source.fd, &expirations, sizeof(expirations)) < 0) {
+                    continue;
+                }
+            }
+            const QString error = source.handler();
+            if (!error.isEmpty()) {
+                return error;
+            }
+        }
+    }
+    return {};
+}
+
+QString EventLoop::add(int fd, bool timer, const Handler &handler)
+{
+    if (mEpoll < 0) {
+        return systemError(QStringLiteral("epoll_create1"));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u32 = quint32(mSources.size());
+    if (::epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return systemError(QStringLiteral("epoll_ctl"));
+    }
+    mSources.append({fd, timer, handler});
+    return {};
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+
+namespace ModbusSimulator {
+
+// CLOCK_MONOTONIC в нс
+qint64 monotonicNow();
+// однократное срабатывание timerfd в момент deadline по monotonicNow(), 0 - снять таймер
+void setTimerDeadline(int timer, qint64 deadline);
+
+// Однопоточный цикл на epoll: источники (вложенные epoll симуляторов, таймеры)
+// обрабатываются по очереди, поэтому образ регистров не требует синхронизации.
+class EventLoop
+{
+public:
+    // обработчик возвращает ошибку, после которой цикл завершается
+    using Handler = std::function<QString()>;
+
+    EventLoop();
+    ~EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // источники добавляются до run(); handler вызывается, когда fd готов к чтению
+    QString addReader(int fd, const Handler &handler);
+    // периодический вызов handler раз в interval мс
+    QString addTimer(int interval, const Handler &handler);
+
+    QString run(const std::atomic<bool> &stop);
+
+private:
+    struct Source {
+        int fd;
+        bool timer;
+        Handler handler;
+    };
+
+    QString add(int fd, bool timer, const Handler &handler);
+
+private:
+    int mEpoll{-1};
+    QVector<Source> mSources;
+};
+
+}
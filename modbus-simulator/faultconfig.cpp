@@ -0,0 +1,145 @@
+#include "faultconfig.h"
+
+#include "utils.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QObject>
+
+namespace {
+using Distribution = ModbusSimulator::LatencySettings::Distribution;
+
+bool toDistribution(const QString &text, Distribution *distribution)
+{
+    static const QHash<QString, Distribution> distributions = {
+        {QStringLiteral("fixed"), Distribution::Fixed},
+        {QStringLiteral("uniform"), Distribution::Uniform},
+        {QStringLiteral("normal"), Distribution::Normal},
+        {QStringLiteral("exponential"), Distribution::Exponential}
+    };
+    auto it = distributions.constFind(text);
+    if (it == distributions.constEnd()) {
+        return false;
+    }
+    *distribution = it.value();
+    return true;
+}
+
+QString readProbability(const QJsonObject &obj, const QString &key, double *probability)
+{
+    *probability = obj.value(key).toDouble(*probability);
+    if (!(*probability >= 0 && *probability <= 1)) {
+        return QObject::tr("%0 должно быть вероятностью от 0 до 1").arg(key);
+    }
+    return {};
+}
+
+QString readLatency(const QJsonObject &obj, ModbusSimulator::LatencySettings *latency)
+{
+    const QString name = obj.value(QStringLiteral("distribution")).toString();
+    if (!toDistribution(name, &latency->distribution)) {
+        return QObject::tr("Неизвестное распределение задержки '%0'").arg(name);
+    }
+    latency->mean = obj.value(QStringLiteral("mean")).toDouble();
+    latency->stddev = obj.value(QStringLiteral("stddev")).toDouble();
+    latency->min = obj.value(QStringLiteral("min")).toDouble();
+    latency->max = obj.value(QStringLiteral("max")).toDouble();
+    if (latency->mean < 0 || latency->stddev < 0 || latency->min < 0 || latency->max < 0) {
+        return QObject::tr("Параметры задержки не могут быть отрицательными");
+    }
+    if (latency->distribution == Distribution::Uniform && latency->max < latency->min) {
+        return QObject::tr("max меньше min");
+    }
+    return {};
+}
+
+QString readException(const QJsonObject &obj, ModbusSimulator::ExceptionFault *fault)
+{
+    using namespace ModbusConfig;
+    fault->regType = toRegisterType(obj.value(QStringLiteral("reg_type")).toString());
+    fault->address = obj.value(QStringLiteral("address")).toInt();
+    fault->count = obj.value(QStringLiteral("count")).toInt(1);
+    const int code = obj.value(QStringLiteral("code")).toInt(4);
+    fault->code = quint8(code);
+    fault->probability = 1;
+
+    QString error = checkRegisterAddress(fault->regType, fault->address);
+    if (error.isEmpty() && fault->count < 1) {
+        error = QObject::tr("count должно быть положительным");
+    }
+    if (error.isEmpty() && (code < 1 || code > 0x7F)) {
+        error = QObject::tr("Некорректный код исключения %0").arg(code);
+    }
+    if (error.isEmpty()) {
+        error = readProbability(obj, QStringLiteral("probability"), &fault->probability);
+    }
+    return error;
+}
+
+QString readProfile(const QJsonObject &obj, ModbusSimulator::FaultProfile *profile)
+{
+    QString error;
+    if (obj.contains(QStringLiteral("latency"))) {
+        error = readLatency(obj.value(QStringLiteral("latency")).toObject(), &profile->latency);
+    }
+    if (error.isEmpty()) {
+        error = readProbability(obj, QStringLiteral("drop"), &profile->drop);
+    }
+    if (error.isEmpty()) {
+        error = readProbability(obj, QStringLiteral("reset"), &profile->reset);
+    }
+    if (error.isEmpty()) {
+        error = readProbability(obj, QStringLiteral("corrupt_crc"), &profile->corruptCrc);
+    }
+    for (const auto &value : obj.value(QStringLiteral("exceptions")).toArray()) {
+        if (!error.isEmpty()) {
+            break;
+        }
+        ModbusSimulator::ExceptionFault fault;
+        error = readException(value.toObject(), &fault);
+        profile->exceptions.append(fault);
+    }
+    return error;
+}
+}
+
+namespace ModbusSimulator {
+
+QString readFaultConfig(const QString &path, FaultConfig *config)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QObject::tr("Не удалось открыть %0: %1").arg(path, file.errorString());
+    }
+    QJsonParseError parseError;
+    const auto document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (!document.isObject()) {
+        return QObject::tr("%0: %1").arg(path, parseError.errorString());
+    }
+    const QJsonObject root = document.object();
+    config->seed = quint64(root.value(QStringLiteral("seed")).toDouble(double(config->seed)));
+
+    const QJsonObject devices = root.value(QStringLiteral("devices")).toObject();
+    for (auto it = devices.constBegin(); it != devices.constEnd(); ++it) {
+        FaultProfile profile;
+        const QString error = readProfile(it.value().toObject(), &profile);
+        if (!error.isEmpty()) {
+            return QObject::tr("Неисправности '%0': %1").arg(it.key(), error);
+        }
+        if (it.key() == QLatin1String("*")) {
+            config->hasDefault = true;
+            config->defaultProfile = profile;
+            continue;
+        }
+        const QUuid id(it.key());
+        if (id.isNull()) {
+            return QObject::tr("'%0' не является UUID устройства").arg(it.key());
+        }
+        config->devices.insert(id, profile);
+    }
+    return {};
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QHash>
+#include <QString>
+#include <QUuid>
+#include <QVector>
+
+namespace ModbusSimulator {
+
+// Распределение задержки ответа, значения в мс.
+// fixed - mean; uniform - от min до max; normal - mean и stddev;
+// exponential - min плюс экспоненциальная часть со средним mean.
+// У normal и exponential max > 0 ограничивает задержку сверху.
+struct LatencySettings {
+    enum class Distribution {
+        None,
+        Fixed,
+        Uniform,
+        Normal,
+        Exponential
+    };
+
+    Distribution distribution{Distribution::None};
+    double mean{};
+    double stddev{};
+    double min{};
+    double max{};
+};
+
+// Ответ исключением на запросы, задевающие регистры address..address + count - 1.
+struct ExceptionFault {
+    ModbusConfig::RegisterAddress::RegisterType regType;
+    // адрес как в конфигурации (например 40001)
+    int address;
+    int count;
+    quint8 code;
+    double probability;
+};
+
+// Неисправности устройства, вероятности - на запрос.
+struct FaultProfile {
+    LatencySettings latency;
+    double drop{};
+    // только TCP: соединение сбрасывается (RST) вместо ответа
+    double reset{};
+    // только RTU: ответ с искажённой CRC
+    double corruptCrc{};
+    QVector<ExceptionFault> exceptions;
+};
+
+// Файл неисправностей симулятора (JSON):
+// {"seed": 1, "devices": {"<UUID устройства>" | "*": {
+//   "latency": {"distribution": "fixed" | "uniform" | "normal" | "exponential",
+//               "mean": 0, "stddev": 0, "min": 0, "max": 0},
+//   "drop": 0, "reset": 0, "corrupt_crc": 0,
+//   "exceptions": [{"reg_type": "analog_output_holding_registers", "address": 40001,
+//                   "count": 1, "code": 4, "probability": 1}]}}}
+// "*" - профиль устройств, не указанных отдельно.
+struct FaultConfig {
+    quint64 seed{1};
+    bool hasDefault{};
+    FaultProfile defaultProfile;
+    QHash<QUuid, FaultProfile> devices;
+};
+
+QString readFaultConfig(const QString &path, FaultConfig *config);
+
+}
@@ -0,0 +1,154 @@
+#include "faultinjector.h"
+
+#include "modbusslave.h"
+
+#include <cmath>
+
+namespace {
+constexpr double pi = 3.14159265358979323846;
+
+// splitmix64: быстрый генератор с хорошим перемешиванием соседних зёрен
+quint64 nextRandom(quint64 *state)
+{
+    quint64 z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// FNV-1a
+quint64 hash(const QByteArray &data)
+{
+    quint64 result = 0xCBF29CE484222325ull;
+    for (char c : data) {
+        result = (result ^ quint8(c)) * 0x100000001B3ull;
+    }
+    return result;
+}
+
+bool overlaps(const ModbusSimulator::RequestRange &range, int first, int end)
+{
+    return range.first < end && first < range.first + range.count;
+}
+}
+
+namespace ModbusSimulator {
+
+void FaultInjector::build(const Simulation &simulation, const FaultConfig &config)
+{
+    mProfiles.clear();
+    mUnitProfiles.clear();
+    mUnitStates.clear();
+
+    QHash<QUuid, int> profileIndex;
+    auto addProfile = [this](const FaultProfile &settings) {
+        Profile profile;
+        profile.settings = settings;
+        for (const auto &fault : settings.exceptions) {
+            const int first = ModbusConfig::pduAddress(fault.regType, fault.address);
+            profile.exceptions.append(
+                {fault.regType, first, first + fault.count, fault.code, fault.probability});
+        }
+        mProfiles.append(profile);
+        return mProfiles.size() - 1;
+    };
+    const int defaultProfile = config.hasDefault ? addProfile(config.defaultProfile) : -1;
+
+    const int unitCount = simulation.image().unitCount();
+    for (int unit = 0; unit < unitCount; ++unit) {
+        const QUuid device = simulation.unitDevice(unit);
+        int profile = defaultProfile;
+        auto it = config.devices.constFind(device);
+        if (it != config.devices.constEnd()) {
+            auto indexIt = profileIndex.find(device);
+            if (indexIt == profileIndex.end()) {
+                indexIt = profileIndex.insert(device, addProfile(it.value()));
+            }
+            profile = indexIt.value();
+        }
+        // номер слейва добавляется, чтобы слейвы одного устройства не повторяли друг друга
+        quint64 state = config.seed ^ hash(device.toByteArray());
+        state += quint64(unit) * 0x9E3779B97F4A7C15ull;
+        mUnitProfiles.append(profile);
+        mUnitStates.append(nextRandom(&state));
+    }
+}
+
+FaultDecision FaultInjector::decide(int unit, const quint8 *pdu, int size)
+{
+    FaultDecision decision;
+    if (unit < 0 || unit >= mUnitProfiles.size() || mUnitProfiles.at(unit) < 0) {
+        return decision;
+    }
+    const Profile &profile = mProfiles.at(mUnitProfiles.at(unit));
+    const FaultProfile &settings = profile.settings;
+    quint64 *state = &mUnitStates[unit];
+
+    if (settings.reset > 0 && uniform(state) < settings.reset) {
+        decision.reset = true;
+        return decision;
+    }
+    if (settings.drop > 0 && uniform(state) < settings.drop) {
+        decision.drop = true;
+        return decision;
+    }
+    if (!profile.exceptions.isEmpty()) {
+        RequestRange ranges[2];
+        const int rangeCount = requestRanges(pdu, size, ranges);
+        for (const auto &exception : profile.exceptions) {
+            bool hit = false;
+            for (int i = 0; i < rangeCount; ++i) {
+                hit = hit || (ranges[i].regType == exception.regType
+                    && overlaps(ranges[i], exception.first, exception.end));
+            }
+            if (hit && (exception.probability >= 1 || uniform(state) < exception.probability)) {
+                decision.exception = exception.code;
+                break;
+            }
+        }
+    }
+    decision.latency = latency(settings.latency, state);
+    if (settings.corruptCrc > 0 && uniform(state) < settings.corruptCrc) {
+        decision.corruptCrc = true;
+    }
+    return decision;
+}
+
+double FaultInjector::uniform(quint64 *state)
+{
+    // старшие 53 бита - равномерно в [0, 1)
+    return double(nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+qint64 FaultInjector::latency(const LatencySettings &settings, quint64 *state)
+{
+    using Distribution = LatencySettings::Distribution;
+    double ms = 0;
+    switch (settings.distribution) {
+    case Distribution::None:
+        return 0;
+    case Distribution::Fixed:
+        ms = settings.mean;
+        break;
+    case Distribution::Uniform:
+        ms = settings.min + (settings.max - settings.min) * uniform(state);
+        break;
+    case Distribution::Normal: {
+        // Бокс-Мюллер, второе значение пары не используется
+        const double u = 1 - uniform(state);
+        const double v = uniform(state);
+        ms = settings.mean + settings.stddev * std::sqrt(-2 * std::log(u)) * std::cos(2 * pi * v);
+        ms = qMax(ms, settings.min);
+        break;
+    }
+    case Distribution::Exponential:
+        ms = settings.min - settings.mean * std::log(1 - uniform(state));
+        break;
+    }
+    if (settings.max > 0) {
+        ms = qMin(ms, settings.max);
+    }
+    return qint64(qMax(ms, 0.0) * 1e6);
+}
+
+}
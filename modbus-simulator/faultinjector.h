@@ -0,0 +1,57 @@
+#pragma once
+
+#include "faultconfig.h"
+#include "simulation.h"
+
+#include <QVector>
+
+namespace ModbusSimulator {
+
+// Что сделать с запросом вместо обычного ответа.
+struct FaultDecision {
+    bool reset{};
+    bool drop{};
+    // код исключения или 0
+    quint8 exception{};
+    bool corruptCrc{};
+    // задержка ответа в нс
+    qint64 latency{};
+};
+
+// Неисправности слейвов одной Simulation. У каждого слейва свой генератор,
+// засеянный seed и UUID устройства, поэтому последовательность решений слейва
+// повторяется от запуска к запуску и не зависит от запросов к другим слейвам.
+class FaultInjector
+{
+public:
+    FaultInjector() = default;
+
+    void build(const Simulation &simulation, const FaultConfig &config);
+    FaultDecision decide(int unit, const quint8 *pdu, int size);
+
+private:
+    struct Exception {
+        ModbusConfig::RegisterAddress::RegisterType regType;
+        // смещения PDU
+        int first;
+        int end;
+        quint8 code;
+        double probability;
+    };
+
+    struct Profile {
+        FaultProfile settings;
+        QVector<Exception> exceptions;
+    };
+
+    static double uniform(quint64 *state);
+    static qint64 latency(const LatencySettings &settings, quint64 *state);
+
+private:
+    QVector<Profile> mProfiles;
+    // по слейву: индекс профиля или -1 и состояние генератора
+    QVector<int> mUnitProfiles;
+    QVector<quint64> mUnitStates;
+};
+
+}
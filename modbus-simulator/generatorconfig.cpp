@@ -0,0 +1,149 @@
+#include "generatorconfig.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QObject>
+#include <QRegularExpression>
+#include <QTextStream>
+
+namespace {
+using Kind = ModbusSimulator::GeneratorSettings::Kind;
+
+bool toKind(const QString &text, Kind *kind)
+{
+    static const QHash<QString, Kind> kinds = {
+        {QStringLiteral("ramp"), Kind::Ramp},
+        {QStringLiteral("sine"), Kind::Sine},
+        {QStringLiteral("random_walk"), Kind::RandomWalk},
+        {QStringLiteral("step"), Kind::Step},
+        {QStringLiteral("replay"), Kind::Replay}
+    };
+    auto it = kinds.constFind(text);
+    if (it == kinds.constEnd()) {
+        return false;
+    }
+    *kind = it.value();
+    return true;
+}
+
+// строки значений через запятую, точку с запятой или пробелы, # - комментарий
+QString readReplayFile(const QString &path, QVector<QVector<double>> *rows)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return QObject::tr("Не удалось открыть %0: %1").arg(path, file.errorString());
+    }
+    static const QRegularExpression separators(QStringLiteral("[,;\\s]+"));
+    QTextStream stream(&file);
+    int lineNumber = 0;
+    while (!stream.atEnd()) {
+        ++lineNumber;
+        const QString line = stream.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith(QLatin1Char('#'))) {
+            continue;
+        }
+        QVector<double> row;
+        for (const auto &part : line.split(separators, Qt::SkipEmptyParts)) {
+            bool ok = false;
+            row.append(part.toDouble(&ok));
+            if (!ok) {
+                return QObject::tr("%0:%1: '%2' не является числом")
+                    .arg(path).arg(lineNumber).arg(part);
+            }
+        }
+        rows->append(row);
+    }
+    if (rows->isEmpty()) {
+        return QObject::tr("В %0 нет значений").arg(path);
+    }
+    return {};
+}
+
+QString readSettings(const QJsonObject &obj, const QString &baseDir,
+    ModbusSimulator::GeneratorSettings *settings)
+{
+    if (!toKind(obj.value(QStringLiteral("type")).toString(), &settings->kind)) {
+        return QObject::tr("Неизвестный тип генератора '%0'")
+            .arg(obj.value(QStringLiteral("type")).toString());
+    }
+    settings->min = obj.value(QStringLiteral("min")).toDouble(settings->min);
+    settings->max = obj.value(QStringLiteral("max")).toDouble(settings->max);
+    settings->period = obj.value(QStringLiteral("period")).toDouble(settings->period);
+    settings->phase = obj.value(QStringLiteral("phase")).toDouble(settings->phase);
+    settings->phaseStep = obj.value(QStringLiteral("phase_step")).toDouble(settings->phaseStep);
+    settings->step = obj.value(QStringLiteral("step")).toDouble(settings->step);
+    settings->start = obj.value(QStringLiteral("start")).toDouble(settings->start);
+    for (const auto &level : obj.value(QStringLiteral("levels")).toArray()) {
+        settings->levels.append(level.toDouble());
+    }
+
+    if (settings->max < settings->min) {
+        return QObject::tr("max меньше min");
+    }
+    switch (settings->kind) {
+    case Kind::Ramp:
+    case Kind::Sine:
+    case Kind::Step:
+        if (!(settings->period > 0)) {
+            return QObject::tr("Период должен быть положительным");
+        }
+        if (settings->kind == Kind::Step && settings->levels.isEmpty()) {
+            return QObject::tr("Для step нужен список levels");
+        }
+        break;
+    case Kind::RandomWalk:
+        if (settings->step < 0) {
+            return QObject::tr("Шаг случайного блуждания не может быть отрицательным");
+        }
+        break;
+    case Kind::Replay: {
+        const QString file = obj.value(QStringLiteral("file")).toString();
+        if (file.isEmpty()) {
+            return QObject::tr("Для replay нужен file");
+        }
+        return readReplayFile(QFileInfo(file).isAbsolute() ? file : baseDir + '/' + file,
+            &settings->rows);
+    }
+    }
+    return {};
+}
+
+}
+
+namespace ModbusSimulator {
+
+QString readGeneratorConfig(const QString &path, GeneratorConfig *config)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QObject::tr("Не удалось открыть %0: %1").arg(path, file.errorString());
+    }
+    QJsonParseError parseError;
+    const auto document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (!document.isObject()) {
+        return QObject::tr("%0: %1").arg(path, parseError.errorString());
+    }
+    const QJsonObject root = document.object();
+    config->tick = root.value(QStringLiteral("tick")).toInt(config->tick);
+    config->seed = quint32(root.value(QStringLiteral("seed")).toInt(int(config->seed)));
+    if (config->tick <= 0) {
+        return QObject::tr("Период обновления генераторов должен быть положительным");
+    }
+
+    const QString baseDir = QFileInfo(path).absolutePath();
+    const QJsonObject generators = root.value(QStringLiteral("generators")).toObject();
+    for (auto it = generators.constBegin(); it != generators.constEnd(); ++it) {
+        GeneratorSettings settings;
+        const QString error = readSettings(it.value().toObject(), baseDir, &settings);
+        if (!error.isEmpty()) {
+            return QObject::tr("Генератор '%0': %1").arg(it.key(), error);
+        }
+        config->generators.insert(it.key(), settings);
+    }
+    return {};
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include <limits>
+
+namespace ModbusSimulator {
+
+struct GeneratorSettings {
+    enum class Kind {
+        Ramp,
+        Sine,
+        RandomWalk,
+        Step,
+        Replay
+    };
+
+    Kind kind{Kind::Sine};
+    double min{};
+    double max{1};
+    // период ramp, sine и step в секундах
+    double period{60};
+    // начальная фаза и сдвиг фазы соседних значений карты - в долях периода
+    double phase{};
+    double phaseStep{};
+    // наибольшее изменение случайного блуждания за такт, старт - по умолчанию середина
+    double step{1};
+    double start{std::numeric_limits<double>::quiet_NaN()};
+    // значения step по очереди, по одному на период
+    QVector<double> levels;
+    // replay: строка на такт, значения карты берут столбцы по кругу
+    QVector<QVector<double>> rows;
+};
+
+// Файл генераторов значений симулятора (JSON):
+// {"tick": 100, "seed": 1, "generators": {"<UUID датчика>": {...},
+//  "<UUID устройства>/<id карты>": {...}}}
+// у генератора "type": "ramp" | "sine" | "random_walk" | "step" | "replay"
+// и параметры "min", "max", "period", "phase", "phase_step", "step", "start",
+// "levels" (step), "file" (replay: путь относительно файла генераторов).
+struct GeneratorConfig {
+    // период обновления в мс
+    int tick{100};
+    quint32 seed{1};
+    QHash<QString, GeneratorSettings> generators;
+};
+
+QString readGeneratorConfig(const QString &path, GeneratorConfig *config);
+
+}
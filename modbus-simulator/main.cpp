@@ -0,0 +1,194 @@
+#include "eventloop.h"
+#include "faultinjector.h"
+#include "generatorconfig.h"
+#include "rtusimulator.h"
+#include "serializer.h"
+#include "signalgenerators.h"
+#include "simulation.h"
+#include "tcpsimulator.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+
+#include <atomic>
+#include <csignal>
+#include <sys/resource.h>
+
+namespace {
+std::atomic<bool> stopRequested{false};
+
+void onSignal(int)
+{
+    stopRequested = true;
+}
+
+// по соединению и серверу на устройство - лимита дескрипторов по умолчанию не хватает
+void raiseFileLimit()
+{
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    using namespace ModbusConfig;
+    using namespace ModbusSimulator;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QObject::tr("Симулятор Modbus слейвов по файлу конфигурации"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("config"), QObject::tr("Файл конфигурации"));
+    QCommandLineOption listenOption(QStringLiteral("listen"),
+        QObject::tr("Адрес для серверов Modbus TCP"), QStringLiteral("host"),
+        QStringLiteral("127.0.0.1"));
+    QCommandLineOption portOffsetOption(QStringLiteral("port-offset"),
+        QObject::tr("Сдвиг портов относительно портов устройств"), QStringLiteral("offset"),
+        QStringLiteral("0"));
+    QCommandLineOption ptyDirOption(QStringLiteral("pty-dir"),
+        QObject::tr("Каталог ссылок на псевдотерминалы линий RTU"), QStringLiteral("dir"),
+        QDir::temp().filePath(QStringLiteral("modbus-simulator")));
+    QCommandLineOption generatorsOption(QStringLiteral("generators"),
+        QObject::tr("Файл генераторов значений датчиков и карт"), QStringLiteral("file"));
+    QCommandLineOption faultsOption(QStringLiteral("faults"),
+        QObject::tr("Файл неисправностей устройств: задержки, потери, исключения"),
+        QStringLiteral("file"));
+    QCommandLineOption statsOption(QStringLiteral("stats"),
+        QObject::tr("Печатать статистику раз в секунду"));
+    parser.addOption(listenOption);
+    parser.addOption(portOffsetOption);
+    parser.addOption(ptyDirOption);
+    parser.addOption(generatorsOption);
+    parser.addOption(faultsOption);
+    parser.addOption(statsOption);
+    parser.process(a);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+    QFile file(parser.positionalArguments().first());
+    if (!file.open(QIODevice::ReadOnly)) {
+        qCritical().noquote() << QObject::tr("Не удалось открыть %0: %1")
+            .arg(file.fileName(), file.errorString());
+        return 1;
+    }
+    QString error;
+    const auto model = Serializer().deserialize(
+        QJsonDocument::fromJson(file.readAll()).object(), &error);
+    if (!error.isEmpty()) {
+        qCritical().noquote() << error;
+        return 1;
+    }
+
+    Simulation tcpSimulation;
+    Simulation rtuSimulation;
+    for (const auto &warning : tcpSimulation.load(model, ConnectionParams::Type::Tcp)
+            + rtuSimulation.load(model, ConnectionParams::Type::RtuSerial)) {
+        qWarning().noquote() << warning;
+    }
+
+    GeneratorConfig generatorConfig;
+    if (parser.isSet(generatorsOption)) {
+        error = readGeneratorConfig(parser.value(generatorsOption), &generatorConfig);
+        if (!error.isEmpty()) {
+            qCritical().noquote() << error;
+            return 1;
+        }
+    }
+    SignalGenerators generators;
+    for (const auto &warning : generators.build({&tcpSimulation, &rtuSimulation},
+             generatorConfig)) {
+        qWarning().noquote() << warning;
+    }
+
+    FaultConfig faultConfig;
+    if (parser.isSet(faultsOption)) {
+        error = readFaultConfig(parser.value(faultsOption), &faultConfig);
+        if (!error.isEmpty()) {
+            qCritical().noquote() << error;
+            return 1;
+        }
+        for (auto it = faultConfig.devices.cbegin(); it != faultConfig.devices.cend(); ++it) {
+            if (!model.devicesIds().contains(it.key())) {
+                qWarning().noquote() << QObject::tr("Неисправности: устройство %0 не найдено")
+                    .arg(it.key().toString());
+            }
+        }
+    }
+    FaultInjector tcpFaults;
+    FaultInjector rtuFaults;
+    tcpFaults.build(tcpSimulation, faultConfig);
+    rtuFaults.build(rtuSimulation, faultConfig);
+
+    raiseFileLimit();
+    EventLoop loop;
+    TcpSimulator tcp(&tcpSimulation);
+    RtuSimulator rtu(&rtuSimulation);
+    if (parser.isSet(faultsOption)) {
+        tcp.setFaultInjector(&tcpFaults);
+        rtu.setFaultInjector(&rtuFaults);
+    }
+    if (!tcpSimulation.endpoints().isEmpty()) {
+        error = tcp.listen(parser.value(listenOption), parser.value(portOffsetOption).toInt());
+        if (error.isEmpty()) {
+            error = loop.addReader(tcp.fd(), [&tcp]() { return tcp.processEvents(); });
+        }
+    }
+    if (error.isEmpty() && !rtuSimulation.endpoints().isEmpty()) {
+        error = rtu.open(parser.value(ptyDirOption));
+        if (error.isEmpty()) {
+            error = loop.addReader(rtu.fd(), [&rtu]() { return rtu.processEvents(); });
+        }
+    }
+    if (error.isEmpty() && generators.valueCount() > 0) {
+        error = loop.addTimer(generatorConfig.tick, [&generators]() {
+            generators.tick();
+            return QString();
+        });
+    }
+    if (!error.isEmpty()) {
+        qCritical().noquote() << error;
+        return 1;
+    }
+    qInfo().noquote() << QObject::tr("Серверов TCP: %0, регистров: %1, битов: %2")
+        .arg(tcp.listenerCount())
+        .arg(tcpSimulation.image().registerCount())
+        .arg(tcpSimulation.image().bitCount());
+    for (const auto &link : rtu.links()) {
+        qInfo().noquote() << QObject::tr("Линия RTU %0: %1").arg(link.first, link.second);
+    }
+
+    quint64 lastRequests = 0;
+    QElapsedTimer statsTimer;
+    statsTimer.start();
+    if (parser.isSet(statsOption)) {
+        loop.addTimer(1000, [&]() {
+            const quint64 requests = tcp.requestCount() + rtu.requestCount();
+            const double seconds = statsTimer.restart() / 1000.0;
+            qInfo().noquote() << QObject::tr("соединений: %0, запросов/с: %1")
+                .arg(tcp.connectionCount())
+                .arg(qRound64((requests - lastRequests) / seconds));
+            lastRequests = requests;
+            return QString();
+        });
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    error = loop.run(stopRequested);
+    if (!error.isEmpty()) {
+        qCritical().noquote() << error;
+        return 1;
+    }
+    return 0;
+}
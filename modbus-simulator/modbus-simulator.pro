@@ -0,0 +1,39 @@
+QT       += core gui network concurrent
+
+# utils.h из ядра конфигурации использует QComboBox
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include(../modbus-config-editor/modbusconfigcore.pri)
+
+SOURCES += \
+    eventloop.cpp \
+    faultconfig.cpp \
+    faultinjector.cpp \
+    generatorconfig.cpp \
+    main.cpp \
+    modbusslave.cpp \
+    registerimage.cpp \
+    rtusimulator.cpp \
+    signalgenerators.cpp \
+    simulation.cpp \
+    tcpsimulator.cpp
+
+HEADERS += \
+    eventloop.h \
+    faultconfig.h \
+    faultinjector.h \
+    generatorconfig.h \
+    modbusslave.h \
+    registerimage.h \
+    rtusimulator.h \
+    signalgenerators.h \
+    simulation.h \
+    tcpsimulator.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
@@ -0,0 +1,275 @@
+#include "modbusslave.h"
+
+#include <cstring>
+
+namespace {
+using ModbusConfig::ExceptionCode;
+using ModbusConfig::FunctionCode;
+using ModbusSimulator::RegisterImage;
+using RegisterType = RegisterImage::RegisterType;
+
+constexpr int maxReadBits = 2000;
+constexpr int maxReadRegisters = 125;
+constexpr int maxWriteBits = 1968;
+constexpr int maxWriteRegisters = 123;
+constexpr int maxReadWriteRegisters = 121;
+
+int fail(const quint8 *pdu, ExceptionCode code, quint8 *response)
+{
+    return ModbusSimulator::exceptionResponse(pdu[0], code, response);
+}
+
+inline int word(const quint8 *data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+inline void putWord(quint8 *data, int value)
+{
+    data[0] = quint8(value >> 8);
+    data[1] = quint8(value);
+}
+
+int readBits(RegisterImage *image, int unit, RegisterType type, const quint8 *pdu, int size,
+    quint8 *response)
+{
+    if (size != 5) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    const int first = word(pdu + 1);
+    const int count = word(pdu + 3);
+    if (count < 1 || count > maxReadBits) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    const quint8 *bits = image->bits(unit, type, first, count);
+    if (!bits) {
+        return fail(pdu, ExceptionCode::IllegalDataAddress, response);
+    }
+    const int bytes = (count + 7) / 8;
+    response[0] = pdu[0];
+    response[1] = quint8(bytes);
+    std::memset(response + 2, 0, bytes);
+    for (int i = 0; i < count; ++i) {
+        response[2 + i / 8] |= quint8((bits[i] & 1) << (i % 8));
+    }
+    return 2 + bytes;
+}
+
+int readRegisters(RegisterImage *image, int unit, RegisterType type, const quint8 *pdu,
+    int size, quint8 *response)
+{
+    if (size != 5) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    const int first = word(pdu + 1);
+    const int count = word(pdu + 3);
+    if (count < 1 || count > maxReadRegisters) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    const quint16 *registers = image->registers(unit, type, first, count);
+    if (!registers) {
+        return fail(pdu, ExceptionCode::IllegalDataAddress, response);
+    }
+    response[0] = pdu[0];
+    response[1] = quint8(count * 2);
+    for (int i = 0; i < count; ++i) {
+        putWord(response + 2 + i * 2, registers[i]);
+    }
+    return 2 + count * 2;
+}
+
+int writeCoil(RegisterImage *image, int unit, const quint8 *pdu, int size, quint8 *response)
+{
+    if (size != 5 || (word(pdu + 3) != 0xFF00 && word(pdu + 3) != 0x0000)) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    quint8 *bits = image->bits(unit, RegisterType::DiscreteOutputCoils, word(pdu + 1), 1);
+    if (!bits) {
+        return fail(pdu, ExceptionCode::IllegalDataAddress, response);
+    }
+    bits[0] = pdu[3] ? 1 : 0;
+    std::memcpy(response, pdu, 5);
+    return 5;
+}
+
+int writeRegister(RegisterImage *image, int unit, const quint8 *pdu, int size, quint8 *response)
+{
+    if (size != 5) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    quint16 *registers = image->registers(
+        unit, RegisterType::AnalogOutputHoldingRegisters, word(pdu + 1), 1);
+    if (!registers) {
+        return fail(pdu, ExceptionCode::IllegalDataAddress, response);
+    }
+    registers[0] = quint16(word(pdu + 3));
+    std::memcpy(response, pdu, 5);
+    return 5;
+}
+
+int writeCoils(RegisterImage *image, int unit, const quint8 *pdu, int size, quint8 *response)
+{
+    if (size < 6) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    const int first = word(pdu + 1);
+    const int count = word(pdu + 3);
+    const int bytes = pdu[5];
+    if (count < 1 || count > maxWriteBits || bytes != (count + 7) / 8 || size != 6 + bytes) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    quint8 *bits = image->bits(unit, RegisterType::DiscreteOutputCoils, first, count);
+    if (!bits) {
+        return fail(pdu, ExceptionCode::IllegalDataAddress, response);
+    }
+    for (int i = 0; i < count; ++i) {
+        bits[i] = (pdu[6 + i / 8] >> (i % 8)) & 1;
+    }
+    std::memcpy(response, pdu, 5);
+    return 5;
+}
+
+int writeRegisters(RegisterImage *image, int unit, const quint8 *pdu, int size,
+    quint8 *response)
+{
+    if (size < 6) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    const int first = word(pdu + 1);
+    const int count = word(pdu + 3);
+    const int bytes = pdu[5];
+    if (count < 1 || count > maxWriteRegisters || bytes != count * 2 || size != 6 + bytes) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    quint16 *registers = image->registers(
+        unit, RegisterType::AnalogOutputHoldingRegisters, first, count);
+    if (!registers) {
+        return fail(pdu, ExceptionCode::IllegalDataAddress, response);
+    }
+    for (int i = 0; i < count; ++i) {
+        registers[i] = quint16(word(pdu + 6 + i * 2));
+    }
+    std::memcpy(response, pdu, 5);
+    return 5;
+}
+
+int readWriteRegisters(RegisterImage *image, int unit, const quint8 *pdu, int size,
+    quint8 *response)
+{
+    if (size < 10) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    const int readFirst = word(pdu + 1);
+    const int readCount = word(pdu + 3);
+    const int writeFirst = word(pdu + 5);
+    const int writeCount = word(pdu + 7);
+    const int bytes = pdu[9];
+    if (readCount < 1 || readCount > maxReadRegisters || writeCount < 1
+        || writeCount > maxReadWriteRegisters || bytes != writeCount * 2
+        || size != 10 + bytes) {
+        return fail(pdu, ExceptionCode::IllegalDataValue, response);
+    }
+    const auto type = RegisterType::AnalogOutputHoldingRegisters;
+    quint16 *written = image->registers(unit, type, writeFirst, writeCount);
+    const quint16 *read = image->registers(unit, type, readFirst, readCount);
+    if (!written || !read) {
+        return fail(pdu, ExceptionCode::IllegalDataAddress, response);
+    }
+    // по спецификации запись выполняется до чтения
+    for (int i = 0; i < writeCount; ++i) {
+        written[i] = quint16(word(pdu + 10 + i * 2));
+    }
+    response[0] = pdu[0];
+    response[1] = quint8(readCount * 2);
+    for (int i = 0; i < readCount; ++i) {
+        putWord(response + 2 + i * 2, read[i]);
+    }
+    return 2 + readCount * 2;
+}
+
+}
+
+namespace ModbusSimulator {
+
+int processRequest(RegisterImage *image, int unit, const quint8 *pdu, int size,
+    quint8 *response)
+{
+    if (size < 1) {
+        return 0;
+    }
+    switch (FunctionCode(pdu[0])) {
+    case FunctionCode::ReadCoils:
+        return readBits(image, unit, RegisterType::DiscreteOutputCoils, pdu, size, response);
+    case FunctionCode::ReadDiscreteInputs:
+        return readBits(image, unit, RegisterType::DiscreteInputContacts, pdu, size, response);
+    case FunctionCode::ReadHoldingRegisters:
+        return readRegisters(
+            image, unit, RegisterType::AnalogOutputHoldingRegisters, pdu, size, response);
+    case FunctionCode::ReadInputRegisters:
+        return readRegisters(
+            image, unit, RegisterType::AnalogInputRegisters, pdu, size, response);
+    case FunctionCode::WriteSingleCoil:
+        return writeCoil(image, unit, pdu, size, response);
+    case FunctionCode::WriteSingleRegister:
+        return writeRegister(image, unit, pdu, size, response);
+    case FunctionCode::WriteMultipleCoils:
+        return writeCoils(image, unit, pdu, size, response);
+    case FunctionCode::WriteMultipleRegisters:
+        return writeRegisters(image, unit, pdu, size, response);
+    case FunctionCode::ReadWriteMultipleRegisters:
+        return readWriteRegisters(image, unit, pdu, size, response);
+    default:
+        break;
+    }
+    return exceptionResponse(pdu[0], ExceptionCode::IllegalFunction, response);
+}
+
+int exceptionResponse(quint8 function, ExceptionCode code, quint8 *response)
+{
+    response[0] = quint8(function | 0x80);
+    response[1] = quint8(code);
+    return 2;
+}
+
+int requestRanges(const quint8 *pdu, int size, RequestRange *ranges)
+{
+    if (size < 5) {
+        return 0;
+    }
+    const int first = word(pdu + 1);
+    const int count = word(pdu + 3);
+    switch (FunctionCode(pdu[0])) {
+    case FunctionCode::ReadCoils:
+    case FunctionCode::WriteMultipleCoils:
+        ranges[0] = {RegisterType::DiscreteOutputCoils, first, count};
+        return 1;
+    case FunctionCode::ReadDiscreteInputs:
+        ranges[0] = {RegisterType::DiscreteInputContacts, first, count};
+        return 1;
+    case FunctionCode::ReadHoldingRegisters:
+    case FunctionCode::WriteMultipleRegisters:
+        ranges[0] = {RegisterType::AnalogOutputHoldingRegisters, first, count};
+        return 1;
+    case FunctionCode::ReadInputRegisters:
+        ranges[0] = {RegisterType::AnalogInputRegisters, first, count};
+        return 1;
+    case FunctionCode::WriteSingleCoil:
+        ranges[0] = {RegisterType::DiscreteOutputCoils, first, 1};
+        return 1;
+    case FunctionCode::WriteSingleRegister:
+        ranges[0] = {RegisterType::AnalogOutputHoldingRegisters, first, 1};
+        return 1;
+    case FunctionCode::ReadWriteMultipleRegisters:
+        if (size < 9) {
+            return 0;
+        }
+        ranges[0] = {RegisterType::AnalogOutputHoldingRegisters, first, count};
+        ranges[1] = {RegisterType::AnalogOutputHoldingRegisters, word(pdu + 5), word(pdu + 7)};
+        return 2;
+    default:
+        break;
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "modbusframe.h"
+#include "registerimage.h"
+
+namespace ModbusSimulator {
+
+using ModbusConfig::ExceptionCode;
+using ModbusConfig::maxPduSize;
+
+// Обработка PDU запроса к слейву unit: FC1-FC6, FC15, FC16, FC23.
+// response должен вмещать maxPduSize байт, возвращается длина PDU ответа.
+int processRequest(RegisterImage *image, int unit, const quint8 *pdu, int size,
+    quint8 *response);
+int exceptionResponse(quint8 function, ExceptionCode code, quint8 *response);
+
+struct RequestRange {
+    RegisterImage::RegisterType regType;
+    int first;
+    int count;
+};
+
+// диапазоны адресов PDU, которых касается запрос (у FC23 - запись и чтение),
+// возвращает их количество: 0 для неизвестной функции или короткого PDU
+int requestRanges(const quint8 *pdu, int size, RequestRange *ranges);
+
+}
@@ -0,0 +1,125 @@
+#include "registerimage.h"
+
+#include "utils.h"
+
+#include <algorithm>
+
+namespace ModbusSimulator {
+
+int RegisterImage::addUnit()
+{
+    mUnits.append(Unit());
+    return mUnits.size() - 1;
+}
+
+int RegisterImage::unitCount() const
+{
+    return mUnits.size();
+}
+
+void RegisterImage::cover(int unit, RegisterType type, int first, int count)
+{
+    const int table = tableIndex(type);
+    if (table < 0 || count <= 0) {
+        return;
+    }
+    mUnits[unit].blocks[table].append({first, first + count, 0});
+}
+
+void RegisterImage::build()
+{
+    int registers = 0;
+    int bits = 0;
+    for (auto &unit : mUnits) {
+        for (int table = 0; table < 4; ++table) {
+            auto &blocks = unit.blocks[table];
+            std::sort(blocks.begin(), blocks.end(), [](const Block &l, const Block &r) {
+                return l.first < r.first;
+            });
+            // пересекающиеся и смежные диапазоны объединяются в один блок
+            int merged = 0;
+            for (int i = 0; i < blocks.size(); ++i) {
+                if (merged > 0 && blocks.at(i).first <= blocks.at(merged - 1).end) {
+                    blocks[merged - 1].end = qMax(blocks.at(merged - 1).end, blocks.at(i).end);
+                    continue;
+                }
+                blocks[merged++] = blocks.at(i);
+            }
+            blocks.resize(merged);
+            const bool bitTable = ModbusConfig::isBitRegisterType(RegisterType(table + 1));
+            for (auto &block : blocks) {
+                int &size = bitTable ? bits : registers;
+                block.offset = size;
+                size += block.end - block.first;
+            }
+        }
+    }
+    mRegisters.fill(0, registers);
+    mBits.fill(0, bits);
+}
+
+quint16 *RegisterImage::registers(int unit, RegisterType type, int first, int count)
+{
+    if (ModbusConfig::isBitRegisterType(type)) {
+        return nullptr;
+    }
+    const Block *block = findBlock(unit, type, first, count);
+    return block ? mRegisters.data() + block->offset + (first - block->first) : nullptr;
+}
+
+quint8 *RegisterImage::bits(int unit, RegisterType type, int first, int count)
+{
+    if (!ModbusConfig::isBitRegisterType(type)) {
+        return nullptr;
+    }
+    const Block *block = findBlock(unit, type, first, count);
+    return block ? mBits.data() + block->offset + (first - block->first) : nullptr;
+}
+
+int RegisterImage::registerCount() const
+{
+    return mRegisters.size();
+}
+
+int RegisterImage::bitCount() const
+{
+    return mBits.size();
+}
+
+int RegisterImage::tableIndex(RegisterType type)
+{
+    switch (type) {
+    case RegisterType::DiscreteOutputCoils:
+    case RegisterType::DiscreteInputContacts:
+    case RegisterType::AnalogInputRegisters:
+    case RegisterType::AnalogOutputHoldingRegisters:
+        return ModbusConfig::toInt(type) - 1;
+    default:
+        break;
+    }
+    return -1;
+}
+
+const RegisterImage::Block *RegisterImage::findBlock(
+    int unit, RegisterType type, int first, int count) const
+{
+    const int table = tableIndex(type);
+    if (unit < 0 || unit >= mUnits.size() || table < 0 || count <= 0) {
+        return nullptr;
+    }
+    const auto &blocks = mUnits.at(unit).blocks[table];
+    auto it = std::upper_bound(blocks.cbegin(), blocks.cend(), first,
+        [](int address, const Block &block) {
+            return address < block.first;
+        });
+    if (it == blocks.cbegin()) {
+        return nullptr;
+    }
+    --it;
+    if (first + count > it->end) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "modbusentities.h"
+
+#include <QVector>
+
+namespace ModbusSimulator {
+
+// Образ регистров всех симулируемых слейвов в плоских массивах: регистры - quint16,
+// coils и discrete inputs - по байту на бит. Адреса - смещения PDU (с 0).
+// Слейв отвечает только на покрытые датчиками и картами регистры, соседние покрытые
+// диапазоны сливаются, поэтому запрос может захватывать несколько датчиков сразу.
+class RegisterImage
+{
+public:
+    using RegisterType = ModbusConfig::RegisterAddress::RegisterType;
+
+    RegisterImage() = default;
+
+    int addUnit();
+    int unitCount() const;
+
+    // до build() - только накопление покрытия
+    void cover(int unit, RegisterType type, int first, int count);
+    void build();
+
+    // count ячеек начиная с first или nullptr, если диапазон покрыт не целиком
+    quint16 *registers(int unit, RegisterType type, int first, int count);
+    quint8 *bits(int unit, RegisterType type, int first, int count);
+
+    int registerCount() const;
+    int bitCount() const;
+
+private:
+    struct Block {
+        int first;
+        int end;
+        int offset;
+    };
+
+    struct Unit {
+        QVector<Block> blocks[4];
+    };
+
+    static int tableIndex(RegisterType type);
+    const Block *findBlock(int unit, RegisterType type, int first, int count) const;
+
+private:
+    QVector<Unit> mUnits;
+    QVector<quint16> mRegisters;
+    QVector<quint8> mBits;
+};
+
+}
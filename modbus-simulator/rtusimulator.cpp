@@ -0,0 +1,340 @@
+#include "rtusimulator.h"
+
+#include "eventloop.h"
+#include "faultinjector.h"
+#include "modbusframe.h"
+#include "modbusslave.h"
+#include "pollplanner.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <QSet>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+constexpr int maxEvents = 64;
+constexpr int readChunk = 4096;
+constexpr quint8 broadcastAddress = 0;
+
+QString systemError(const QString &what)
+{
+    return QObject::tr("%0: %1").arg(what, QString::fromLocal8Bit(std::strerror(errno)));
+}
+
+qint64 nanoseconds(double seconds)
+{
+    return qint64(seconds * 1e9);
+}
+
+quint64 eventData(int line, bool timer)
+{
+    return (quint64(line) << 1) | (timer ? 1 : 0);
+}
+}
+
+namespace ModbusSimulator {
+
+using namespace ModbusConfig;
+
+RtuSimulator::RtuSimulator(Simulation *simulation)
+    : mSimulation(simulation)
+{
+}
+
+RtuSimulator::~RtuSimulator()
+{
+    for (const auto &line : qAsConst(mLines)) {
+        for (int fd : {line.master, line.slave, line.timer}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+        if (!line.link.isEmpty()) {
+            ::unlink(QFile::encodeName(line.link).constData());
+        }
+    }
+    if (mEpoll >= 0) {
+        ::close(mEpoll);
+    }
+}
+
+QString RtuSimulator::open(const QString &ptyDir)
+{
+    if (mEpoll < 0) {
+        mEpoll = ::epoll_create1(EPOLL_CLOEXEC);
+        if (mEpoll < 0) {
+            return systemError(QStringLiteral("epoll_create1"));
+        }
+    }
+    if (!QDir().mkpath(ptyDir)) {
+        return QObject::tr("Не удалось создать каталог %0").arg(ptyDir);
+    }
+
+    QSet<QString> links;
+    const auto &endpoints = mSimulation->endpoints();
+    for (int i = 0; i < endpoints.size(); ++i) {
+        const auto &params = endpoints.at(i).params;
+        QString name = QFileInfo(params.deviceName).fileName();
+        if (name.isEmpty()) {
+            name = QStringLiteral("rtu%0").arg(i);
+        }
+        const QString link = QDir(ptyDir).filePath(name);
+        if (links.contains(link)) {
+            return QObject::tr("Линии '%0' и другой линии соответствует одна ссылка %1")
+                .arg(params.deviceName, link);
+        }
+        links.insert(link);
+
+        Line line;
+        line.endpoint = i;
+        const ModbusConfig::PollCostModel costModel(params);
+        line.charTime = nanoseconds(costModel.charTime());
+        line.silenceTime = nanoseconds(costModel.silenceTime());
+        mLines.append(line);
+        Line &added = mLines.last();
+
+        added.master = ::posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        char slaveName[128];
+        if (added.master < 0 || ::grantpt(added.master) != 0 || ::unlockpt(added.master) != 0
+            || ::ptsname_r(added.master, slaveName, sizeof(slaveName)) != 0) {
+            return systemError(QStringLiteral("posix_openpt"));
+        }
+        added.slave = ::open(slaveName, O_RDWR | O_NOCTTY | O_CLOEXEC);
+        if (added.slave < 0) {
+            return systemError(QString::fromLocal8Bit(slaveName));
+        }
+        // без режима raw терминал преобразует байты кадров как текст
+        termios attributes{};
+        ::tcgetattr(added.slave, &attributes);
+        ::cfmakeraw(&attributes);
+        ::tcsetattr(added.slave, TCSANOW, &attributes);
+
+        const QByteArray linkPath = QFile::encodeName(link);
+        ::unlink(linkPath.constData());
+        if (::symlink(slaveName, linkPath.constData()) != 0) {
+            return systemError(link);
+        }
+        added.link = link;
+
+        added.timer = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (added.timer < 0) {
+            return systemError(QStringLiteral("timerfd_create"));
+        }
+        for (bool timer : {false, true}) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = eventData(mLines.size() - 1, timer);
+            if (::epoll_ctl(mEpoll, EPOLL_CTL_ADD, timer ? added.timer : added.master,
+                    &event) != 0) {
+                return systemError(QStringLiteral("epoll_ctl"));
+            }
+        }
+    }
+    return {};
+}
+
+int RtuSimulator::fd() const
+{
+    return mEpoll;
+}
+
+QString RtuSimulator::processEvents()
+{
+    if (mEpoll < 0) {
+        return QObject::tr("Линии не открыты");
+    }
+    epoll_event events[maxEvents];
+    const int count = ::epoll_wait(mEpoll, events, maxEvents, 0);
+    if (count < 0) {
+        return errno == EINTR ? QString() : systemError(QStringLiteral("epoll_wait"));
+    }
+    for (int i = 0; i < count; ++i) {
+        Line *line = &mLines[int(events[i].data.u64 >> 1)];
+        if (events[i].data.u64 & 1) {
+            onTimer(line);
+        } else {
+            receive(line);
+        }
+    }
+    return {};
+}
+
+QVector<QPair<QString, QString>> RtuSimulator::links() const
+{
+    QVector<QPair<QString, QString>> result;
+    for (const auto &line : mLines) {
+        result.append(qMakePair(
+            mSimulation->endpoints().at(line.endpoint).params.deviceName, line.link));
+    }
+    return result;
+}
+
+void RtuSimulator::setFaultInjector(FaultInjector *faults)
+{
+    mFaults = faults;
+}
+
+quint64 RtuSimulator::requestCount() const
+{
+    return mRequests;
+}
+
+void RtuSimulator::receive(Line *line)
+{
+    for (;;) {
+        const int size = line->input.size();
+        line->input.resize(size + readChunk);
+        const ssize_t received = ::read(line->master, line->input.data() + size, readChunk);
+        line->input.resize(size + int(qMax<ssize_t>(received, 0)));
+        if (received > 0) {
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        break;
+    }
+    const qint64 now = monotonicNow();
+    line->lastInput = now;
+    processInput(line, now, false);
+    armTimer(line);
+}
+
+void RtuSimulator::onTimer(Line *line)
+{
+    quint64 expirations = 0;
+    if (::read(line->timer, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        return;
+    }
+    const qint64 now = monotonicNow();
+    sendDue(line, now);
+    if (!line->input.isEmpty() && now >= line->lastInput + line->silenceTime) {
+        processInput(line, now, true);
+    }
+    armTimer(line);
+}
+
+void RtuSimulator::processInput(Line *line, qint64 now, bool silence)
+{
+    ModbusFrame request;
+    int pos = 0;
+    while (pos < line->input.size()) {
+        const auto *data = reinterpret_cast<const quint8 *>(line->input.constData()) + pos;
+        const int size = line->input.size() - pos;
+        const int length = rtuRequestLength(data, size);
+        if (length > 0 && size >= length) {
+            if (!parseRtuFrame(data, length, &request)) {
+                // искажённый кадр отбрасывается вместе с хвостом до паузы на линии
+                pos = line->input.size();
+                break;
+            }
+            processFrame(line, request, now);
+            pos += length;
+            continue;
+        }
+        if (silence) {
+            // пауза 3.5 символа завершает кадр, длину которого нельзя вывести из функции
+            if (length == 0 && parseRtuFrame(data, size, &request)) {
+                processFrame(line, request, now);
+            }
+            pos = line->input.size();
+        }
+        break;
+    }
+    line->input.remove(0, pos);
+}
+
+void RtuSimulator::processFrame(Line *line, const ModbusFrame &request, qint64 now)
+{
+    ++mRequests;
+    const Endpoint &endpoint = mSimulation->endpoints().at(line->endpoint);
+    const int size = request.pduSize + rtuOverhead;
+    // опросчик пишет кадр в pty мгновенно, по линии он передавался бы size символов
+    const qint64 requestEnd = qMax(now, line->busyUntil) + size * line->charTime;
+    line->busyUntil = requestEnd + line->silenceTime;
+
+    if (request.unit == broadcastAddress) {
+        // широковещательная запись выполняется всеми слейвами линии без ответа
+        quint8 response[maxPduSize];
+        QSet<int> units;
+        for (int unit : endpoint.units) {
+            if (unit >= 0 && !units.contains(unit)) {
+                units.insert(unit);
+                processRequest(&mSimulation->image(), unit, request.pdu, request.pduSize,
+                    response);
+            }
+        }
+        return;
+    }
+    const int unit = endpoint.units.at(request.unit);
+    if (unit < 0) {
+        // на линии нет такого слейва - опросчик получит таймаут
+        return;
+    }
+    // сброс соединения на последовательной линии не имеет смысла и не применяется
+    const FaultDecision fault = mFaults
+        ? mFaults->decide(unit, request.pdu, request.pduSize) : FaultDecision();
+    if (fault.drop) {
+        return;
+    }
+
+    // кадр ответа собирается прямо в очереди отправки
+    line->pending.append({0, QByteArray(maxRtuFrameSize, Qt::Uninitialized)});
+    QByteArray &frame = line->pending.last().frame;
+    auto *response = reinterpret_cast<quint8 *>(frame.data());
+    const int pduSize = fault.exception
+        ? exceptionResponse(request.pdu[0], ExceptionCode(fault.exception),
+              response + rtuPduOffset)
+        : processRequest(&mSimulation->image(), unit, request.pdu, request.pduSize,
+              response + rtuPduOffset);
+    const int responseSize = finishRtuFrame(response, request.unit, pduSize);
+    if (fault.corruptCrc) {
+        response[responseSize - 2] ^= 0xFF;
+        response[responseSize - 1] ^= 0xFF;
+    }
+    frame.resize(responseSize);
+
+    // задержка устройства добавляется к паузе перед ответом
+    const qint64 due = requestEnd + line->silenceTime + fault.latency
+        + responseSize * line->charTime;
+    line->busyUntil = due + line->silenceTime;
+    line->pending.last().due = due;
+}
+
+void RtuSimulator::sendDue(Line *line, qint64 now)
+{
+    int sent = 0;
+    while (sent < line->pending.size() && line->pending.at(sent).due <= now) {
+        const QByteArray &frame = line->pending.at(sent).frame;
+        // ответ, не вместившийся в буфер pty, теряется, как на линии без приёмника
+        const ssize_t written = ::write(line->master, frame.constData(), frame.size());
+        Q_UNUSED(written)
+        ++sent;
+    }
+    line->pending.remove(0, sent);
+}
+
+void RtuSimulator::armTimer(Line *line)
+{
+    qint64 deadline = 0;
+    if (!line->pending.isEmpty()) {
+        deadline = line->pending.first().due;
+    }
+    if (!line->input.isEmpty()) {
+        const qint64 frameEnd = line->lastInput + line->silenceTime;
+        deadline = deadline > 0 ? qMin(deadline, frameEnd) : frameEnd;
+    }
+    setTimerDeadline(line->timer, deadline);
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "modbusframe.h"
+#include "simulation.h"
+
+#include <QByteArray>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+namespace ModbusSimulator {
+
+class FaultInjector;
+
+// Modbus RTU слейвы последовательных устройств: по псевдотерминалу на deviceName,
+// ссылка на ведомую сторону pty создаётся в каталоге ptyDir с именем файла deviceName.
+// Задержка ответа моделирует передачу запроса и ответа по линии со скоростью,
+// чётностью и стоп-битами устройства, линия занята до окончания ответа.
+class RtuSimulator
+{
+public:
+    explicit RtuSimulator(Simulation *simulation);
+    ~RtuSimulator();
+
+    RtuSimulator(const RtuSimulator &) = delete;
+    RtuSimulator &operator=(const RtuSimulator &) = delete;
+
+    QString open(const QString &ptyDir);
+    // epoll всех pty и таймеров симулятора, встраивается в EventLoop
+    int fd() const;
+    // обработка готовых событий без ожидания
+    QString processEvents();
+
+    // пары "deviceName - путь к ведомой стороне pty"
+    QVector<QPair<QString, QString>> links() const;
+    // задержки, потери, исключения и искажённая CRC ответов; nullptr - без неисправностей
+    void setFaultInjector(FaultInjector *faults);
+    quint64 requestCount() const;
+
+private:
+    struct Pending {
+        qint64 due;
+        QByteArray frame;
+    };
+
+    struct Line {
+        int endpoint;
+        int master{-1};
+        // своя копия ведомой стороны, чтобы закрытие порта опросчиком не давало EIO
+        int slave{-1};
+        int timer{-1};
+        QString link;
+        qint64 charTime{};
+        qint64 silenceTime{};
+        QByteArray input;
+        qint64 lastInput{};
+        // момент освобождения линии после последнего ответа
+        qint64 busyUntil{};
+        QVector<Pending> pending;
+    };
+
+    void receive(Line *line);
+    void onTimer(Line *line);
+    // разбор кадров из начала входного буфера
+    void processInput(Line *line, qint64 now, bool silence);
+    void processFrame(Line *line, const ModbusConfig::ModbusFrame &request, qint64 now);
+    void sendDue(Line *line, qint64 now);
+    void armTimer(Line *line);
+
+private:
+    Simulation *mSimulation;
+    FaultInjector *mFaults{};
+    int mEpoll{-1};
+    QVector<Line> mLines;
+    quint64 mRequests{};
+};
+
+}
@@ -0,0 +1,382 @@
+#include "signalgenerators.h"
+
+#include "cpufeatures.h"
+#include "modbusframe.h"
+#include "utils.h"
+
+#include <QObject>
+#include <QSet>
+
+#include <cmath>
+
+#if defined(MODBUS_CONFIG_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+constexpr double twoPi = 6.283185307179586;
+constexpr int encodeChunk = 256;
+// (x >> 8) * 2^-23 - 1 переводит 24 старших бита xorshift32 в [-1, 1)
+constexpr double walkScale = 1.0 / (1 << 23);
+
+double fraction(double value)
+{
+    return value - std::floor(value);
+}
+
+quint32 xorshift32(quint32 x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// разные ненулевые начальные состояния для соседних значений
+quint32 walkSeed(quint32 seed, int lane)
+{
+    quint32 x = seed * 0x9E3779B9u + quint32(lane) * 0x85EBCA6Bu;
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    return x != 0 ? x : 0x6D2B79F5u;
+}
+
+#if defined(MODBUS_CONFIG_X86)
+MODBUS_CONFIG_TARGET("avx2,fma")
+int sineAvx2(int count, const double *offset, const double *amplitude, double *re, double *im,
+    const double *cos, const double *sin, double *value)
+{
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d threeHalves = _mm256_set1_pd(1.5);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256d r = _mm256_loadu_pd(re + i);
+        const __m256d m = _mm256_loadu_pd(im + i);
+        const __m256d c = _mm256_loadu_pd(cos + i);
+        const __m256d s = _mm256_loadu_pd(sin + i);
+        __m256d nextRe = _mm256_fmsub_pd(r, c, _mm256_mul_pd(m, s));
+        __m256d nextIm = _mm256_fmadd_pd(r, s, _mm256_mul_pd(m, c));
+        const __m256d norm = _mm256_fmadd_pd(nextRe, nextRe, _mm256_mul_pd(nextIm, nextIm));
+        const __m256d scale = _mm256_fnmadd_pd(half, norm, threeHalves);
+        nextRe = _mm256_mul_pd(nextRe, scale);
+        nextIm = _mm256_mul_pd(nextIm, scale);
+        _mm256_storeu_pd(re + i, nextRe);
+        _mm256_storeu_pd(im + i, nextIm);
+        _mm256_storeu_pd(value + i, _mm256_fmadd_pd(_mm256_loadu_pd(amplitude + i), nextIm,
+            _mm256_loadu_pd(offset + i)));
+    }
+    return i;
+}
+
+MODBUS_CONFIG_TARGET("avx2")
+int rampAvx2(int count, double *phase, const double *increment, const double *base,
+    const double *span, double *value)
+{
+    const __m256d one = _mm256_set1_pd(1);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d p = _mm256_add_pd(_mm256_loadu_pd(phase + i), _mm256_loadu_pd(increment + i));
+        p = _mm256_sub_pd(p, _mm256_and_pd(_mm256_cmp_pd(p, one, _CMP_GE_OQ), one));
+        _mm256_storeu_pd(phase + i, p);
+        _mm256_storeu_pd(value + i, _mm256_add_pd(_mm256_loadu_pd(base + i),
+            _mm256_mul_pd(_mm256_loadu_pd(span + i), p)));
+    }
+    return i;
+}
+
+MODBUS_CONFIG_TARGET("avx2")
+int walkAvx2(int count, double *value, const double *step, const double *min, const double *max,
+    quint32 *state)
+{
+    const __m256d scale = _mm256_set1_pd(walkScale);
+    const __m256d one = _mm256_set1_pd(1);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(state + i));
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+        x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(state + i), x);
+        const __m256i high = _mm256_srli_epi32(x, 8);
+        for (int k = 0; k < 2; ++k) {
+            const __m128i half = k == 0 ? _mm256_castsi256_si128(high)
+                                        : _mm256_extracti128_si256(high, 1);
+            const __m256d u =
+                _mm256_sub_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(half), scale), one);
+            const int j = i + 4 * k;
+            __m256d v = _mm256_add_pd(_mm256_loadu_pd(value + j),
+                _mm256_mul_pd(_mm256_loadu_pd(step + j), u));
+            v = _mm256_min_pd(_mm256_max_pd(v, _mm256_loadu_pd(min + j)),
+                _mm256_loadu_pd(max + j));
+            _mm256_storeu_pd(value + j, v);
+        }
+    }
+    return i;
+}
+#endif
+
+}
+
+namespace ModbusSimulator {
+
+using namespace ModbusConfig;
+
+QStringList SignalGenerators::build(const QVector<Simulation *> &simulations,
+    const GeneratorConfig &config)
+{
+    QStringList warnings;
+    mTickSeconds = config.tick / 1000.0;
+    mSeed = config.seed;
+
+    // ключи приводятся к QUuid::toString, чтобы фигурные скобки в файле были необязательны
+    QHash<QString, QString> keys;
+    for (auto it = config.generators.constBegin(); it != config.generators.constEnd(); ++it) {
+        const QString &key = it.key();
+        const int slash = key.indexOf(QLatin1Char('/'));
+        const QUuid id(slash < 0 ? key : key.left(slash));
+        if (id.isNull()) {
+            warnings.append(QObject::tr("Генератор '%0': ключ должен быть UUID датчика "
+                                        "или UUID устройства/id карты").arg(key));
+            continue;
+        }
+        keys.insert(slash < 0 ? id.toString() : id.toString() + key.mid(slash), key);
+    }
+
+    // генераторы карт целиком записываются раньше генераторов отдельных датчиков карт,
+    // чтобы датчик с собственным генератором не перезаписывался картой
+    QSet<QString> bound;
+    for (bool wholeMaps : {true, false}) {
+        for (Simulation *simulation : simulations) {
+            for (const auto &channel : simulation->channels()) {
+                if (channel.sensorId.isNull() != wholeMaps) {
+                    continue;
+                }
+                const QString key = channel.sensorId.isNull()
+                    ? channel.deviceId.toString() + QLatin1Char('/') + channel.mapId
+                    : channel.sensorId.toString();
+                auto it = keys.constFind(key);
+                if (it == keys.constEnd()) {
+                    continue;
+                }
+                add(&simulation->image(), channel, config.generators.value(it.value()));
+                bound.insert(it.value());
+            }
+        }
+    }
+    for (auto it = keys.constBegin(); it != keys.constEnd(); ++it) {
+        if (!bound.contains(it.value())) {
+            warnings.append(QObject::tr("Генератор '%0': датчик или карта не найдены")
+                .arg(it.value()));
+        }
+    }
+
+    updateHeld();
+    for (const auto &binding : qAsConst(mBindings)) {
+        write(binding, values(binding.kind) + binding.first);
+    }
+    return warnings;
+}
+
+void SignalGenerators::tick()
+{
+    ++mTick;
+    int i = 0;
+    const int sineCount = mSineValue.size();
+#if defined(MODBUS_CONFIG_X86)
+    if (cpuFeatures().avx2 && cpuFeatures().fma) {
+        i = sineAvx2(sineCount, mSineOffset.constData(), mSineAmplitude.constData(),
+            mSineRe.data(), mSineIm.data(), mSineCos.constData(), mSineSin.constData(),
+            mSineValue.data());
+    }
+#endif
+    for (; i < sineCount; ++i) {
+        double re = mSineRe.at(i) * mSineCos.at(i) - mSineIm.at(i) * mSineSin.at(i);
+        double im = mSineRe.at(i) * mSineSin.at(i) + mSineIm.at(i) * mSineCos.at(i);
+        // поправка длины вектора, иначе ошибка округления накапливается от такта к такту
+        const double scale = 1.5 - 0.5 * (re * re + im * im);
+        mSineRe[i] = re * scale;
+        mSineIm[i] = im * scale;
+        mSineValue[i] = mSineOffset.at(i) + mSineAmplitude.at(i) * mSineIm.at(i);
+    }
+
+    i = 0;
+    const int rampCount = mRampValue.size();
+#if defined(MODBUS_CONFIG_X86)
+    if (cpuFeatures().avx2) {
+        i = rampAvx2(rampCount, mRampPhase.data(), mRampIncrement.constData(),
+            mRampBase.constData(), mRampSpan.constData(), mRampValue.data());
+    }
+#endif
+    for (; i < rampCount; ++i) {
+        double phase = mRampPhase.at(i) + mRampIncrement.at(i);
+        if (phase >= 1) {
+            phase -= 1;
+        }
+        mRampPhase[i] = phase;
+        mRampValue[i] = mRampBase.at(i) + mRampSpan.at(i) * phase;
+    }
+
+    i = 0;
+    const int walkCount = mWalkValue.size();
+#if defined(MODBUS_CONFIG_X86)
+    if (cpuFeatures().avx2) {
+        i = walkAvx2(walkCount, mWalkValue.data(), mWalkStep.constData(), mWalkMin.constData(),
+            mWalkMax.constData(), mWalkState.data());
+    }
+#endif
+    for (; i < walkCount; ++i) {
+        const quint32 x = xorshift32(mWalkState.at(i));
+        mWalkState[i] = x;
+        const double u = int(x >> 8) * walkScale - 1;
+        mWalkValue[i] = qMin(qMax(mWalkValue.at(i) + mWalkStep.at(i) * u, mWalkMin.at(i)),
+            mWalkMax.at(i));
+    }
+
+    updateHeld();
+    for (const auto &binding : qAsConst(mBindings)) {
+        write(binding, values(binding.kind) + binding.first);
+    }
+}
+
+int SignalGenerators::valueCount() const
+{
+    return mSineValue.size() + mRampValue.size() + mWalkValue.size() + mHeldValue.size();
+}
+
+void SignalGenerators::add(RegisterImage *image, const Channel &channel,
+    const GeneratorSettings &settings)
+{
+    const auto &address = channel.address;
+    Binding binding{settings.kind, 0, channel.valueCount, RegisterDecoder(address), image,
+        channel.unit, address.regType, pduAddress(address.regType, address.regAddress),
+        address.bitOffset};
+    const double middle = (settings.min + settings.max) / 2;
+    switch (settings.kind) {
+    case Kind::Sine: {
+        binding.first = mSineValue.size();
+        const double angle = twoPi * mTickSeconds / settings.period;
+        for (int i = 0; i < channel.valueCount; ++i) {
+            const double phase = twoPi * (settings.phase + i * settings.phaseStep);
+            const double amplitude = (settings.max - settings.min) / 2;
+            mSineOffset.append(middle);
+            mSineAmplitude.append(amplitude);
+            mSineRe.append(std::cos(phase));
+            mSineIm.append(std::sin(phase));
+            mSineCos.append(std::cos(angle));
+            mSineSin.append(std::sin(angle));
+            mSineValue.append(middle + amplitude * std::sin(phase));
+        }
+        break;
+    }
+    case Kind::Ramp: {
+        binding.first = mRampValue.size();
+        const double increment = fraction(mTickSeconds / settings.period);
+        for (int i = 0; i < channel.valueCount; ++i) {
+            const double phase = fraction(settings.phase + i * settings.phaseStep);
+            mRampPhase.append(phase);
+            mRampIncrement.append(increment);
+            mRampBase.append(settings.min);
+            mRampSpan.append(settings.max - settings.min);
+            mRampValue.append(settings.min + (settings.max - settings.min) * phase);
+        }
+        break;
+    }
+    case Kind::RandomWalk: {
+        binding.first = mWalkValue.size();
+        const double start = std::isnan(settings.start)
+            ? middle : qBound(settings.min, settings.start, settings.max);
+        for (int i = 0; i < channel.valueCount; ++i) {
+            mWalkValue.append(start);
+            mWalkStep.append(settings.step);
+            mWalkMin.append(settings.min);
+            mWalkMax.append(settings.max);
+            mWalkState.append(walkSeed(mSeed, mWalkState.size()));
+        }
+        break;
+    }
+    case Kind::Step:
+    case Kind::Replay:
+        binding.first = mHeldValue.size();
+        mHeldValue.resize(mHeldValue.size() + channel.valueCount);
+        mHeld.append({binding.first, channel.valueCount, settings});
+        break;
+    }
+    mBindings.append(binding);
+}
+
+void SignalGenerators::updateHeld()
+{
+    const double time = mTick * mTickSeconds;
+    for (const auto &held : qAsConst(mHeld)) {
+        double *out = mHeldValue.data() + held.first;
+        const auto &settings = held.settings;
+        if (settings.kind == Kind::Step) {
+            const auto &levels = settings.levels;
+            const qint64 index = qint64(std::floor(time / settings.period + settings.phase));
+            const double level = levels.at(int(((index % levels.size()) + levels.size())
+                % levels.size()));
+            std::fill(out, out + held.count, level);
+            continue;
+        }
+        const auto &row = settings.rows.at(int(mTick % quint64(settings.rows.size())));
+        for (int i = 0; i < held.count; ++i) {
+            out[i] = row.at(i % row.size());
+        }
+    }
+}
+
+void SignalGenerators::write(const Binding &binding, const double *values)
+{
+    RegisterImage *image = binding.image;
+    if (isBitRegisterType(binding.regType)) {
+        quint8 *bits = image->bits(binding.unit, binding.regType, binding.pduAddress,
+            binding.count);
+        for (int i = 0; bits && i < binding.count; ++i) {
+            bits[i] = values[i] != 0 && !std::isnan(values[i]) ? 1 : 0;
+        }
+        return;
+    }
+    if (binding.bitOffset >= 0) {
+        quint16 *reg = image->registers(binding.unit, binding.regType, binding.pduAddress, 1);
+        if (reg) {
+            const quint16 mask = quint16(1 << binding.bitOffset);
+            *reg = quint16(values[0] != 0 && !std::isnan(values[0]) ? *reg | mask : *reg & ~mask);
+        }
+        return;
+    }
+    const int perValue = binding.decoder.registersPerValue();
+    quint16 *registers = image->registers(binding.unit, binding.regType, binding.pduAddress,
+        binding.count * perValue);
+    if (!registers) {
+        return;
+    }
+    // в образе регистры хранятся числами, в сети - старшим байтом вперёд
+    quint8 raw[encodeChunk * 8];
+    for (int offset = 0; offset < binding.count; offset += encodeChunk) {
+        const int chunk = qMin(encodeChunk, binding.count - offset);
+        binding.decoder.encode(values + offset, chunk, raw);
+        quint16 *out = registers + offset * perValue;
+        for (int i = 0; i < chunk * perValue; ++i) {
+            out[i] = quint16((raw[2 * i] << 8) | raw[2 * i + 1]);
+        }
+    }
+}
+
+const double *SignalGenerators::values(Kind kind) const
+{
+    switch (kind) {
+    case Kind::Sine:
+        return mSineValue.constData();
+    case Kind::Ramp:
+        return mRampValue.constData();
+    case Kind::RandomWalk:
+        return mWalkValue.constData();
+    case Kind::Step:
+    case Kind::Replay:
+        break;
+    }
+    return mHeldValue.constData();
+}
+
+}
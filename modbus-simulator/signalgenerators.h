@@ -0,0 +1,86 @@
+#pragma once
+
+#include "generatorconfig.h"
+#include "registerdecoder.h"
+#include "simulation.h"
+
+#include <QStringList>
+#include <QVector>
+
+namespace ModbusSimulator {
+
+// Генераторы значений датчиков и карт симулятора. Состояния генераторов одного вида
+// хранятся подряд по всем значениям (SoA), такт обновляет их одним проходом
+// векторного ядра, затем значения кодируются по valType/typeOrder в образ регистров.
+class SignalGenerators
+{
+public:
+    SignalGenerators() = default;
+
+    // ключи без датчика или карты в simulations возвращаются предупреждениями
+    QStringList build(const QVector<Simulation *> &simulations, const GeneratorConfig &config);
+    // продвигает генераторы на такт и записывает значения
+    void tick();
+
+    int valueCount() const;
+
+private:
+    using Kind = GeneratorSettings::Kind;
+
+    // значения канала в массиве вида kind начиная с first
+    struct Binding {
+        Kind kind;
+        int first;
+        int count;
+        ModbusConfig::RegisterDecoder decoder;
+        RegisterImage *image;
+        int unit;
+        ModbusConfig::RegisterAddress::RegisterType regType;
+        int pduAddress;
+        int bitOffset;
+    };
+
+    // step и replay меняют значение канала целиком, их такт скалярный
+    struct Held {
+        int first;
+        int count;
+        GeneratorSettings settings;
+    };
+
+    void add(RegisterImage *image, const Channel &channel, const GeneratorSettings &settings);
+    void updateHeld();
+    void write(const Binding &binding, const double *values);
+    const double *values(Kind kind) const;
+
+private:
+    double mTickSeconds{};
+    quint64 mTick{};
+    quint32 mSeed{};
+    QVector<Binding> mBindings;
+    QVector<Held> mHeld;
+
+    // sine: value = offset + amplitude * im, (re, im) поворачивается на (cos, sin) за такт
+    QVector<double> mSineOffset;
+    QVector<double> mSineAmplitude;
+    QVector<double> mSineRe;
+    QVector<double> mSineIm;
+    QVector<double> mSineCos;
+    QVector<double> mSineSin;
+    QVector<double> mSineValue;
+    // ramp: value = base + span * phase, phase в [0, 1)
+    QVector<double> mRampPhase;
+    QVector<double> mRampIncrement;
+    QVector<double> mRampBase;
+    QVector<double> mRampSpan;
+    QVector<double> mRampValue;
+    // random walk: состояние xorshift32 на значение
+    QVector<double> mWalkValue;
+    QVector<double> mWalkStep;
+    QVector<double> mWalkMin;
+    QVector<double> mWalkMax;
+    QVector<quint32> mWalkState;
+    // step и replay
+    QVector<double> mHeldValue;
+};
+
+}
@@ -0,0 +1,129 @@
+#include "simulation.h"
+
+#include "modbusframe.h"
+#include "utils.h"
+
+#include <QHash>
+#include <QObject>
+
+#include <algorithm>
+
+namespace {
+constexpr int slaveAddressCount = 256;
+}
+
+namespace ModbusSimulator {
+
+using namespace ModbusConfig;
+
+QStringList Simulation::load(const ModbusConfigModel &model, ConnectionParams::Type type)
+{
+    QStringList warnings;
+    mImage = RegisterImage();
+    mEndpoints.clear();
+    mChannels.clear();
+    mUnitDevices.clear();
+
+    // порядок устройств фиксируется, чтобы номера слейвов не зависели от QHash
+    auto devicesIds = model.devicesIds();
+    std::sort(devicesIds.begin(), devicesIds.end());
+
+    QHash<QString, int> endpointIndex;
+    for (const auto &devId : devicesIds) {
+        const auto &device = model.device(devId);
+        const auto &params = device.settings.connectionParams;
+        if (params.type != type) {
+            continue;
+        }
+        const QString key = endpointKey(params);
+        auto it = endpointIndex.find(key);
+        if (it == endpointIndex.end()) {
+            Endpoint endpoint;
+            endpoint.params = params;
+            endpoint.units.fill(-1, slaveAddressCount);
+            mEndpoints.append(endpoint);
+            it = endpointIndex.insert(key, mEndpoints.size() - 1);
+        }
+        Endpoint &endpoint = mEndpoints[it.value()];
+        endpoint.devices.append(devId);
+
+        // слейвы устройства: адрес слейва задаётся у каждого датчика и карты
+        QHash<int, int> deviceUnits;
+        auto unitOf = [&](const RegisterAddress &address) {
+            auto unitIt = deviceUnits.find(address.slaveAddress);
+            if (unitIt == deviceUnits.end()) {
+                int &unit = endpoint.units[address.slaveAddress];
+                if (unit >= 0) {
+                    warnings.append(QObject::tr(
+                        "Слейв %0 на '%1' уже занят другим устройством, "
+                        "регистры устройства '%2' объединены с ним")
+                        .arg(address.slaveAddress).arg(key, device.settings.description));
+                } else {
+                    unit = mImage.addUnit();
+                    mUnitDevices.append(devId);
+                }
+                unitIt = deviceUnits.insert(address.slaveAddress, unit);
+            }
+            return unitIt.value();
+        };
+
+        for (const auto &sensor : device.sensors) {
+            if (sensor.type == Sensor::Type::Separate) {
+                const auto &address = sensor.registerAddress;
+                const int unit = unitOf(address);
+                mImage.cover(unit, address.regType, pduAddress(address.regType, address.regAddress),
+                    registerCount(address));
+                mChannels.append({devId, sensor.id, QString(), address, unit, 1});
+            } else if (sensor.type == Sensor::Type::Map && device.maps.contains(sensor.mapId)) {
+                RegisterAddress address = device.maps.value(sensor.mapId).registеrAddress;
+                address.regAddress += sensor.mapOffset * registerCount(address);
+                mChannels.append({devId, sensor.id, sensor.mapId, address, unitOf(address), 1});
+            }
+        }
+        for (const auto &map : device.maps) {
+            const auto &address = map.registеrAddress;
+            const int unit = unitOf(address);
+            mImage.cover(unit, address.regType, pduAddress(address.regType, address.regAddress),
+                map.valueCount * registerCount(address));
+            mChannels.append({devId, QUuid(), map.id, address, unit, map.valueCount});
+        }
+    }
+    mImage.build();
+    return warnings;
+}
+
+RegisterImage &Simulation::image()
+{
+    return mImage;
+}
+
+const RegisterImage &Simulation::image() const
+{
+    return mImage;
+}
+
+const QVector<Endpoint> &Simulation::endpoints() const
+{
+    return mEndpoints;
+}
+
+const QVector<Channel> &Simulation::channels() const
+{
+    return mChannels;
+}
+
+QUuid Simulation::unitDevice(int unit) const
+{
+    return mUnitDevices.value(unit);
+}
+
+QString Simulation::endpointKey(const ConnectionParams &params)
+{
+    // все TCP-устройства слушают на одном локальном адресе, поэтому различаются только портом
+    if (params.type == ConnectionParams::Type::Tcp) {
+        return QStringLiteral("tcp:%0").arg(params.port);
+    }
+    return channelKey(params);
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "modbusconfigmodel.h"
+#include "registerimage.h"
+
+#include <QStringList>
+#include <QVector>
+
+namespace ModbusSimulator {
+
+// Точка подключения: порт TCP или последовательная линия, за которой стоят слейвы.
+struct Endpoint {
+    ModbusConfig::ConnectionParams params;
+    QVector<QUuid> devices;
+    // units[slaveAddress] - слейв в RegisterImage или -1
+    QVector<int> units;
+};
+
+// Значения датчика или карты в образе регистров.
+struct Channel {
+    QUuid deviceId;
+    // пустой для карты целиком
+    QUuid sensorId;
+    QString mapId;
+    // для датчика карты - адрес его элемента
+    ModbusConfig::RegisterAddress address;
+    int unit;
+    int valueCount;
+};
+
+// Симулируемые устройства одного типа подключения, построенные по конфигурации.
+class Simulation
+{
+public:
+    Simulation() = default;
+
+    // предупреждения (конфликты адресов слейвов и т.п.) возвращаются списком
+    QStringList load(const ModbusConfig::ModbusConfigModel &model,
+        ModbusConfig::ConnectionParams::Type type);
+
+    RegisterImage &image();
+    const RegisterImage &image() const;
+    const QVector<Endpoint> &endpoints() const;
+    const QVector<Channel> &channels() const;
+    // устройство, создавшее слейв unit (при объединении слейвов - первое)
+    QUuid unitDevice(int unit) const;
+
+private:
+    static QString endpointKey(const ModbusConfig::ConnectionParams &params);
+
+private:
+    RegisterImage mImage;
+    QVector<Endpoint> mEndpoints;
+    QVector<Channel> mChannels;
+    QVector<QUuid> mUnitDevices;
+};
+
+}
@@ -0,0 +1,384 @@
+#include "tcpsimulator.h"
+
+#include "eventloop.h"
+#include "faultinjector.h"
+#include "modbusframe.h"
+#include "modbusslave.h"
+
+#include <QObject>
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+constexpr int maxEvents = 256;
+constexpr int receiveChunk = 64 * 1024;
+
+QString systemError(const QString &what)
+{
+    return QObject::tr("%0: %1").arg(what, QString::fromLocal8Bit(std::strerror(errno)));
+}
+}
+
+namespace ModbusSimulator {
+
+using namespace ModbusConfig;
+
+TcpSimulator::TcpSimulator(Simulation *simulation)
+    : mSimulation(simulation)
+{
+}
+
+TcpSimulator::~TcpSimulator()
+{
+    for (auto it = mConnections.cbegin(); it != mConnections.cend(); ++it) {
+        ::close(it.key());
+    }
+    for (auto it = mListeners.cbegin(); it != mListeners.cend(); ++it) {
+        ::close(it.key());
+    }
+    if (mTimer >= 0) {
+        ::close(mTimer);
+    }
+    if (mEpoll >= 0) {
+        ::close(mEpoll);
+    }
+}
+
+QString TcpSimulator::listen(const QString &host, int portOffset)
+{
+    if (mEpoll < 0) {
+        mEpoll = ::epoll_create1(EPOLL_CLOEXEC);
+        if (mEpoll < 0) {
+            return systemError(QStringLiteral("epoll_create1"));
+        }
+        mTimer = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (mTimer < 0) {
+            return systemError(QStringLiteral("timerfd_create"));
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = mTimer;
+        if (::epoll_ctl(mEpoll, EPOLL_CTL_ADD, mTimer, &event) != 0) {
+            return systemError(QStringLiteral("epoll_ctl"));
+        }
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    if (::inet_pton(AF_INET, host.toLatin1().constData(), &address.sin_addr) != 1) {
+        return QObject::tr("Некорректный адрес для прослушивания: %0").arg(host);
+    }
+
+    const auto &endpoints = mSimulation->endpoints();
+    for (int i = 0; i < endpoints.size(); ++i) {
+        const int port = endpoints.at(i).params.port + portOffset;
+        if (port <= 0 || port > 0xFFFF) {
+            return QObject::tr("Порт %0 вне допустимого диапазона").arg(port);
+        }
+        const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return systemError(QStringLiteral("socket"));
+        }
+        const int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        address.sin_port = htons(quint16(port));
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+            || ::listen(fd, SOMAXCONN) != 0) {
+            const QString error = systemError(QObject::tr("порт %0").arg(port));
+            ::close(fd);
+            return error;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            const QString error = systemError(QStringLiteral("epoll_ctl"));
+            ::close(fd);
+            return error;
+        }
+        mListeners.insert(fd, i);
+    }
+    return {};
+}
+
+void TcpSimulator::setFaultInjector(FaultInjector *faults)
+{
+    mFaults = faults;
+}
+
+int TcpSimulator::fd() const
+{
+    return mEpoll;
+}
+
+QString TcpSimulator::processEvents()
+{
+    if (mEpoll < 0) {
+        return QObject::tr("Серверы не запущены");
+    }
+    epoll_event events[maxEvents];
+    const int count = ::epoll_wait(mEpoll, events, maxEvents, 0);
+    if (count < 0) {
+        return errno == EINTR ? QString() : systemError(QStringLiteral("epoll_wait"));
+    }
+    for (int i = 0; i < count; ++i) {
+        const int fd = events[i].data.fd;
+        if (fd == mTimer) {
+            onTimer();
+            continue;
+        }
+        if (mListeners.contains(fd)) {
+            accept(fd);
+            continue;
+        }
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+            close(fd);
+            continue;
+        }
+        if (events[i].events & EPOLLOUT) {
+            flush(fd);
+        }
+        if (events[i].events & EPOLLIN) {
+            receive(fd);
+        }
+    }
+    return {};
+}
+
+int TcpSimulator::listenerCount() const
+{
+    return mListeners.size();
+}
+
+int TcpSimulator::connectionCount() const
+{
+    return mConnections.size();
+}
+
+quint64 TcpSimulator::requestCount() const
+{
+    return mRequests;
+}
+
+void TcpSimulator::accept(int listener)
+{
+    const int endpoint = mListeners.value(listener);
+    for (;;) {
+        const int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN - очередь разобрана, EMFILE и прочее - повтор на следующем событии
+            return;
+        }
+        const int on = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (::epoll_ctl(mEpoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+            ::close(fd);
+            continue;
+        }
+        mConnections.insert(fd, {endpoint, {}, {}, false, false, {}});
+    }
+}
+
+void TcpSimulator::receive(int fd)
+{
+    auto it = mConnections.find(fd);
+    if (it == mConnections.end()) {
+        return;
+    }
+    Connection &connection = it.value();
+    for (;;) {
+        const int size = connection.input.size();
+        connection.input.resize(size + receiveChunk);
+        const ssize_t received = ::recv(fd, connection.input.data() + size, receiveChunk, 0);
+        connection.input.resize(size + int(qMax<ssize_t>(received, 0)));
+        if (received > 0) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        // соединение закрыто клиентом
+        close(fd);
+        return;
+    }
+    if (!processInput(fd, &connection)) {
+        close(fd);
+        return;
+    }
+    flush(fd);
+}
+
+bool TcpSimulator::processInput(int fd, Connection *connection)
+{
+    const Endpoint &endpoint = mSimulation->endpoints().at(connection->endpoint);
+    const auto *data = reinterpret_cast<const quint8 *>(connection->input.constData());
+    const int size = connection->input.size();
+    const qint64 now = mFaults ? monotonicNow() : 0;
+    ModbusFrame request;
+    int pos = 0;
+    // клиенты могут слать запросы, не дожидаясь ответов - разбираются все полные кадры
+    for (;;) {
+        const int length = parseTcpFrame(data + pos, size - pos, &request);
+        if (length == 0) {
+            return false;
+        }
+        if (length < 0) {
+            break;
+        }
+        const int unit = endpoint.units.at(request.unit);
+        const FaultDecision fault = mFaults
+            ? mFaults->decide(unit, request.pdu, request.pduSize) : FaultDecision();
+        if (fault.reset) {
+            connection->reset = true;
+            return false;
+        }
+        ++mRequests;
+        pos += length;
+        if (fault.drop) {
+            continue;
+        }
+
+        // ответ без задержки за задержанным тоже ждёт, чтобы не нарушить порядок
+        const bool delayed = fault.latency > 0 || !connection->delayed.isEmpty();
+        QByteArray delayedFrame;
+        // кадр ответа собирается прямо в выходном буфере
+        QByteArray &target = delayed ? delayedFrame : connection->output;
+        const int start = target.size();
+        target.resize(start + maxTcpFrameSize);
+        auto *frame = reinterpret_cast<quint8 *>(target.data()) + start;
+        quint8 *response = frame + tcpPduOffset;
+        const quint8 function = request.pdu[0];
+        int responseSize = 0;
+        if (unit < 0) {
+            responseSize = exceptionResponse(function, ExceptionCode::GatewayTargetFailed, response);
+        } else if (fault.exception) {
+            responseSize = exceptionResponse(function, ExceptionCode(fault.exception), response);
+        } else {
+            responseSize = processRequest(&mSimulation->image(), unit, request.pdu,
+                request.pduSize, response);
+        }
+        target.resize(start + finishTcpFrame(frame, request.transactionId, request.unit,
+            responseSize));
+        if (delayed) {
+            delay(fd, connection, now + fault.latency, delayedFrame);
+        }
+    }
+    connection->input.remove(0, pos);
+    return true;
+}
+
+void TcpSimulator::flush(int fd)
+{
+    auto it = mConnections.find(fd);
+    if (it == mConnections.end()) {
+        return;
+    }
+    Connection &connection = it.value();
+    QByteArray &output = connection.output;
+    int sent = 0;
+    while (sent < output.size()) {
+        const ssize_t result = ::send(fd, output.constData() + sent, output.size() - sent,
+            MSG_NOSIGNAL);
+        if (result > 0) {
+            sent += int(result);
+            continue;
+        }
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        close(fd);
+        return;
+    }
+    output.remove(0, sent);
+    // остаток отправляется по EPOLLOUT
+    if (connection.writing != !output.isEmpty()) {
+        connection.writing = !output.isEmpty();
+        updateEvents(fd, connection.writing);
+    }
+}
+
+void TcpSimulator::close(int fd)
+{
+    auto it = mConnections.constFind(fd);
+    if (it != mConnections.constEnd() && it.value().reset) {
+        // нулевой SO_LINGER - close() отправляет RST вместо FIN
+        const linger option{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &option, sizeof(option));
+    }
+    ::epoll_ctl(mEpoll, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    mConnections.remove(fd);
+}
+
+void TcpSimulator::updateEvents(int fd, bool wantWrite)
+{
+    epoll_event event{};
+    event.events = EPOLLIN | (wantWrite ? EPOLLOUT : 0);
+    event.data.fd = fd;
+    ::epoll_ctl(mEpoll, EPOLL_CTL_MOD, fd, &event);
+}
+
+void TcpSimulator::delay(int fd, Connection *connection, qint64 due, QByteArray frame)
+{
+    if (!connection->delayed.isEmpty()) {
+        due = qMax(due, connection->delayed.last().due);
+    }
+    connection->delayed.append({due, frame});
+    mDelayed.insert(due, fd);
+    if (mTimerDeadline == 0 || due < mTimerDeadline) {
+        armTimer();
+    }
+}
+
+void TcpSimulator::onTimer()
+{
+    quint64 expirations = 0;
+    if (::read(mTimer, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        return;
+    }
+    const qint64 now = monotonicNow();
+    while (!mDelayed.isEmpty() && mDelayed.firstKey() <= now) {
+        const int fd = mDelayed.first();
+        mDelayed.erase(mDelayed.begin());
+        // соединение могло закрыться, а его fd - достаться новому: тогда сроки не наступили
+        auto it = mConnections.find(fd);
+        if (it == mConnections.end()) {
+            continue;
+        }
+        Connection &connection = it.value();
+        int ready = 0;
+        while (ready < connection.delayed.size() && connection.delayed.at(ready).due <= now) {
+            connection.output.append(connection.delayed.at(ready).frame);
+            ++ready;
+        }
+        if (ready > 0) {
+            connection.delayed.remove(0, ready);
+            flush(fd);
+        }
+    }
+    armTimer();
+}
+
+void TcpSimulator::armTimer()
+{
+    mTimerDeadline = mDelayed.isEmpty() ? 0 : mDelayed.firstKey();
+    setTimerDeadline(mTimer, mTimerDeadline);
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "simulation.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QMultiMap>
+#include <QString>
+#include <QVector>
+
+namespace ModbusSimulator {
+
+class FaultInjector;
+
+// Modbus TCP слейвы всех TCP-устройств конфигурации: по серверу на порт устройства.
+// Все соединения обслуживаются одним потоком на epoll - с тысячами портов поток на
+// соединение или QTcpServer на порт упираются в переключения контекста и сигналы Qt.
+class TcpSimulator
+{
+public:
+    explicit TcpSimulator(Simulation *simulation);
+    ~TcpSimulator();
+
+    TcpSimulator(const TcpSimulator &) = delete;
+    TcpSimulator &operator=(const TcpSimulator &) = delete;
+
+    // порт сервера - порт устройства + portOffset
+    QString listen(const QString &host, int portOffset = 0);
+    // задержки, потери, исключения и сбросы соединений; nullptr - без неисправностей
+    void setFaultInjector(FaultInjector *faults);
+    // epoll всех сокетов симулятора, встраивается в EventLoop
+    int fd() const;
+    // обработка готовых событий без ожидания
+    QString processEvents();
+
+    int listenerCount() const;
+    int connectionCount() const;
+    quint64 requestCount() const;
+
+private:
+    struct Delayed {
+        qint64 due;
+        QByteArray frame;
+    };
+
+    struct Connection {
+        int endpoint;
+        QByteArray input;
+        QByteArray output;
+        // ждём EPOLLOUT для отправки остатка output
+        bool writing;
+        // закрыть с RST
+        bool reset;
+        // задержанные ответы в порядке запросов
+        QVector<Delayed> delayed;
+    };
+
+    void accept(int listener);
+    void receive(int fd);
+    void flush(int fd);
+    void close(int fd);
+    // разбор всех полных кадров из входного буфера, false - закрыть соединение
+    bool processInput(int fd, Connection *connection);
+    void updateEvents(int fd, bool wantWrite);
+    void delay(int fd, Connection *connection, qint64 due, QByteArray frame);
+    void onTimer();
+    void armTimer();
+
+private:
+    Simulation *mSimulation;
+    FaultInjector *mFaults{};
+    int mEpoll{-1};
+    int mTimer{-1};
+    // срок ответа -> fd соединения, таймер взведён на первый срок
+    QMultiMap<qint64, int> mDelayed;
+    qint64 mTimerDeadline{};
+    // fd сервера -> индекс Endpoint
+    QHash<int, int> mListeners;
+    QHash<int, Connection> mConnections;
+    quint64 mRequests{};
+};
+
+}
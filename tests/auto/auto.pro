@@ -0,0 +1,10 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    byteorderinference \
+    configpartitioner \
+    expressioncompiler \
+    modbusconfigmodel \
+    modbusframe \
+    pollplan \
+    scalardecoder
@@ -0,0 +1,7 @@
+TARGET = tst_byteorderinference
+CONFIG += testcase
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_byteorderinference.cpp
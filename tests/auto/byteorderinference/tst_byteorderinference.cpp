@@ -0,0 +1,121 @@
+#include "byteorderinference.h"
+
+#include "registerdecoder.h"
+
+#include <QtTest>
+
+#include <cmath>
+#include <random>
+
+using namespace ModbusConfig;
+using ValType = RegisterAddress::ValType;
+
+Q_DECLARE_METATYPE(ModbusConfig::RegisterAddress::ValType)
+
+namespace {
+// медленно меняющийся сигнал с шумом, как у реального датчика, в байтах по typeOrder
+ByteOrderCapture makeCapture(ValType type, const QString &typeOrder, double base,
+    double amplitude, int count)
+{
+    std::mt19937 random(static_cast<uint>(type));
+    std::normal_distribution<double> noise(0, amplitude / 100);
+    QVector<double> values(count);
+    for (int i = 0; i < count; ++i) {
+        values[i] = base + amplitude * std::sin(i * 0.02) + noise(random);
+    }
+    const RegisterDecoder decoder(type, typeOrder);
+    ByteOrderCapture capture;
+    capture.valType = type;
+    capture.registers.resize(count * decoder.valueSize());
+    decoder.encode(values.constData(), count,
+        reinterpret_cast<quint8 *>(capture.registers.data()));
+    return capture;
+}
+}
+
+class ByteOrderInferenceTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void trueOrderRanksFirst_data();
+    void trueOrderRanksFirst();
+    void batchMatchesSingle();
+    void candidateOrders();
+};
+
+void ByteOrderInferenceTest::trueOrderRanksFirst_data()
+{
+    QTest::addColumn<ValType>("type");
+    QTest::addColumn<QString>("typeOrder");
+    QTest::addColumn<double>("base");
+    QTest::addColumn<double>("amplitude");
+    QTest::addColumn<QVariant>("minValue");
+    QTest::addColumn<QVariant>("maxValue");
+
+    QTest::newRow("float 1234") << ValType::Float << QStringLiteral("1234") << 20.0 << 5.0
+                                << QVariant() << QVariant();
+    QTest::newRow("float 2143") << ValType::Float << QStringLiteral("2143") << 20.0 << 5.0
+                                << QVariant(0.0) << QVariant(100.0);
+    QTest::newRow("uint32 4321") << ValType::UInt32 << QStringLiteral("4321") << 100000.0
+                                 << 5000.0 << QVariant() << QVariant();
+    QTest::newRow("int16 21") << ValType::Int16 << QStringLiteral("21") << 1500.0 << 300.0
+                              << QVariant() << QVariant();
+    QTest::newRow("double 78563412") << ValType::Double << QStringLiteral("78563412")
+                                     << 1000.0 << 100.0 << QVariant() << QVariant();
+    QTest::newRow("int64 21436587") << ValType::Int64 << QStringLiteral("21436587")
+                                    << 500000.0 << 20000.0 << QVariant(0.0)
+                                    << QVariant(1000000.0);
+}
+
+// выборка, записанная в известном порядке, должна дать этот порядок первым
+void ByteOrderInferenceTest::trueOrderRanksFirst()
+{
+    QFETCH(ValType, type);
+    QFETCH(QString, typeOrder);
+    QFETCH(double, base);
+    QFETCH(double, amplitude);
+    QFETCH(QVariant, minValue);
+    QFETCH(QVariant, maxValue);
+
+    ByteOrderCapture capture = makeCapture(type, typeOrder, base, amplitude, 512);
+    capture.minValue = minValue;
+    capture.maxValue = maxValue;
+    const auto candidates = ByteOrderInference().rank(capture);
+    QVERIFY(!candidates.isEmpty());
+    QCOMPARE(candidates.first().typeOrder, typeOrder);
+    QCOMPARE(candidates.first().inRange, 1.0);
+}
+
+// параллельная обработка нескольких выборок даёт тот же результат, что и по одной
+void ByteOrderInferenceTest::batchMatchesSingle()
+{
+    const QVector<ByteOrderCapture> captures = {
+        makeCapture(ValType::Float, QStringLiteral("3412"), 50, 10, 256),
+        makeCapture(ValType::Double, QStringLiteral("87654321"), 50, 10, 256),
+        makeCapture(ValType::UInt16, QStringLiteral("12"), 500, 100, 256)};
+    ByteOrderInference inference;
+    inference.setResultCount(3);
+    const auto batch = inference.rank(captures);
+    QCOMPARE(batch.size(), captures.size());
+    for (int i = 0; i < captures.size(); ++i) {
+        const auto single = inference.rank(captures.at(i));
+        QCOMPARE(batch.at(i).size(), single.size());
+        for (int j = 0; j < single.size(); ++j) {
+            QCOMPARE(batch.at(i).at(j).typeOrder, single.at(j).typeOrder);
+        }
+    }
+}
+
+void ByteOrderInferenceTest::candidateOrders()
+{
+    QCOMPARE(ByteOrderInference::candidateOrders(ValType::UInt8), QStringList{QString()});
+    QCOMPARE(ByteOrderInference::candidateOrders(ValType::Int16),
+        QStringList({QStringLiteral("12"), QStringLiteral("21")}));
+    QCOMPARE(ByteOrderInference::candidateOrders(ValType::Float).size(), 24);
+    QCOMPARE(ByteOrderInference::candidateOrders(ValType::Double).size(), 40320);
+}
+
+QTEST_APPLESS_MAIN(ByteOrderInferenceTest)
+
+#include "tst_byteorderinference.moc"
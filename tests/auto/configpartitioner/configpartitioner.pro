@@ -0,0 +1,7 @@
+TARGET = tst_configpartitioner
+CONFIG += testcase
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_configpartitioner.cpp
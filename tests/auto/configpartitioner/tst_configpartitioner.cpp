@@ -0,0 +1,121 @@
+#include "configpartitioner.h"
+#include "serializer.h"
+
+#include <QtTest>
+
+using namespace ModbusConfig;
+
+namespace {
+// каждое устройство на своём tcp адресе - отдельный канал
+QUuid addDevice(ModbusConfigModel *model, int index)
+{
+    const QUuid devId = QUuid::createUuid();
+    ConnectionParams params;
+    params.type = ConnectionParams::Type::Tcp;
+    params.address = QStringLiteral("10.0.0.%0").arg(index + 1);
+    params.port = 502;
+    model->upsertDevice(devId, QUuid(), params, QStringLiteral("device %0").arg(index));
+    return devId;
+}
+
+Sensor separateSensor(int regAddress)
+{
+    Sensor sensor;
+    sensor.id = QUuid::createUuid();
+    sensor.description = QStringLiteral("sensor");
+    sensor.type = Sensor::Type::Separate;
+    sensor.mode = Sensor::Mode::Read;
+    sensor.registerAddress.slaveAddress = 1;
+    sensor.registerAddress.regType = RegisterAddress::RegisterType::AnalogInputRegisters;
+    sensor.registerAddress.regAddress = regAddress;
+    sensor.registerAddress.valType = RegisterAddress::ValType::UInt16;
+    return sensor;
+}
+
+Sensor virtualSensor(const QUuid &reference)
+{
+    Sensor sensor;
+    sensor.id = QUuid::createUuid();
+    sensor.description = QStringLiteral("virtual");
+    sensor.type = Sensor::Type::Virtual;
+    sensor.mode = Sensor::Mode::Read;
+    sensor.correctFunction = reference.toString() + QStringLiteral(" * 2");
+    return sensor;
+}
+
+int partitionOf(const QVector<ModbusConfigModel> &partitions, const QUuid &devId)
+{
+    for (int i = 0; i < partitions.size(); ++i) {
+        if (partitions.at(i).devicesIds().contains(devId)) {
+            return i;
+        }
+    }
+    return -1;
+}
+}
+
+class ConfigPartitionerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void referencedChannelsShareNode();
+    void danglingReferenceIsRejected();
+};
+
+// датчик и датчики, на которые он ссылается, должны попасть в одну конфигурацию узла
+void ConfigPartitionerTest::referencedChannelsShareNode()
+{
+    ModbusConfigModel model;
+    QVector<QUuid> devices;
+    QVector<QUuid> sources;
+    for (int i = 0; i < 6; ++i) {
+        devices.append(addDevice(&model, i));
+        const Sensor source = separateSensor(30001 + i);
+        QCOMPARE(model.upsertSensor(devices.last(), QUuid(), source), QString());
+        sources.append(source.id);
+    }
+    // цепочка 0 <- 3 <- 5 через устройства разных каналов
+    QCOMPARE(model.upsertSensor(devices.at(3), QUuid(), virtualSensor(sources.at(0))),
+        QString());
+    QCOMPARE(model.upsertSensor(devices.at(5), QUuid(), virtualSensor(sources.at(3))),
+        QString());
+
+    PartitionReport report;
+    const auto partitions = ConfigPartitioner().partition(model, 3, &report);
+    QCOMPARE(partitions.size(), 3);
+    const int node = partitionOf(partitions, devices.at(0));
+    QVERIFY(node >= 0);
+    QCOMPARE(partitionOf(partitions, devices.at(3)), node);
+    QCOMPARE(partitionOf(partitions, devices.at(5)), node);
+    QCOMPARE(report.nodes.at(node).channels.size(), 3);
+
+    int deviceCount = 0;
+    for (const auto &partition : partitions) {
+        QCOMPARE(partition.checkReferencedSensors(), QString());
+        deviceCount += partition.devicesIds().size();
+    }
+    QCOMPARE(deviceCount, devices.size());
+}
+
+// конфигурация со ссылкой на отсутствующий датчик не загружается
+void ConfigPartitionerTest::danglingReferenceIsRejected()
+{
+    ModbusConfigModel model;
+    const QUuid devId = addDevice(&model, 0);
+    Device device = model.device(devId);
+    QCOMPARE(model.deleteDevice(devId), QString());
+    const Sensor dependent = virtualSensor(QUuid::createUuid());
+    device.sensors.insert(dependent.id, dependent);
+    QCOMPARE(model.insertDevice(device), QString());
+    QVERIFY(!model.checkReferencedSensors().isEmpty());
+
+    Serializer serializer;
+    QString error;
+    serializer.deserialize(serializer.serialize(model), &error);
+    QVERIFY(!error.isEmpty());
+}
+
+QTEST_APPLESS_MAIN(ConfigPartitionerTest)
+
+#include "tst_configpartitioner.moc"
@@ -0,0 +1,7 @@
+TARGET = tst_expressioncompiler
+CONFIG += testcase
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_expressioncompiler.cpp
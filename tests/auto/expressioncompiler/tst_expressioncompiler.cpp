@@ -0,0 +1,57 @@
+#include "expressioncompiler.h"
+
+#include <QtTest>
+
+using namespace ModbusConfig;
+
+class ExpressionCompilerTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void unusedProgramsAreDropped();
+    void replaceReference();
+};
+
+// кэш не держит программы, которые больше никому не нужны
+void ExpressionCompilerTest::unusedProgramsAreDropped()
+{
+    ExpressionCompiler compiler;
+    const auto kept = compiler.compile(QStringLiteral("val * 2"), nullptr);
+    QVERIFY(!kept.isNull());
+    for (int i = 0; i < 10000; ++i) {
+        QVERIFY(!compiler.compile(QStringLiteral("val + %0").arg(i), nullptr).isNull());
+    }
+    QCOMPARE(compiler.cacheSize(), 1);
+    QCOMPARE(compiler.compile(QStringLiteral(" val * 2 "), nullptr), kept);
+
+    QString error;
+    QVERIFY(compiler.compile(QStringLiteral("val *"), &error).isNull());
+    QVERIFY(!error.isEmpty());
+    QCOMPARE(compiler.cacheSize(), 1);
+}
+
+void ExpressionCompilerTest::replaceReference()
+{
+    const QUuid from = QUuid::createUuid();
+    const QUuid to = QUuid::createUuid();
+    const QUuid other = QUuid::createUuid();
+    const QString bare = from.toString().mid(1, 36);
+
+    const QString text = QStringLiteral("max({%0}, { %1 }) + %2 - val").arg(
+        bare.toUpper(), other.toString().mid(1, 36), from.toString());
+    const QString expected = QStringLiteral("max(%0, { %1 }) + %0 - val").arg(
+        to.toString(), other.toString().mid(1, 36));
+    QCOMPARE(ModbusConfig::replaceReference(text, from, to), expected);
+
+    ExpressionCompiler compiler;
+    const auto program = compiler.compile(expected, nullptr);
+    QVERIFY(!program.isNull());
+    QCOMPARE(program->references(), (QVector<QUuid>{to, other}));
+    QCOMPARE(ModbusConfig::replaceReference(QStringLiteral("val + {"), from, to),
+        QStringLiteral("val + {"));
+}
+
+QTEST_APPLESS_MAIN(ExpressionCompilerTest)
+
+#include "tst_expressioncompiler.moc"
@@ -0,0 +1,7 @@
+TARGET = tst_modbusconfigmodel
+CONFIG += testcase
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_modbusconfigmodel.cpp
@@ -0,0 +1,198 @@
+#include "modbusconfigmodel.h"
+
+#include <QtTest>
+
+using namespace ModbusConfig;
+
+namespace {
+QUuid addDevice(ModbusConfigModel *model)
+{
+    const QUuid devId = QUuid::createUuid();
+    ConnectionParams params;
+    params.type = ConnectionParams::Type::Tcp;
+    params.address = QStringLiteral("127.0.0.1");
+    params.port = 502;
+    model->upsertDevice(devId, QUuid(), params, QStringLiteral("device"));
+    return devId;
+}
+
+Sensor separateSensor(const QString &correctFunction)
+{
+    Sensor sensor;
+    sensor.id = QUuid::createUuid();
+    sensor.description = QStringLiteral("sensor");
+    sensor.type = Sensor::Type::Separate;
+    sensor.mode = Sensor::Mode::Read;
+    sensor.registerAddress.slaveAddress = 1;
+    sensor.registerAddress.regType = RegisterAddress::RegisterType::AnalogInputRegisters;
+    sensor.registerAddress.regAddress = 30001;
+    sensor.registerAddress.valType = RegisterAddress::ValType::UInt16;
+    sensor.correctFunction = correctFunction;
+    return sensor;
+}
+
+Sensor virtualSensor(const QString &correctFunction)
+{
+    Sensor sensor;
+    sensor.id = QUuid::createUuid();
+    sensor.description = QStringLiteral("virtual");
+    sensor.type = Sensor::Type::Virtual;
+    sensor.mode = Sensor::Mode::Read;
+    sensor.correctFunction = correctFunction;
+    return sensor;
+}
+
+QString reference(const QUuid &id)
+{
+    return id.toString();
+}
+}
+
+class ModbusConfigModelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void invalidExpressionIsAccepted();
+    void identicalExpressionsShareProgram();
+    void virtualSensorIsComputed();
+    void referencedSensorIsKept();
+    void renamedSensorKeepsReferences();
+    void rejectedMapRenameKeepsSensors();
+};
+
+// ошибка в выражении не делает конфигурацию незагружаемой: датчик сохраняется без коррекции
+void ModbusConfigModelTest::invalidExpressionIsAccepted()
+{
+    ModbusConfigModel model;
+    const QUuid devId = addDevice(&model);
+    const Sensor sensor = separateSensor(QStringLiteral("val * (2 +"));
+    QCOMPARE(model.upsertSensor(devId, QUuid(), sensor), QString());
+    QVERIFY(model.device(devId).sensors.contains(sensor.id));
+    QVERIFY(model.sensorCorrection(sensor.id).isNull());
+
+    Sensor fixed = sensor;
+    fixed.correctFunction = QStringLiteral("val * 2");
+    QCOMPARE(model.upsertSensor(devId, sensor.id, fixed), QString());
+    QVERIFY(!model.sensorCorrection(sensor.id).isNull());
+
+    Device device;
+    device.settings.id = QUuid::createUuid();
+    const Sensor loaded = separateSensor(QStringLiteral("val $ 3"));
+    device.sensors.insert(loaded.id, loaded);
+    QCOMPARE(model.insertDevice(device), QString());
+    QVERIFY(model.sensorCorrection(loaded.id).isNull());
+}
+
+void ModbusConfigModelTest::identicalExpressionsShareProgram()
+{
+    ModbusConfigModel model;
+    const QUuid devId = addDevice(&model);
+    const Sensor first = separateSensor(QStringLiteral("val * 2 + 1"));
+    const Sensor second = separateSensor(QStringLiteral("val * 2 + 1"));
+    QCOMPARE(model.upsertSensor(devId, QUuid(), first), QString());
+    QCOMPARE(model.upsertSensor(devId, QUuid(), second), QString());
+    QVERIFY(!model.sensorCorrection(first.id).isNull());
+    QCOMPARE(model.sensorCorrection(first.id), model.sensorCorrection(second.id));
+}
+
+void ModbusConfigModelTest::virtualSensorIsComputed()
+{
+    ModbusConfigModel model;
+    const QUuid devId = addDevice(&model);
+    const Sensor source = separateSensor(QString());
+    QCOMPARE(model.upsertSensor(devId, QUuid(), source), QString());
+
+    const Sensor sum = virtualSensor(reference(source.id) + QStringLiteral(" * 2 + 1"));
+    QCOMPARE(model.upsertSensor(devId, QUuid(), sum), QString());
+    QVERIFY(!model.sensorCorrection(sum.id).isNull());
+    QVERIFY(!model.sensorDecoder(sum.id).isValid());
+    // регистров не занимает
+    QCOMPARE(model.pollPlan().deviceRequests(devId).size(), 1);
+
+    QVERIFY(!model.upsertSensor(devId, QUuid(), virtualSensor(QStringLiteral("val * 2")))
+                 .isEmpty());
+    QVERIFY(!model.upsertSensor(devId, QUuid(), virtualSensor(QStringLiteral("3"))).isEmpty());
+    QVERIFY(!model.upsertSensor(devId, QUuid(), virtualSensor(reference(source.id) + "+"))
+                 .isEmpty());
+    Sensor writable = virtualSensor(reference(source.id));
+    writable.mode = Sensor::Mode::ReadWrite;
+    QVERIFY(!model.upsertSensor(devId, QUuid(), writable).isEmpty());
+}
+
+// удаление датчика или устройства не должно оставлять висячих ссылок
+void ModbusConfigModelTest::referencedSensorIsKept()
+{
+    ModbusConfigModel model;
+    const QUuid devId = addDevice(&model);
+    const QUuid otherDevId = addDevice(&model);
+    const Sensor source = separateSensor(QString());
+    QCOMPARE(model.upsertSensor(devId, QUuid(), source), QString());
+    const Sensor dependent = virtualSensor(reference(source.id));
+    QCOMPARE(model.upsertSensor(otherDevId, QUuid(), dependent), QString());
+
+    QVERIFY(!model.deleteSensor(devId, source.id).isEmpty());
+    QVERIFY(!model.deleteDevice(devId).isEmpty());
+    QVERIFY(model.device(devId).sensors.contains(source.id));
+
+    QCOMPARE(model.deleteSensor(otherDevId, dependent.id), QString());
+    QCOMPARE(model.deleteDevice(devId), QString());
+}
+
+void ModbusConfigModelTest::renamedSensorKeepsReferences()
+{
+    ModbusConfigModel model;
+    const QUuid devId = addDevice(&model);
+    const Sensor source = separateSensor(QString());
+    QCOMPARE(model.upsertSensor(devId, QUuid(), source), QString());
+    Sensor dependent = separateSensor(
+        QStringLiteral("val + {%0} * { %0 }").arg(source.id.toString().mid(1, 36)));
+    dependent.registerAddress.regAddress = 30002;
+    QCOMPARE(model.upsertSensor(devId, QUuid(), dependent), QString());
+
+    Sensor renamed = source;
+    renamed.id = QUuid::createUuid();
+    QCOMPARE(model.upsertSensor(devId, source.id, renamed), QString());
+
+    const QString rewritten = model.device(devId).sensors.value(dependent.id).correctFunction;
+    QCOMPARE(rewritten, QStringLiteral("val + %0 * %0").arg(reference(renamed.id)));
+    const auto correction = model.sensorCorrection(dependent.id);
+    QVERIFY(!correction.isNull());
+    QCOMPARE(correction->references(), QVector<QUuid>{renamed.id});
+    QVERIFY(!model.deleteSensor(devId, renamed.id).isEmpty());
+}
+
+// отклонённое переименование карты не должно менять mapId привязанных датчиков
+void ModbusConfigModelTest::rejectedMapRenameKeepsSensors()
+{
+    ModbusConfigModel model;
+    const QUuid devId = addDevice(&model);
+    SensorsMap map;
+    map.id = QStringLiteral("map");
+    map.registеrAddress.slaveAddress = 1;
+    map.registеrAddress.regType = RegisterAddress::RegisterType::AnalogInputRegisters;
+    map.registеrAddress.regAddress = 30001;
+    map.registеrAddress.valType = RegisterAddress::ValType::UInt16;
+    map.valueCount = 10;
+    QCOMPARE(model.upsertSensorMap(devId, QString(), map), QString());
+    Sensor sensor = separateSensor(QString());
+    sensor.type = Sensor::Type::Map;
+    sensor.mapId = map.id;
+    sensor.mapOffset = 3;
+    QCOMPARE(model.upsertSensor(devId, QUuid(), sensor), QString());
+
+    SensorsMap renamed = map;
+    renamed.id = QStringLiteral("renamed");
+    renamed.registеrAddress.bitOffset = 2;
+    QVERIFY(!model.upsertSensorMap(devId, map.id, renamed).isEmpty());
+    renamed.registеrAddress.bitOffset = -1;
+    renamed.registеrAddress.regAddress = 0;
+    QVERIFY(!model.upsertSensorMap(devId, map.id, renamed).isEmpty());
+
+    QVERIFY(model.device(devId).maps.contains(map.id));
+    QCOMPARE(model.device(devId).sensors.value(sensor.id).mapId, map.id);
+}
+
+QTEST_APPLESS_MAIN(ModbusConfigModelTest)
+
+#include "tst_modbusconfigmodel.moc"
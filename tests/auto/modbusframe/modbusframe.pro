@@ -0,0 +1,7 @@
+TARGET = tst_modbusframe
+CONFIG += testcase
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_modbusframe.cpp
@@ -0,0 +1,198 @@
+#include "modbusframe.h"
+
+#include <QtTest>
+
+#include <random>
+#include <vector>
+
+using namespace ModbusConfig;
+
+namespace {
+constexpr int fuzzIterations = 200000;
+
+const FunctionCode readFunctions[] = {FunctionCode::ReadCoils,
+    FunctionCode::ReadDiscreteInputs, FunctionCode::ReadHoldingRegisters,
+    FunctionCode::ReadInputRegisters};
+
+int randomInt(std::mt19937 &random, int min, int max)
+{
+    return std::uniform_int_distribution<int>(min, max)(random);
+}
+
+// буфер ровно по размеру данных, чтобы выход за границу ловили санитайзеры
+std::vector<quint8> randomBytes(std::mt19937 &random, int size)
+{
+    std::vector<quint8> data(static_cast<size_t>(size));
+    for (auto &byte : data) {
+        byte = quint8(random());
+    }
+    return data;
+}
+
+// ответ на чтение: TCP или RTU кадр, который затем портится
+std::vector<quint8> validResponse(std::mt19937 &random, bool tcp)
+{
+    quint8 frame[maxTcpFrameSize];
+    quint8 *pdu = frame + (tcp ? tcpPduOffset : rtuPduOffset);
+    const FunctionCode function = readFunctions[randomInt(random, 0, 3)];
+    const bool bits = function == FunctionCode::ReadCoils
+        || function == FunctionCode::ReadDiscreteInputs;
+    const int count = randomInt(random, 1, bits ? 2000 : 125);
+    const int bytes = bits ? (count + 7) / 8 : count * 2;
+    pdu[0] = quint8(function);
+    pdu[1] = quint8(bytes);
+    for (int i = 0; i < bytes; ++i) {
+        pdu[2 + i] = quint8(random());
+    }
+    const int size = tcp ? finishTcpFrame(frame, quint16(random()), 1, 2 + bytes)
+                         : finishRtuFrame(frame, 1, 2 + bytes);
+    return std::vector<quint8>(frame, frame + size);
+}
+
+void mutate(std::mt19937 &random, std::vector<quint8> *data)
+{
+    switch (randomInt(random, data->empty() ? 1 : 0, 3)) {
+    case 0:
+        (*data)[size_t(randomInt(random, 0, int(data->size()) - 1))] = quint8(random());
+        break;
+    case 1:
+        data->resize(size_t(randomInt(random, 0, int(data->size()))));
+        break;
+    case 2:
+        data->push_back(quint8(random()));
+        break;
+    default:
+        break;
+    }
+}
+
+bool inside(const quint8 *begin, int size, const quint8 *pointer, int length)
+{
+    return pointer >= begin && length >= 0 && pointer + length <= begin + size;
+}
+}
+
+class ModbusFrameTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void tcpFuzz();
+    void rtuFuzz();
+    void readResponseFuzz();
+    void exceptionCodeZeroIsError();
+    void readRequestRoundTrip();
+};
+
+// разбор произвольных и испорченных кадров не выходит за буфер и не возвращает мусор
+void ModbusFrameTest::tcpFuzz()
+{
+    std::mt19937 random(1);
+    for (int i = 0; i < fuzzIterations; ++i) {
+        std::vector<quint8> data = i % 2 ? randomBytes(random, randomInt(random, 0, 300))
+                                         : validResponse(random, true);
+        mutate(random, &data);
+        const int size = int(data.size());
+        ModbusFrame frame;
+        const int length = parseTcpFrame(data.data(), size, &frame);
+        QVERIFY2(length >= -1 && length <= qMin(size, maxTcpFrameSize),
+            qPrintable(QStringLiteral("iteration %0: length %1").arg(i).arg(length)));
+        if (length > 0) {
+            QVERIFY(frame.pduSize >= 1 && frame.pduSize <= maxPduSize);
+            QVERIFY(inside(data.data(), length, frame.pdu, frame.pduSize));
+        }
+    }
+}
+
+void ModbusFrameTest::rtuFuzz()
+{
+    std::mt19937 random(2);
+    for (int i = 0; i < fuzzIterations; ++i) {
+        std::vector<quint8> data = i % 2 ? randomBytes(random, randomInt(random, 0, 300))
+                                         : validResponse(random, false);
+        const bool valid = i % 4 == 0;
+        if (!valid) {
+            mutate(random, &data);
+        }
+        const int size = int(data.size());
+        for (int length : {rtuRequestLength(data.data(), size),
+                 rtuResponseLength(data.data(), size)}) {
+            QVERIFY2(length == -1 || length == 0 || (length >= 4 && length <= maxRtuFrameSize),
+                qPrintable(QStringLiteral("iteration %0: length %1").arg(i).arg(length)));
+            QVERIFY(length != -1 || size < 11);
+        }
+        ModbusFrame frame;
+        const bool parsed = parseRtuFrame(data.data(), size, &frame);
+        if (valid) {
+            QVERIFY(parsed);
+            QCOMPARE(rtuResponseLength(data.data(), size), size);
+        }
+        if (parsed) {
+            QVERIFY(inside(data.data(), size, frame.pdu, frame.pduSize));
+            QCOMPARE(frame.pduSize, size - 3);
+        }
+    }
+}
+
+void ModbusFrameTest::readResponseFuzz()
+{
+    std::mt19937 random(3);
+    for (int i = 0; i < fuzzIterations; ++i) {
+        std::vector<quint8> pdu = randomBytes(random, randomInt(random, 0, maxPduSize));
+        const FunctionCode function = readFunctions[randomInt(random, 0, 3)];
+        const int count = randomInt(random, -1, 2100);
+        if (pdu.size() >= 2 && i % 3 == 0) {
+            // правдоподобный заголовок, чтобы доходить до проверки данных
+            pdu[0] = quint8(function) | (i % 2 ? 0x80 : 0);
+            pdu[1] = quint8(pdu.size() - 2);
+        }
+        const int size = int(pdu.size());
+        const quint8 *data = nullptr;
+        const int result = readResponseData(pdu.data(), size, function, count, &data);
+        QVERIFY2(result >= -1 && result <= 0xFF,
+            qPrintable(QStringLiteral("iteration %0: result %1").arg(i).arg(result)));
+        if (result == 0) {
+            const bool bits = function == FunctionCode::ReadCoils
+                || function == FunctionCode::ReadDiscreteInputs;
+            QVERIFY(inside(pdu.data(), size, data, bits ? (count + 7) / 8 : count * 2));
+        } else if (result > 0) {
+            QCOMPARE(size, 2);
+            QCOMPARE(int(pdu[0]), quint8(function) | 0x80);
+        }
+    }
+}
+
+void ModbusFrameTest::exceptionCodeZeroIsError()
+{
+    const quint8 *data = nullptr;
+    const quint8 zero[] = {quint8(FunctionCode::ReadHoldingRegisters) | 0x80, 0};
+    QCOMPARE(readResponseData(zero, 2, FunctionCode::ReadHoldingRegisters, 1, &data), -1);
+    const quint8 busy[] = {quint8(FunctionCode::ReadHoldingRegisters) | 0x80, 0x06};
+    QCOMPARE(readResponseData(busy, 2, FunctionCode::ReadHoldingRegisters, 1, &data), 0x06);
+    QVERIFY(data == nullptr);
+}
+
+void ModbusFrameTest::readRequestRoundTrip()
+{
+    quint8 buffer[maxTcpFrameSize];
+    const int pduSize = encodeReadRequest(
+        buffer + tcpPduOffset, FunctionCode::ReadInputRegisters, 100, 125);
+    const int size = finishTcpFrame(buffer, 0x1234, 17, pduSize);
+    ModbusFrame frame;
+    QCOMPARE(parseTcpFrame(buffer, size, &frame), size);
+    QCOMPARE(int(frame.transactionId), 0x1234);
+    QCOMPARE(int(frame.unit), 17);
+    QCOMPARE(frame.pduSize, pduSize);
+    QCOMPARE(parseTcpFrame(buffer, size - 1, &frame), -1);
+
+    const int rtuSize = finishRtuFrame(buffer, 17,
+        encodeReadRequest(buffer + rtuPduOffset, FunctionCode::ReadCoils, 0, 2000));
+    QCOMPARE(rtuRequestLength(buffer, rtuSize), rtuSize);
+    QVERIFY(parseRtuFrame(buffer, rtuSize, &frame));
+    buffer[3] ^= 1;
+    QVERIFY(!parseRtuFrame(buffer, rtuSize, &frame));
+}
+
+QTEST_APPLESS_MAIN(ModbusFrameTest)
+
+#include "tst_modbusframe.moc"
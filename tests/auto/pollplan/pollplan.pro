@@ -0,0 +1,7 @@
+TARGET = tst_pollplan
+CONFIG += testcase
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_pollplan.cpp
@@ -0,0 +1,207 @@
+#include "modbusconfigmodel.h"
+#include "pollplanner.h"
+
+#include <QtTest>
+
+#include <random>
+
+using namespace ModbusConfig;
+
+namespace {
+using RegisterType = RegisterAddress::RegisterType;
+using ValType = RegisterAddress::ValType;
+
+int randomInt(std::mt19937 &random, int min, int max)
+{
+    return std::uniform_int_distribution<int>(min, max)(random);
+}
+
+RegisterAddress randomAddress(std::mt19937 &random)
+{
+    static const RegisterType types[] = {RegisterType::AnalogOutputHoldingRegisters,
+        RegisterType::AnalogInputRegisters, RegisterType::DiscreteOutputCoils};
+    static const ValType valTypes[] = {ValType::Int16, ValType::UInt16, ValType::Float,
+        ValType::Double};
+
+    RegisterAddress address;
+    address.slaveAddress = quint8(randomInt(random, 1, 3));
+    address.regType = types[randomInt(random, 0, 2)];
+    switch (address.regType) {
+    case RegisterType::AnalogOutputHoldingRegisters:
+        address.regAddress = 40001 + randomInt(random, 0, 600);
+        break;
+    case RegisterType::AnalogInputRegisters:
+        address.regAddress = 30001 + randomInt(random, 0, 600);
+        break;
+    default:
+        address.regAddress = 1 + randomInt(random, 0, 600);
+        break;
+    }
+    address.valType = address.regType == RegisterType::DiscreteOutputCoils
+        ? ValType::Bool
+        : valTypes[randomInt(random, 0, 3)];
+    return address;
+}
+
+Sensor randomSensor(std::mt19937 &random, const QUuid &id)
+{
+    Sensor sensor;
+    sensor.id = id;
+    sensor.description = QStringLiteral("sensor");
+    sensor.type = Sensor::Type::Separate;
+    sensor.mode = Sensor::Mode::Read;
+    sensor.registerAddress = randomAddress(random);
+    return sensor;
+}
+
+SensorsMap randomMap(std::mt19937 &random, const QString &id)
+{
+    SensorsMap map;
+    map.id = id;
+    map.registеrAddress = randomAddress(random);
+    map.valueCount = randomInt(random, 1, 150);
+    return map;
+}
+}
+
+class PollPlanTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void incrementalMatchesFullRebuild_data();
+    void incrementalMatchesFullRebuild();
+    void emptyGroupIsDropped();
+    void renamedDeviceKeepsPlan();
+};
+
+void PollPlanTest::incrementalMatchesFullRebuild_data()
+{
+    QTest::addColumn<uint>("seed");
+    QTest::addColumn<int>("initialSensors");
+    QTest::addColumn<int>("edits");
+
+    QTest::newRow("small") << 1u << 20 << 300;
+    QTest::newRow("medium") << 2u << 300 << 1000;
+    QTest::newRow("bulk load") << 3u << 3000 << 200;
+}
+
+// после каждой правки план модели должен совпадать с планом, построенным заново
+void PollPlanTest::incrementalMatchesFullRebuild()
+{
+    QFETCH(uint, seed);
+    QFETCH(int, initialSensors);
+    QFETCH(int, edits);
+
+    std::mt19937 random(seed);
+    ModbusConfigModel model;
+    const QUuid devId = QUuid::createUuid();
+    ConnectionParams params;
+    params.type = ConnectionParams::Type::Tcp;
+    params.address = QStringLiteral("127.0.0.1");
+    params.port = 502;
+    QVERIFY(model.upsertDevice(devId, QUuid(), params, QStringLiteral("device")).isEmpty());
+
+    QVector<QUuid> sensorIds;
+    for (int i = 0; i < initialSensors; ++i) {
+        const QUuid id = QUuid::createUuid();
+        QVERIFY(model.upsertSensor(devId, QUuid(), randomSensor(random, id)).isEmpty());
+        sensorIds.append(id);
+    }
+    QStringList mapIds;
+    for (int i = 0; i < 10; ++i) {
+        const QString id = QStringLiteral("map%0").arg(i);
+        QVERIFY(model.upsertSensorMap(devId, QString(), randomMap(random, id)).isEmpty());
+        mapIds.append(id);
+    }
+    QVERIFY(model.pollPlan().deviceRequests(devId) == PollPlanner().plan(model.device(devId)));
+
+    int nextMap = mapIds.size();
+    for (int edit = 0; edit < edits; ++edit) {
+        const int action = randomInt(random, 0, 7);
+        QString error;
+        if (action == 0 || sensorIds.isEmpty()) {
+            const QUuid id = QUuid::createUuid();
+            error = model.upsertSensor(devId, QUuid(), randomSensor(random, id));
+            sensorIds.append(id);
+        } else if (action == 1) {
+            const QUuid id = sensorIds.takeAt(randomInt(random, 0, sensorIds.size() - 1));
+            error = model.deleteSensor(devId, id);
+        } else if (action == 2) {
+            // смена идентификатора датчика
+            const int index = randomInt(random, 0, sensorIds.size() - 1);
+            const QUuid id = QUuid::createUuid();
+            error = model.upsertSensor(devId, sensorIds.at(index), randomSensor(random, id));
+            sensorIds[index] = id;
+        } else if (action == 3 && !mapIds.isEmpty()) {
+            const QString id = mapIds.at(randomInt(random, 0, mapIds.size() - 1));
+            error = model.upsertSensorMap(devId, id, randomMap(random, id));
+        } else if (action == 4 && !mapIds.isEmpty()) {
+            const int index = randomInt(random, 0, mapIds.size() - 1);
+            const QString id = QStringLiteral("map%0").arg(nextMap++);
+            error = model.upsertSensorMap(devId, mapIds.at(index), randomMap(random, id));
+            mapIds[index] = id;
+        } else if (action == 5 && !mapIds.isEmpty()) {
+            error = model.deleteSensorMap(
+                devId, mapIds.takeAt(randomInt(random, 0, mapIds.size() - 1)));
+        } else if (action == 6) {
+            PollSettings settings;
+            settings.maxRegisterGap = randomInt(random, -1, 20);
+            settings.maxRequestSize = randomInt(random, 0, 1) ? -1 : randomInt(random, 1, 125);
+            error = model.setDevicePollSettings(devId, settings);
+        } else {
+            const int index = randomInt(random, 0, sensorIds.size() - 1);
+            error = model.upsertSensor(
+                devId, sensorIds.at(index), randomSensor(random, sensorIds.at(index)));
+        }
+        QVERIFY2(error.isEmpty(), qPrintable(error));
+        QVERIFY2(model.pollPlan().deviceRequests(devId)
+                == PollPlanner().plan(model.device(devId)),
+            qPrintable(QStringLiteral("edit %0, action %1").arg(edit).arg(action)));
+    }
+}
+
+void PollPlanTest::emptyGroupIsDropped()
+{
+    ModbusConfigModel model;
+    const QUuid devId = QUuid::createUuid();
+    ConnectionParams params;
+    params.type = ConnectionParams::Type::Tcp;
+    QVERIFY(model.upsertDevice(devId, QUuid(), params, QStringLiteral("device")).isEmpty());
+
+    std::mt19937 random(7);
+    Sensor sensor = randomSensor(random, QUuid::createUuid());
+    QVERIFY(model.upsertSensor(devId, QUuid(), sensor).isEmpty());
+    QCOMPARE(model.pollPlan().groupKeys().size(), 1);
+    QCOMPARE(model.pollPlan().deviceRequests(devId).size(), 1);
+
+    QVERIFY(model.deleteSensor(devId, sensor.id).isEmpty());
+    QVERIFY(model.pollPlan().isUpToDate());
+    QVERIFY(model.pollPlan().groupKeys().isEmpty());
+    QVERIFY(model.pollPlan().deviceRequests(devId).isEmpty());
+}
+
+void PollPlanTest::renamedDeviceKeepsPlan()
+{
+    ModbusConfigModel model;
+    const QUuid devId = QUuid::createUuid();
+    ConnectionParams params;
+    params.type = ConnectionParams::Type::Tcp;
+    QVERIFY(model.upsertDevice(devId, QUuid(), params, QStringLiteral("device")).isEmpty());
+    std::mt19937 random(11);
+    for (int i = 0; i < 50; ++i) {
+        QVERIFY(model.upsertSensor(devId, QUuid(), randomSensor(random, QUuid::createUuid()))
+                    .isEmpty());
+    }
+    const auto before = model.pollPlan().deviceRequests(devId);
+
+    const QUuid newId = QUuid::createUuid();
+    QVERIFY(model.upsertDevice(newId, devId, params, QStringLiteral("device")).isEmpty());
+    QVERIFY(model.pollPlan().deviceRequests(devId).isEmpty());
+    QVERIFY(model.pollPlan().deviceRequests(newId) == before);
+    QVERIFY(before == PollPlanner().plan(model.device(newId)));
+}
+
+QTEST_APPLESS_MAIN(PollPlanTest)
+
+#include "tst_pollplan.moc"
@@ -0,0 +1,7 @@
+TARGET = tst_scalardecoder
+CONFIG += testcase
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_scalardecoder.cpp
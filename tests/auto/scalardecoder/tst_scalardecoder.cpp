@@ -0,0 +1,224 @@
+#include "scalardecoder.h"
+
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+using namespace ModbusConfig;
+using ValType = RegisterAddress::ValType;
+
+namespace {
+int valueSize(ValType type)
+{
+    switch (type) {
+    case ValType::Int32:
+    case ValType::UInt32:
+    case ValType::Float:
+        return 4;
+    case ValType::Int64:
+    case ValType::UInt64:
+    case ValType::Double:
+        return 8;
+    default:
+        return 2;
+    }
+}
+
+// эталон: байты значения по typeOrder от старшего к младшему, затем приведение типа
+double referenceDecode(ValType type, const QString &typeOrder, const quint8 *raw)
+{
+    const int size = valueSize(type);
+    quint64 bits = 0;
+    for (int p = 0; p < size; ++p) {
+        const int wireByte = typeOrder.isEmpty() ? p : typeOrder.at(p).digitValue() - 1;
+        bits = (bits << 8) | raw[wireByte];
+    }
+    switch (type) {
+    case ValType::Bool:
+        return bits != 0 ? 1 : 0;
+    case ValType::Int8:
+        return qint8(quint8(bits));
+    case ValType::UInt8:
+        return quint8(bits);
+    case ValType::Int16:
+        return qint16(quint16(bits));
+    case ValType::UInt16:
+        return quint16(bits);
+    case ValType::Int32:
+        return qint32(quint32(bits));
+    case ValType::UInt32:
+        return quint32(bits);
+    case ValType::Int64:
+        return double(qint64(bits));
+    case ValType::UInt64:
+        return double(bits);
+    case ValType::Float: {
+        const quint32 value32 = quint32(bits);
+        float value;
+        std::memcpy(&value, &value32, sizeof(value));
+        return value;
+    }
+    case ValType::Double: {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    default:
+        return 0;
+    }
+}
+
+bool sameValue(double l, double r)
+{
+    return l == r || (std::isnan(l) && std::isnan(r));
+}
+
+// все порядки байт типа; для 8-битных и Bool порядок не задаётся
+QStringList allOrders(ValType type)
+{
+    if (type == ValType::Bool || type == ValType::Int8 || type == ValType::UInt8) {
+        return {QString()};
+    }
+    QString order;
+    for (int i = 1; i <= valueSize(type); ++i) {
+        order += QString::number(i);
+    }
+    QStringList result{QString()};
+    do {
+        result.append(order);
+    } while (std::next_permutation(order.begin(), order.end()));
+    return result;
+}
+}
+
+Q_DECLARE_METATYPE(ModbusConfig::RegisterAddress::ValType)
+
+class ScalarDecoderTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchesReference_data();
+    void matchesReference();
+    void specializedOrders_data();
+    void specializedOrders();
+    void invalidOrders();
+    void bitFields();
+};
+
+void ScalarDecoderTest::matchesReference_data()
+{
+    QTest::addColumn<ValType>("type");
+
+    QTest::newRow("bool") << ValType::Bool;
+    QTest::newRow("int8") << ValType::Int8;
+    QTest::newRow("uint8") << ValType::UInt8;
+    QTest::newRow("int16") << ValType::Int16;
+    QTest::newRow("uint16") << ValType::UInt16;
+    QTest::newRow("int32") << ValType::Int32;
+    QTest::newRow("uint32") << ValType::UInt32;
+    QTest::newRow("float") << ValType::Float;
+    QTest::newRow("int64") << ValType::Int64;
+    QTest::newRow("uint64") << ValType::UInt64;
+    QTest::newRow("double") << ValType::Double;
+}
+
+// каждый порядок байт каждого типа, специализированный или общий, против эталона
+void ScalarDecoderTest::matchesReference()
+{
+    QFETCH(ValType, type);
+
+    std::mt19937 random(static_cast<uint>(type));
+    // крайние значения байт и случайные
+    QVector<QVector<quint8>> samples = {QVector<quint8>(8, 0x00), QVector<quint8>(8, 0xff),
+        {0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01},
+        {0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe}};
+    for (int i = 0; i < 4; ++i) {
+        QVector<quint8> sample(8);
+        for (auto &byte : sample) {
+            byte = quint8(random());
+        }
+        samples.append(sample);
+    }
+
+    for (const auto &order : allOrders(type)) {
+        const ScalarDecoder decoder(type, order);
+        QVERIFY2(decoder.isValid(), qPrintable(order));
+        for (const auto &sample : qAsConst(samples)) {
+            const double expected = referenceDecode(type, order, sample.constData());
+            const double actual = decoder(sample.constData());
+            QVERIFY2(sameValue(actual, expected),
+                qPrintable(QStringLiteral("order '%0': %1 != %2")
+                               .arg(order)
+                               .arg(actual, 0, 'g', 17)
+                               .arg(expected, 0, 'g', 17)));
+        }
+    }
+}
+
+void ScalarDecoderTest::specializedOrders_data()
+{
+    QTest::addColumn<ValType>("type");
+    QTest::addColumn<int>("specialized");
+
+    // 2 и 4 байта - все перестановки, 8 байт - перестановки целых регистров
+    // с одним порядком байт внутри регистра: 24 * 2
+    QTest::newRow("int16") << ValType::Int16 << 2;
+    QTest::newRow("float") << ValType::Float << 24;
+    QTest::newRow("double") << ValType::Double << 48;
+}
+
+void ScalarDecoderTest::specializedOrders()
+{
+    QFETCH(ValType, type);
+    QFETCH(int, specialized);
+
+    QStringList orders = allOrders(type);
+    orders.removeFirst();
+    int count = 0;
+    for (const auto &order : qAsConst(orders)) {
+        if (ScalarDecoder(type, order).isSpecialized()) {
+            ++count;
+        }
+    }
+    QCOMPARE(count, specialized);
+    QVERIFY(ScalarDecoder(type, QString()).isSpecialized());
+}
+
+void ScalarDecoderTest::invalidOrders()
+{
+    QVERIFY(!ScalarDecoder().isValid());
+    QVERIFY(!ScalarDecoder(ValType::Unknown, QString()).isValid());
+    QVERIFY(!ScalarDecoder(ValType::Int16, QStringLiteral("1")).isValid());
+    QVERIFY(!ScalarDecoder(ValType::Int16, QStringLiteral("11")).isValid());
+    QVERIFY(!ScalarDecoder(ValType::Float, QStringLiteral("1235")).isValid());
+    QVERIFY(!ScalarDecoder(ValType::Int8, QStringLiteral("12")).isValid());
+    QVERIFY(!ScalarDecoder(ValType::Double, QStringLiteral("1234")).isValid());
+}
+
+void ScalarDecoderTest::bitFields()
+{
+    RegisterAddress address;
+    address.valType = ValType::Bool;
+    for (int bit = 0; bit < 16; ++bit) {
+        address.bitOffset = bit;
+        const ScalarDecoder decoder(address);
+        QVERIFY(decoder.isValid());
+        for (unsigned word : {0x0000u, 0xffffu, 0xa5c3u, 1u << bit, ~(1u << bit) & 0xffffu}) {
+            const quint8 raw[2] = {quint8(word >> 8), quint8(word)};
+            QCOMPARE(decoder(raw), double((word >> bit) & 1u));
+        }
+    }
+    address.bitOffset = 16;
+    QVERIFY(!ScalarDecoder(address).isValid());
+    address.bitOffset = 3;
+    address.valType = ValType::Int16;
+    QVERIFY(!ScalarDecoder(address).isValid());
+}
+
+QTEST_APPLESS_MAIN(ScalarDecoderTest)
+
+#include "tst_scalardecoder.moc"
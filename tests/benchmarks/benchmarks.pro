@@ -0,0 +1,8 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    crc16 \
+    mapupdatekernel \
+    modbusframe \
+    pollplan \
+    registerdecoder
@@ -0,0 +1,6 @@
+TARGET = tst_bench_crc16
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_bench_crc16.cpp
@@ -0,0 +1,78 @@
+#include "crc16.h"
+
+#include <QtTest>
+
+#include <random>
+
+using namespace ModbusConfig;
+
+namespace {
+// одна итерация замера - 1000 кадров подряд из одного буфера
+constexpr int framesPerIteration = 1000;
+
+using Crc16Function = quint16 (*)(const quint8 *, int);
+
+QByteArray randomFrames(int size)
+{
+    QByteArray raw(framesPerIteration * size, Qt::Uninitialized);
+    std::mt19937 random(1);
+    for (auto &byte : raw) {
+        byte = char(random());
+    }
+    return raw;
+}
+}
+
+Q_DECLARE_METATYPE(Crc16Function)
+
+class Crc16Benchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void crc_data();
+    void crc();
+};
+
+void Crc16Benchmark::crc_data()
+{
+    QTest::addColumn<Crc16Function>("function");
+    QTest::addColumn<int>("size");
+
+    const QVector<QPair<Crc16Function, QString>> functions = {
+        {crc16Table, QStringLiteral("table")},
+        {crc16SliceBy8, QStringLiteral("slice-by-8")},
+        {crc16Clmul, QStringLiteral("pclmul")},
+        {crc16, QStringLiteral("dispatch")}};
+    for (const auto &function : functions) {
+        for (int size : {8, 16, 32, 64, 128, 256}) {
+            QTest::newRow(qPrintable(QStringLiteral("%0 %1 bytes").arg(function.second).arg(size)))
+                << function.first << size;
+        }
+    }
+}
+
+void Crc16Benchmark::crc()
+{
+    QFETCH(Crc16Function, function);
+    QFETCH(int, size);
+
+    const QByteArray raw = randomFrames(size);
+    const auto *data = reinterpret_cast<const quint8 *>(raw.constData());
+    // все реализации должны совпадать с табличной
+    for (int i = 0; i < framesPerIteration; ++i) {
+        QCOMPARE(function(data + i * size, size), crc16Table(data + i * size, size));
+    }
+
+    quint16 result = 0;
+    QBENCHMARK {
+        for (int i = 0; i < framesPerIteration; ++i) {
+            result ^= function(data + i * size, size);
+        }
+    }
+    Q_UNUSED(result);
+}
+
+QTEST_APPLESS_MAIN(Crc16Benchmark)
+
+#include "tst_bench_crc16.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_bench_mapupdatekernel
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_bench_mapupdatekernel.cpp
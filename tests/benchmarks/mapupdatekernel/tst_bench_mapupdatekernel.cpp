@@ -0,0 +1,224 @@
+#include "mapupdatekernel.h"
+#include "modbusconfigmodel.h"
+
+#include <QtTest>
+
+#include <cmath>
+#include <limits>
+#include <random>
+
+using namespace ModbusConfig;
+
+namespace {
+const QString mapId = QStringLiteral("map");
+
+// карта из valueCount значений, датчик на каждом step-м значении с линейной коррекцией,
+// границами и порогом - тот же набор операций, что выполняет ядро
+QUuid fillModel(ModbusConfigModel *model, RegisterAddress::ValType valType, int valueCount,
+    int step)
+{
+    const QUuid devId = QUuid::createUuid();
+    ConnectionParams params;
+    params.type = ConnectionParams::Type::Tcp;
+    params.address = QStringLiteral("127.0.0.1");
+    params.port = 502;
+    model->upsertDevice(devId, QUuid(), params, QStringLiteral("device"));
+
+    SensorsMap map;
+    map.id = mapId;
+    map.registеrAddress.slaveAddress = 1;
+    map.registеrAddress.regType = RegisterAddress::RegisterType::AnalogInputRegisters;
+    map.registеrAddress.regAddress = 30001;
+    map.registеrAddress.valType = valType;
+    map.valueCount = valueCount;
+    model->upsertSensorMap(devId, QString(), map);
+
+    for (int offset = 0; offset < valueCount; offset += step) {
+        Sensor sensor;
+        sensor.id = QUuid::createUuid();
+        sensor.description = QStringLiteral("sensor");
+        sensor.type = Sensor::Type::Map;
+        sensor.mode = Sensor::Mode::Read;
+        sensor.mapId = mapId;
+        sensor.mapOffset = offset;
+        sensor.correctFunction = QStringLiteral("val * 0.1 + 2");
+        sensor.minValue = 0;
+        sensor.maxValue = 5000;
+        sensor.updateThreshold = 0.5;
+        model->upsertSensor(devId, QUuid(), sensor);
+    }
+    return devId;
+}
+
+QByteArray randomBlock(std::mt19937 &random, int bytes)
+{
+    QByteArray raw(bytes, Qt::Uninitialized);
+    for (auto &byte : raw) {
+        byte = char(random());
+    }
+    return raw;
+}
+
+// для сравнения: то же преобразование отдельными проходами по всему блоку -
+// декодирование, коррекция, ограничение, порог
+class FourPassUpdate
+{
+public:
+    FourPassUpdate(const ModbusConfigModel &model, const QUuid &devId)
+    {
+        const auto &device = model.device(devId);
+        mDecoder = RegisterDecoder(device.maps.value(mapId).registеrAddress);
+        for (const auto &sensor : device.sensors) {
+            mOffsets.append(sensor.mapOffset);
+            const auto program = model.sensorCorrection(sensor.id);
+            mScales.append(program->scale());
+            mShifts.append(program->offset());
+            mMinValues.append(sensor.minValue.toDouble());
+            mMaxValues.append(sensor.maxValue.toDouble());
+            mThresholds.append(sensor.updateThreshold);
+        }
+        mLastSent.fill(std::numeric_limits<double>::quiet_NaN(), mOffsets.size());
+        mValues.resize(mOffsets.size());
+    }
+
+    void process(const quint8 *raw, int count, QVector<QPair<int, double>> *changes)
+    {
+        mDecoded.resize(count);
+        mDecoder.decode(raw, count, mDecoded.data());
+        const int size = mOffsets.size();
+        for (int i = 0; i < size; ++i) {
+            mValues[i] = mScales.at(i) * mDecoded.at(mOffsets.at(i)) + mShifts.at(i);
+        }
+        for (int i = 0; i < size; ++i) {
+            // NaN не ограничивается и отсекается порогом, как в ядре
+            if (!std::isnan(mValues.at(i))) {
+                mValues[i] = qBound(mMinValues.at(i), mValues.at(i), mMaxValues.at(i));
+            }
+        }
+        for (int i = 0; i < size; ++i) {
+            const double value = mValues.at(i);
+            const double last = mLastSent.at(i);
+            if (!std::isnan(value) && value != last
+                && !(std::fabs(value - last) < mThresholds.at(i))) {
+                mLastSent[i] = value;
+                changes->append(qMakePair(i, value));
+            }
+        }
+    }
+
+private:
+    RegisterDecoder mDecoder;
+    QVector<int> mOffsets;
+    QVector<double> mScales;
+    QVector<double> mShifts;
+    QVector<double> mMinValues;
+    QVector<double> mMaxValues;
+    QVector<double> mThresholds;
+    QVector<double> mLastSent;
+    QVector<double> mDecoded;
+    QVector<double> mValues;
+};
+}
+
+Q_DECLARE_METATYPE(ModbusConfig::RegisterAddress::ValType)
+
+class MapUpdateKernelBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fused_data();
+    void fused();
+    void fourPass_data();
+    void fourPass();
+};
+
+void MapUpdateKernelBenchmark::fused_data()
+{
+    QTest::addColumn<RegisterAddress::ValType>("valType");
+    QTest::addColumn<int>("valueCount");
+    QTest::addColumn<int>("step");
+
+    const QVector<QPair<RegisterAddress::ValType, QString>> types = {
+        {RegisterAddress::ValType::UInt16, QStringLiteral("uint16")},
+        {RegisterAddress::ValType::Float, QStringLiteral("float")}};
+    for (const auto &type : types) {
+        for (int valueCount : {1, 10, 100, 1000, 10000}) {
+            QTest::newRow(qPrintable(QStringLiteral("%0 %1 values, all bound")
+                                         .arg(type.second).arg(valueCount)))
+                << type.first << valueCount << 1;
+            if (valueCount >= 100) {
+                QTest::newRow(qPrintable(QStringLiteral("%0 %1 values, every 8th bound")
+                                             .arg(type.second).arg(valueCount)))
+                    << type.first << valueCount << 8;
+            }
+        }
+    }
+}
+
+// блоки чередуются, чтобы значительная часть датчиков менялась на каждом проходе
+void MapUpdateKernelBenchmark::fused()
+{
+    QFETCH(RegisterAddress::ValType, valType);
+    QFETCH(int, valueCount);
+    QFETCH(int, step);
+
+    ModbusConfigModel model;
+    const QUuid devId = fillModel(&model, valType, valueCount, step);
+    MapUpdateKernel kernel(model, devId, mapId);
+    const int bytes = valueCount * RegisterDecoder(valType, QString()).valueSize();
+    std::mt19937 random(1);
+    const QByteArray blocks[] = {randomBlock(random, bytes), randomBlock(random, bytes)};
+
+    QVector<QPair<int, double>> changes;
+    int pass = 0;
+    QBENCHMARK {
+        changes.clear();
+        kernel.process(reinterpret_cast<const quint8 *>(blocks[pass++ & 1].constData()), 0,
+            valueCount, &changes);
+    }
+}
+
+void MapUpdateKernelBenchmark::fourPass_data()
+{
+    fused_data();
+}
+
+void MapUpdateKernelBenchmark::fourPass()
+{
+    QFETCH(RegisterAddress::ValType, valType);
+    QFETCH(int, valueCount);
+    QFETCH(int, step);
+
+    ModbusConfigModel model;
+    const QUuid devId = fillModel(&model, valType, valueCount, step);
+    FourPassUpdate update(model, devId);
+    const int bytes = valueCount * RegisterDecoder(valType, QString()).valueSize();
+    std::mt19937 random(1);
+    const QByteArray blocks[] = {randomBlock(random, bytes), randomBlock(random, bytes)};
+
+    // обе реализации должны давать одинаковое число обновлений
+    MapUpdateKernel kernel(model, devId, mapId);
+    QVector<QPair<int, double>> expected;
+    QVector<QPair<int, double>> changes;
+    for (const auto &block : blocks) {
+        expected.clear();
+        changes.clear();
+        kernel.process(reinterpret_cast<const quint8 *>(block.constData()), 0, valueCount,
+            &expected);
+        update.process(reinterpret_cast<const quint8 *>(block.constData()), valueCount,
+            &changes);
+        QCOMPARE(changes.size(), expected.size());
+    }
+
+    int pass = 0;
+    QBENCHMARK {
+        changes.clear();
+        update.process(reinterpret_cast<const quint8 *>(blocks[pass++ & 1].constData()),
+            valueCount, &changes);
+    }
+}
+
+QTEST_APPLESS_MAIN(MapUpdateKernelBenchmark)
+
+#include "tst_bench_mapupdatekernel.moc"
@@ -0,0 +1,6 @@
+TARGET = tst_bench_modbusframe
+
+include(../../tests.pri)
+
+SOURCES += \
+    tst_bench_modbusframe.cpp
@@ -0,0 +1,147 @@
+#include "modbusframe.h"
+
+#include <QtTest>
+
+#include <random>
+
+using namespace ModbusConfig;
+
+namespace {
+// одна итерация замера - 1000 кадров, кадров в секунду = 1e9 / (нс на итерацию) * 1000
+constexpr int framesPerIteration = 1000;
+
+// поток ответов на чтение count регистров, как он приходит из сокета или порта
+QByteArray responseStream(bool tcp, int count)
+{
+    std::mt19937 random(1);
+    QByteArray stream;
+    quint8 frame[maxTcpFrameSize];
+    for (int i = 0; i < framesPerIteration; ++i) {
+        quint8 *pdu = frame + (tcp ? tcpPduOffset : rtuPduOffset);
+        pdu[0] = quint8(FunctionCode::ReadHoldingRegisters);
+        pdu[1] = quint8(count * 2);
+        for (int j = 0; j < count * 2; ++j) {
+            pdu[2 + j] = quint8(random());
+        }
+        const int size = tcp ? finishTcpFrame(frame, quint16(i), 1, 2 + count * 2)
+                             : finishRtuFrame(frame, 1, 2 + count * 2);
+        stream.append(reinterpret_cast<const char *>(frame), size);
+    }
+    return stream;
+}
+}
+
+class ModbusFrameBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parseTcp_data();
+    void parseTcp();
+    void parseRtu_data();
+    void parseRtu();
+    void encodeRequest_data();
+    void encodeRequest();
+};
+
+void ModbusFrameBenchmark::parseTcp_data()
+{
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("1 register") << 1;
+    QTest::newRow("10 registers") << 10;
+    QTest::newRow("125 registers") << 125;
+}
+
+// разбор потока ответов и проверка ответа на запрос
+void ModbusFrameBenchmark::parseTcp()
+{
+    QFETCH(int, count);
+
+    const QByteArray stream = responseStream(true, count);
+    const auto *begin = reinterpret_cast<const quint8 *>(stream.constData());
+    int parsed = 0;
+    QBENCHMARK {
+        parsed = 0;
+        int position = 0;
+        ModbusFrame frame;
+        const quint8 *data = nullptr;
+        while (position < stream.size()) {
+            const int length = parseTcpFrame(begin + position, stream.size() - position, &frame);
+            if (length <= 0 || readResponseData(frame.pdu, frame.pduSize,
+                                   FunctionCode::ReadHoldingRegisters, count, &data) != 0) {
+                break;
+            }
+            position += length;
+            ++parsed;
+        }
+    }
+    QCOMPARE(parsed, framesPerIteration);
+}
+
+void ModbusFrameBenchmark::parseRtu_data()
+{
+    parseTcp_data();
+}
+
+// длина кадра по его началу, затем проверка CRC
+void ModbusFrameBenchmark::parseRtu()
+{
+    QFETCH(int, count);
+
+    const QByteArray stream = responseStream(false, count);
+    const auto *begin = reinterpret_cast<const quint8 *>(stream.constData());
+    int parsed = 0;
+    QBENCHMARK {
+        parsed = 0;
+        int position = 0;
+        ModbusFrame frame;
+        const quint8 *data = nullptr;
+        while (position < stream.size()) {
+            const int length = rtuResponseLength(begin + position, stream.size() - position);
+            if (length <= 0 || !parseRtuFrame(begin + position, length, &frame)
+                || readResponseData(frame.pdu, frame.pduSize,
+                       FunctionCode::ReadHoldingRegisters, count, &data) != 0) {
+                break;
+            }
+            position += length;
+            ++parsed;
+        }
+    }
+    QCOMPARE(parsed, framesPerIteration);
+}
+
+void ModbusFrameBenchmark::encodeRequest_data()
+{
+    QTest::addColumn<bool>("tcp");
+
+    QTest::newRow("tcp") << true;
+    QTest::newRow("rtu") << false;
+}
+
+void ModbusFrameBenchmark::encodeRequest()
+{
+    QFETCH(bool, tcp);
+
+    quint8 frame[maxTcpFrameSize];
+    int total = 0;
+    QBENCHMARK {
+        total = 0;
+        for (int i = 0; i < framesPerIteration; ++i) {
+            if (tcp) {
+                const int pduSize = encodeReadRequest(frame + tcpPduOffset,
+                    FunctionCode::ReadHoldingRegisters, i, 125);
+                total += finishTcpFrame(frame, quint16(i), 1, pduSize);
+            } else {
+                const int pduSize = encodeReadRequest(frame + rtuPduOffset,
+                    FunctionCode::ReadHoldingRegisters, i, 125);
+                total += finishRtuFrame(frame, 1, pduSize);
+            }
+        }
+    }
+    QCOMPARE(total, framesPerIteration * (tcp ? mbapHeaderSize + 5 : rtuOverhead + 5));
+}
+
+QTEST_APPLESS_MAIN(ModbusFrameBenchmark)
+
+#include "tst_bench_modbusframe.moc"
@@ -0,0 +1,100 @@
+#include "modbusconfigmodel.h"
+#include "pollplanner.h"
+
+#include <QtTest>
+
+using namespace ModbusConfig;
+
+namespace {
+// датчики по одному регистру на 16 слейвах и двух типах регистров: 32 группы опроса
+void fillModel(ModbusConfigModel *model, const QUuid &devId, int sensorCount,
+    QVector<Sensor> *sensors)
+{
+    ConnectionParams params;
+    params.type = ConnectionParams::Type::Tcp;
+    params.address = QStringLiteral("127.0.0.1");
+    params.port = 502;
+    model->upsertDevice(devId, QUuid(), params, QStringLiteral("device"));
+    for (int i = 0; i < sensorCount; ++i) {
+        Sensor sensor;
+        sensor.id = QUuid::createUuid();
+        sensor.description = QStringLiteral("sensor");
+        sensor.type = Sensor::Type::Separate;
+        sensor.mode = Sensor::Mode::Read;
+        sensor.registerAddress.slaveAddress = quint8(1 + i % 16);
+        const bool input = (i / 16) % 2 != 0;
+        sensor.registerAddress.regType = input
+            ? RegisterAddress::RegisterType::AnalogInputRegisters
+            : RegisterAddress::RegisterType::AnalogOutputHoldingRegisters;
+        sensor.registerAddress.regAddress = (input ? 30001 : 40001) + (i / 32) % 9998;
+        sensor.registerAddress.valType = RegisterAddress::ValType::UInt16;
+        model->upsertSensor(devId, QUuid(), sensor);
+        sensors->append(sensor);
+    }
+    model->pollPlan();
+}
+}
+
+class PollPlanBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void singleEdit_data();
+    void singleEdit();
+    void fullRebuild_data();
+    void fullRebuild();
+};
+
+void PollPlanBenchmark::singleEdit_data()
+{
+    QTest::addColumn<int>("sensorCount");
+
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+    QTest::newRow("1M") << 1000000;
+}
+
+// задержка от правки одного датчика до актуального плана
+void PollPlanBenchmark::singleEdit()
+{
+    QFETCH(int, sensorCount);
+
+    ModbusConfigModel model;
+    const QUuid devId = QUuid::createUuid();
+    QVector<Sensor> sensors;
+    fillModel(&model, devId, sensorCount, &sensors);
+
+    int edit = 0;
+    QBENCHMARK {
+        Sensor sensor = sensors.at(int(qint64(edit) * 7919 % sensors.size()));
+        sensor.registerAddress.regAddress += edit % 2;
+        ++edit;
+        model.upsertSensor(devId, sensor.id, sensor);
+        model.pollPlan();
+    }
+}
+
+void PollPlanBenchmark::fullRebuild_data()
+{
+    singleEdit_data();
+}
+
+// для сравнения: план всего устройства с нуля
+void PollPlanBenchmark::fullRebuild()
+{
+    QFETCH(int, sensorCount);
+
+    ModbusConfigModel model;
+    const QUuid devId = QUuid::createUuid();
+    QVector<Sensor> sensors;
+    fillModel(&model, devId, sensorCount, &sensors);
+
+    QBENCHMARK {
+        PollPlanner().plan(model.device(devId));
+    }
+}
+
+QTEST_APPLESS_MAIN(PollPlanBenchmark)
+
+#include "tst_bench_pollplan.moc"
@@ -0,0 +1,144 @@
+#include "registerdecoder.h"
+#include "utils.h"
+
+#include <QtTest>
+
+#include <random>
+
+using namespace ModbusConfig;
+
+namespace {
+// одна итерация замера - 10 млн регистров, время итерации - время на 10 млн регистров
+constexpr int registersPerIteration = 10000000;
+
+QByteArray randomRegisters()
+{
+    QByteArray raw(registersPerIteration * 2, Qt::Uninitialized);
+    std::mt19937 random(1);
+    for (auto &byte : raw) {
+        byte = char(random());
+    }
+    return raw;
+}
+}
+
+Q_DECLARE_METATYPE(ModbusConfig::RegisterAddress::ValType)
+
+class RegisterDecoderBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void decodeNative_data();
+    void decodeNative();
+    void decode_data();
+    void decode();
+    void decodeOne_data();
+    void decodeOne();
+
+private:
+    QByteArray mRaw;
+};
+
+void RegisterDecoderBenchmark::initTestCase()
+{
+    mRaw = randomRegisters();
+}
+
+void RegisterDecoderBenchmark::decodeNative_data()
+{
+    using T = RegisterAddress::ValType;
+    QTest::addColumn<RegisterAddress::ValType>("valType");
+    QTest::addColumn<QString>("typeOrder");
+
+    const QStringList orders16 = {QString(), QStringLiteral("21")};
+    const QStringList orders32 = {QString(), QStringLiteral("4321"), QStringLiteral("2143"),
+        QStringLiteral("3412")};
+    const QStringList orders64 = {QString(), QStringLiteral("87654321"),
+        QStringLiteral("21436587"), QStringLiteral("78563412")};
+    auto addRows = [](T type, const QStringList &orders) {
+        for (const auto &order : orders) {
+            const QString orderName = order.isEmpty() ? QStringLiteral("default") : order;
+            const QString name = QStringLiteral("%0 %1").arg(toString(type), orderName);
+            QTest::newRow(qPrintable(name)) << type << order;
+        }
+    };
+    for (T type : {T::Bool, T::Int8, T::UInt8}) {
+        addRows(type, {QString()});
+    }
+    for (T type : {T::Int16, T::UInt16}) {
+        addRows(type, orders16);
+    }
+    for (T type : {T::Int32, T::UInt32, T::Float}) {
+        addRows(type, orders32);
+    }
+    for (T type : {T::Int64, T::UInt64, T::Double}) {
+        addRows(type, orders64);
+    }
+}
+
+// перестановка байт без преобразования в double
+void RegisterDecoderBenchmark::decodeNative()
+{
+    QFETCH(RegisterAddress::ValType, valType);
+    QFETCH(QString, typeOrder);
+
+    const RegisterDecoder decoder(valType, typeOrder);
+    QVERIFY(decoder.isValid());
+    const int count = registersPerIteration / decoder.registersPerValue();
+    QByteArray out(count * qMax(decoder.valueSize(), 2), Qt::Uninitialized);
+    const auto *raw = reinterpret_cast<const quint8 *>(mRaw.constData());
+    QBENCHMARK {
+        decoder.decodeNative(raw, count, out.data());
+    }
+}
+
+void RegisterDecoderBenchmark::decode_data()
+{
+    decodeNative_data();
+}
+
+void RegisterDecoderBenchmark::decode()
+{
+    QFETCH(RegisterAddress::ValType, valType);
+    QFETCH(QString, typeOrder);
+
+    const RegisterDecoder decoder(valType, typeOrder);
+    QVERIFY(decoder.isValid());
+    const int count = registersPerIteration / decoder.registersPerValue();
+    QVector<double> out(count);
+    const auto *raw = reinterpret_cast<const quint8 *>(mRaw.constData());
+    QBENCHMARK {
+        decoder.decode(raw, count, out.data());
+    }
+}
+
+void RegisterDecoderBenchmark::decodeOne_data()
+{
+    decodeNative_data();
+}
+
+// для сравнения: по одному значению, как до блочного декодера
+void RegisterDecoderBenchmark::decodeOne()
+{
+    QFETCH(RegisterAddress::ValType, valType);
+    QFETCH(QString, typeOrder);
+
+    const RegisterDecoder decoder(valType, typeOrder);
+    QVERIFY(decoder.isValid());
+    const int count = registersPerIteration / decoder.registersPerValue();
+    const int stride = decoder.registersPerValue() * 2;
+    QVector<double> out(count);
+    const auto *raw = reinterpret_cast<const quint8 *>(mRaw.constData());
+    QBENCHMARK {
+        for (int i = 0; i < count; ++i) {
+            out[i] = decoder.decodeOne(raw + i * stride);
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(RegisterDecoderBenchmark)
+
+#include "tst_bench_registerdecoder.moc"
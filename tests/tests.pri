@@ -0,0 +1,13 @@
+# Общие настройки тестов и замеров: ядро конфигурации без виджетов редактора.
+# Тесты из auto запускаются через make check, замеры из benchmarks - вручную,
+# например ./tst_bench_crc16 -median 5
+
+QT       += core gui network concurrent testlib
+
+# utils.h из ядра конфигурации использует QComboBox
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+include($$PWD/../modbus-config-editor/modbusconfigcore.pri)